@@ -0,0 +1,811 @@
+#include "AsyncHttp.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <new>
+
+#include <FlightRecorder.h>
+#include <GzipInflater.h>
+
+#ifdef ASYNC_HTTP_TLS
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/x509_crt.h>
+#endif
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <esp_attr.h>
+uint32_t asyncHttpMillis(){
+  return millis();
+}
+#ifdef ASYNC_HTTP_TLS
+static uint32_t freeHeap(){
+  return ESP.getFreeHeap();
+}
+#endif
+#else
+#include <time.h>
+uint32_t asyncHttpMillis(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+#ifdef ASYNC_HTTP_TLS
+/*heap peaks are only measured on the ESP32*/
+static uint32_t freeHeap(){
+  return 0;
+}
+#endif
+/*nothing survives the process, but the RTC copies still get made*/
+#define RTC_DATA_ATTR
+#endif
+
+/*resolved addresses, so DNS only blocks on the first request to a host*/
+#define DNS_CACHE_SIZE 4
+
+struct DnsEntry {
+  char host[ASYNC_HTTP_MAX_HOST];
+  struct sockaddr_in addr;
+};
+
+static DnsEntry dnsCache[DNS_CACHE_SIZE];
+/*numbers the requests in the flight recorder*/
+static uint16_t requestCount = 0;
+static int dnsNext = 0;
+
+static bool resolve(const char *host, uint16_t port, struct sockaddr_in &addr){
+  for(int i = 0; i < DNS_CACHE_SIZE; i++){
+    if(strcmp(dnsCache[i].host, host) == 0){
+      addr = dnsCache[i].addr;
+      addr.sin_port = htons(port);
+      return true;
+    }
+  }
+
+  FlightScope scope(FLIGHT_DNS);
+  struct addrinfo hints, *result = NULL;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  if(getaddrinfo(host, NULL, &hints, &result) != 0 || result == NULL){
+    return false;
+  }
+  memcpy(&addr, result->ai_addr, sizeof(addr));
+  freeaddrinfo(result);
+
+  DnsEntry &entry = dnsCache[dnsNext];
+  dnsNext = (dnsNext + 1) % DNS_CACHE_SIZE;
+  snprintf(entry.host, sizeof(entry.host), "%s", host);
+  entry.addr = addr;
+
+  addr.sin_port = htons(port);
+  return true;
+}
+
+/*the host may have moved, its next request asks DNS again*/
+static void forgetAddress(const char *host){
+  for(int i = 0; i < DNS_CACHE_SIZE; i++){
+    if(strcmp(dnsCache[i].host, host) == 0){
+      dnsCache[i].host[0] = '\0';
+    }
+  }
+}
+
+/*splits http[s]://host[:port]/path, path points into url*/
+static bool parseUrl(const char *url, char *host, uint16_t &port, const char *&path, bool &secure){
+  const char *p;
+  if(strncmp(url, "http://", 7) == 0){
+    p = url + 7;
+    secure = false;
+  }else if(strncmp(url, "https://", 8) == 0){
+    p = url + 8;
+    secure = true;
+  }else{
+    return false;
+  }
+  size_t hostLen = strcspn(p, ":/");
+  if(hostLen == 0 || hostLen >= ASYNC_HTTP_MAX_HOST){
+    return false;
+  }
+  memcpy(host, p, hostLen);
+  host[hostLen] = '\0';
+  p += hostLen;
+
+  port = secure ? 443 : 80;
+  if(*p == ':'){
+    port = (uint16_t)atoi(p + 1);
+    p += strcspn(p, "/");
+  }
+  path = *p ? p : "/";
+  return true;
+}
+
+#ifdef ASYNC_HTTP_TLS
+/*Shared by all requests: random numbers, the configuration and the CA
+certificates. Set up by the first https request, the entropy seeding
+takes a while*/
+static struct {
+  bool ready;
+  bool haveCa;
+  mbedtls_entropy_context entropy;
+  mbedtls_ctr_drbg_context drbg;
+  mbedtls_ssl_config config;
+  mbedtls_x509_crt ca;
+} tlsShared;
+
+static bool initTls(){
+  if(tlsShared.ready){
+    return true;
+  }
+  mbedtls_entropy_init(&tlsShared.entropy);
+  mbedtls_ctr_drbg_init(&tlsShared.drbg);
+  mbedtls_ssl_config_init(&tlsShared.config);
+  mbedtls_x509_crt_init(&tlsShared.ca);
+  const char *personal = "AsyncHttp";
+  if(mbedtls_ctr_drbg_seed(&tlsShared.drbg, mbedtls_entropy_func, &tlsShared.entropy,
+                           (const unsigned char *)personal, strlen(personal)) != 0 ||
+     mbedtls_ssl_config_defaults(&tlsShared.config, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                 MBEDTLS_SSL_PRESET_DEFAULT) != 0){
+    mbedtls_ssl_config_free(&tlsShared.config);
+    mbedtls_ctr_drbg_free(&tlsShared.drbg);
+    mbedtls_entropy_free(&tlsShared.entropy);
+    return false;
+  }
+  mbedtls_ssl_conf_rng(&tlsShared.config, mbedtls_ctr_drbg_random, &tlsShared.drbg);
+  mbedtls_ssl_conf_authmode(&tlsShared.config, MBEDTLS_SSL_VERIFY_REQUIRED);
+  mbedtls_ssl_conf_session_tickets(&tlsShared.config, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+  tlsShared.ready = true;
+  return true;
+}
+
+/*the last session with each host, offered on the next connection*/
+#define TLS_SESSION_CACHE_SIZE DNS_CACHE_SIZE
+
+struct TlsSessionEntry {
+  char host[ASYNC_HTTP_MAX_HOST];
+  uint16_t port;
+  bool valid;
+  mbedtls_ssl_session session;
+};
+
+static TlsSessionEntry tlsSessions[TLS_SESSION_CACHE_SIZE];
+static int tlsSessionNext = 0;
+
+#ifdef ASYNC_HTTP_TLS_RTC_SESSIONS
+/*Serialized copies in RTC slow memory, which keeps its contents through
+deep sleep and is cleared at power on. A session with the server's
+certificate in it takes 1.5 to 2 kB, ones that don't fit aren't kept*/
+#ifndef ASYNC_HTTP_TLS_RTC_SESSION_BYTES
+#define ASYNC_HTTP_TLS_RTC_SESSION_BYTES 2048
+#endif
+#define TLS_RTC_MAGIC 0x544c5331
+
+struct RtcSession {
+  uint32_t magic;
+  char host[ASYNC_HTTP_MAX_HOST];
+  uint16_t port;
+  uint16_t length;
+  unsigned char data[ASYNC_HTTP_TLS_RTC_SESSION_BYTES];
+};
+
+RTC_DATA_ATTR static RtcSession rtcSessions[2];
+#endif
+
+static TlsSessionEntry *findSession(const char *host, uint16_t port){
+  for(int i = 0; i < TLS_SESSION_CACHE_SIZE; i++){
+    TlsSessionEntry &entry = tlsSessions[i];
+    if(entry.valid && entry.port == port && strcmp(entry.host, host) == 0){
+      return &entry;
+    }
+  }
+  return NULL;
+}
+
+static TlsSessionEntry &claimSession(const char *host, uint16_t port){
+  TlsSessionEntry *entry = findSession(host, port);
+  if(entry == NULL){
+    entry = &tlsSessions[tlsSessionNext];
+    tlsSessionNext = (tlsSessionNext + 1) % TLS_SESSION_CACHE_SIZE;
+  }
+  /*never used entries are zeroed, which is what init leaves too*/
+  mbedtls_ssl_session_free(&entry->session);
+  mbedtls_ssl_session_init(&entry->session);
+  strncpy(entry->host, host, sizeof(entry->host) - 1);
+  entry->host[sizeof(entry->host) - 1] = '\0';
+  entry->port = port;
+  entry->valid = false;
+  return *entry;
+}
+
+/*a session from RAM, or one that survived deep sleep in RTC memory*/
+static const mbedtls_ssl_session *cachedSession(const char *host, uint16_t port){
+  TlsSessionEntry *entry = findSession(host, port);
+  if(entry != NULL){
+    return &entry->session;
+  }
+#ifdef ASYNC_HTTP_TLS_RTC_SESSIONS
+  for(int i = 0; i < 2; i++){
+    RtcSession &rtc = rtcSessions[i];
+    if(rtc.magic == TLS_RTC_MAGIC && rtc.port == port && strcmp(rtc.host, host) == 0){
+      TlsSessionEntry &loaded = claimSession(host, port);
+      loaded.valid = mbedtls_ssl_session_load(&loaded.session, rtc.data, rtc.length) == 0;
+      if(!loaded.valid){
+        rtc.magic = 0;
+        return NULL;
+      }
+      return &loaded.session;
+    }
+  }
+#endif
+  return NULL;
+}
+
+static void storeSession(const char *host, uint16_t port, const mbedtls_ssl_context *ssl){
+  TlsSessionEntry &entry = claimSession(host, port);
+  entry.valid = mbedtls_ssl_get_session(ssl, &entry.session) == 0;
+#ifdef ASYNC_HTTP_TLS_RTC_SESSIONS
+  /*the host's own slot, else an empty one, else the other host's*/
+  RtcSession *rtc = NULL;
+  for(int i = 0; i < 2 && rtc == NULL; i++){
+    if(rtcSessions[i].magic == TLS_RTC_MAGIC && rtcSessions[i].port == port && strcmp(rtcSessions[i].host, host) == 0){
+      rtc = &rtcSessions[i];
+    }
+  }
+  if(rtc == NULL){
+    rtc = rtcSessions[0].magic != TLS_RTC_MAGIC ? &rtcSessions[0] : &rtcSessions[1];
+  }
+  size_t length = 0;
+  rtc->magic = 0;
+  if(entry.valid && mbedtls_ssl_session_save(&entry.session, rtc->data, sizeof(rtc->data), &length) == 0){
+    strncpy(rtc->host, host, sizeof(rtc->host) - 1);
+    rtc->host[sizeof(rtc->host) - 1] = '\0';
+    rtc->port = port;
+    rtc->length = (uint16_t)length;
+    rtc->magic = TLS_RTC_MAGIC;
+  }
+#endif
+}
+
+struct AsyncHttpTls {
+  mbedtls_ssl_context ssl;
+  char host[ASYNC_HTTP_MAX_HOST];
+  uint16_t port;
+  /*a cached session went out in the client hello*/
+  bool offered;
+  /*the server sent a certificate, which only a full handshake does*/
+  bool certificateSeen;
+};
+
+static int tlsSend(void *context, const unsigned char *data, size_t len){
+  ssize_t n = send(*(int *)context, data, len, 0);
+  if(n < 0){
+    return errno == EAGAIN || errno == EWOULDBLOCK ? MBEDTLS_ERR_SSL_WANT_WRITE : MBEDTLS_ERR_NET_SEND_FAILED;
+  }
+  return (int)n;
+}
+
+static int tlsReceive(void *context, unsigned char *data, size_t len){
+  ssize_t n = recv(*(int *)context, data, len, 0);
+  if(n < 0){
+    return errno == EAGAIN || errno == EWOULDBLOCK ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_RECV_FAILED;
+  }
+  return (int)n;
+}
+
+static int noteCertificate(void *context, mbedtls_x509_crt *certificate, int depth, uint32_t *flags){
+  (void)certificate;
+  (void)depth;
+  (void)flags;
+  ((AsyncHttpTls *)context)->certificateSeen = true;
+  return 0;
+}
+
+void asyncHttpForgetSessions(bool rtcToo){
+  for(int i = 0; i < TLS_SESSION_CACHE_SIZE; i++){
+    mbedtls_ssl_session_free(&tlsSessions[i].session);
+    mbedtls_ssl_session_init(&tlsSessions[i].session);
+    tlsSessions[i].valid = false;
+  }
+#ifdef ASYNC_HTTP_TLS_RTC_SESSIONS
+  if(rtcToo){
+    rtcSessions[0].magic = 0;
+    rtcSessions[1].magic = 0;
+  }
+#else
+  (void)rtcToo;
+#endif
+}
+
+bool asyncHttpSetCaCerts(const char *pem){
+  if(!initTls()){
+    return false;
+  }
+  /*a resumed session skips the certificate, so the ones checked against
+  the old CAs must not be offered again*/
+  asyncHttpForgetSessions(true);
+  mbedtls_x509_crt_free(&tlsShared.ca);
+  mbedtls_x509_crt_init(&tlsShared.ca);
+  tlsShared.haveCa = mbedtls_x509_crt_parse(&tlsShared.ca, (const unsigned char *)pem, strlen(pem) + 1) == 0;
+  mbedtls_ssl_conf_ca_chain(&tlsShared.config, tlsShared.haveCa ? &tlsShared.ca : NULL, NULL);
+  return tlsShared.haveCa;
+}
+#else
+void asyncHttpForgetSessions(bool rtcToo){
+  (void)rtcToo;
+}
+
+bool asyncHttpSetCaCerts(const char *pem){
+  (void)pem;
+  return false;
+}
+#endif
+
+AsyncHttpRequest::AsyncHttpRequest()
+  : fd(-1), traceId(0), tls(NULL), isSecure(false), wasResumed(false), handshakeStartedAt(0), handshakeMs(0),
+    heapBefore(0), heapUsed(0), tlsErr(0), gzip(NULL), inflating(false), state(ASYNC_HTTP_IDLE), err(ASYNC_HTTP_OK), statusCode(0), length(-1), retryAfterSeconds(-1),
+    received(0), startedAt(0), finishedAt(0), timeout(0),
+    bodyCallback(NULL), headerCallback(NULL), context(NULL),
+    requestLen(0), requestSent(0), lineLen(0){
+  host[0] = '\0';
+}
+
+AsyncHttpRequest::~AsyncHttpRequest(){
+  closeSocket();
+}
+
+bool AsyncHttpRequest::start(const char *url, uint32_t timeoutMs, AsyncHttpBodyCallback onBody, void *ctx){
+  if(busy()){
+    cancel();
+  }
+  err = ASYNC_HTTP_OK;
+  statusCode = 0;
+  length = -1;
+  retryAfterSeconds = -1;
+  received = 0;
+  wasResumed = false;
+  handshakeMs = 0;
+  heapUsed = 0;
+  tlsErr = 0;
+  inflating = false;
+  lineLen = 0;
+  requestSent = 0;
+  bodyCallback = onBody;
+  context = ctx;
+  timeout = timeoutMs;
+  startedAt = asyncHttpMillis();
+  traceId = ++requestCount;
+  enter(ASYNC_HTTP_CONNECTING);
+
+  host[0] = '\0';
+  uint16_t port;
+  const char *path;
+  if(!parseUrl(url, host, port, path, isSecure)){
+    fail(ASYNC_HTTP_BAD_URL);
+    return false;
+  }
+
+  int n = snprintf(request, sizeof(request),
+                   "GET %s HTTP/1.0\r\nHost: %s\r\nUser-Agent: ESP32WeatherStation\r\n%sConnection: close\r\n\r\n",
+                   path, host, gzip != NULL ? "Accept-Encoding: gzip\r\n" : "");
+  if(n < 0 || (size_t)n >= sizeof(request)){
+    fail(ASYNC_HTTP_BAD_URL);
+    return false;
+  }
+  requestLen = n;
+
+  struct sockaddr_in addr;
+  if(!resolve(host, port, addr)){
+    fail(ASYNC_HTTP_DNS_FAILED);
+    return false;
+  }
+  if(isSecure && !startTls(host, port)){
+    return false;
+  }
+
+  fd = socket(AF_INET, SOCK_STREAM, 0);
+  if(fd < 0){
+    fail(ASYNC_HTTP_CONNECT_FAILED);
+    return false;
+  }
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+  if(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS){
+    fail(ASYNC_HTTP_CONNECT_FAILED);
+    return false;
+  }
+  return true;
+}
+
+bool AsyncHttpRequest::poll(){
+  if(!busy()){
+    return false;
+  }
+  if(asyncHttpMillis() - startedAt >= timeout){
+    fail(ASYNC_HTTP_TIMEOUT);
+    return false;
+  }
+
+  if(state == ASYNC_HTTP_CONNECTING){
+    fd_set writable;
+    FD_ZERO(&writable);
+    FD_SET(fd, &writable);
+    struct timeval zero = {0, 0};
+    if(select(fd + 1, NULL, &writable, NULL, &zero) <= 0){
+      return true;
+    }
+    int soError = 0;
+    socklen_t len = sizeof(soError);
+    if(getsockopt(fd, SOL_SOCKET, SO_ERROR, &soError, &len) < 0 || soError != 0){
+      fail(ASYNC_HTTP_CONNECT_FAILED);
+      return false;
+    }
+    handshakeStartedAt = asyncHttpMillis();
+    enter(isSecure ? ASYNC_HTTP_HANDSHAKE : ASYNC_HTTP_SENDING);
+  }
+
+  if(state == ASYNC_HTTP_HANDSHAKE && !handshake()){
+    return busy();
+  }
+
+  if(state == ASYNC_HTTP_SENDING){
+    int n = sendSome(request + requestSent, requestLen - requestSent);
+    if(n < 0){
+      if(n == -1){
+        return true;
+      }
+      fail(isSecure ? ASYNC_HTTP_TLS_FAILED : ASYNC_HTTP_IO_FAILED);
+      return false;
+    }
+    requestSent += n;
+    if(requestSent < requestLen){
+      return true;
+    }
+    enter(ASYNC_HTTP_HEADERS);
+  }
+
+  readResponse();
+  return busy();
+}
+
+void AsyncHttpRequest::cancel(){
+  if(busy()){
+    fail(ASYNC_HTTP_CANCELLED);
+  }
+}
+
+uint32_t AsyncHttpRequest::elapsed() const {
+  return (busy() ? asyncHttpMillis() : finishedAt) - startedAt;
+}
+
+uint32_t AsyncHttpRequest::inflatedBytes() const {
+  return inflating ? gzip->bytesOut() : received;
+}
+
+/*feeds received bytes to the header parser, returns how many were used.
+Whatever is left after the blank line ending the headers is body*/
+size_t AsyncHttpRequest::parseHeaders(const uint8_t *data, size_t len){
+  for(size_t i = 0; i < len; i++){
+    char c = data[i];
+    if(c == '\r'){
+      continue;
+    }
+    if(c != '\n'){
+      /*overlong lines are cut, nothing we look at is that long*/
+      if(lineLen < sizeof(line) - 1){
+        line[lineLen++] = c;
+      }
+      continue;
+    }
+
+    line[lineLen] = '\0';
+    if(lineLen == 0){
+      if(statusCode == 0){
+        fail(ASYNC_HTTP_BAD_RESPONSE);
+      }else{
+        enter(ASYNC_HTTP_BODY);
+      }
+      return i + 1;
+    }
+    handleHeaderLine();
+    lineLen = 0;
+    if(!busy()){
+      return i + 1;
+    }
+  }
+  return len;
+}
+
+void AsyncHttpRequest::handleHeaderLine(){
+  if(statusCode == 0){
+    /*HTTP/1.x 200 OK*/
+    const char *space = strchr(line, ' ');
+    if(strncmp(line, "HTTP/", 5) != 0 || space == NULL || (statusCode = atoi(space + 1)) <= 0){
+      fail(ASYNC_HTTP_BAD_RESPONSE);
+    }
+    return;
+  }
+
+  char *colon = strchr(line, ':');
+  if(colon == NULL){
+    return;
+  }
+  *colon = '\0';
+  const char *value = colon + 1;
+  while(*value == ' ' || *value == '\t') value++;
+
+  if(strcasecmp(line, "Content-Length") == 0){
+    length = atol(value);
+  }else if(strcasecmp(line, "Retry-After") == 0 && *value >= '0' && *value <= '9'){
+    retryAfterSeconds = atol(value);
+  }else if(strcasecmp(line, "Content-Encoding") == 0 && gzip != NULL && strncasecmp(value, "gzip", 4) == 0){
+    inflating = true;
+    gzip->begin(bodyCallback, context);
+  }
+  if(headerCallback != NULL){
+    headerCallback(line, value, context);
+  }
+}
+
+void AsyncHttpRequest::deliverBody(const uint8_t *data, size_t len){
+  if(length >= 0 && received + len > (uint32_t)length){
+    len = length - received;
+  }
+  received += len;
+  if(inflating){
+    if(gzip->feed(data, len) == GZIP_ERROR){
+      fail(ASYNC_HTTP_INFLATE_FAILED);
+      return;
+    }
+  }else if(len > 0 && bodyCallback != NULL){
+    bodyCallback(data, len, context);
+  }
+  if(length >= 0 && received >= (uint32_t)length){
+    finish();
+  }
+}
+
+/*reads everything that has arrived so far*/
+void AsyncHttpRequest::readResponse(){
+  uint8_t buf[512];
+  while(busy()){
+    if(state == ASYNC_HTTP_BODY && length >= 0 && received >= (uint32_t)length){
+      finish();
+      return;
+    }
+    int n = receiveSome(buf, sizeof(buf));
+    if(n < 0){
+      if(n != -1){
+        fail(isSecure ? ASYNC_HTTP_TLS_FAILED : ASYNC_HTTP_IO_FAILED);
+      }
+      return;
+    }
+    if(n == 0){
+      /*HTTP/1.0 without Content-Length ends when the server closes*/
+      if(state != ASYNC_HTTP_BODY || (length >= 0 && received < (uint32_t)length)){
+        fail(state == ASYNC_HTTP_BODY ? ASYNC_HTTP_IO_FAILED : ASYNC_HTTP_BAD_RESPONSE);
+      }else{
+        finish();
+      }
+      return;
+    }
+
+    size_t used = 0;
+    if(state == ASYNC_HTTP_HEADERS){
+      used = parseHeaders(buf, n);
+    }
+    if(state == ASYNC_HTTP_BODY){
+      deliverBody(buf + used, n - used);
+    }
+  }
+}
+
+void AsyncHttpRequest::finish(){
+  /*a gzip stream cut short is only noticed at the end*/
+  if(inflating && !gzip->done()){
+    fail(ASYNC_HTTP_INFLATE_FAILED);
+    return;
+  }
+  closeSocket();
+  finishedAt = asyncHttpMillis();
+  enter(ASYNC_HTTP_DONE);
+}
+
+void AsyncHttpRequest::fail(AsyncHttpError error){
+  /*a refused or unanswered connection may be to an address the host
+  has since left*/
+  if(error == ASYNC_HTTP_CONNECT_FAILED || (error == ASYNC_HTTP_TIMEOUT && state == ASYNC_HTTP_CONNECTING)){
+    forgetAddress(host);
+  }
+  closeSocket();
+  finishedAt = asyncHttpMillis();
+  err = error;
+  enter(ASYNC_HTTP_FAILED);
+  flightRecord(FLIGHT_HTTP_FAILED, FLIGHT_INSTANT, error);
+}
+
+/*the flight recorder event for each phase that takes time*/
+static FlightEventId phaseEvent(AsyncHttpState state){
+  switch(state){
+    case ASYNC_HTTP_CONNECTING: return FLIGHT_HTTP_CONNECT;
+    case ASYNC_HTTP_HANDSHAKE: return FLIGHT_HTTP_HANDSHAKE;
+    case ASYNC_HTTP_SENDING: return FLIGHT_HTTP_SEND;
+    case ASYNC_HTTP_HEADERS: return FLIGHT_HTTP_HEADERS;
+    case ASYNC_HTTP_BODY: return FLIGHT_HTTP_BODY;
+    default: return FLIGHT_EVENT_COUNT;
+  }
+}
+
+void AsyncHttpRequest::enter(AsyncHttpState next){
+  FlightEventId ending = phaseEvent(state), starting = phaseEvent(next);
+  if(ending != FLIGHT_EVENT_COUNT){
+    flightRecord(ending, FLIGHT_END, traceId);
+  }
+  if(starting != FLIGHT_EVENT_COUNT){
+    flightRecord(starting, FLIGHT_BEGIN, traceId);
+  }
+  state = next;
+}
+
+#ifdef ASYNC_HTTP_TLS
+/*sets up the TLS context before connecting, so the heap it takes counts
+against the handshake*/
+bool AsyncHttpRequest::startTls(const char *host, uint16_t port){
+  heapBefore = freeHeap();
+  tls = new (std::nothrow) AsyncHttpTls;
+  if(tls == NULL){
+    fail(ASYNC_HTTP_TLS_FAILED);
+    return false;
+  }
+  mbedtls_ssl_init(&tls->ssl);
+  if(!initTls()){
+    fail(ASYNC_HTTP_TLS_FAILED);
+    return false;
+  }
+  /*nothing to check the server against, it doesn't get the request*/
+  if(!tlsShared.haveCa){
+    fail(ASYNC_HTTP_NO_CA);
+    return false;
+  }
+  strcpy(tls->host, host);
+  tls->port = port;
+  tls->certificateSeen = false;
+  tls->offered = false;
+
+  if((tlsErr = mbedtls_ssl_setup(&tls->ssl, &tlsShared.config)) != 0 ||
+     (tlsErr = mbedtls_ssl_set_hostname(&tls->ssl, host)) != 0){
+    fail(ASYNC_HTTP_TLS_FAILED);
+    return false;
+  }
+  mbedtls_ssl_set_bio(&tls->ssl, &fd, tlsSend, tlsReceive, NULL);
+  mbedtls_ssl_set_verify(&tls->ssl, noteCertificate, tls);
+
+  const mbedtls_ssl_session *session = cachedSession(host, port);
+  tls->offered = session != NULL && mbedtls_ssl_set_session(&tls->ssl, session) == 0;
+  return true;
+}
+
+/*one go at the handshake, true once it's done*/
+bool AsyncHttpRequest::handshake(){
+  int ret = mbedtls_ssl_handshake(&tls->ssl);
+  uint32_t heap = freeHeap();
+  if(heapBefore > heap && heapBefore - heap > heapUsed){
+    heapUsed = heapBefore - heap;
+  }
+  if(ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE){
+    return false;
+  }
+  if(ret != 0){
+    tlsErr = ret;
+    fail(ASYNC_HTTP_TLS_FAILED);
+    return false;
+  }
+  handshakeMs = asyncHttpMillis() - handshakeStartedAt;
+  wasResumed = tls->offered && !tls->certificateSeen;
+  storeSession(tls->host, tls->port, &tls->ssl);
+  enter(ASYNC_HTTP_SENDING);
+  return true;
+}
+
+#else
+bool AsyncHttpRequest::startTls(const char *host, uint16_t port){
+  (void)host;
+  (void)port;
+  fail(ASYNC_HTTP_TLS_FAILED);
+  return false;
+}
+
+bool AsyncHttpRequest::handshake(){
+  return false;
+}
+#endif
+
+/*Both return the bytes moved, 0 when the server has closed the
+connection, -1 when it would block and -2 on errors*/
+int AsyncHttpRequest::sendSome(const char *data, size_t len){
+#ifdef ASYNC_HTTP_TLS
+  if(tls != NULL){
+    int n = mbedtls_ssl_write(&tls->ssl, (const unsigned char *)data, len);
+    if(n == MBEDTLS_ERR_SSL_WANT_READ || n == MBEDTLS_ERR_SSL_WANT_WRITE){
+      return -1;
+    }
+    if(n < 0){
+      tlsErr = n;
+      return -2;
+    }
+    return n;
+  }
+#endif
+  ssize_t n = send(fd, data, len, 0);
+  if(n < 0){
+    return errno == EAGAIN || errno == EWOULDBLOCK ? -1 : -2;
+  }
+  return (int)n;
+}
+
+int AsyncHttpRequest::receiveSome(uint8_t *data, size_t len){
+#ifdef ASYNC_HTTP_TLS
+  if(tls != NULL){
+    int n = mbedtls_ssl_read(&tls->ssl, data, len);
+    if(n == MBEDTLS_ERR_SSL_WANT_READ || n == MBEDTLS_ERR_SSL_WANT_WRITE){
+      return -1;
+    }
+    /*most servers close the socket without a close_notify*/
+    if(n == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY || n == MBEDTLS_ERR_SSL_CONN_EOF){
+      return 0;
+    }
+    if(n < 0){
+      tlsErr = n;
+      return -2;
+    }
+    return n;
+  }
+#endif
+  ssize_t n = recv(fd, data, len, 0);
+  if(n < 0){
+    return errno == EAGAIN || errno == EWOULDBLOCK ? -1 : -2;
+  }
+  return (int)n;
+}
+
+void AsyncHttpRequest::closeSocket(){
+#ifdef ASYNC_HTTP_TLS
+  if(tls != NULL){
+    mbedtls_ssl_free(&tls->ssl);
+    delete tls;
+    tls = NULL;
+  }
+#endif
+  if(fd >= 0){
+    close(fd);
+    fd = -1;
+  }
+}
+
+const char *AsyncHttpRequest::errorName(AsyncHttpError error){
+  switch(error){
+    case ASYNC_HTTP_OK: return "ok";
+    case ASYNC_HTTP_BAD_URL: return "bad url";
+    case ASYNC_HTTP_DNS_FAILED: return "dns failed";
+    case ASYNC_HTTP_CONNECT_FAILED: return "connect failed";
+    case ASYNC_HTTP_IO_FAILED: return "io failed";
+    case ASYNC_HTTP_BAD_RESPONSE: return "bad response";
+    case ASYNC_HTTP_TIMEOUT: return "timeout";
+    case ASYNC_HTTP_CANCELLED: return "cancelled";
+    case ASYNC_HTTP_TLS_FAILED: return "tls failed";
+    case ASYNC_HTTP_INFLATE_FAILED: return "inflate failed";
+    case ASYNC_HTTP_NO_CA: return "no ca certificates";
+  }
+  return "?";
+}
@@ -0,0 +1,199 @@
+#ifndef ASYNC_HTTP_H
+#define ASYNC_HTTP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*Event driven HTTP GET on a non-blocking socket. start() opens the
+connection and returns right away, poll() advances the request as far as it
+can without waiting and returns false once it's finished, so the caller can
+keep sampling and drawing between polls. Every request has a deadline, when
+it passes the request fails with ASYNC_HTTP_TIMEOUT no matter which phase it
+is in, and cancel() can stop it at any time.
+
+The body is handed to the callback piece by piece as it arrives. Requests
+are sent as HTTP/1.0 so servers answer without chunked encoding and close
+the connection when done. With acceptGzip() the server may compress the
+answer, it is inflated on the way to the callback and the callback never
+sees the difference.
+
+Host names are resolved with getaddrinfo(), which blocks, so the address is
+cached and only the first request to a host waits for DNS. A connection
+that is refused or never answered drops the address, so a host that moved
+is looked up again. Each phase is
+recorded in lib/FlightRecorder under a request number. Works on top of
+lwIP on the ESP32 and on Linux.
+
+https:// urls go through mbedtls, which the ESP32 core already links, or
+on Linux when built with ASYNC_HTTP_TLS. The handshake is stepped from
+poll() like the rest of the request. A full handshake costs the ESP32
+hundreds of milliseconds of public key math and tens of kB of heap for
+the certificate chain, so the session (ID or ticket) of the last handshake with each host is kept and
+offered again, and a server that accepts it skips the certificate and key
+exchange. With ASYNC_HTTP_TLS_RTC_SESSIONS the sessions are also copied
+to RTC memory and survive deep sleep.
+
+The server certificate must chain to one of the CA certificates given to
+asyncHttpSetCaCerts() and be for the host in the url. Setting them drops
+the cached sessions, which were checked against the old ones. Until some
+are set
+https requests fail with ASYNC_HTTP_NO_CA before connecting, an
+unauthenticated server never sees the request*/
+
+#if defined(ARDUINO) && !defined(ASYNC_HTTP_NO_TLS)
+#define ASYNC_HTTP_TLS
+#endif
+
+enum AsyncHttpState {
+  ASYNC_HTTP_IDLE,
+  ASYNC_HTTP_CONNECTING,
+  ASYNC_HTTP_HANDSHAKE,
+  ASYNC_HTTP_SENDING,
+  ASYNC_HTTP_HEADERS,
+  ASYNC_HTTP_BODY,
+  ASYNC_HTTP_DONE,
+  ASYNC_HTTP_FAILED
+};
+
+enum AsyncHttpError {
+  ASYNC_HTTP_OK,
+  ASYNC_HTTP_BAD_URL,
+  ASYNC_HTTP_DNS_FAILED,
+  ASYNC_HTTP_CONNECT_FAILED,
+  ASYNC_HTTP_IO_FAILED,
+  ASYNC_HTTP_BAD_RESPONSE,
+  ASYNC_HTTP_TIMEOUT,
+  ASYNC_HTTP_CANCELLED,
+  ASYNC_HTTP_TLS_FAILED,
+  ASYNC_HTTP_INFLATE_FAILED,
+  ASYNC_HTTP_NO_CA
+};
+
+typedef void (*AsyncHttpBodyCallback)(const uint8_t *data, size_t len, void *context);
+typedef void (*AsyncHttpHeaderCallback)(const char *name, const char *value, void *context);
+
+#define ASYNC_HTTP_MAX_HOST 64
+#define ASYNC_HTTP_MAX_REQUEST 512
+#define ASYNC_HTTP_MAX_LINE 256
+
+class GzipInflater;
+
+class AsyncHttpRequest {
+ public:
+  AsyncHttpRequest();
+  ~AsyncHttpRequest();
+
+  /*starts GET url and gives it timeoutMs to finish. Returns false if the
+  url can't be used or the connection can't even be started, error() tells
+  why. A request that is still running is cancelled first*/
+  bool start(const char *url, uint32_t timeoutMs, AsyncHttpBodyCallback onBody, void *context);
+
+  /*optional, called for every response header before the body*/
+  void onHeader(AsyncHttpHeaderCallback callback) { headerCallback = callback; }
+  /*optional, asks for gzip and inflates a compressed answer with this
+  inflater. A broken stream, or one that reaches past the inflater's
+  window, fails with ASYNC_HTTP_INFLATE_FAILED. NULL asks for plain text
+  again*/
+  void acceptGzip(GzipInflater *inflater) { gzip = inflater; }
+
+  /*does whatever can be done without blocking,
+  returns true while the request is still running*/
+  bool poll();
+
+  void cancel();
+
+  bool busy() const { return state > ASYNC_HTTP_IDLE && state < ASYNC_HTTP_DONE; }
+  AsyncHttpState getState() const { return state; }
+  AsyncHttpError error() const { return err; }
+
+  /*HTTP status code once the status line has arrived, 0 before that*/
+  int status() const { return statusCode; }
+  /*-1 if the server didn't send Content-Length*/
+  int32_t contentLength() const { return length; }
+  /*seconds the server asked to wait with Retry-After, -1 if it didn't
+  or gave an HTTP date instead*/
+  int32_t retryAfter() const { return retryAfterSeconds; }
+  /*request bytes written to the connection*/
+  uint32_t sentBytes() const { return requestSent; }
+  /*body bytes as they came over the network*/
+  uint32_t bodyBytes() const { return received; }
+  /*true if the answer was gzip*/
+  bool compressed() const { return inflating; }
+  /*body bytes handed to the callback*/
+  uint32_t inflatedBytes() const;
+  /*milliseconds from start() to done or failed*/
+  uint32_t elapsed() const;
+
+  bool secure() const { return isSecure; }
+  /*true once a handshake has finished on a session offered from the
+  cache, the server skipped sending its certificate*/
+  bool resumed() const { return wasResumed; }
+  /*milliseconds from the TCP connection to the finished handshake*/
+  uint32_t handshakeTime() const { return handshakeMs; }
+  /*how far free heap went below what it was before the TLS context was
+  set up, sampled every time the handshake waits for the network. 0 on
+  Linux*/
+  uint32_t handshakeHeap() const { return heapUsed; }
+  /*the mbedtls error behind ASYNC_HTTP_TLS_FAILED*/
+  int tlsError() const { return tlsErr; }
+
+  static const char *errorName(AsyncHttpError error);
+
+ private:
+  void enter(AsyncHttpState next);
+  void fail(AsyncHttpError error);
+  void finish();
+  void closeSocket();
+  void readResponse();
+  size_t parseHeaders(const uint8_t *data, size_t len);
+  void handleHeaderLine();
+  void deliverBody(const uint8_t *data, size_t len);
+  bool startTls(const char *host, uint16_t port);
+  bool handshake();
+  int sendSome(const char *data, size_t len);
+  int receiveSome(uint8_t *data, size_t len);
+
+  int fd;
+  uint16_t traceId;
+  struct AsyncHttpTls *tls;
+  bool isSecure, wasResumed;
+  uint32_t handshakeStartedAt, handshakeMs;
+  uint32_t heapBefore, heapUsed;
+  int tlsErr;
+  GzipInflater *gzip;
+  bool inflating;
+  AsyncHttpState state;
+  AsyncHttpError err;
+  int statusCode;
+  int32_t length;
+  int32_t retryAfterSeconds;
+  uint32_t received;
+  uint32_t startedAt, finishedAt, timeout;
+
+  AsyncHttpBodyCallback bodyCallback;
+  AsyncHttpHeaderCallback headerCallback;
+  void *context;
+
+  char host[ASYNC_HTTP_MAX_HOST];
+  char request[ASYNC_HTTP_MAX_REQUEST];
+  size_t requestLen, requestSent;
+
+  char line[ASYNC_HTTP_MAX_LINE];
+  size_t lineLen;
+};
+
+/*milliseconds on the same clock the requests use*/
+uint32_t asyncHttpMillis();
+
+/*PEM certificates to check https servers against, several can be
+concatenated. A server without a valid chain to one of them for its host
+name fails with ASYNC_HTTP_TLS_FAILED. false if they don't parse, https
+is then refused, or if there is no TLS in this build*/
+bool asyncHttpSetCaCerts(const char *pem);
+
+/*drops the TLS sessions kept for resumption, the next request to each
+host does a full handshake. false keeps the RTC copies, which is what
+deep sleep does to the rest*/
+void asyncHttpForgetSessions(bool rtcToo);
+
+#endif
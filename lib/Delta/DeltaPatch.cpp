@@ -0,0 +1,249 @@
+#include "DeltaPatch.h"
+
+#include <string.h>
+
+static uint32_t readLe32(const uint8_t *p){
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+DeltaPatch::DeltaPatch(DeltaImages &images, uint8_t *window, size_t windowSize)
+  : images(images), inflate(window, window != NULL ? windowSize : 1), canInflate(window != NULL), haveOldHash(false){
+  begin();
+}
+
+void DeltaPatch::begin(){
+  gzip = false;
+  started = false;
+  state = STATE_HEADER;
+  err = DELTA_OK;
+  memset(&head, 0, sizeof(head));
+  hash.begin();
+  fed = 0;
+  written = 0;
+  oldPos = 0;
+  addLeft = extraLeft = seek = 0;
+  fieldLen = 0;
+}
+
+void DeltaPatch::setOldHash(const uint8_t digest[SHA256_BYTES]){
+  memcpy(oldHash, digest, SHA256_BYTES);
+  haveOldHash = true;
+}
+
+bool DeltaPatch::checkSignature(const uint8_t publicKey[ED25519_PUBLIC_BYTES]){
+  if(state == STATE_ERROR){
+    return false;
+  }
+  if(state == STATE_HEADER ||
+     !ed25519Verify(publicKey, signedPart, DELTA_SIGNED_SIZE, head.signature)){
+    fail(DELTA_BAD_SIGNATURE);
+    return false;
+  }
+  return true;
+}
+
+DeltaResult DeltaPatch::feed(const uint8_t *data, size_t len){
+  if(state == STATE_DONE){
+    return DELTA_DONE;
+  }
+  if(state == STATE_ERROR){
+    return DELTA_ERROR;
+  }
+  if(!started && len > 0){
+    started = true;
+    gzip = data[0] == 0x1f;
+    if(gzip){
+      if(!canInflate){
+        return fail(DELTA_BAD_HEADER);
+      }
+      inflate.begin(inflated, this);
+    }
+  }
+  fed += len;
+
+  if(!gzip){
+    apply(data, len);
+  }else{
+    GzipResult r = inflate.feed(data, len);
+    if(state != STATE_ERROR){
+      if(r == GZIP_ERROR){
+        return fail(DELTA_INFLATE_FAILED);
+      }
+      if(r == GZIP_DONE && state != STATE_DONE){
+        return fail(DELTA_TRUNCATED);
+      }
+    }
+  }
+  if(state == STATE_ERROR){
+    return DELTA_ERROR;
+  }
+  return state == STATE_DONE ? DELTA_DONE : DELTA_MORE;
+}
+
+void DeltaPatch::inflated(const uint8_t *data, size_t len, void *context){
+  static_cast<DeltaPatch *>(context)->apply(data, len);
+}
+
+void DeltaPatch::apply(const uint8_t *data, size_t len){
+  while(len > 0 && state != STATE_DONE && state != STATE_ERROR){
+    size_t n;
+    switch(state){
+      case STATE_HEADER:
+      case STATE_CONTROL: {
+        size_t want = state == STATE_HEADER ? DELTA_HEADER_SIZE : DELTA_CONTROL_SIZE;
+        n = want - fieldLen < len ? want - fieldLen : len;
+        memcpy(field + fieldLen, data, n);
+        fieldLen += n;
+        if(fieldLen == want){
+          fieldLen = 0;
+          if(state == STATE_HEADER ? !parseHeader() : !parseControl()){
+            return;
+          }
+          advance();
+        }
+        break;
+      }
+      case STATE_ADD:
+        n = (size_t)addLeft < len ? addLeft : len;
+        if(n > DELTA_CHUNK){
+          n = DELTA_CHUNK;
+        }
+        if(!images.readOld(oldPos, scratch, n)){
+          fail(DELTA_READ_FAILED);
+          return;
+        }
+        for(size_t i = 0; i < n; i++){
+          scratch[i] += data[i];
+        }
+        if(!write(scratch, n)){
+          return;
+        }
+        oldPos += n;
+        addLeft -= n;
+        advance();
+        break;
+      case STATE_EXTRA:
+        n = (size_t)extraLeft < len ? extraLeft : len;
+        if(!write(data, n)){
+          return;
+        }
+        extraLeft -= n;
+        advance();
+        break;
+      default:
+        return;
+    }
+    data += n;
+    len -= n;
+  }
+}
+
+bool DeltaPatch::parseHeader(){
+  if(memcmp(field, DELTA_MAGIC, 4) != 0){
+    fail(DELTA_BAD_HEADER);
+    return false;
+  }
+  head.oldSize = readLe32(field + 4);
+  head.newSize = readLe32(field + 8);
+  memcpy(head.oldHash, field + 12, SHA256_BYTES);
+  memcpy(head.newHash, field + 12 + SHA256_BYTES, SHA256_BYTES);
+  memcpy(head.signature, field + DELTA_SIGNED_SIZE, ED25519_SIGNATURE_BYTES);
+  memcpy(signedPart, field, DELTA_SIGNED_SIZE);
+
+  /*the whole old image, not only the parts the blocks read*/
+  uint8_t digest[SHA256_BYTES];
+  if(haveOldHash){
+    memcpy(digest, oldHash, SHA256_BYTES);
+  }else{
+    Sha256 old;
+    for(uint32_t at = 0; at < head.oldSize; at += DELTA_CHUNK){
+      size_t n = head.oldSize - at < DELTA_CHUNK ? head.oldSize - at : DELTA_CHUNK;
+      if(!images.readOld(at, scratch, n)){
+        fail(DELTA_READ_FAILED);
+        return false;
+      }
+      old.update(scratch, n);
+    }
+    old.finish(digest);
+  }
+  if(memcmp(digest, head.oldHash, SHA256_BYTES) != 0){
+    fail(DELTA_WRONG_BASE);
+    return false;
+  }
+  state = STATE_CONTROL;
+  return true;
+}
+
+bool DeltaPatch::parseControl(){
+  addLeft = (int32_t)readLe32(field);
+  extraLeft = (int32_t)readLe32(field + 4);
+  seek = (int32_t)readLe32(field + 8);
+  uint32_t left = head.newSize - written;
+  if(addLeft < 0 || extraLeft < 0 || (uint32_t)addLeft > left || (uint32_t)extraLeft > left - addLeft ||
+     (uint32_t)addLeft > head.oldSize - oldPos){
+    fail(DELTA_BAD_BLOCK);
+    return false;
+  }
+  state = STATE_ADD;
+  return true;
+}
+
+void DeltaPatch::advance(){
+  if(state == STATE_CONTROL && written == head.newSize){
+    uint8_t digest[SHA256_BYTES];
+    hash.finish(digest);
+    if(memcmp(digest, head.newHash, SHA256_BYTES) != 0){
+      fail(DELTA_BAD_HASH);
+    }else{
+      state = STATE_DONE;
+    }
+    return;
+  }
+  if(state == STATE_ADD && addLeft == 0){
+    state = STATE_EXTRA;
+  }
+  if(state == STATE_EXTRA && extraLeft == 0){
+    int64_t next = (int64_t)oldPos + seek;
+    if(next < 0 || next > head.oldSize){
+      fail(DELTA_BAD_BLOCK);
+      return;
+    }
+    oldPos = next;
+    state = STATE_CONTROL;
+    advance();
+  }
+}
+
+bool DeltaPatch::write(const uint8_t *data, size_t len){
+  hash.update(data, len);
+  if(!images.writeNew(data, len)){
+    fail(DELTA_WRITE_FAILED);
+    return false;
+  }
+  written += len;
+  return true;
+}
+
+DeltaResult DeltaPatch::fail(DeltaError error){
+  if(state != STATE_ERROR){
+    err = error;
+    state = STATE_ERROR;
+  }
+  return DELTA_ERROR;
+}
+
+const char *DeltaPatch::errorName(DeltaError error){
+  switch(error){
+    case DELTA_OK: return "ok";
+    case DELTA_BAD_HEADER: return "bad header";
+    case DELTA_WRONG_BASE: return "made for another image";
+    case DELTA_BAD_BLOCK: return "bad block";
+    case DELTA_READ_FAILED: return "old image read failed";
+    case DELTA_WRITE_FAILED: return "new image write failed";
+    case DELTA_BAD_HASH: return "new image hash differs";
+    case DELTA_INFLATE_FAILED: return "inflate failed";
+    case DELTA_TRUNCATED: return "patch ends early";
+    case DELTA_BAD_SIGNATURE: return "bad signature";
+  }
+  return "?";
+}
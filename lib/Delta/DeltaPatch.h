@@ -0,0 +1,136 @@
+#ifndef DELTA_PATCH_H
+#define DELTA_PATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "GzipInflater.h"
+#include "Sha256.h"
+#include "Ed25519.h"
+
+/*Applies a binary delta made by tools/delta/mkdelta as it arrives, in
+pieces of any size, without ever holding either image. The format is
+bsdiff's without the bzip2: a header, then blocks of
+
+  add length, extra length, seek    (int32 little endian each)
+  add length bytes                  (added to the old image byte by byte)
+  extra length bytes                (new bytes, copied as they are)
+
+Each block continues the new image from where the last one ended and the
+old one from where the last seek left it. Code that only moved, with its
+addresses shifted, becomes runs of mostly zero add bytes, which is why
+mkdelta gzips the whole patch. A gzip patch is inflated here through
+lib/Gzip with the window given to the constructor, mkdelta --window sets
+how far back its compressor reaches.
+
+The header carries the SHA-256 and size of both images and an Ed25519
+signature over them from mkdelta --key. The old image is hashed before
+anything is written, so a patch made against another build fails with
+DELTA_WRONG_BASE, and the new image's hash is checked once the last block
+is written. Anyone can make a patch with matching hashes, it's the
+signature that says who made it. checkSignature() is separate from feed()
+so the caller decides when to spend the time on it, it has to pass before
+the new image is used. Plain C++, tools/delta/applydelta runs the same
+code against image files*/
+
+#define DELTA_MAGIC "WSD2"
+/*magic, sizes and hashes, what the signature is over*/
+#define DELTA_SIGNED_SIZE (4 + 4 + 4 + 2 * SHA256_BYTES)
+#define DELTA_HEADER_SIZE (DELTA_SIGNED_SIZE + ED25519_SIGNATURE_BYTES)
+#define DELTA_CONTROL_SIZE 12
+/*old image bytes read at a time*/
+#define DELTA_CHUNK 512
+
+struct DeltaHeader {
+  uint32_t oldSize, newSize;
+  uint8_t oldHash[SHA256_BYTES];
+  uint8_t newHash[SHA256_BYTES];
+  uint8_t signature[ED25519_SIGNATURE_BYTES];
+};
+
+/*where the images live: flash partitions on the station, files on a PC*/
+class DeltaImages {
+ public:
+  virtual ~DeltaImages() {}
+  virtual bool readOld(uint32_t offset, uint8_t *data, size_t len) = 0;
+  /*the new image in order, from its first byte*/
+  virtual bool writeNew(const uint8_t *data, size_t len) = 0;
+};
+
+enum DeltaResult {
+  DELTA_MORE,  //everything fed was used, the new image isn't finished
+  DELTA_DONE,  //new image written and its hash checked
+  DELTA_ERROR
+};
+
+enum DeltaError {
+  DELTA_OK,
+  DELTA_BAD_HEADER,     //not a patch, or gzip without a window to inflate it
+  DELTA_WRONG_BASE,     //the old image isn't the one the patch was made from
+  DELTA_BAD_BLOCK,      //a block reaching outside either image
+  DELTA_READ_FAILED,
+  DELTA_WRITE_FAILED,
+  DELTA_BAD_HASH,       //the new image came out different
+  DELTA_INFLATE_FAILED, //inflater.error() tells why
+  DELTA_TRUNCATED,      //the gzip stream ended before the new image
+  DELTA_BAD_SIGNATURE   //not signed with the key it was checked against
+};
+
+class DeltaPatch {
+ public:
+  /*window is for gzip patches, a power of two up to 32768. NULL takes
+  uncompressed ones only*/
+  DeltaPatch(DeltaImages &images, uint8_t *window, size_t windowSize);
+
+  void begin();
+  /*the SHA-256 of the whole old image when the caller has it already,
+  the header is checked against it instead of reading the image again.
+  Kept through begin()*/
+  void setOldHash(const uint8_t digest[SHA256_BYTES]);
+  DeltaResult feed(const uint8_t *data, size_t len);
+  /*once the header has arrived, false and DELTA_BAD_SIGNATURE unless
+  the signature is publicKey's*/
+  bool checkSignature(const uint8_t publicKey[ED25519_PUBLIC_BYTES]);
+
+  bool done() const { return state == STATE_DONE; }
+  DeltaError error() const { return err; }
+  /*filled in once the header has arrived*/
+  const DeltaHeader &header() const { return head; }
+  bool compressed() const { return gzip; }
+  /*patch bytes fed, compressed as they came*/
+  uint32_t bytesIn() const { return fed; }
+  uint32_t bytesOut() const { return written; }
+  const GzipInflater &inflater() const { return inflate; }
+
+  static const char *errorName(DeltaError error);
+
+ private:
+  enum State : uint8_t { STATE_HEADER, STATE_CONTROL, STATE_ADD, STATE_EXTRA, STATE_DONE, STATE_ERROR };
+
+  static void inflated(const uint8_t *data, size_t len, void *context);
+  /*the uncompressed patch*/
+  void apply(const uint8_t *data, size_t len);
+  bool parseHeader();
+  bool parseControl();
+  /*moves past finished parts of a block*/
+  void advance();
+  bool write(const uint8_t *data, size_t len);
+  DeltaResult fail(DeltaError error);
+
+  DeltaImages &images;
+  GzipInflater inflate;
+  bool canInflate, gzip, started, haveOldHash;
+  State state;
+  DeltaError err;
+  DeltaHeader head;
+  uint8_t signedPart[DELTA_SIGNED_SIZE];
+  uint8_t oldHash[SHA256_BYTES];
+  Sha256 hash;
+  uint32_t fed, written;
+  uint32_t oldPos;
+  int32_t addLeft, extraLeft, seek;
+  uint8_t field[DELTA_HEADER_SIZE]; //header or control bytes so far
+  size_t fieldLen;
+  uint8_t scratch[DELTA_CHUNK];
+};
+
+#endif
@@ -0,0 +1,417 @@
+#include "Ed25519.h"
+#include "Sha512.h"
+
+#include <string.h>
+
+/*Field elements mod 2^255-19 as 16 limbs of 16 bits, with room in the
+int64 for the carries of a multiplication*/
+typedef int64_t Field[16];
+
+static const Field zero = {0};
+static const Field one = {1};
+
+/*d = -121665/121666, 2d, sqrt(-1) and the base point, worked out once
+instead of written down as constants*/
+static Field d, d2, sqrtm1;
+static Field baseX, baseY;
+static bool ready = false;
+
+/*the group order, little endian*/
+static const int64_t order[32] = {
+  0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58, 0xd6, 0x9c, 0xf7, 0xa2, 0xde, 0xf9, 0xde, 0x14,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x10
+};
+
+static void copy(Field out, const Field a){
+  memcpy(out, a, sizeof(Field));
+}
+
+static void carry(Field o){
+  for(int i = 0; i < 16; i++){
+    o[i] += (int64_t)1 << 16;
+    int64_t c = o[i] >> 16;
+    if(i < 15){
+      o[i + 1] += c - 1;
+    }else{
+      o[0] += 38 * (c - 1);
+    }
+    o[i] -= c << 16;
+  }
+}
+
+/*swaps p and q if b is 1, without branching on it*/
+static void swapIf(Field p, Field q, int b){
+  int64_t mask = ~((int64_t)b - 1);
+  for(int i = 0; i < 16; i++){
+    int64_t t = mask & (p[i] ^ q[i]);
+    p[i] ^= t;
+    q[i] ^= t;
+  }
+}
+
+static void pack(uint8_t out[32], const Field n){
+  Field m, t;
+  copy(t, n);
+  carry(t);
+  carry(t);
+  carry(t);
+  for(int j = 0; j < 2; j++){
+    m[0] = t[0] - 0xffed;
+    for(int i = 1; i < 15; i++){
+      m[i] = t[i] - 0xffff - ((m[i - 1] >> 16) & 1);
+      m[i - 1] &= 0xffff;
+    }
+    m[15] = t[15] - 0x7fff - ((m[14] >> 16) & 1);
+    int b = (m[15] >> 16) & 1;
+    m[14] &= 0xffff;
+    swapIf(t, m, 1 - b);
+  }
+  for(int i = 0; i < 16; i++){
+    out[2 * i] = t[i] & 0xff;
+    out[2 * i + 1] = t[i] >> 8;
+  }
+}
+
+static void unpack(Field out, const uint8_t in[32]){
+  for(int i = 0; i < 16; i++){
+    out[i] = in[2 * i] + ((int64_t)in[2 * i + 1] << 8);
+  }
+  out[15] &= 0x7fff;
+}
+
+static bool different(const Field a, const Field b){
+  uint8_t x[32], y[32];
+  pack(x, a);
+  pack(y, b);
+  return memcmp(x, y, 32) != 0;
+}
+
+static int parity(const Field a){
+  uint8_t x[32];
+  pack(x, a);
+  return x[0] & 1;
+}
+
+static void add(Field out, const Field a, const Field b){
+  for(int i = 0; i < 16; i++){
+    out[i] = a[i] + b[i];
+  }
+}
+
+static void sub(Field out, const Field a, const Field b){
+  for(int i = 0; i < 16; i++){
+    out[i] = a[i] - b[i];
+  }
+}
+
+static void mul(Field out, const Field a, const Field b){
+  int64_t t[31] = {0};
+  for(int i = 0; i < 16; i++){
+    for(int j = 0; j < 16; j++){
+      t[i + j] += a[i] * b[j];
+    }
+  }
+  /*2^256 is 38 mod p*/
+  for(int i = 0; i < 15; i++){
+    t[i] += 38 * t[i + 16];
+  }
+  for(int i = 0; i < 16; i++){
+    out[i] = t[i];
+  }
+  carry(out);
+  carry(out);
+}
+
+static void square(Field out, const Field a){
+  mul(out, a, a);
+}
+
+/*a^(p-2)*/
+static void invert(Field out, const Field a){
+  Field c;
+  copy(c, a);
+  for(int i = 253; i >= 0; i--){
+    square(c, c);
+    if(i != 2 && i != 4){
+      mul(c, c, a);
+    }
+  }
+  copy(out, c);
+}
+
+/*a^((p-5)/8), for square roots*/
+static void pow2523(Field out, const Field a){
+  Field c;
+  copy(c, a);
+  for(int i = 250; i >= 0; i--){
+    square(c, c);
+    if(i != 1){
+      mul(c, c, a);
+    }
+  }
+  copy(out, c);
+}
+
+/*points in extended coordinates X, Y, Z, T*/
+typedef Field Point[4];
+
+static void pointAdd(Point p, Point q){
+  Field a, b, c, e, f, g, h, t, dd;
+  sub(a, p[1], p[0]);
+  sub(t, q[1], q[0]);
+  mul(a, a, t);
+  add(b, p[0], p[1]);
+  add(t, q[0], q[1]);
+  mul(b, b, t);
+  mul(c, p[3], q[3]);
+  mul(c, c, d2);
+  mul(dd, p[2], q[2]);
+  add(dd, dd, dd);
+  sub(e, b, a);
+  sub(f, dd, c);
+  add(g, dd, c);
+  add(h, b, a);
+  mul(p[0], e, f);
+  mul(p[1], h, g);
+  mul(p[2], g, f);
+  mul(p[3], e, h);
+}
+
+static void pointSelect(Point p, Point q, int b){
+  for(int i = 0; i < 4; i++){
+    swapIf(p[i], q[i], b);
+  }
+}
+
+static void pointPack(uint8_t out[32], Point p){
+  Field x, y, zi;
+  invert(zi, p[2]);
+  mul(x, p[0], zi);
+  mul(y, p[1], zi);
+  pack(out, y);
+  out[31] ^= parity(x) << 7;
+}
+
+/*p = s * q, q is used up*/
+static void scalarMult(Point p, Point q, const uint8_t s[32]){
+  copy(p[0], zero);
+  copy(p[1], one);
+  copy(p[2], one);
+  copy(p[3], zero);
+  for(int i = 255; i >= 0; i--){
+    int b = (s[i / 8] >> (i & 7)) & 1;
+    pointSelect(p, q, b);
+    pointAdd(q, p);
+    pointAdd(p, p);
+    pointSelect(p, q, b);
+  }
+}
+
+static void scalarBase(Point p, const uint8_t s[32]){
+  Point q;
+  copy(q[0], baseX);
+  copy(q[1], baseY);
+  copy(q[2], one);
+  mul(q[3], baseX, baseY);
+  scalarMult(p, q, s);
+}
+
+/*the point a key or R encodes, negated. false if it isn't on the curve*/
+static bool unpackNegated(Point r, const uint8_t in[32]){
+  Field t, check, num, den, den2, den4, den6;
+  copy(r[2], one);
+  unpack(r[1], in);
+  square(num, r[1]);
+  mul(den, num, d);
+  sub(num, num, r[2]);
+  add(den, r[2], den);
+
+  square(den2, den);
+  square(den4, den2);
+  mul(den6, den4, den2);
+  mul(t, den6, num);
+  mul(t, t, den);
+
+  pow2523(t, t);
+  mul(t, t, num);
+  mul(t, t, den);
+  mul(t, t, den);
+  mul(r[0], t, den);
+
+  square(check, r[0]);
+  mul(check, check, den);
+  if(different(check, num)){
+    mul(r[0], r[0], sqrtm1);
+  }
+  square(check, r[0]);
+  mul(check, check, den);
+  if(different(check, num)){
+    return false;
+  }
+  if(parity(r[0]) == (in[31] >> 7)){
+    sub(r[0], zero, r[0]);
+  }
+  mul(r[3], r[0], r[1]);
+  return true;
+}
+
+/*r = x mod the group order, x is 64 limbs of about a byte*/
+static void modOrder(uint8_t r[32], int64_t x[64]){
+  for(int i = 63; i >= 32; i--){
+    int64_t c = 0;
+    int j;
+    for(j = i - 32; j < i - 12; j++){
+      x[j] += c - 16 * x[i] * order[j - (i - 32)];
+      c = (x[j] + 128) >> 8;
+      x[j] -= c << 8;
+    }
+    x[j] += c;
+    x[i] = 0;
+  }
+  int64_t c = 0;
+  for(int j = 0; j < 32; j++){
+    x[j] += c - (x[31] >> 4) * order[j];
+    c = x[j] >> 8;
+    x[j] &= 255;
+  }
+  for(int j = 0; j < 32; j++){
+    x[j] -= c * order[j];
+  }
+  for(int i = 0; i < 32; i++){
+    x[i + 1] += x[i] >> 8;
+    r[i] = x[i] & 255;
+  }
+}
+
+/*a 64 byte hash reduced in place to its first 32 bytes*/
+static void reduce(uint8_t r[64]){
+  int64_t x[64];
+  for(int i = 0; i < 64; i++){
+    x[i] = r[i];
+  }
+  memset(r, 0, 64);
+  modOrder(r, x);
+}
+
+static void setup(){
+  if(ready){
+    return;
+  }
+  Field a = {0xdb41, 1}, b = {0xdb42, 1};
+  invert(b, b);
+  mul(a, a, b);
+  sub(d, zero, a);
+  add(d2, d, d);
+
+  /*2 isn't a square mod p, so 2^((p-1)/4) squares to -1*/
+  uint8_t e[32];
+  memset(e, 0xff, sizeof(e));
+  e[0] = 0xfb;
+  e[31] = 0x1f;
+  Field two = {2};
+  copy(sqrtm1, one);
+  for(int i = 255; i >= 0; i--){
+    square(sqrtm1, sqrtm1);
+    if((e[i / 8] >> (i & 7)) & 1){
+      mul(sqrtm1, sqrtm1, two);
+    }
+  }
+
+  /*y = 4/5 with x even*/
+  uint8_t base[32];
+  memset(base, 0x66, sizeof(base));
+  base[0] = 0x58;
+  Point p;
+  unpackNegated(p, base);
+  sub(baseX, zero, p[0]);
+  copy(baseY, p[1]);
+  ready = true;
+}
+
+static void expandSeed(const uint8_t seed[ED25519_SEED_BYTES], uint8_t h[SHA512_BYTES]){
+  Sha512 hash;
+  hash.update(seed, ED25519_SEED_BYTES);
+  hash.finish(h);
+  h[0] &= 248;
+  h[31] &= 127;
+  h[31] |= 64;
+}
+
+void ed25519PublicKey(const uint8_t seed[ED25519_SEED_BYTES], uint8_t publicKey[ED25519_PUBLIC_BYTES]){
+  setup();
+  uint8_t h[SHA512_BYTES];
+  expandSeed(seed, h);
+  Point p;
+  scalarBase(p, h);
+  pointPack(publicKey, p);
+}
+
+void ed25519Sign(const uint8_t seed[ED25519_SEED_BYTES], const uint8_t *message, size_t len,
+                 uint8_t signature[ED25519_SIGNATURE_BYTES]){
+  setup();
+  uint8_t h[SHA512_BYTES], publicKey[ED25519_PUBLIC_BYTES], r[SHA512_BYTES], k[SHA512_BYTES];
+  expandSeed(seed, h);
+  Point p;
+  scalarBase(p, h);
+  pointPack(publicKey, p);
+
+  Sha512 hash;
+  hash.update(h + 32, 32);
+  hash.update(message, len);
+  hash.finish(r);
+  reduce(r);
+  scalarBase(p, r);
+  pointPack(signature, p);
+
+  hash.begin();
+  hash.update(signature, 32);
+  hash.update(publicKey, ED25519_PUBLIC_BYTES);
+  hash.update(message, len);
+  hash.finish(k);
+  reduce(k);
+
+  int64_t x[64] = {0};
+  for(int i = 0; i < 32; i++){
+    x[i] = r[i];
+  }
+  for(int i = 0; i < 32; i++){
+    for(int j = 0; j < 32; j++){
+      x[i + j] += (int64_t)k[i] * h[j];
+    }
+  }
+  modOrder(signature + 32, x);
+}
+
+bool ed25519Verify(const uint8_t publicKey[ED25519_PUBLIC_BYTES], const uint8_t *message, size_t len,
+                   const uint8_t signature[ED25519_SIGNATURE_BYTES]){
+  setup();
+  /*S has to be below the group order, or one signature has many forms*/
+  const uint8_t *s = signature + 32;
+  int i = 31;
+  while(i >= 0 && s[i] == order[i]){
+    i--;
+  }
+  if(i < 0 || s[i] > order[i]){
+    return false;
+  }
+
+  Point p, q;
+  if(!unpackNegated(q, publicKey)){
+    return false;
+  }
+  uint8_t k[SHA512_BYTES];
+  Sha512 hash;
+  hash.update(signature, 32);
+  hash.update(publicKey, ED25519_PUBLIC_BYTES);
+  hash.update(message, len);
+  hash.finish(k);
+  reduce(k);
+
+  /*S*B - k*A has to come out as R*/
+  scalarMult(p, q, k);
+  scalarBase(q, s);
+  pointAdd(p, q);
+  uint8_t r[32];
+  pointPack(r, p);
+  return memcmp(r, signature, 32) == 0;
+}
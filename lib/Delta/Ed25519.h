@@ -0,0 +1,28 @@
+#ifndef ED25519_H
+#define ED25519_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ED25519_SEED_BYTES 32
+#define ED25519_PUBLIC_BYTES 32
+#define ED25519_SIGNATURE_BYTES 64
+
+/*Ed25519 signatures (RFC 8032) for firmware patches. mkdelta signs with a
+secret seed that never leaves the build machine, the station checks the
+signature against the public key compiled into it. The arithmetic follows
+TweetNaCl: small and constant time, not fast. A check takes two scalar
+multiplications, a few hundred ms on the ESP32, which is fine once per
+update. Plain C++ so tools/delta signs and checks with the same code*/
+
+/*the public key that goes with a secret seed*/
+void ed25519PublicKey(const uint8_t seed[ED25519_SEED_BYTES], uint8_t publicKey[ED25519_PUBLIC_BYTES]);
+
+void ed25519Sign(const uint8_t seed[ED25519_SEED_BYTES], const uint8_t *message, size_t len,
+                 uint8_t signature[ED25519_SIGNATURE_BYTES]);
+
+/*true if signature is publicKey's over message*/
+bool ed25519Verify(const uint8_t publicKey[ED25519_PUBLIC_BYTES], const uint8_t *message, size_t len,
+                   const uint8_t signature[ED25519_SIGNATURE_BYTES]);
+
+#endif
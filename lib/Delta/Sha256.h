@@ -0,0 +1,29 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_BYTES 32
+
+/*SHA-256 over data that arrives in pieces. Plain C++ so a firmware image
+hashes the same on the station and in tools/delta*/
+class Sha256 {
+ public:
+  Sha256() { begin(); }
+
+  void begin();
+  void update(const void *data, size_t len);
+  /*the digest of everything since begin()*/
+  void finish(uint8_t digest[SHA256_BYTES]);
+
+ private:
+  void block(const uint8_t *p);
+
+  uint32_t h[8];
+  uint64_t length;
+  uint8_t buffer[64];
+  size_t used;
+};
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef SHA512_H
+#define SHA512_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA512_BYTES 64
+
+/*SHA-512 over data that arrives in pieces, for the Ed25519 signatures on
+patches. Plain C++ like Sha256*/
+class Sha512 {
+ public:
+  Sha512() { begin(); }
+
+  void begin();
+  void update(const void *data, size_t len);
+  /*the digest of everything since begin()*/
+  void finish(uint8_t digest[SHA512_BYTES]);
+
+ private:
+  void block(const uint8_t *p);
+
+  uint64_t h[8];
+  uint64_t length;
+  uint8_t buffer[128];
+  size_t used;
+};
+
+#endif
@@ -0,0 +1,88 @@
+#include "DisplayPower.h"
+
+/*the 3x3 square walked around its centre*/
+static const int8_t shiftSteps[9][2] = {
+  {0, 0}, {1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1}
+};
+
+/*light sensor noise shouldn't turn into a contrast command every update*/
+#define CONTRAST_HYSTERESIS 8
+
+void DisplayPower::begin(uint32_t now){
+  startedAt = now;
+  lastActivity = now;
+  panelOn = true;
+  level = brightContrast;
+}
+
+bool DisplayPower::activity(uint32_t now){
+  lastActivity = now;
+  if(panelOn){
+    return false;
+  }
+  panelOn = true;
+  wakes++;
+  return true;
+}
+
+bool DisplayPower::update(uint32_t now, int minuteOfDay, int light){
+  night = minuteOfDay >= 0 && within(minuteOfDay, nightFrom, nightUntil);
+  uint32_t idle = now - lastActivity;
+  bool wanted;
+  if(night){
+    wanted = idle < wakeTime;
+  }else{
+    wanted = idleTimeout == 0 || idle < idleTimeout;
+  }
+
+  bool changed = false;
+  if(wanted != panelOn){
+    panelOn = wanted;
+    if(!wanted){
+      sleeps++;
+    }
+    changed = true;
+  }
+
+  uint8_t target = contrastFor(minuteOfDay, light);
+  int diff = (int)target - level;
+  if(diff != 0 && (light < 0 || diff >= CONTRAST_HYSTERESIS || diff <= -CONTRAST_HYSTERESIS ||
+                   target == dimContrast || target == brightContrast)){
+    level = target;
+    changed = true;
+  }
+  return changed;
+}
+
+void DisplayPower::shift(uint32_t now, int8_t &dx, int8_t &dy) const {
+  int step = shiftPeriod > 0 ? ((now - startedAt) / shiftPeriod) % 9 : 0;
+  dx = shiftSteps[step][0];
+  dy = shiftSteps[step][1];
+}
+
+bool DisplayPower::within(int minute, uint16_t from, uint16_t until){
+  if(from == until){
+    return false;
+  }
+  if(from < until){
+    return minute >= from && minute < until;
+  }
+  return minute >= from || minute < until;
+}
+
+uint8_t DisplayPower::contrastFor(int minuteOfDay, int light) const {
+  if(light >= 0){
+    if(light <= lightDark){
+      return dimContrast;
+    }
+    if(light >= lightBright){
+      return brightContrast;
+    }
+    return dimContrast + (int32_t)(brightContrast - dimContrast) * (light - lightDark) / (lightBright - lightDark);
+  }
+  /*woken at night it's still dark in the room*/
+  if(minuteOfDay >= 0 && (night || within(minuteOfDay, dimFrom, dimUntil))){
+    return dimContrast;
+  }
+  return brightContrast;
+}
@@ -0,0 +1,68 @@
+#ifndef DISPLAY_POWER_H
+#define DISPLAY_POWER_H
+
+#include <stdint.h>
+
+/*Decides when the panel is on, how bright it is and where the picture
+sits. Nothing here talks to the panel, the firmware asks after every
+update() and passes the answers on to BufferedDisplay.
+
+Times of day are minutes since local midnight. At night the panel is off
+unless a button or motion sensor woke it in the last wakeTime. With a
+wake input idleTimeout also turns it off during the day once nobody has
+been around for that long, without one (idleTimeout 0) it stays on.
+Contrast follows the light sensor when there is one, otherwise it is
+dimContrast during the dim hours. Until the clock is set the time of day
+is unknown and the panel is on at full contrast.
+
+OLED pixels that stay lit for months fade, and a station shows the same
+labels in the same places all day. shift() moves the whole picture one
+pixel around a 3x3 square every shiftPeriod, so no pixel is lit all the
+time. Plain C++*/
+
+class DisplayPower {
+ public:
+  /*off and dimmed between from and until, equal means never*/
+  uint16_t nightFrom = 0, nightUntil = 0;
+  uint16_t dimFrom = 0, dimUntil = 0;
+  uint8_t brightContrast = 0xCF, dimContrast = 0x10;
+
+  /*ms without activity before the panel goes off, 0 never*/
+  uint32_t idleTimeout = 0;
+  /*ms a wake keeps the panel on at night*/
+  uint32_t wakeTime = 30000;
+
+  /*light sensor readings that mean dimContrast and brightContrast,
+  contrast is interpolated in between*/
+  int lightDark = 100, lightBright = 2000;
+
+  uint32_t shiftPeriod = 60000;
+
+  void begin(uint32_t now);
+
+  /*a button press or motion, returns true if it turned the panel on*/
+  bool activity(uint32_t now);
+
+  /*minuteOfDay is -1 while the clock isn't set, light -1 without a
+  light sensor. Returns true if on() or contrast() changed*/
+  bool update(uint32_t now, int minuteOfDay, int light);
+
+  bool on() const { return panelOn; }
+  uint8_t contrast() const { return level; }
+  void shift(uint32_t now, int8_t &dx, int8_t &dy) const;
+
+  uint32_t wakes = 0;  //activity that turned the panel on
+  uint32_t sleeps = 0;
+
+ private:
+  static bool within(int minute, uint16_t from, uint16_t until);
+  uint8_t contrastFor(int minuteOfDay, int light) const;
+
+  bool panelOn = true;
+  bool night = false;
+  uint8_t level = 0xCF;
+  uint32_t lastActivity = 0;
+  uint32_t startedAt = 0;
+};
+
+#endif
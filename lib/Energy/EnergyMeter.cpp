@@ -0,0 +1,93 @@
+#include "EnergyMeter.h"
+
+#include <string.h>
+
+const char *const energyUseNames[ENERGY_COUNT] = {
+  "board", "cpu_active", "cpu_idle", "wifi_search", "wifi_associated", "http_forecast", "http_upload",
+  "udp", "oled", "dht", "ds18b20"
+};
+
+/*Typical figures from the ESP32, SH1106 and sensor datasheets for a
+board running at 240 MHz without light sleep. Radio uses are on top of
+the CPU, which is counted separately*/
+static const float defaultCurrent[ENERGY_COUNT] = {
+  10,   //board
+  50,   //cpu_active
+  40,   //cpu_idle, yield() keeps the core awake
+  100,  //wifi_search
+  15,   //wifi_associated
+  90,   //http_forecast
+  90,   //http_upload
+  120,  //udp
+  10,   //oled, a typical screen's worth of lit pixels
+  1.5f, //dht
+  1.5f  //ds18b20
+};
+
+EnergyMeter::EnergyMeter(){
+  memcpy(current, defaultCurrent, sizeof(current));
+  memset(total, 0, sizeof(total));
+  memset(onSince, 0, sizeof(onSince));
+  memset(on, 0, sizeof(on));
+  memset(events, 0, sizeof(events));
+}
+
+void EnergyMeter::begin(uint32_t now){
+  startedAt = now;
+  set(ENERGY_BOARD, true, now);
+  set(ENERGY_OLED, true, now);
+}
+
+void EnergyMeter::add(EnergyUse use, uint32_t ms){
+  total[use] += ms;
+  events[use]++;
+}
+
+void EnergyMeter::set(EnergyUse use, bool state, uint32_t now){
+  if(state == on[use]){
+    return;
+  }
+  if(state){
+    onSince[use] = now;
+    events[use]++;
+  }else{
+    total[use] += now - onSince[use];
+  }
+  on[use] = state;
+}
+
+uint64_t EnergyMeter::onTime(EnergyUse use, uint32_t now) const {
+  if(use == ENERGY_CPU_ACTIVE){
+    uint64_t idle = onTime(ENERGY_CPU_IDLE, now);
+    uint32_t all = elapsed(now);
+    return idle < all ? all - idle : 0;
+  }
+  return total[use] + (on[use] ? now - onSince[use] : 0);
+}
+
+float EnergyMeter::milliampHours(EnergyUse use, uint32_t now) const {
+  return current[use] * (onTime(use, now) / 3600000.0f);
+}
+
+float EnergyMeter::totalMilliampHours(uint32_t now) const {
+  float sum = 0;
+  for(int i = 0; i < ENERGY_COUNT; i++){
+    sum += milliampHours((EnergyUse)i, now);
+  }
+  return sum;
+}
+
+float EnergyMeter::milliampHoursPerDay(uint32_t now) const {
+  uint32_t ms = elapsed(now);
+  return ms > 0 ? totalMilliampHours(now) * (86400000.0f / ms) : 0;
+}
+
+bool EnergyMeter::setCurrent(const char *name, float milliamps){
+  for(int i = 0; i < ENERGY_COUNT; i++){
+    if(strcmp(energyUseNames[i], name) == 0){
+      current[i] = milliamps;
+      return true;
+    }
+  }
+  return false;
+}
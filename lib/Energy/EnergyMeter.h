@@ -0,0 +1,75 @@
+#ifndef ENERGY_METER_H
+#define ENERGY_METER_H
+
+#include <stdint.h>
+
+/*Where the battery goes. Every part that draws current is a use with an
+on-time and a current from the model below, mAh is the sum of current
+times on-time. Nothing here measures current, the numbers are only as
+good as the model, but they are the same model for every build so two
+firmware versions or configurations can be compared on energy the same
+way they are on latency.
+
+Uses that run for a known time are added with add(), ones that stay on
+until something changes are switched with set(). CPU active time is
+whatever isn't idle. Plain C++, tools/replay reports the same numbers
+for a simulated day*/
+
+enum EnergyUse {
+  ENERGY_BOARD,           //regulator, USB serial chip, always on
+  ENERGY_CPU_ACTIVE,
+  ENERGY_CPU_IDLE,        //waiting between measurements and screens
+  ENERGY_WIFI_SEARCH,     //not associated, scanning and reconnecting
+  ENERGY_WIFI_ASSOCIATED, //modem sleep between beacons
+  ENERGY_HTTP_FORECAST,   //radio busy with a forecast request
+  ENERGY_HTTP_UPLOAD,
+  ENERGY_UDP,             //collector frames
+  ENERGY_OLED,
+  ENERGY_DHT,             //DHT22 measuring
+  ENERGY_DS18B20,         //DS18B20 converting
+  ENERGY_COUNT
+};
+
+extern const char *const energyUseNames[ENERGY_COUNT];
+
+class EnergyMeter {
+ public:
+  EnergyMeter();
+
+  /*starts counting, board and display are on from here*/
+  void begin(uint32_t now);
+
+  /*use was on for ms, one event (a request, a reading)*/
+  void add(EnergyUse use, uint32_t ms);
+  /*switches a use that stays on, repeating the same state is fine*/
+  void set(EnergyUse use, bool on, uint32_t now);
+
+  uint32_t elapsed(uint32_t now) const { return now - startedAt; }
+  /*ms the use was on, including a running interval*/
+  uint64_t onTime(EnergyUse use, uint32_t now) const;
+  uint32_t eventCount(EnergyUse use) const { return events[use]; }
+  /*true for uses worked out from the others, they have no events of
+  their own*/
+  static bool derived(EnergyUse use) { return use == ENERGY_CPU_ACTIVE; }
+
+  float milliampHours(EnergyUse use, uint32_t now) const;
+  float totalMilliampHours(uint32_t now) const;
+  /*what a whole day would take at the rate so far*/
+  float milliampHoursPerDay(uint32_t now) const;
+
+  /*sets a model current by its name in energyUseNames, false if there
+  is no such use*/
+  bool setCurrent(const char *name, float milliamps);
+
+  /*the current model in mA, each use on top of the others*/
+  float current[ENERGY_COUNT];
+
+ private:
+  uint32_t startedAt = 0;
+  uint64_t total[ENERGY_COUNT];
+  uint32_t onSince[ENERGY_COUNT];
+  bool on[ENERGY_COUNT];
+  uint32_t events[ENERGY_COUNT];
+};
+
+#endif
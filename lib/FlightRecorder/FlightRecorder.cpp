@@ -0,0 +1,158 @@
+#include "FlightRecorder.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <esp_attr.h>
+static uint32_t flightMicros(){
+  return micros();
+}
+#ifdef FLIGHT_RECORDER_RTC
+#define FLIGHT_RING_ATTR RTC_NOINIT_ATTR
+#else
+#define FLIGHT_RING_ATTR __NOINIT_ATTR
+#endif
+#else
+#include <time.h>
+static uint32_t flightMicros(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)(ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+#define FLIGHT_RING_ATTR
+#endif
+
+const FlightEventInfo flightEvents[FLIGHT_EVENT_COUNT] = {
+  {"boot", FLIGHT_TRACK_LOOP},
+  {"pass", FLIGHT_TRACK_LOOP},
+  {"wait", FLIGHT_TRACK_LOOP},
+  {"dht", FLIGHT_TRACK_LOOP},
+  {"ds18b20", FLIGHT_TRACK_LOOP},
+  {"dns", FLIGHT_TRACK_LOOP},
+  {"parse", FLIGHT_TRACK_LOOP},
+  {"render", FLIGHT_TRACK_LOOP},
+  {"connect", FLIGHT_TRACK_HTTP},
+  {"handshake", FLIGHT_TRACK_HTTP},
+  {"send", FLIGHT_TRACK_HTTP},
+  {"headers", FLIGHT_TRACK_HTTP},
+  {"body", FLIGHT_TRACK_HTTP},
+  {"http_failed", FLIGHT_TRACK_HTTP},
+  {"flush", FLIGHT_TRACK_DISPLAY},
+  {"wifi_up", FLIGHT_TRACK_WIFI},
+  {"wifi_down", FLIGHT_TRACK_WIFI}
+};
+
+const char *const flightTrackNames[FLIGHT_TRACK_COUNT] = {"loop", "http", "display", "wifi"};
+
+#define FLIGHT_MAGIC 0x464c4931
+#define FLIGHT_MASK (FLIGHT_RECORDER_EVENTS - 1)
+/*the phase of a slot while it's written*/
+#define FLIGHT_WRITING 0xff
+
+struct FlightRing {
+  uint32_t magic;
+  uint32_t capacity;
+  uint32_t boots;
+  uint32_t head; //free running, the next slot is head & FLIGHT_MASK
+  FlightEvent events[FLIGHT_RECORDER_EVENTS];
+};
+
+FLIGHT_RING_ATTR static FlightRing ring;
+static bool started = false;
+
+void flightStart(uint16_t resetReason){
+  if(ring.magic != FLIGHT_MAGIC || ring.capacity != FLIGHT_RECORDER_EVENTS){
+    memset(&ring, 0, sizeof(ring));
+    ring.magic = FLIGHT_MAGIC;
+    ring.capacity = FLIGHT_RECORDER_EVENTS;
+  }
+  ring.boots++;
+  started = true;
+  flightRecord(FLIGHT_BOOT, FLIGHT_INSTANT, resetReason);
+}
+
+void flightRecord(FlightEventId id, FlightPhase phase, uint16_t arg){
+  if(!started){
+    return;
+  }
+  uint32_t slot = __atomic_fetch_add(&ring.head, 1, __ATOMIC_RELAXED) & FLIGHT_MASK;
+  FlightEvent &e = ring.events[slot];
+  /*marked before the fields change and published after, the fence keeps
+  the claim and the mark ahead of the fields for flightGet()*/
+  __atomic_store_n(&e.phase, FLIGHT_WRITING, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  e.time = flightMicros();
+  e.arg = arg;
+  e.id = id;
+  __atomic_store_n(&e.phase, (uint8_t)phase, __ATOMIC_RELEASE);
+}
+
+uint32_t flightBoots(){
+  return ring.boots;
+}
+
+uint32_t flightCount(){
+  uint32_t head = __atomic_load_n(&ring.head, __ATOMIC_RELAXED);
+  return head < FLIGHT_RECORDER_EVENTS ? head : FLIGHT_RECORDER_EVENTS;
+}
+
+bool flightGet(uint32_t index, FlightEvent &event){
+  uint32_t count = flightCount();
+  if(index >= count){
+    return false;
+  }
+  uint32_t head = __atomic_load_n(&ring.head, __ATOMIC_ACQUIRE);
+  uint32_t position = head - count + index;
+  const FlightEvent &e = ring.events[position & FLIGHT_MASK];
+  uint8_t phase = __atomic_load_n(&e.phase, __ATOMIC_ACQUIRE);
+  event.time = e.time;
+  event.arg = e.arg;
+  event.id = e.id;
+  event.phase = phase;
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  /*a slot being written right now, garbage after a crash mid-write, or
+  one a writer claimed again while it was copied*/
+  if(__atomic_load_n(&e.phase, __ATOMIC_RELAXED) != phase ||
+     __atomic_load_n(&ring.head, __ATOMIC_RELAXED) - position > FLIGHT_RECORDER_EVENTS){
+    return false;
+  }
+  return event.id < FLIGHT_EVENT_COUNT && event.phase <= FLIGHT_INSTANT;
+}
+
+int formatFlightHeader(char *buf, size_t len){
+  return snprintf(buf, len, "@FR %lu %lu %u", (unsigned long)ring.boots, (unsigned long)flightCount(),
+                  (unsigned)FLIGHT_RECORDER_EVENTS);
+}
+
+int formatFlightEvent(const FlightEvent &event, char *buf, size_t len){
+  static const char phases[] = "BEI";
+  return snprintf(buf, len, "@FE %lu %c %s %u", (unsigned long)event.time, phases[event.phase],
+                  flightEvents[event.id].name, (unsigned)event.arg);
+}
+
+bool parseFlightEvent(const char *line, FlightEvent &event){
+  unsigned long time;
+  char phase;
+  char name[24];
+  unsigned arg;
+  if(sscanf(line, "@FE %lu %c %23s %u", &time, &phase, name, &arg) != 4){
+    return false;
+  }
+  const char *phases = "BEI";
+  const char *p = strchr(phases, phase);
+  if(p == NULL || phase == '\0'){
+    return false;
+  }
+  for(int i = 0; i < FLIGHT_EVENT_COUNT; i++){
+    if(strcmp(flightEvents[i].name, name) == 0){
+      event.time = (uint32_t)time;
+      event.arg = (uint16_t)arg;
+      event.id = (uint8_t)i;
+      event.phase = (uint8_t)(p - phases);
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,119 @@
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*What the station was doing just before it hung or crashed. Every major
+operation records a begin and an end event with a microsecond timestamp
+into a fixed ring of FLIGHT_RECORDER_EVENTS, 8 bytes each, nothing is
+allocated. Any task can record, a slot is claimed with one atomic add.
+The phase byte is written last and the others check it before and after
+copying an event, so a dump never shows an event half written or
+overwritten while it was read, it leaves it out.
+
+On the ESP32 the ring lives in .noinit RAM, which a software reset, panic
+or watchdog reset leaves alone, so after a crash the events leading up to
+it are still there. flightStart() keeps them and adds a boot event, the
+type f serial command prints the whole ring and tools/trace2chrome turns
+it into a Chrome trace (chrome://tracing or ui.perfetto.dev). With
+FLIGHT_RECORDER_RTC the ring goes to RTC memory instead and also survives
+deep sleep. That's 8 kB shared with the TLS sessions, so the ring is
+smaller there.
+
+Dump lines, oldest event first:
+  @FR <boots> <events> <capacity>
+  @FE <us> <B|E|I> <name> <arg>
+
+Plain C++, on Linux the ring is ordinary memory*/
+
+/*a power of two*/
+#ifndef FLIGHT_RECORDER_EVENTS
+#ifdef FLIGHT_RECORDER_RTC
+#define FLIGHT_RECORDER_EVENTS 256
+#else
+#define FLIGHT_RECORDER_EVENTS 1024
+#endif
+#endif
+
+/*where an event is drawn in the trace*/
+enum FlightTrack {
+  FLIGHT_TRACK_LOOP,
+  FLIGHT_TRACK_HTTP,    //requests overlap the loop, each one is its own span
+  FLIGHT_TRACK_DISPLAY, //the flush task
+  FLIGHT_TRACK_WIFI,
+  FLIGHT_TRACK_COUNT
+};
+
+enum FlightEventId {
+  FLIGHT_BOOT,           //arg: reset reason
+  FLIGHT_PASS,
+  FLIGHT_WAIT,
+  FLIGHT_DHT,
+  FLIGHT_DS18B20,
+  FLIGHT_DNS,
+  FLIGHT_PARSE,
+  FLIGHT_RENDER,         //arg: screen
+  FLIGHT_HTTP_CONNECT,   //HTTP phases, arg: request number
+  FLIGHT_HTTP_HANDSHAKE,
+  FLIGHT_HTTP_SEND,
+  FLIGHT_HTTP_HEADERS,
+  FLIGHT_HTTP_BODY,
+  FLIGHT_HTTP_FAILED,    //arg: AsyncHttpError
+  FLIGHT_FLUSH,          //arg: pages sent as bits, 256 + type for a transition
+  FLIGHT_WIFI_UP,
+  FLIGHT_WIFI_DOWN,      //arg: disconnect reason
+  FLIGHT_EVENT_COUNT
+};
+
+enum FlightPhase {
+  FLIGHT_BEGIN,
+  FLIGHT_END,
+  FLIGHT_INSTANT
+};
+
+struct FlightEvent {
+  uint32_t time; //micros(), wraps every 71 minutes
+  uint16_t arg;
+  uint8_t id;
+  uint8_t phase;
+};
+
+struct FlightEventInfo {
+  const char *name;
+  FlightTrack track;
+};
+
+extern const FlightEventInfo flightEvents[FLIGHT_EVENT_COUNT];
+extern const char *const flightTrackNames[FLIGHT_TRACK_COUNT];
+
+/*keeps what a previous run left in the ring, or clears it after power on,
+and records the boot. Nothing is recorded before this*/
+void flightStart(uint16_t resetReason);
+
+void flightRecord(FlightEventId id, FlightPhase phase, uint16_t arg = 0);
+
+/*begin and end of the enclosing block*/
+class FlightScope {
+ public:
+  explicit FlightScope(FlightEventId id, uint16_t arg = 0) : id(id), arg(arg) { flightRecord(id, FLIGHT_BEGIN, arg); }
+  ~FlightScope() { flightRecord(id, FLIGHT_END, arg); }
+ private:
+  FlightEventId id;
+  uint16_t arg;
+};
+
+/*boots seen since the ring was cleared, events held and capacity*/
+uint32_t flightBoots();
+uint32_t flightCount();
+/*index 0 is the oldest event held*/
+bool flightGet(uint32_t index, FlightEvent &event);
+
+/*return the length written like snprintf*/
+int formatFlightHeader(char *buf, size_t len);
+int formatFlightEvent(const FlightEvent &event, char *buf, size_t len);
+
+/*false for lines that aren't @FE, or name events this build doesn't know*/
+bool parseFlightEvent(const char *line, FlightEvent &event);
+
+#endif
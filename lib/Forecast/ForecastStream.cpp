@@ -0,0 +1,388 @@
+#include "ForecastStream.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+  ST_VALUE,   //a value has to come next
+  ST_KEY,     //inside an object, a key or } has to come next
+  ST_COLON,
+  ST_AFTER,   //after a value, , or the closing bracket
+  ST_STRING,
+  ST_ESCAPE,
+  ST_UNICODE,
+  ST_NUMBER,
+  ST_LITERAL, //true, false or null
+  ST_DONE,
+  ST_ERROR
+};
+
+#define SECONDS_PER_DAY 86400L
+
+static bool isSpace(char c){
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+/*division rounding half away from zero*/
+static int32_t roundDiv(int32_t value, int32_t by){
+  return value < 0 ? -((-value + by / 2) / by) : (value + by / 2) / by;
+}
+
+static int32_t floorDiv(int32_t value, int32_t by){
+  return value < 0 ? -((-value + by - 1) / by) : value / by;
+}
+
+/*condition groups in order of how much they matter when a day has as
+many of one as of another*/
+static int conditionGroup(int id){
+  if(id >= 200 && id < 300) return 0; //thunderstorm
+  if(id >= 600 && id < 700) return 1; //snow
+  if(id >= 500 && id < 600) return 2; //rain
+  if(id >= 300 && id < 400) return 3; //drizzle
+  if(id >= 700 && id < 800) return 4; //fog, mist, dust...
+  if(id > 800 && id < 900) return 5;  //clouds
+  if(id == 800) return 6;             //clear
+  return -1;
+}
+
+const char *conditionName(int id){
+  static const char *names[] = {"Thdr", "Snow", "Rain", "Drzl", "Fog", "Clds", "Sun"};
+  int group = conditionGroup(id);
+  return group < 0 ? "?" : names[group];
+}
+
+int32_t parseCenti(const char *text){
+  bool negative = *text == '-';
+  if(negative) text++;
+  int32_t value = 0;
+  while(*text >= '0' && *text <= '9'){
+    value = value * 10 + (*text++ - '0');
+  }
+  value *= 100;
+  if(*text == '.'){
+    text++;
+    for(int32_t scale = 10; scale > 0 && *text >= '0' && *text <= '9'; scale /= 10){
+      value += (*text++ - '0') * scale;
+    }
+    if(*text >= '5' && *text <= '9'){
+      value++;
+    }
+  }
+  return negative ? -value : value;
+}
+
+void ForecastStream::bodyCallback(const uint8_t *data, size_t len, void *context){
+  ((ForecastStream *)context)->feed(data, len);
+}
+
+void ForecastStream::begin(ForecastSlot *s, int count){
+  slots = s;
+  slotCount = count;
+  filled = 0;
+  entries = 0;
+  dayTotal = 0;
+  memset(groupCount, 0, sizeof(groupCount));
+  memset(groupId, 0, sizeof(groupId));
+  nextUtcOffset = utcOffset;
+
+  state = ST_VALUE;
+  depth = 0;
+  textLen = 0;
+  sawList = false;
+}
+
+void ForecastStream::feed(const uint8_t *data, size_t len){
+  for(size_t i = 0; i < len && state != ST_ERROR; i++){
+    put((char)data[i]);
+  }
+}
+
+int ForecastStream::finish(){
+  if(state != ST_DONE || !sawList){
+    return -1;
+  }
+  closeDay();
+  utcOffset = nextUtcOffset;
+  return entries;
+}
+
+void ForecastStream::append(char c){
+  if(textLen < FORECAST_MAX_VALUE - 1){
+    text[textLen++] = c;
+  }
+}
+
+void ForecastStream::put(char c){
+  switch(state){
+    case ST_VALUE:
+      if(isSpace(c)) return;
+      if(c == ']' && depth > 0 && levels[depth - 1].array){
+        popLevel(); //empty array
+        return;
+      }
+      startValue(c);
+      return;
+
+    case ST_KEY:
+      if(isSpace(c)) return;
+      if(c == '"'){
+        isKey = true;
+        textLen = 0;
+        state = ST_STRING;
+      }else if(c == '}'){
+        popLevel(); //empty object
+      }else{
+        state = ST_ERROR;
+      }
+      return;
+
+    case ST_COLON:
+      if(isSpace(c)) return;
+      state = c == ':' ? ST_VALUE : ST_ERROR;
+      return;
+
+    case ST_AFTER: {
+      if(isSpace(c)) return;
+      Level &top = levels[depth - 1];
+      if(c == ','){
+        if(top.array){
+          if(top.index < 255) top.index++;
+          state = ST_VALUE;
+        }else{
+          state = ST_KEY;
+        }
+      }else if(c == (top.array ? ']' : '}')){
+        popLevel();
+      }else{
+        state = ST_ERROR;
+      }
+      return;
+    }
+
+    case ST_STRING:
+      if(c == '\\'){
+        state = ST_ESCAPE;
+      }else if(c == '"'){
+        text[textLen] = '\0';
+        if(isKey){
+          keyDone();
+          state = ST_COLON;
+        }else{
+          scalar();
+          endValue();
+        }
+      }else{
+        append(c);
+      }
+      return;
+
+    case ST_ESCAPE:
+      if(c == 'u'){
+        skip = 4;
+        state = ST_UNICODE;
+      }else{
+        append(c);
+        state = ST_STRING;
+      }
+      return;
+
+    case ST_UNICODE:
+      if(--skip == 0){
+        append('?');
+        state = ST_STRING;
+      }
+      return;
+
+    case ST_NUMBER:
+      if((c >= '0' && c <= '9') || c == '.' || c == '-' || c == '+' || c == 'e' || c == 'E'){
+        append(c);
+        return;
+      }
+      text[textLen] = '\0';
+      scalar();
+      endValue();
+      put(c);
+      return;
+
+    case ST_LITERAL:
+      if(c >= 'a' && c <= 'z') return;
+      endValue();
+      put(c);
+      return;
+
+    case ST_DONE:
+      if(!isSpace(c)) state = ST_ERROR;
+      return;
+  }
+}
+
+void ForecastStream::startValue(char c){
+  if(c == '{' || c == '['){
+    pushLevel(c == '[');
+  }else if(c == '"'){
+    isKey = false;
+    textLen = 0;
+    state = ST_STRING;
+  }else if(c == '-' || (c >= '0' && c <= '9')){
+    textLen = 0;
+    append(c);
+    state = ST_NUMBER;
+  }else if(c == 't' || c == 'f' || c == 'n'){
+    state = ST_LITERAL;
+  }else{
+    state = ST_ERROR;
+  }
+}
+
+void ForecastStream::endValue(){
+  state = depth == 0 ? ST_DONE : ST_AFTER;
+}
+
+void ForecastStream::pushLevel(bool array){
+  if(depth == FORECAST_MAX_DEPTH){
+    state = ST_ERROR;
+    return;
+  }
+  if(depth == 0 && array){
+    state = ST_ERROR; //a forecast is an object
+    return;
+  }
+  Level &level = levels[depth++];
+  level.array = array;
+  level.key = KEY_OTHER;
+  level.index = 0;
+
+  if(depth == 2 && array && levels[0].key == KEY_LIST){
+    sawList = true;
+  }
+  if(depth == 3 && !array && inEntry()){
+    memset(&entry, 0, sizeof(entry));
+  }
+  state = array ? ST_VALUE : ST_KEY;
+}
+
+void ForecastStream::popLevel(){
+  if(depth == 3 && inEntry()){
+    commitEntry();
+  }
+  depth--;
+  endValue();
+}
+
+/*levels[2] is one element of the list array*/
+bool ForecastStream::inEntry() const {
+  return depth >= 3 && levels[0].key == KEY_LIST && levels[1].array && !levels[2].array;
+}
+
+void ForecastStream::keyDone(){
+  static const struct {
+    const char *name;
+    Key key;
+  } keys[] = {
+    {"list", KEY_LIST}, {"dt", KEY_DT}, {"dt_txt", KEY_DT_TXT}, {"main", KEY_MAIN},
+    {"temp", KEY_TEMP}, {"weather", KEY_WEATHER}, {"id", KEY_ID}, {"city", KEY_CITY},
+    {"timezone", KEY_TIMEZONE}
+  };
+  Key key = KEY_OTHER;
+  for(size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++){
+    if(strcmp(text, keys[i].name) == 0){
+      key = keys[i].key;
+      break;
+    }
+  }
+  levels[depth - 1].key = key;
+}
+
+/*a string or number value is complete in text*/
+void ForecastStream::scalar(){
+  if(depth == 2 && levels[0].key == KEY_CITY && levels[1].key == KEY_TIMEZONE){
+    nextUtcOffset = atol(text);
+    return;
+  }
+  if(!inEntry()){
+    return;
+  }
+  Key field = levels[2].key;
+  if(depth == 3 && field == KEY_DT){
+    entry.dt = atol(text);
+    entry.hasDt = true;
+  }else if(depth == 3 && field == KEY_DT_TXT && textLen >= 16){
+    /*"2024-01-31 15:00:00", only HH:MM fits the screen*/
+    memcpy(entry.time, text + 11, 5);
+    entry.time[5] = '\0';
+  }else if(depth == 4 && field == KEY_MAIN && levels[3].key == KEY_TEMP){
+    entry.tempCentiK = parseCenti(text);
+    entry.hasTemp = true;
+  }else if(depth == 5 && field == KEY_WEATHER && levels[3].array && levels[3].index == 0
+           && levels[4].key == KEY_ID){
+    entry.weatherId = atoi(text);
+  }
+}
+
+void ForecastStream::commitEntry(){
+  if(!entry.hasDt || !entry.hasTemp){
+    return;
+  }
+  entries++;
+  int16_t tempDeci = roundDiv(entry.tempCentiK - 27315, 10);
+
+  if(filled < slotCount){
+    ForecastSlot &slot = slots[filled++];
+    slot.weatherId = entry.weatherId;
+    slot.temperature = roundDiv(tempDeci, 10);
+    if(entry.time[0] != '\0'){
+      memcpy(slot.time, entry.time, sizeof(slot.time));
+    }else{
+      int32_t minutes = (entry.dt % SECONDS_PER_DAY) / 60;
+      slot.time[0] = '0' + minutes / 600;
+      slot.time[1] = '0' + minutes / 60 % 10;
+      slot.time[2] = ':';
+      slot.time[3] = '0' + minutes % 60 / 10;
+      slot.time[4] = '0' + minutes % 10;
+      slot.time[5] = '\0';
+    }
+  }
+
+  addToDay(floorDiv(entry.dt + utcOffset, SECONDS_PER_DAY), tempDeci, entry.weatherId);
+}
+
+void ForecastStream::addToDay(int32_t day, int16_t temp, int16_t id){
+  if(dayTotal == 0 || days[dayTotal - 1].day != day){
+    closeDay();
+    if(dayTotal == FORECAST_DAYS){
+      return;
+    }
+    ForecastDay &d = days[dayTotal++];
+    d.day = day;
+    d.minTemp = temp;
+    d.maxTemp = temp;
+    d.weatherId = 0;
+    d.samples = 0;
+  }
+  ForecastDay &d = days[dayTotal - 1];
+  if(temp < d.minTemp) d.minTemp = temp;
+  if(temp > d.maxTemp) d.maxTemp = temp;
+  d.samples++;
+
+  int group = conditionGroup(id);
+  if(group >= 0){
+    groupCount[group]++;
+    /*within a group a higher id is heavier rain, more clouds...*/
+    if(id > groupId[group]) groupId[group] = id;
+  }
+}
+
+/*picks the most common condition group of the day being filled*/
+void ForecastStream::closeDay(){
+  int best = -1;
+  for(int g = 0; g < 7; g++){
+    if(groupCount[g] > 0 && (best < 0 || groupCount[g] > groupCount[best])){
+      best = g;
+    }
+  }
+  if(best >= 0 && dayTotal > 0){
+    days[dayTotal - 1].weatherId = groupId[best];
+  }
+  memset(groupCount, 0, sizeof(groupCount));
+  memset(groupId, 0, sizeof(groupId));
+}
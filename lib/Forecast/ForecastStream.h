@@ -0,0 +1,108 @@
+#ifndef FORECAST_STREAM_H
+#define FORECAST_STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Station.h"
+
+/*a 5 day forecast touches 6 calendar days unless it starts at midnight*/
+#define FORECAST_DAYS 6
+
+#define FORECAST_MAX_DEPTH 8
+#define FORECAST_MAX_VALUE 24
+
+/*Reads an OpenWeatherMap /forecast response as it arrives, without
+keeping the document. Bytes go through a small JSON tokenizer that only
+remembers the path to the current value; the fields the station uses are
+picked out of each list entry and the entry is folded into the first
+forecast slots and the daily summary before the next one starts. Memory
+is the size of this object whatever cnt is.
+
+Days are split on local midnight. The API sends the UTC offset in
+city.timezone after the list, so it is remembered for the next response
+and the first one uses the offset given to the constructor*/
+class ForecastStream {
+ public:
+  explicit ForecastStream(int32_t utcOffset = 0) : utcOffset(utcOffset) {}
+
+  /*starts a new response, the first slotCount entries fill slots*/
+  void begin(ForecastSlot *slots, int slotCount);
+  void feed(const uint8_t *data, size_t len);
+  /*AsyncHttpBodyCallback with the ForecastStream as context*/
+  static void bodyCallback(const uint8_t *data, size_t len, void *context);
+
+  /*entries read, or -1 if the JSON was broken or had no list*/
+  int finish();
+
+  int slotsFilled() const { return filled; }
+  const ForecastDay *getDays() const { return days; }
+  int dayCount() const { return dayTotal; }
+  int32_t getUtcOffset() const { return utcOffset; }
+
+ private:
+  enum Key : uint8_t {
+    KEY_OTHER, KEY_LIST, KEY_DT, KEY_DT_TXT, KEY_MAIN, KEY_TEMP,
+    KEY_WEATHER, KEY_ID, KEY_CITY, KEY_TIMEZONE
+  };
+
+  struct Level {
+    bool array;
+    Key key;       //object: key of the value being read
+    uint8_t index; //array: element being read
+  };
+
+  void put(char c);
+  void startValue(char c);
+  void endValue();
+  void scalar();
+  void keyDone();
+  void append(char c);
+  void pushLevel(bool array);
+  void popLevel();
+  bool inEntry() const;
+  void commitEntry();
+  void addToDay(int32_t day, int16_t temp, int16_t id);
+  void closeDay();
+
+  /*tokenizer*/
+  uint8_t state;
+  bool isKey;
+  uint8_t depth;
+  Level levels[FORECAST_MAX_DEPTH];
+  char text[FORECAST_MAX_VALUE];
+  uint8_t textLen;
+  uint8_t skip; //hex digits of a \u escape still to come
+  bool sawList;
+
+  /*list entry being read*/
+  struct {
+    bool hasDt, hasTemp;
+    int32_t dt;
+    int32_t tempCentiK;
+    int16_t weatherId;
+    char time[6];
+  } entry;
+  int entries;
+
+  ForecastSlot *slots = NULL;
+  int slotCount = 0;
+  int filled = 0;
+
+  int32_t utcOffset;
+  int32_t nextUtcOffset;
+
+  ForecastDay days[FORECAST_DAYS];
+  int dayTotal = 0;
+  /*condition groups counted for the day being filled*/
+  uint8_t groupCount[7];
+  int16_t groupId[7];
+};
+
+/*"283.47" as 28347, rounded at the third decimal*/
+int32_t parseCenti(const char *text);
+
+/*short name of the condition group of an OpenWeatherMap weather id*/
+const char *conditionName(int weatherId);
+
+#endif
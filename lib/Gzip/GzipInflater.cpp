@@ -0,0 +1,442 @@
+#include "GzipInflater.h"
+
+#include <string.h>
+
+/*length and distance codes, RFC 1951 3.2.5*/
+static const uint16_t lengthBase[29] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t lengthExtra[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t distanceBase[30] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+  4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t distanceExtra[30] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+/*order the code length code's lengths come in*/
+static const uint8_t lengthOrder[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+/*CRC-32 a nibble at a time*/
+static const uint32_t crcTable[16] = {
+  0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+  0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+};
+
+#define GZIP_FLAG_HCRC 0x02
+#define GZIP_FLAG_EXTRA 0x04
+#define GZIP_FLAG_NAME 0x08
+#define GZIP_FLAG_COMMENT 0x10
+
+/*the most bits one step takes: a length code with its extra bits and a
+distance code with its extra bits. The gzip trailer guarantees there are
+always that many after any symbol, so a step can wait for them*/
+#define STEP_BITS 48
+
+/*builds the code from each symbol's length, false if the lengths ask for
+more codes than there are. Fewer is allowed, decode() fails on the codes
+that are missing*/
+static bool buildHuffman(GzipHuffman &h, const uint8_t *length, int n){
+  memset(h.count, 0, sizeof(h.count));
+  for(int s = 0; s < n; s++){
+    h.count[length[s]]++;
+  }
+  int left = 1;
+  for(int len = 1; len < 16; len++){
+    left <<= 1;
+    left -= h.count[len];
+    if(left < 0){
+      return false;
+    }
+  }
+  uint16_t offset[16];
+  offset[1] = 0;
+  for(int len = 1; len < 15; len++){
+    offset[len + 1] = offset[len] + h.count[len];
+  }
+  for(int s = 0; s < n; s++){
+    if(length[s] != 0){
+      h.symbol[offset[length[s]]++] = s;
+    }
+  }
+  return true;
+}
+
+GzipInflater::GzipInflater(uint8_t *window, size_t windowSize)
+  : window(window), mask(windowSize - 1), output(NULL), context(NULL), state(STATE_DONE), err(GZIP_OK){
+  lit.symbol = litSymbols;
+  dist.symbol = distSymbols;
+}
+
+void GzipInflater::begin(GzipOutput out, void *ctx){
+  output = out;
+  context = ctx;
+  state = STATE_HEADER;
+  err = GZIP_OK;
+  flags = 0;
+  lastBlock = false;
+  bitBuffer = 0;
+  bitCount = 0;
+  inCount = total = flushed = maxDistance = 0;
+  crc = 0xffffffff;
+  remaining = 0;
+}
+
+GzipResult GzipInflater::feed(const uint8_t *data, size_t len){
+  if(state == STATE_DONE){
+    return GZIP_DONE;
+  }
+  if(state == STATE_ERROR){
+    return GZIP_ERROR;
+  }
+  in = data;
+  inEnd = data + len;
+  inCount += len;
+  GzipResult result = run();
+  flush();
+  return result;
+}
+
+/*true once n bits are buffered. Everything fed ends up in the bit
+buffer before feed() returns, there is never input left over*/
+bool GzipInflater::need(unsigned n){
+  while(bitCount <= 56 && in < inEnd){
+    bitBuffer |= (uint64_t)*in++ << bitCount;
+    bitCount += 8;
+  }
+  return bitCount >= n;
+}
+
+uint32_t GzipInflater::bits(unsigned n){
+  uint32_t value = (uint32_t)(bitBuffer & (((uint64_t)1 << n) - 1));
+  bitBuffer >>= n;
+  bitCount -= n;
+  return value;
+}
+
+void GzipInflater::alignToByte(){
+  bits(bitCount & 7);
+}
+
+/*one bit at a time down the canonical code, RFC 1951 3.2.2*/
+int GzipInflater::decode(const GzipHuffman &h){
+  int code = 0, first = 0, index = 0;
+  for(int len = 1; len < 16; len++){
+    code |= bits(1);
+    int count = h.count[len];
+    if(code - count < first){
+      return h.symbol[index + (code - first)];
+    }
+    index += count;
+    first += count;
+    first <<= 1;
+    code <<= 1;
+  }
+  return -1;
+}
+
+/*output stays in the window until it would be overwritten, so the
+callback gets it in pieces as big as the window*/
+void GzipInflater::put(uint8_t b){
+  if(total - flushed > mask){
+    flush();
+  }
+  window[total & mask] = b;
+  total++;
+}
+
+void GzipInflater::flush(){
+  while(flushed != total){
+    uint32_t start = flushed & mask;
+    uint32_t n = total - flushed;
+    if(n > mask + 1 - start){
+      n = mask + 1 - start;
+    }
+    const uint8_t *p = window + start;
+    for(uint32_t i = 0; i < n; i++){
+      crc ^= p[i];
+      crc = (crc >> 4) ^ crcTable[crc & 15];
+      crc = (crc >> 4) ^ crcTable[crc & 15];
+    }
+    if(output != NULL){
+      output(p, n, context);
+    }
+    flushed += n;
+  }
+}
+
+/*after the fixed header and each optional field, the next one the flags
+ask for*/
+void GzipInflater::nextHeaderField(){
+  if(flags & GZIP_FLAG_EXTRA){
+    flags &= ~GZIP_FLAG_EXTRA;
+    state = STATE_EXTRA_LENGTH;
+  }else if(flags & GZIP_FLAG_NAME){
+    flags &= ~GZIP_FLAG_NAME;
+    state = STATE_NAME;
+  }else if(flags & GZIP_FLAG_COMMENT){
+    flags &= ~GZIP_FLAG_COMMENT;
+    state = STATE_COMMENT;
+  }else if(flags & GZIP_FLAG_HCRC){
+    flags &= ~GZIP_FLAG_HCRC;
+    state = STATE_HEADER_CRC;
+  }else{
+    state = STATE_BLOCK;
+  }
+}
+
+GzipResult GzipInflater::fail(GzipError error){
+  err = error;
+  state = STATE_ERROR;
+  return GZIP_ERROR;
+}
+
+/*runs until the input runs out in the middle of a step, the step is
+then done from the start when more comes*/
+GzipResult GzipInflater::run(){
+  for(;;){
+    switch(state){
+      case STATE_HEADER:
+        if(!need(32)) return GZIP_MORE;
+        if(bits(8) != 0x1f || bits(8) != 0x8b || bits(8) != 8){
+          return fail(GZIP_BAD_HEADER);
+        }
+        flags = bits(8);
+        if(flags & 0xe0){
+          return fail(GZIP_BAD_HEADER);
+        }
+        state = STATE_HEADER_REST;
+        break;
+
+      case STATE_HEADER_REST:
+        /*modification time, extra flags, OS*/
+        if(!need(48)) return GZIP_MORE;
+        bits(32);
+        bits(16);
+        nextHeaderField();
+        break;
+
+      case STATE_EXTRA_LENGTH:
+        if(!need(16)) return GZIP_MORE;
+        remaining = bits(16);
+        state = STATE_EXTRA;
+        break;
+
+      case STATE_EXTRA:
+        while(remaining > 0){
+          if(!need(8)) return GZIP_MORE;
+          bits(8);
+          remaining--;
+        }
+        nextHeaderField();
+        break;
+
+      case STATE_NAME:
+      case STATE_COMMENT:
+        for(;;){
+          if(!need(8)) return GZIP_MORE;
+          if(bits(8) == 0) break;
+        }
+        nextHeaderField();
+        break;
+
+      case STATE_HEADER_CRC:
+        if(!need(16)) return GZIP_MORE;
+        bits(16);
+        state = STATE_BLOCK;
+        break;
+
+      case STATE_BLOCK: {
+        if(!need(3)) return GZIP_MORE;
+        lastBlock = bits(1);
+        uint32_t type = bits(2);
+        if(type == 0){
+          alignToByte();
+          state = STATE_STORED_LENGTH;
+        }else if(type == 1){
+          /*the fixed code, RFC 1951 3.2.6*/
+          int s = 0;
+          for(; s < 144; s++) lengths[s] = 8;
+          for(; s < 256; s++) lengths[s] = 9;
+          for(; s < 280; s++) lengths[s] = 7;
+          for(; s < 288; s++) lengths[s] = 8;
+          buildHuffman(lit, lengths, 288);
+          memset(lengths, 5, 30);
+          buildHuffman(dist, lengths, 30);
+          state = STATE_CODES;
+        }else if(type == 2){
+          state = STATE_TABLE_SIZES;
+        }else{
+          return fail(GZIP_BAD_BLOCK);
+        }
+        break;
+      }
+
+      case STATE_STORED_LENGTH: {
+        if(!need(32)) return GZIP_MORE;
+        uint32_t len = bits(16), inverse = bits(16);
+        if(len != (~inverse & 0xffff)){
+          return fail(GZIP_BAD_BLOCK);
+        }
+        remaining = len;
+        state = STATE_STORED;
+        break;
+      }
+
+      case STATE_STORED:
+        /*what is in the bit buffer first, then straight from the input*/
+        while(remaining > 0){
+          if(bitCount >= 8){
+            put(bits(8));
+          }else if(in < inEnd){
+            put(*in++);
+          }else{
+            return GZIP_MORE;
+          }
+          remaining--;
+        }
+        state = lastBlock ? STATE_TRAILER : STATE_BLOCK;
+        break;
+
+      case STATE_TABLE_SIZES:
+        if(!need(14)) return GZIP_MORE;
+        literalCodes = bits(5) + 257;
+        distanceCodes = bits(5) + 1;
+        lengthCodes = bits(4) + 4;
+        if(literalCodes > 286 || distanceCodes > 30){
+          return fail(GZIP_BAD_BLOCK);
+        }
+        memset(lengths, 0, 19);
+        lengthIndex = 0;
+        state = STATE_CODE_LENGTHS;
+        break;
+
+      case STATE_CODE_LENGTHS:
+        while(lengthIndex < lengthCodes){
+          if(!need(3)) return GZIP_MORE;
+          lengths[lengthOrder[lengthIndex++]] = bits(3);
+        }
+        /*the code length code goes in dist until the real one is read*/
+        if(!buildHuffman(dist, lengths, 19)){
+          return fail(GZIP_BAD_BLOCK);
+        }
+        lengthIndex = 0;
+        state = STATE_LENGTHS;
+        break;
+
+      case STATE_LENGTHS: {
+        uint16_t all = literalCodes + distanceCodes;
+        while(lengthIndex < all){
+          /*a code length code and up to 7 extra bits*/
+          if(!need(14)) return GZIP_MORE;
+          int symbol = decode(dist);
+          if(symbol < 0){
+            return fail(GZIP_BAD_BLOCK);
+          }
+          if(symbol < 16){
+            lengths[lengthIndex++] = symbol;
+            continue;
+          }
+          uint8_t value = 0;
+          uint32_t repeat;
+          if(symbol == 16){
+            if(lengthIndex == 0){
+              return fail(GZIP_BAD_BLOCK);
+            }
+            value = lengths[lengthIndex - 1];
+            repeat = 3 + bits(2);
+          }else if(symbol == 17){
+            repeat = 3 + bits(3);
+          }else{
+            repeat = 11 + bits(7);
+          }
+          if(lengthIndex + repeat > all){
+            return fail(GZIP_BAD_BLOCK);
+          }
+          memset(lengths + lengthIndex, value, repeat);
+          lengthIndex += repeat;
+        }
+        /*a block that can't end is broken*/
+        if(lengths[256] == 0 || !buildHuffman(lit, lengths, literalCodes) ||
+           !buildHuffman(dist, lengths + literalCodes, distanceCodes)){
+          return fail(GZIP_BAD_BLOCK);
+        }
+        state = STATE_CODES;
+        break;
+      }
+
+      case STATE_CODES:
+        for(;;){
+          if(!need(STEP_BITS)) return GZIP_MORE;
+          int symbol = decode(lit);
+          if(symbol < 0){
+            return fail(GZIP_BAD_CODE);
+          }
+          if(symbol < 256){
+            put(symbol);
+            continue;
+          }
+          if(symbol == 256){
+            break;
+          }
+          symbol -= 257;
+          if(symbol >= 29){
+            return fail(GZIP_BAD_CODE);
+          }
+          uint32_t length = lengthBase[symbol] + bits(lengthExtra[symbol]);
+          int code = decode(dist);
+          if(code < 0 || code >= 30){
+            return fail(GZIP_BAD_CODE);
+          }
+          uint32_t distance = distanceBase[code] + bits(distanceExtra[code]);
+          if(distance > total){
+            return fail(GZIP_BAD_CODE);
+          }
+          if(distance > mask + 1){
+            return fail(GZIP_TOO_FAR);
+          }
+          if(distance > maxDistance){
+            maxDistance = distance;
+          }
+          /*byte by byte, the copy may overlap what it writes*/
+          while(length-- > 0){
+            put(window[(total - distance) & mask]);
+          }
+        }
+        state = lastBlock ? STATE_TRAILER : STATE_BLOCK;
+        break;
+
+      case STATE_TRAILER: {
+        alignToByte();
+        if(!need(64)) return GZIP_MORE;
+        flush();
+        uint32_t expectedCrc = bits(32), expectedLength = bits(32);
+        if(expectedCrc != ~crc || expectedLength != total){
+          return fail(GZIP_BAD_CHECKSUM);
+        }
+        state = STATE_DONE;
+        return GZIP_DONE;
+      }
+
+      case STATE_DONE:
+        return GZIP_DONE;
+
+      case STATE_ERROR:
+        return GZIP_ERROR;
+    }
+  }
+}
+
+const char *GzipInflater::errorName(GzipError error){
+  switch(error){
+    case GZIP_OK: return "ok";
+    case GZIP_BAD_HEADER: return "bad header";
+    case GZIP_BAD_BLOCK: return "bad block";
+    case GZIP_BAD_CODE: return "bad code";
+    case GZIP_TOO_FAR: return "reference past the window";
+    case GZIP_BAD_CHECKSUM: return "bad checksum";
+  }
+  return "?";
+}
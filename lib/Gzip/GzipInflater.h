@@ -0,0 +1,107 @@
+#ifndef GZIP_INFLATER_H
+#define GZIP_INFLATER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*Inflates a gzip stream as it arrives, in pieces of any size, and hands
+the output on in pieces too. The only memory is this object (about 1 kB of
+code tables) and the window given to the constructor, which holds the
+output a back-reference can reach. Deflate allows 32 kB back, but a
+server's compressor only reaches as far back as the text goes, so a
+window the size of the uncompressed answer is always enough and smaller
+usually is. A reference past the window fails with GZIP_TOO_FAR,
+farthest() tells how far they went on a stream that fitted.
+
+The CRC and length in the gzip trailer are checked, a stream only counts
+as done() once they match. Plain C++, the same code is used on the host
+by tools/forecast/forecastsum*/
+
+enum GzipResult {
+  GZIP_MORE,  //everything fed was used, the stream isn't finished
+  GZIP_DONE,  //trailer checked, anything after it is ignored
+  GZIP_ERROR
+};
+
+enum GzipError {
+  GZIP_OK,
+  GZIP_BAD_HEADER,   //not gzip, or not deflate inside
+  GZIP_BAD_BLOCK,    //reserved block type, stored length mismatch, bad code lengths
+  GZIP_BAD_CODE,     //a symbol or distance that doesn't exist
+  GZIP_TOO_FAR,      //a back-reference past the window
+  GZIP_BAD_CHECKSUM  //CRC or length in the trailer differ
+};
+
+typedef void (*GzipOutput)(const uint8_t *data, size_t len, void *context);
+
+/*canonical Huffman code as counts of each length and the symbols in
+code order*/
+struct GzipHuffman {
+  uint16_t count[16];
+  uint16_t *symbol;
+};
+
+class GzipInflater {
+ public:
+  /*windowSize is a power of two up to 32768*/
+  GzipInflater(uint8_t *window, size_t windowSize);
+
+  /*starts a new stream, inflated bytes go to out*/
+  void begin(GzipOutput out, void *context);
+  GzipResult feed(const uint8_t *data, size_t len);
+
+  bool done() const { return state == STATE_DONE; }
+  GzipError error() const { return err; }
+  uint32_t bytesIn() const { return inCount; }
+  uint32_t bytesOut() const { return total; }
+  /*the longest back-reference in the stream so far*/
+  uint32_t farthest() const { return maxDistance; }
+  size_t windowSize() const { return mask + 1; }
+
+  static const char *errorName(GzipError error);
+
+ private:
+  enum State : uint8_t {
+    STATE_HEADER, STATE_HEADER_REST, STATE_EXTRA_LENGTH, STATE_EXTRA, STATE_NAME, STATE_COMMENT,
+    STATE_HEADER_CRC, STATE_BLOCK, STATE_STORED_LENGTH, STATE_STORED, STATE_TABLE_SIZES,
+    STATE_CODE_LENGTHS, STATE_LENGTHS, STATE_CODES, STATE_TRAILER, STATE_DONE, STATE_ERROR
+  };
+
+  GzipResult run();
+  bool need(unsigned n);
+  uint32_t bits(unsigned n);
+  void alignToByte();
+  int decode(const GzipHuffman &h);
+  void put(uint8_t b);
+  void flush();
+  void nextHeaderField();
+  GzipResult fail(GzipError error);
+
+  uint8_t *window;
+  uint32_t mask;
+  GzipOutput output;
+  void *context;
+
+  State state;
+  GzipError err;
+  uint8_t flags;
+  bool lastBlock;
+  uint64_t bitBuffer;
+  unsigned bitCount;
+  const uint8_t *in, *inEnd;
+
+  uint32_t inCount, total, flushed, maxDistance;
+  uint32_t crc;
+  uint32_t remaining; //stored bytes, extra field bytes
+
+  /*dynamic block header, code lengths are read into lengths and decoded
+  with the code length code, which is built in dist until dist is needed*/
+  uint16_t literalCodes, distanceCodes, lengthCodes, lengthIndex;
+  uint8_t lengths[320];
+
+  GzipHuffman lit, dist;
+  uint16_t litSymbols[288];
+  uint16_t distSymbols[32];
+};
+
+#endif
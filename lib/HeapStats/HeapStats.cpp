@@ -0,0 +1,253 @@
+#include "HeapStats.h"
+
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+static const char *tagNames[HEAP_TAG_COUNT] = {"other", "http", "json", "display", "strings"};
+
+/*written from the wrappers below on any task, so only touched
+with atomic adds*/
+static HeapTagCounters totals[HEAP_TAG_COUNT];
+
+/*the tag only applies to the task that opened the scope*/
+static volatile HeapTag currentTag = HEAP_TAG_OTHER;
+static TaskHandle_t tagOwner = NULL;
+
+static HeapSample window[HEAP_STATS_WINDOW];
+static int windowHead = 0, windowCount = 0;
+static HeapTagCounters lastTotals[HEAP_TAG_COUNT];
+/*tagged blocks that didn't fit the table and count as other*/
+static uint32_t untracked = 0;
+
+HeapTagScope::HeapTagScope(HeapTag tag){
+  previous = currentTag;
+  previousOwner = tagOwner;
+  tagOwner = xTaskGetCurrentTaskHandle();
+  currentTag = tag;
+}
+
+/*the outer scope's task too, or an outer tag would go on applying to
+whichever task last opened a scope*/
+HeapTagScope::~HeapTagScope(){
+  currentTag = previous;
+  tagOwner = previousOwner;
+}
+
+#ifdef HEAP_STATS_WRAP_MALLOC
+
+extern "C" {
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+static inline HeapTag activeTag(){
+  HeapTag tag = currentTag;
+  if(tag != HEAP_TAG_OTHER && xTaskGetCurrentTaskHandle() != tagOwner){
+    tag = HEAP_TAG_OTHER;
+  }
+  return tag;
+}
+
+/*the tagged blocks alive, by address. Linear probing, kept at most 3/4
+full so a lookup always ends at an empty slot*/
+struct TrackedBlock {
+  void *ptr;
+  uint8_t tag;
+};
+static TrackedBlock tracked[HEAP_STATS_TRACKED];
+static uint32_t trackedCount = 0;
+static portMUX_TYPE trackedLock = portMUX_INITIALIZER_UNLOCKED;
+
+static inline uint32_t homeSlot(void *ptr){
+  return (uint32_t)((uintptr_t)ptr >> 3) * 2654435761u % HEAP_STATS_TRACKED;
+}
+
+/*false if the table is full*/
+static bool track(void *ptr, HeapTag tag){
+  bool stored = false;
+  portENTER_CRITICAL(&trackedLock);
+  if(trackedCount < HEAP_STATS_TRACKED * 3 / 4){
+    uint32_t i = homeSlot(ptr);
+    while(tracked[i].ptr != NULL){
+      i = (i + 1) % HEAP_STATS_TRACKED;
+    }
+    tracked[i].ptr = ptr;
+    tracked[i].tag = tag;
+    trackedCount++;
+    stored = true;
+  }
+  portEXIT_CRITICAL(&trackedLock);
+  return stored;
+}
+
+/*the tag ptr was allocated under, taken out of the table if forget*/
+static HeapTag trackedTag(void *ptr, bool forget){
+  if(__atomic_load_n(&trackedCount, __ATOMIC_RELAXED) == 0){
+    return HEAP_TAG_OTHER;
+  }
+  HeapTag tag = HEAP_TAG_OTHER;
+  portENTER_CRITICAL(&trackedLock);
+  uint32_t i = homeSlot(ptr);
+  while(tracked[i].ptr != NULL && tracked[i].ptr != ptr){
+    i = (i + 1) % HEAP_STATS_TRACKED;
+  }
+  if(tracked[i].ptr == ptr){
+    tag = (HeapTag)tracked[i].tag;
+    if(forget){
+      /*entries after the hole move back into it unless that would put
+      them before their home slot, so no lookup stops short of them*/
+      uint32_t hole = i;
+      for(uint32_t j = (i + 1) % HEAP_STATS_TRACKED; tracked[j].ptr != NULL; j = (j + 1) % HEAP_STATS_TRACKED){
+        uint32_t home = homeSlot(tracked[j].ptr);
+        bool between = hole < j ? home > hole && home <= j : home > hole || home <= j;
+        if(!between){
+          tracked[hole] = tracked[j];
+          hole = j;
+        }
+      }
+      tracked[hole].ptr = NULL;
+      trackedCount--;
+    }
+  }
+  portEXIT_CRITICAL(&trackedLock);
+  return tag;
+}
+
+static inline void countAlloc(void *ptr){
+  if(ptr == NULL){
+    return;
+  }
+  HeapTag tag = activeTag();
+  if(tag != HEAP_TAG_OTHER && !track(ptr, tag)){
+    tag = HEAP_TAG_OTHER;
+    __atomic_fetch_add(&untracked, 1, __ATOMIC_RELAXED);
+  }
+  HeapTagCounters &c = totals[tag];
+  __atomic_fetch_add(&c.allocs, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&c.bytes, (int32_t)heap_caps_get_allocated_size(ptr), __ATOMIC_RELAXED);
+}
+
+/*before the block goes back to the heap, while its size can be asked*/
+static inline void countFree(void *ptr, size_t size){
+  if(ptr == NULL){
+    return;
+  }
+  HeapTagCounters &c = totals[trackedTag(ptr, true)];
+  __atomic_fetch_add(&c.frees, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_sub(&c.bytes, (int32_t)size, __ATOMIC_RELAXED);
+}
+
+void *__wrap_malloc(size_t size){
+  void *ptr = __real_malloc(size);
+  countAlloc(ptr);
+  return ptr;
+}
+
+void *__wrap_calloc(size_t n, size_t size){
+  void *ptr = __real_calloc(n, size);
+  countAlloc(ptr);
+  return ptr;
+}
+
+/*a realloc that moves the block counts as a free and an allocation, one
+that resizes it in place only changes its tag's bytes. A failed one
+changes nothing, the old block is still there*/
+void *__wrap_realloc(void *ptr, size_t size){
+  size_t oldSize = ptr != NULL ? heap_caps_get_allocated_size(ptr) : 0;
+  void *moved = __real_realloc(ptr, size);
+  if(moved != NULL && moved == ptr){
+    int32_t grown = (int32_t)heap_caps_get_allocated_size(moved) - (int32_t)oldSize;
+    __atomic_fetch_add(&totals[trackedTag(ptr, false)].bytes, grown, __ATOMIC_RELAXED);
+    return moved;
+  }
+  if(moved != NULL || size == 0){
+    countFree(ptr, oldSize);
+  }
+  countAlloc(moved);
+  return moved;
+}
+
+void __wrap_free(void *ptr){
+  if(ptr != NULL){
+    countFree(ptr, heap_caps_get_allocated_size(ptr));
+  }
+  __real_free(ptr);
+}
+}
+
+#endif
+
+void heapStatsSample(){
+  HeapSample &s = window[windowHead];
+  s.time = millis();
+  s.freeHeap = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+  s.largestBlock = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+  s.minFreeHeap = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+
+  HeapTagCounters now[HEAP_TAG_COUNT];
+  heapStatsTotals(now);
+  for(int i = 0; i < HEAP_TAG_COUNT; i++){
+    uint32_t allocs = now[i].allocs - lastTotals[i].allocs;
+    s.allocs[i] = allocs > 0xFFFF ? 0xFFFF : allocs;
+    s.bytes[i] = now[i].bytes - lastTotals[i].bytes;
+    lastTotals[i] = now[i];
+  }
+
+  windowHead = (windowHead + 1) % HEAP_STATS_WINDOW;
+  if(windowCount < HEAP_STATS_WINDOW){
+    windowCount++;
+  }
+}
+
+const HeapSample *heapStatsGet(int index){
+  if(index < 0 || index >= windowCount){
+    return NULL;
+  }
+  return &window[(windowHead - 1 - index + HEAP_STATS_WINDOW) % HEAP_STATS_WINDOW];
+}
+
+void heapStatsTotals(HeapTagCounters *counters){
+  for(int i = 0; i < HEAP_TAG_COUNT; i++){
+    counters[i].allocs = __atomic_load_n(&totals[i].allocs, __ATOMIC_RELAXED);
+    counters[i].frees = __atomic_load_n(&totals[i].frees, __ATOMIC_RELAXED);
+    counters[i].bytes = __atomic_load_n(&totals[i].bytes, __ATOMIC_RELAXED);
+  }
+}
+
+int heapFragmentation(const HeapSample &sample){
+  if(sample.freeHeap == 0){
+    return 0;
+  }
+  return 100 - (int)((uint64_t)sample.largestBlock * 100 / sample.freeHeap);
+}
+
+void heapStatsDump(Print &out){
+  out.println("heap: time_s free largest min_free frag% | allocs/change in live bytes per pass by tag");
+  for(int i = windowCount - 1; i >= 0; i--){
+    const HeapSample &s = *heapStatsGet(i);
+    out.printf("%7lu %6lu %6lu %6lu %3d%% |", (unsigned long)(s.time / 1000), (unsigned long)s.freeHeap,
+               (unsigned long)s.largestBlock, (unsigned long)s.minFreeHeap, heapFragmentation(s));
+    for(int t = 0; t < HEAP_TAG_COUNT; t++){
+      out.printf(" %s %u/%+ld", tagNames[t], s.allocs[t], (long)s.bytes[t]);
+    }
+    out.println();
+  }
+
+  HeapTagCounters now[HEAP_TAG_COUNT];
+  heapStatsTotals(now);
+  out.println("heap totals since boot: tag allocs frees live_bytes");
+  for(int t = 0; t < HEAP_TAG_COUNT; t++){
+    out.printf("  %-8s %8lu %8lu %10ld\n", tagNames[t], (unsigned long)now[t].allocs,
+               (unsigned long)now[t].frees, (long)now[t].bytes);
+  }
+#ifdef HEAP_STATS_WRAP_MALLOC
+  uint32_t missed = __atomic_load_n(&untracked, __ATOMIC_RELAXED);
+  if(missed > 0){
+    out.printf("  %lu tagged blocks didn't fit HEAP_STATS_TRACKED and count as other\n", (unsigned long)missed);
+  }
+#else
+  out.println("  (allocation counting is off, build with HEAP_STATS_WRAP_MALLOC)");
+#endif
+}
@@ -0,0 +1,88 @@
+#ifndef HEAP_STATS_H
+#define HEAP_STATS_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+/*Heap telemetry. heapStatsSample() is called once per loop pass and keeps a
+rolling window of free heap, largest free block and the lowest free heap
+seen since boot, so fragmentation shows up as a growing gap between free
+heap and largest block well before an allocation fails.
+
+With HEAP_STATS_WRAP_MALLOC defined and the linker told to wrap malloc,
+calloc, realloc and free (see platformio.ini) every allocation made by the
+loop task is also counted against the subsystem that is active at the time.
+Code marks its subsystem with a HeapTagScope:
+
+  HeapTagScope scope(HEAP_TAG_JSON);
+  JSONVar weatherForecast = JSON.parse(jsonBuffer);
+
+Allocations from other tasks (WiFi, lwIP) and outside any scope count as
+HEAP_TAG_OTHER. A block is freed against the tag it was allocated under,
+whichever task frees it, so allocs - frees and bytes are what each tag
+holds right now. The blocks of the other tags are remembered in a table
+of HEAP_STATS_TRACKED, ones that don't fit count as HEAP_TAG_OTHER.
+HEAP_TAG_OTHER's bytes are approximate: memory taken with heap_caps_malloc()
+and given back with free() only shows up on the way out*/
+
+enum HeapTag {
+  HEAP_TAG_OTHER,
+  HEAP_TAG_HTTP,
+  HEAP_TAG_JSON,
+  HEAP_TAG_DISPLAY,
+  HEAP_TAG_STRINGS,
+  HEAP_TAG_COUNT
+};
+
+struct HeapTagCounters {
+  uint32_t allocs;
+  uint32_t frees;
+  int32_t bytes; //live, allocated and not yet freed
+};
+
+struct HeapSample {
+  uint32_t time;
+  uint32_t freeHeap;
+  uint32_t largestBlock;
+  uint32_t minFreeHeap;
+  /*allocations and the change in live bytes per tag during the pass
+  that ended with this sample*/
+  uint16_t allocs[HEAP_TAG_COUNT];
+  int32_t bytes[HEAP_TAG_COUNT];
+};
+
+/*number of samples kept, one per loop pass*/
+#define HEAP_STATS_WINDOW 32
+/*tagged blocks alive at once that are freed against their tag, 8 bytes
+of RAM each. A parsed forecast holds a few hundred*/
+#ifndef HEAP_STATS_TRACKED
+#define HEAP_STATS_TRACKED 512
+#endif
+
+class HeapTagScope {
+ public:
+  explicit HeapTagScope(HeapTag tag);
+  ~HeapTagScope();
+ private:
+  HeapTag previous;
+  TaskHandle_t previousOwner;
+};
+
+/*takes a sample and stores it in the rolling window*/
+void heapStatsSample();
+
+/*index 0 is the latest sample, returns NULL past the ones taken so far*/
+const HeapSample *heapStatsGet(int index);
+
+/*counters since boot*/
+void heapStatsTotals(HeapTagCounters *counters);
+
+/*fragmentation in percent: how much of the free heap is not usable
+as one block*/
+int heapFragmentation(const HeapSample &sample);
+
+/*prints the window and totals as a table*/
+void heapStatsDump(Print &out);
+
+#endif
@@ -0,0 +1,174 @@
+#include "I2cBus.h"
+
+#include <esp_timer.h>
+#include <string.h>
+
+I2cBus::I2cBus(TwoWire &wire)
+  : bus(wire), clients(0), nextTicket(0), serving(0), begunAt(0), acquiredAt(0){
+  lock = portMUX_INITIALIZER_UNLOCKED;
+  memset(ticket, 0, sizeof(ticket));
+  memset(waiting, 0, sizeof(waiting));
+  memset(wake, 0, sizeof(wake));
+  memset(stats, 0, sizeof(stats));
+}
+
+void I2cBus::begin(){
+  begunAt = esp_timer_get_time();
+}
+
+int I2cBus::addClient(const char *name){
+  SemaphoreHandle_t semaphore = xSemaphoreCreateBinary();
+  int client = -1;
+  portENTER_CRITICAL(&lock);
+  if(clients < I2C_BUS_MAX_CLIENTS && semaphore != NULL){
+    client = clients++;
+    wake[client] = semaphore;
+    stats[client].name = name;
+  }
+  portEXIT_CRITICAL(&lock);
+  if(client < 0 && semaphore != NULL){
+    vSemaphoreDelete(semaphore);
+  }
+  return client;
+}
+
+/*a ticket lock: whoever asks next gets the next number and the bus is
+handed on in number order, so nobody can take it twice in a row while
+someone else waits*/
+void I2cBus::acquire(int client){
+  uint64_t asked = esp_timer_get_time();
+  portENTER_CRITICAL(&lock);
+  uint32_t mine = nextTicket++;
+  bool now = mine == serving;
+  if(!now){
+    ticket[client] = mine;
+    waiting[client] = true;
+  }
+  portEXIT_CRITICAL(&lock);
+
+  while(!now){
+    xSemaphoreTake(wake[client], portMAX_DELAY);
+    portENTER_CRITICAL(&lock);
+    now = serving == mine;
+    if(now){
+      waiting[client] = false;
+    }
+    portEXIT_CRITICAL(&lock);
+  }
+
+  acquiredAt = esp_timer_get_time();
+  I2cClientStats &s = stats[client];
+  uint32_t waited = acquiredAt - asked;
+  s.waitUs += waited;
+  if(waited > s.maxWaitUs){
+    s.maxWaitUs = waited;
+  }
+}
+
+void I2cBus::release(int client, bool acknowledged){
+  I2cClientStats &s = stats[client];
+  s.transactions++;
+  s.busyUs += esp_timer_get_time() - acquiredAt;
+  if(!acknowledged){
+    s.failed++;
+  }
+
+  int next = -1;
+  portENTER_CRITICAL(&lock);
+  serving++;
+  for(int i = 0; i < clients; i++){
+    if(waiting[i] && ticket[i] == serving){
+      next = i;
+      break;
+    }
+  }
+  portEXIT_CRITICAL(&lock);
+  if(next >= 0){
+    xSemaphoreGive(wake[next]);
+  }
+}
+
+I2cClientStats I2cBus::clientStats(int client){
+  portENTER_CRITICAL(&lock);
+  I2cClientStats s = stats[client];
+  portEXIT_CRITICAL(&lock);
+  return s;
+}
+
+float I2cBus::utilization(){
+  uint64_t busy = 0;
+  for(int i = 0; i < clients; i++){
+    busy += clientStats(i).busyUs;
+  }
+  uint64_t elapsed = esp_timer_get_time() - begunAt;
+  return elapsed > 0 ? (float)busy / elapsed : 0;
+}
+
+void I2cBus::printStats(Print &out){
+  out.printf("bus %.1f %% busy\n", utilization() * 100);
+  out.printf("%-8s %9s %7s %9s %8s %8s\n", "client", "trans", "failed", "busy %", "wait us", "max us");
+  uint64_t elapsed = esp_timer_get_time() - begunAt;
+  for(int i = 0; i < clients; i++){
+    I2cClientStats s = clientStats(i);
+    uint32_t n = s.transactions > 0 ? s.transactions : 1;
+    out.printf("%-8s %9lu %7lu %9.2f %8lu %8lu\n", s.name, (unsigned long)s.transactions, (unsigned long)s.failed,
+               elapsed > 0 ? 100.0 * s.busyUs / elapsed : 0.0, (unsigned long)(s.waitUs / n),
+               (unsigned long)s.maxWaitUs);
+  }
+}
+
+int I2cDevice::client(){
+  if(id < 0){
+    id = bus.addClient(name);
+  }
+  return id;
+}
+
+bool I2cDevice::write(uint8_t first, const uint8_t *bytes, size_t len){
+  int c = client();
+  if(c < 0){
+    return false;
+  }
+  bus.acquire(c);
+  TwoWire &wire = bus.wire();
+  wire.beginTransmission(address);
+  wire.write(first);
+  if(len > 0){
+    wire.write(bytes, len);
+  }
+  bool ok = wire.endTransmission() == 0;
+  bus.release(c, ok);
+  return ok;
+}
+
+bool I2cDevice::readRegister(uint8_t reg, uint8_t *bytes, size_t len){
+  int c = client();
+  if(c < 0){
+    return false;
+  }
+  bus.acquire(c);
+  TwoWire &wire = bus.wire();
+  wire.beginTransmission(address);
+  wire.write(reg);
+  bool ok = wire.endTransmission(false) == 0 && wire.requestFrom(address, (uint8_t)len) == len;
+  for(size_t i = 0; ok && i < len; i++){
+    bytes[i] = wire.read();
+  }
+  bus.release(c, ok);
+  return ok;
+}
+
+bool I2cDevice::read(uint8_t *bytes, size_t len){
+  int c = client();
+  if(c < 0){
+    return false;
+  }
+  bus.acquire(c);
+  TwoWire &wire = bus.wire();
+  bool ok = wire.requestFrom(address, (uint8_t)len) == len;
+  for(size_t i = 0; ok && i < len; i++){
+    bytes[i] = wire.read();
+  }
+  bus.release(c, ok);
+  return ok;
+}
@@ -0,0 +1,90 @@
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <Wire.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#ifndef I2C_BUS_MAX_CLIENTS
+#define I2C_BUS_MAX_CLIENTS 6
+#endif
+
+/*Takes turns on one I2C bus between tasks. The display's flush task and
+the sensors in the loop share OLED_SDA/OLED_SCL, every device holds the
+bus for one transaction at a time and turns go in the order they were
+asked for. A full frame is two dozen transactions of at most 65 bytes, so
+a sensor waits for one of them (about 1.5 ms at 400 kHz) and not for the
+frame, and a sensor can't keep the display off the bus either.
+
+Each device is a client with its own count of transactions, time on the
+bus and time spent waiting for it*/
+
+struct I2cClientStats {
+  const char *name;
+  uint32_t transactions;
+  uint32_t failed;     //not acknowledged
+  uint64_t busyUs;     //holding the bus
+  uint64_t waitUs;     //waiting for its turn
+  uint32_t maxWaitUs;
+};
+
+class I2cBus {
+ public:
+  explicit I2cBus(TwoWire &wire);
+
+  /*starts the clock the utilization is measured against*/
+  void begin();
+
+  /*a client for each device, -1 once there are I2C_BUS_MAX_CLIENTS*/
+  int addClient(const char *name);
+
+  /*blocks until it's this client's turn. A client is used by one task,
+  and doesn't acquire again before it releases*/
+  void acquire(int client);
+  void release(int client, bool acknowledged = true);
+
+  TwoWire &wire() { return bus; }
+
+  int clientCount() const { return clients; }
+  I2cClientStats clientStats(int client);
+  /*share of the time since begin() someone held the bus*/
+  float utilization();
+  void printStats(Print &out);
+
+ private:
+  TwoWire &bus;
+  portMUX_TYPE lock;
+  int clients;
+  uint32_t nextTicket, serving;
+  uint64_t begunAt, acquiredAt;
+
+  /*a client waiting for its ticket sleeps on its own semaphore*/
+  uint32_t ticket[I2C_BUS_MAX_CLIENTS];
+  bool waiting[I2C_BUS_MAX_CLIENTS];
+  SemaphoreHandle_t wake[I2C_BUS_MAX_CLIENTS];
+  I2cClientStats stats[I2C_BUS_MAX_CLIENTS];
+};
+
+/*A device at one address, every call is one transaction with the bus
+held. It becomes a client of the bus the first time it's used*/
+class I2cDevice {
+ public:
+  I2cDevice(I2cBus &bus, uint8_t address, const char *name) : bus(bus), address(address), name(name) {}
+
+ protected:
+  /*first is a register or control byte, bytes follow it*/
+  bool write(uint8_t first, const uint8_t *bytes, size_t len);
+  /*writes reg, then reads len bytes with a repeated start*/
+  bool readRegister(uint8_t reg, uint8_t *bytes, size_t len);
+  bool read(uint8_t *bytes, size_t len);
+
+ private:
+  int client();
+
+  I2cBus &bus;
+  uint8_t address;
+  const char *name;
+  int id = -1;
+};
+
+#endif
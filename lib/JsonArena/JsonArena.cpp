@@ -0,0 +1,50 @@
+#include "JsonArena.h"
+
+#include <stdlib.h>
+
+JsonArena::~JsonArena(){
+  free(buffer);
+}
+
+bool JsonArena::begin(size_t bytes){
+  top = 0;
+  active = bytes > 0;
+  counters.parses++;
+  if(bytes <= capacity){
+    return true;
+  }
+  /*nothing from the arena is alive between rounds, so the old buffer
+  can go before the new one is taken*/
+  size_t rounded = (bytes + 1023) & ~(size_t)1023;
+  free(buffer);
+  buffer = (uint8_t *)malloc(rounded);
+  capacity = buffer != NULL ? rounded : 0;
+  counters.grows++;
+  return buffer != NULL;
+}
+
+void JsonArena::end(){
+  if(top > counters.highWater){
+    counters.highWater = top;
+  }
+  top = 0;
+  active = false;
+}
+
+void *JsonArena::allocate(size_t size){
+  counters.allocations++;
+  size_t aligned = (size + JSON_ARENA_ALIGN - 1) & ~(size_t)(JSON_ARENA_ALIGN - 1);
+  if(active && aligned >= size && aligned <= capacity - top){
+    void *ptr = buffer + top;
+    top += aligned;
+    return ptr;
+  }
+  counters.overflows++;
+  return malloc(size);
+}
+
+void JsonArena::release(void *ptr){
+  if(!owns(ptr)){
+    free(ptr);
+  }
+}
@@ -0,0 +1,66 @@
+#ifndef JSON_ARENA_H
+#define JSON_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*Bump allocator for a parse tree that is thrown away as a whole. Parsing
+a forecast with cJSON takes a malloc for every node, key and string, about
+220 of them for the 3 slot answer, and the same number of frees when the
+tree goes away, scattering small holes over the heap every pass.
+
+begin() makes room for the coming tree and every allocate() after it just
+moves a pointer forward. release() of a block in the arena does nothing,
+end() gives all of it back at once. The buffer stays allocated and only
+grows, in whole kB, when an answer is bigger than any before, so after the
+first few passes parsing doesn't touch the heap at all. What doesn't fit
+goes to malloc() and is freed normally, overflows counts those.
+
+Plain C++, the cJSON hooks that use it are in main.cpp*/
+
+/*every block starts at a multiple of this, enough for cJSON's doubles*/
+#define JSON_ARENA_ALIGN 8
+
+struct JsonArenaStats {
+  uint32_t parses;     //begin() .. end() rounds
+  uint32_t allocations;
+  uint32_t overflows;  //allocations that went to malloc()
+  uint32_t grows;      //times the buffer had to be replaced
+  uint32_t highWater;  //most bytes used in one round
+};
+
+class JsonArena {
+ public:
+  JsonArena() {}
+  ~JsonArena();
+
+  /*starts a round with room for at least bytes, 0 sends everything to
+  malloc(). false if the buffer couldn't grow, the round still works
+  from the old one and malloc()*/
+  bool begin(size_t bytes);
+  /*ends the round, everything allocated from the arena is gone*/
+  void end();
+
+  void *allocate(size_t size);
+  /*free() for blocks from allocate(), whichever round they were from*/
+  void release(void *ptr);
+  bool owns(const void *ptr) const {
+    return buffer != NULL && (const uint8_t *)ptr >= buffer && (const uint8_t *)ptr < buffer + capacity;
+  }
+
+  size_t size() const { return capacity; }
+  size_t used() const { return top; }
+  const JsonArenaStats &stats() const { return counters; }
+
+ private:
+  JsonArena(const JsonArena &);
+  JsonArena &operator=(const JsonArena &);
+
+  uint8_t *buffer = NULL;
+  size_t capacity = 0;
+  size_t top = 0;
+  bool active = false;
+  JsonArenaStats counters = {};
+};
+
+#endif
@@ -0,0 +1,203 @@
+#include "DerivedMetrics.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+/*ln(1 + i/32) and 2^(i/32), Q16*/
+static const int32_t lnTable[33] = {
+  0, 2017, 3973, 5873, 7719, 9515, 11262, 12965, 14624, 16242, 17821, 19364, 20870, 22343, 23783, 25193,
+  26573, 27924, 29248, 30546, 31818, 33067, 34292, 35494, 36675, 37835, 38975, 40095, 41196, 42280, 43345,
+  44394, 45426
+};
+static const int32_t exp2Table[33] = {
+  65536, 66971, 68438, 69936, 71468, 73032, 74632, 76266, 77936, 79642, 81386, 83169, 84990, 86851, 88752,
+  90696, 92682, 94711, 96785, 98905, 101070, 103283, 105545, 107856, 110218, 112631, 115098, 117618, 120194,
+  122825, 125515, 128263, 131072
+};
+
+#define LN2_Q16 45426
+#define INV_LN2_Q16 94548
+
+/*Magnus constants, a over water and ice in Q16, b in hundredths of C*/
+#define MAGNUS_A_WATER 1154744
+#define MAGNUS_B_WATER 24312
+#define MAGNUS_A_ICE 1471939
+#define MAGNUS_B_ICE 27262
+
+/*ln(x) for x > 0, both Q16*/
+static int32_t lnQ16(uint32_t x){
+  int shift = 31 - __builtin_clz(x) - 16;
+  uint32_t m = shift >= 0 ? x >> shift : x << -shift; //[1, 2) in Q16
+  uint32_t frac = m - 65536;
+  uint32_t i = frac >> 11, rest = frac & 2047;
+  int32_t ln = lnTable[i] + (((lnTable[i + 1] - lnTable[i]) * (int32_t)rest) >> 11);
+  return ln + shift * LN2_Q16;
+}
+
+/*e^x, both Q16. x up to about 9.7 before it overflows*/
+static int32_t expQ16(int32_t x){
+  int64_t y = ((int64_t)x * INV_LN2_Q16) >> 16; //log2 of the result, Q16
+  int32_t whole = (int32_t)(y >> 16);
+  uint32_t frac = (uint32_t)y & 0xFFFF;
+  uint32_t i = frac >> 11, rest = frac & 2047;
+  int32_t v = exp2Table[i] + (((exp2Table[i + 1] - exp2Table[i]) * (int32_t)rest) >> 11);
+  if(whole >= 0){
+    return whole > 14 ? INT32_MAX : v << whole;
+  }
+  return whole < -31 ? 0 : v >> -whole;
+}
+
+static uint32_t isqrt(uint64_t x){
+  uint64_t root = 0, bit = (uint64_t)1 << 62;
+  while(bit > x) bit >>= 2;
+  while(bit != 0){
+    if(x >= root + bit){
+      x -= root + bit;
+      root = (root >> 1) + bit;
+    }else{
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return (uint32_t)root;
+}
+
+/*n / d rounded to nearest, d > 0*/
+static int64_t divRound(int64_t n, int64_t d){
+  return n >= 0 ? (n + d / 2) / d : (n - d / 2) / d;
+}
+
+/*NOAA's Rothfusz regression with Steadman's formula below 80 F, the way
+the DHT library's computeHeatIndex() does it. t is in thousandths of F so
+the switch between the two lands where the float version's does, the
+result in hundredths. The coefficients are scaled by 1e9 and the
+polynomial grouped by powers of humidity so every product stays inside
+64 bits*/
+static int32_t heatIndexF(int32_t t, int32_t rh){
+  int64_t simple = ((int64_t)t * 10 + 610000 + ((int64_t)t - 68000) * 12 + rh * 94 / 10) / 2; //1e-4 F
+  if(simple <= 790000){
+    return (int32_t)divRound(simple, 100);
+  }
+
+  int64_t tt = (int64_t)t * t;
+  int64_t a = -42379000000LL + 2049015230LL * t / 1000 - 6837830LL * tt / 1000000;
+  int64_t b = 10143331270LL - 224755410LL * t / 1000 + 1228740LL * tt / 1000000;
+  int64_t c = -54817170LL + 852820LL * t / 1000 - 1990LL * tt / 1000000;
+  int64_t hi = a + b * rh / 100 + c * rh / 100 * rh / 100; //1e-9 F
+  int32_t result = (int32_t)divRound(hi, 10000000);
+
+  int32_t tc = t / 10;
+  if(rh < 1300 && tc >= 8000 && tc <= 11200){
+    /*sqrt((17 - |T - 95|) * 0.05882), Q16*/
+    int32_t root = isqrt((uint64_t)((1700 - abs(tc - 9500)) * 3855 / 100) << 16);
+    result -= (int32_t)(((int64_t)(1300 - rh) * root / 4) >> 16);
+  }else if(rh > 8500 && tc >= 8000 && tc <= 8700){
+    result += (rh - 8500) * (8700 - tc) / 5000;
+  }
+  return result;
+}
+
+bool deriveMetrics(int32_t temperature, int32_t humidity, DerivedMetrics &out){
+  if(temperature < DERIVED_MIN_TEMPERATURE || temperature > DERIVED_MAX_TEMPERATURE ||
+     humidity <= 0 || humidity > 10000){
+    return false;
+  }
+
+  /*ln(e / 6.112 hPa) = ln(RH) + a T / (b + T), the same for both points
+  since the humidity is relative to water*/
+  int32_t lnRh = lnQ16((uint32_t)(((int64_t)humidity << 16) / 10000));
+  int32_t magnus = (int32_t)divRound((int64_t)MAGNUS_A_WATER * temperature, MAGNUS_B_WATER + temperature);
+  int32_t g = lnRh + magnus;
+
+  out.dewPoint = (int32_t)divRound((int64_t)MAGNUS_B_WATER * g, MAGNUS_A_WATER - g);
+  out.frostPoint = out.dewPoint;
+  if(out.dewPoint < 0){
+    out.frostPoint = (int32_t)divRound((int64_t)MAGNUS_B_ICE * g, MAGNUS_A_ICE - g);
+  }
+
+  /*216.7 g K/m3/hPa * 6.112 hPa * e^g / (273.15 + T)*/
+  out.absoluteHumidity = (int32_t)divRound((int64_t)13244704 * expQ16(g), (int64_t)(27315 + temperature) << 16);
+
+  int32_t fahrenheit = temperature * 18 + 32000;
+  out.heatIndex = (int32_t)divRound((int64_t)(heatIndexF(fahrenheit, humidity) - 3200) * 5, 9);
+  return true;
+}
+
+bool deriveMetricsReference(double temperature, double humidity, DerivedMetricsReference &out){
+  if(temperature < DERIVED_MIN_TEMPERATURE / 100.0 || temperature > DERIVED_MAX_TEMPERATURE / 100.0 ||
+     !(humidity > 0) || humidity > 100){
+    return false;
+  }
+  double g = log(humidity / 100) + 17.62 * temperature / (243.12 + temperature);
+  out.dewPoint = 243.12 * g / (17.62 - g);
+  out.frostPoint = out.dewPoint < 0 ? 272.62 * g / (22.46 - g) : out.dewPoint;
+  out.absoluteHumidity = 216.7 * 6.112 * exp(g) / (273.15 + temperature);
+
+  double t = temperature * 1.8 + 32;
+  double hi = 0.5 * (t + 61.0 + ((t - 68.0) * 1.2) + (humidity * 0.094));
+  if(hi > 79){
+    hi = -42.379 + 2.04901523 * t + 10.14333127 * humidity + -0.22475541 * t * humidity +
+         -0.00683783 * pow(t, 2) + -0.05481717 * pow(humidity, 2) + 0.00122874 * pow(t, 2) * humidity +
+         0.00085282 * t * pow(humidity, 2) + -0.00000199 * pow(t, 2) * pow(humidity, 2);
+    if((humidity < 13) && (t >= 80.0) && (t <= 112.0)){
+      hi -= ((13.0 - humidity) * 0.25) * sqrt((17.0 - fabs(t - 95.0)) * 0.05882);
+    }else if((humidity > 85.0) && (t >= 80.0) && (t <= 87.0)){
+      hi += ((humidity - 85.0) * 0.1) * ((87.0 - t) * 0.2);
+    }
+  }
+  out.heatIndex = (hi - 32) / 1.8;
+  return true;
+}
+
+static void keepMax(int32_t &max, double error){
+  int32_t e = (int32_t)ceil(fabs(error) * 100);
+  if(e > max) max = e;
+}
+
+void benchmarkDerivedMetrics(uint32_t (*clockUs)(), int32_t temperatureStep, int32_t humidityStep,
+                             DerivedBenchmark &out){
+  out.samples = 0;
+  for(int i = 0; i < 4; i++) out.maxError[i] = 0;
+
+  for(int32_t t = DERIVED_MIN_TEMPERATURE; t <= DERIVED_MAX_TEMPERATURE; t += temperatureStep){
+    for(int32_t rh = 100; rh <= 10000; rh += humidityStep){
+      DerivedMetrics fixed;
+      DerivedMetricsReference reference;
+      deriveMetrics(t, rh, fixed);
+      deriveMetricsReference(t / 100.0, rh / 100.0, reference);
+      out.samples++;
+
+      keepMax(out.maxError[0], fixed.dewPoint / 100.0 - reference.dewPoint);
+      keepMax(out.maxError[1], fixed.frostPoint / 100.0 - reference.frostPoint);
+      keepMax(out.maxError[2], fixed.absoluteHumidity / 100.0 - reference.absoluteHumidity);
+      keepMax(out.maxError[3], fixed.heatIndex / 100.0 - reference.heatIndex);
+    }
+  }
+
+  /*timed separately over the same grid, the sums keep the compiler
+  from dropping the calls*/
+  volatile int32_t fixedSum = 0;
+  uint32_t started = clockUs();
+  for(int32_t t = DERIVED_MIN_TEMPERATURE; t <= DERIVED_MAX_TEMPERATURE; t += temperatureStep){
+    for(int32_t rh = 100; rh <= 10000; rh += humidityStep){
+      DerivedMetrics fixed = {};
+      deriveMetrics(t, rh, fixed);
+      fixedSum = fixedSum + fixed.dewPoint + fixed.heatIndex;
+    }
+  }
+  uint32_t fixedTime = clockUs() - started;
+
+  volatile double referenceSum = 0;
+  started = clockUs();
+  for(int32_t t = DERIVED_MIN_TEMPERATURE; t <= DERIVED_MAX_TEMPERATURE; t += temperatureStep){
+    for(int32_t rh = 100; rh <= 10000; rh += humidityStep){
+      DerivedMetricsReference reference = {};
+      deriveMetricsReference(t / 100.0, rh / 100.0, reference);
+      referenceSum = referenceSum + reference.dewPoint + reference.heatIndex;
+    }
+  }
+  uint32_t referenceTime = clockUs() - started;
+
+  out.fixedUs = out.samples ? (float)fixedTime / out.samples : 0;
+  out.referenceUs = out.samples ? (float)referenceTime / out.samples : 0;
+}
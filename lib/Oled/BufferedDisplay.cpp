@@ -0,0 +1,325 @@
+#include "BufferedDisplay.h"
+
+#include <esp_timer.h>
+#include <FlightRecorder.h>
+
+BufferedDisplay::BufferedDisplay(Sh1106 &panel)
+  : Adafruit_GFX(OLED_WIDTH, OLED_HEIGHT), panel(panel), task(NULL), frameIntervalMs(50),
+    requestedTransition(TRANSITION_NONE), pendingTransition(TRANSITION_NONE),
+    transitionStepPixels(4), transitionStepMs(15),
+    powerWanted(true), powerOn(true), contrastWanted(SH1106_DEFAULT_CONTRAST), contrastSent(SH1106_DEFAULT_CONTRAST),
+    shiftX(0), shiftY(0), shownShiftX(0), shownShiftY(0), onSince(0), onMsTotal(0),
+    dirty(false), publishedSeq(0), flushedSeq(0), lastFlushAt(0), flushUsTotal(0), frameMsTotal(0){
+  lock = portMUX_INITIALIZER_UNLOCKED;
+  memset(back, 0, sizeof(back));
+  memset(pending, 0, sizeof(pending));
+  memset(front, 0, sizeof(front));
+  memset(incoming, 0, sizeof(incoming));
+  memset(&stats, 0, sizeof(stats));
+}
+
+void BufferedDisplay::begin(uint8_t maxFps){
+  frameIntervalMs = 1000 / (maxFps > 0 ? maxFps : 1);
+  panel.begin();
+  onSince = millis();
+  /*RAM contents are random after power up*/
+  for(uint8_t page = 0; page < OLED_PAGES; page++){
+    panel.writePage(page, 0, front + page * OLED_WIDTH, OLED_WIDTH);
+  }
+  /*loop() runs on core 1, flushing on core 0 next to WiFi*/
+  xTaskCreatePinnedToCore(flushTask, "oledFlush", 2048, this, 1, &task, 0);
+}
+
+void BufferedDisplay::drawPixel(int16_t x, int16_t y, uint16_t color){
+  if(x < 0 || x >= OLED_WIDTH || y < 0 || y >= OLED_HEIGHT){
+    return;
+  }
+  uint8_t *p = &back[x + (y / 8) * OLED_WIDTH];
+  uint8_t bit = 1 << (y & 7);
+  uint8_t old = *p;
+  switch(color){
+    case WHITE: *p |= bit; break;
+    case BLACK: *p &= ~bit; break;
+    case INVERSE: *p ^= bit; break;
+  }
+  if(*p != old){
+    dirty = true;
+  }
+}
+
+void BufferedDisplay::fillScreen(uint16_t color){
+  memset(back, color == BLACK ? 0x00 : 0xFF, sizeof(back));
+  dirty = true;
+}
+
+void BufferedDisplay::display(){
+  int64_t started = esp_timer_get_time();
+  if(!dirty){
+    stats.unchanged++;
+    return;
+  }
+  dirty = false;
+
+  bool changed;
+  portENTER_CRITICAL(&lock);
+  changed = memcmp(back, pending, sizeof(back)) != 0;
+  if(changed){
+    memcpy(pending, back, sizeof(back));
+    publishedSeq++;
+    if(requestedTransition != TRANSITION_NONE){
+      pendingTransition = requestedTransition;
+      requestedTransition = TRANSITION_NONE;
+    }
+  }
+  portEXIT_CRITICAL(&lock);
+
+  if(!changed){
+    stats.unchanged++;
+    return;
+  }
+  stats.published++;
+  if(task != NULL){
+    xTaskNotifyGive(task);
+  }
+  uint32_t took = esp_timer_get_time() - started;
+  if(took > stats.maxPublishUs){
+    stats.maxPublishUs = took;
+  }
+}
+
+void BufferedDisplay::setTransition(TransitionType type){
+  portENTER_CRITICAL(&lock);
+  requestedTransition = type;
+  portEXIT_CRITICAL(&lock);
+}
+
+void BufferedDisplay::setTransitionSpeed(uint8_t stepPixels, uint8_t stepMs){
+  transitionStepPixels = stepPixels > 0 ? stepPixels : 1;
+  transitionStepMs = stepMs;
+}
+
+void BufferedDisplay::setPower(bool on){
+  portENTER_CRITICAL(&lock);
+  powerWanted = on;
+  portEXIT_CRITICAL(&lock);
+  if(task != NULL){
+    xTaskNotifyGive(task);
+  }
+}
+
+void BufferedDisplay::setContrast(uint8_t contrast){
+  portENTER_CRITICAL(&lock);
+  contrastWanted = contrast;
+  portEXIT_CRITICAL(&lock);
+  if(task != NULL){
+    xTaskNotifyGive(task);
+  }
+}
+
+void BufferedDisplay::setShift(int8_t dx, int8_t dy){
+  portENTER_CRITICAL(&lock);
+  bool changed = dx != shiftX || dy != shiftY;
+  shiftX = dx;
+  shiftY = dy;
+  portEXIT_CRITICAL(&lock);
+  if(changed && task != NULL){
+    xTaskNotifyGive(task);
+  }
+}
+
+void BufferedDisplay::flushTask(void *arg){
+  BufferedDisplay *self = (BufferedDisplay *)arg;
+  for(;;){
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    self->applyPower();
+    if(!self->powerOn){
+      continue;
+    }
+
+    /*frame rate cap, whatever gets published meanwhile is picked
+    up by the flush after the wait*/
+    uint32_t sinceLast = millis() - self->lastFlushAt;
+    if(sinceLast < self->frameIntervalMs){
+      vTaskDelay(pdMS_TO_TICKS(self->frameIntervalMs - sinceLast));
+    }
+    self->flushFrame();
+  }
+}
+
+/*contrast first, and a panel that comes back on gets the newest frame
+while it's still dark*/
+void BufferedDisplay::applyPower(){
+  bool on;
+  uint8_t contrast;
+  portENTER_CRITICAL(&lock);
+  on = powerWanted;
+  contrast = contrastWanted;
+  portEXIT_CRITICAL(&lock);
+
+  if(contrast != contrastSent){
+    panel.setContrast(contrast);
+    contrastSent = contrast;
+  }
+  if(on == powerOn){
+    return;
+  }
+  if(on){
+    flushFrame();
+  }
+  panel.setPower(on);
+  uint32_t now = millis();
+  portENTER_CRITICAL(&lock);
+  if(on){
+    onSince = now;
+  }else{
+    onMsTotal += now - onSince;
+    stats.panelOffs++;
+  }
+  powerOn = on;
+  portEXIT_CRITICAL(&lock);
+}
+
+/*moves the frame dx columns right and dy rows down in place. A column
+of 8 pages is one 64 bit word with the top row in bit 0, so a vertical
+move is a shift. Columns are done in the order that reads each one
+before it is overwritten*/
+static void shiftFrame(uint8_t *frame, int dx, int dy){
+  for(int i = 0; i < OLED_WIDTH; i++){
+    int x = dx > 0 ? OLED_WIDTH - 1 - i : i;
+    int from = x - dx;
+    uint64_t column = 0;
+    if(from >= 0 && from < OLED_WIDTH){
+      for(int page = OLED_PAGES - 1; page >= 0; page--){
+        column = column << 8 | frame[page * OLED_WIDTH + from];
+      }
+    }
+    column = dy >= 0 ? column << dy : column >> -dy;
+    for(int page = 0; page < OLED_PAGES; page++){
+      frame[page * OLED_WIDTH + x] = column >> (page * 8);
+    }
+  }
+}
+
+void BufferedDisplay::flushFrame(){
+  uint8_t changedPages = 0;
+  uint32_t seq;
+  TransitionType transition = TRANSITION_NONE;
+  int8_t dx, dy;
+
+  portENTER_CRITICAL(&lock);
+  seq = publishedSeq;
+  dx = shiftX;
+  dy = shiftY;
+  bool fresh = seq != flushedSeq || dx != shownShiftX || dy != shownShiftY;
+  if(fresh){
+    transition = pendingTransition;
+    pendingTransition = TRANSITION_NONE;
+    memcpy(incoming, pending, sizeof(incoming));
+  }
+  portEXIT_CRITICAL(&lock);
+
+  if(!fresh){
+    return;
+  }
+  if(dx != 0 || dy != 0){
+    shiftFrame(incoming, dx, dy);
+  }
+  shownShiftX = dx;
+  shownShiftY = dy;
+  /*a new shift alone republishes the frame that is already there*/
+  uint32_t dropped = seq != flushedSeq ? seq - flushedSeq - 1 : 0;
+
+  if(transition != TRANSITION_NONE){
+    FlightScope scope(FLIGHT_FLUSH, 0x100 | transition);
+    runTransition(transition);
+    stats.dropped += dropped;
+    flushedSeq = seq;
+    lastFlushAt = millis();
+    return;
+  }
+
+  for(uint8_t page = 0; page < OLED_PAGES; page++){
+    uint8_t *from = incoming + page * OLED_WIDTH;
+    uint8_t *to = front + page * OLED_WIDTH;
+    if(memcmp(from, to, OLED_WIDTH) != 0){
+      memcpy(to, from, OLED_WIDTH);
+      changedPages |= 1 << page;
+    }
+  }
+
+  FlightScope scope(FLIGHT_FLUSH, changedPages);
+  int64_t started = esp_timer_get_time();
+  for(uint8_t page = 0; page < OLED_PAGES; page++){
+    if(changedPages & (1 << page)){
+      panel.writePage(page, 0, front + page * OLED_WIDTH, OLED_WIDTH);
+      stats.pagesSent++;
+    }else{
+      stats.pagesSkipped++;
+    }
+  }
+  uint32_t took = esp_timer_get_time() - started;
+
+  uint32_t now = millis();
+  if(stats.flushed > 0){
+    frameMsTotal += now - lastFlushAt;
+    stats.avgFrameMs = frameMsTotal / stats.flushed;
+  }
+  lastFlushAt = now;
+
+  stats.dropped += dropped;
+  flushedSeq = seq;
+  stats.flushed++;
+  stats.lastFlushUs = took;
+  if(took > stats.maxFlushUs){
+    stats.maxFlushUs = took;
+  }
+  flushUsTotal += took;
+  stats.avgFlushUs = flushUsTotal / stats.flushed;
+}
+
+/*front follows the controller RAM step by step, frames published while
+the transition runs wait for the next flush*/
+void BufferedDisplay::runTransition(TransitionType type){
+  OledBus &bus = panel.getBus();
+  uint32_t bytesBefore = bus.dataBytes + bus.commandBytes;
+  Transition transition(panel);
+  transition.begin(type, front, incoming, transitionStepPixels);
+  bool more;
+  do{
+    more = transition.step();
+    stats.transitionSteps++;
+    if(more){
+      vTaskDelay(pdMS_TO_TICKS(transitionStepMs));
+    }
+  }while(more);
+  stats.transitions++;
+  stats.transitionBytes += bus.dataBytes + bus.commandBytes - bytesBefore;
+}
+
+void BufferedDisplay::getStats(DisplayStats &out){
+  uint32_t now = millis();
+  portENTER_CRITICAL(&lock);
+  out = stats;
+  out.panelOnMs = onMsTotal + (powerOn ? now - onSince : 0);
+  portEXIT_CRITICAL(&lock);
+}
+
+void BufferedDisplay::printStats(Print &out){
+  DisplayStats s;
+  getStats(s);
+  out.printf("display: %lu published, %lu unchanged, %lu flushed, %lu dropped\n",
+             (unsigned long)s.published, (unsigned long)s.unchanged,
+             (unsigned long)s.flushed, (unsigned long)s.dropped);
+  out.printf("  pages %lu sent, %lu skipped, bus %lu data + %lu command bytes\n",
+             (unsigned long)s.pagesSent, (unsigned long)s.pagesSkipped,
+             (unsigned long)panel.getBus().dataBytes, (unsigned long)panel.getBus().commandBytes);
+  out.printf("  flush %lu us last, %lu us avg, %lu us max, frame every %lu ms, display() %lu us max\n",
+             (unsigned long)s.lastFlushUs, (unsigned long)s.avgFlushUs, (unsigned long)s.maxFlushUs,
+             (unsigned long)s.avgFrameMs, (unsigned long)s.maxPublishUs);
+  out.printf("  transitions %lu, %lu steps, %lu bus bytes\n",
+             (unsigned long)s.transitions, (unsigned long)s.transitionSteps,
+             (unsigned long)s.transitionBytes);
+  out.printf("  panel on %lu s, switched off %lu times, contrast %u, shifted %d,%d\n",
+             (unsigned long)(s.panelOnMs / 1000), (unsigned long)s.panelOffs, (unsigned)contrastSent,
+             (int)shownShiftX, (int)shownShiftY);
+}
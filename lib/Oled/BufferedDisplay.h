@@ -0,0 +1,113 @@
+#ifndef BUFFERED_DISPLAY_H
+#define BUFFERED_DISPLAY_H
+
+#include <Adafruit_GFX.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "Sh1106.h"
+#include "Transition.h"
+
+#ifndef WHITE
+#define BLACK 0
+#define WHITE 1
+#define INVERSE 2
+#endif
+
+struct DisplayStats {
+  uint32_t published;    //frames handed to the flush task
+  uint32_t unchanged;    //display() calls that had nothing new to show
+  uint32_t flushed;      //frames sent to the panel
+  uint32_t dropped;      //published frames replaced before they were sent
+  uint32_t pagesSent;
+  uint32_t pagesSkipped; //pages that were already on the panel
+  uint32_t lastFlushUs, maxFlushUs, avgFlushUs;
+  uint32_t avgFrameMs;   //time between flushed frames
+  uint32_t maxPublishUs; //longest display() call, what the loop waits
+  uint32_t transitions;
+  uint32_t transitionSteps;
+  uint32_t transitionBytes; //bus bytes spent on transitions
+  uint64_t panelOnMs;       //since begin(), counted from the power commands
+  uint32_t panelOffs;
+};
+
+/*Double buffered display. All drawing goes to a back buffer in RAM and
+display() only copies it over for a background task to send, so the loop
+never waits on I2C. The task sends at most maxFps frames per second, skips
+frames whose content didn't change and only sends the pages that differ
+from what the panel already shows. If several frames are published between
+two flushes only the newest is sent and the rest count as dropped.
+
+Power, contrast and pixel shift are also sent by the task, so they never
+land in the middle of a flush. While the panel is off nothing is flushed,
+the newest frame goes to the panel RAM before it is switched back on*/
+class BufferedDisplay : public Adafruit_GFX {
+ public:
+  explicit BufferedDisplay(Sh1106 &panel);
+
+  /*initialises the panel and starts the flush task on the other core*/
+  void begin(uint8_t maxFps = 20);
+
+  void drawPixel(int16_t x, int16_t y, uint16_t color) override;
+  void fillScreen(uint16_t color) override;
+  void clearDisplay() { fillScreen(BLACK); }
+
+  /*hands the back buffer to the flush task if it changed*/
+  void display();
+
+  /*the next frame that gets published is brought in with this transition
+  instead of being drawn over the old one*/
+  void setTransition(TransitionType type);
+  /*pixels moved per transition step and time between steps*/
+  void setTransitionSpeed(uint8_t stepPixels, uint8_t stepMs);
+
+  void setPower(bool on);
+  void setContrast(uint8_t contrast);
+  /*the panel shows every frame moved dx columns right and dy rows down,
+  what moves past an edge is cut off*/
+  void setShift(int8_t dx, int8_t dy);
+
+  /*back buffer, 8 pages of 128 bytes. Writing to it directly doesn't
+  mark the frame changed, display() only notices when something was also
+  drawn through GFX, clearing the screen is enough*/
+  uint8_t *getBuffer() { return back; }
+  /*for a whole frame copied into the back buffer*/
+  void markChanged() { dirty = true; }
+
+  void getStats(DisplayStats &stats);
+  void printStats(Print &out);
+
+ private:
+  static void flushTask(void *arg);
+  void applyPower();
+  void flushFrame();
+  void runTransition(TransitionType type);
+
+  Sh1106 &panel;
+  TaskHandle_t task;
+  uint32_t frameIntervalMs;
+
+  uint8_t back[OLED_BUFFER_SIZE];    //drawn by the loop
+  uint8_t pending[OLED_BUFFER_SIZE]; //latest published frame
+  uint8_t front[OLED_BUFFER_SIZE];   //what the panel shows
+  uint8_t incoming[OLED_BUFFER_SIZE]; //frame a transition moves to
+
+  TransitionType requestedTransition; //set by the loop for the next publish
+  TransitionType pendingTransition;   //goes with the published frame
+  uint8_t transitionStepPixels, transitionStepMs;
+
+  bool powerWanted, powerOn;
+  uint8_t contrastWanted, contrastSent;
+  int8_t shiftX, shiftY;           //set by the loop
+  int8_t shownShiftX, shownShiftY; //in front
+  uint32_t onSince;
+  uint64_t onMsTotal;
+
+  bool dirty;
+  uint32_t publishedSeq, flushedSeq;
+  uint32_t lastFlushAt;
+  uint64_t flushUsTotal, frameMsTotal;
+  portMUX_TYPE lock;
+  DisplayStats stats;
+};
+
+#endif
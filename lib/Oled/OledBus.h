@@ -0,0 +1,37 @@
+#ifndef OLED_BUS_H
+#define OLED_BUS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*Transport between the SH1106 driver and the controller. On the ESP32 it is
+I2C through Wire (WireOledBus), on a PC it can be an emulated controller.
+Counts what goes over it so bus cost can be reported*/
+class OledBus {
+ public:
+  virtual ~OledBus() {}
+
+  /*one transaction of command bytes*/
+  void command(const uint8_t *bytes, size_t len){
+    commandBytes += len;
+    transactions++;
+    sendCommand(bytes, len);
+  }
+
+  /*display RAM data written at the current page and column*/
+  void data(const uint8_t *bytes, size_t len){
+    dataBytes += len;
+    transactions++;
+    sendData(bytes, len);
+  }
+
+  uint32_t commandBytes = 0;
+  uint32_t dataBytes = 0;
+  uint32_t transactions = 0;
+
+ protected:
+  virtual void sendCommand(const uint8_t *bytes, size_t len) = 0;
+  virtual void sendData(const uint8_t *bytes, size_t len) = 0;
+};
+
+#endif
@@ -0,0 +1,48 @@
+#include "Sh1106.h"
+
+void Sh1106::begin(){
+  static const uint8_t init[] = {
+    0xAE,       //display off
+    0xD5, 0x80, //clock divide ratio
+    0xA8, 0x3F, //multiplex ratio 64
+    0xD3, 0x00, //display offset
+    0x40,       //start line 0
+    0xAD, 0x8B, //DC-DC on
+    0xA1,       //segment remap, column 0 on the left
+    0xC8,       //scan from COM63 down
+    0xDA, 0x12, //COM pins
+    0x81, SH1106_DEFAULT_CONTRAST,
+    0xD9, 0x1F, //precharge
+    0xDB, 0x40, //VCOM deselect level
+    0xA4,       //show RAM contents
+    0xA6,       //not inverted
+    0xAF        //display on
+  };
+  bus.command(init, sizeof(init));
+}
+
+void Sh1106::writePage(uint8_t page, int column, const uint8_t *data, size_t len){
+  uint8_t ramColumn = column + SH1106_COLUMN_OFFSET;
+  const uint8_t cmd[] = {
+    (uint8_t)(0xB0 | (page & 0x07)),
+    (uint8_t)(ramColumn & 0x0F),
+    (uint8_t)(0x10 | (ramColumn >> 4))
+  };
+  bus.command(cmd, sizeof(cmd));
+  bus.data(data, len);
+}
+
+void Sh1106::setContrast(uint8_t contrast){
+  const uint8_t cmd[] = {0x81, contrast};
+  bus.command(cmd, sizeof(cmd));
+}
+
+void Sh1106::setPower(bool on){
+  const uint8_t cmd = on ? 0xAF : 0xAE;
+  bus.command(&cmd, 1);
+}
+
+void Sh1106::setStartLine(uint8_t line){
+  const uint8_t cmd = 0x40 | (line & 0x3F);
+  bus.command(&cmd, 1);
+}
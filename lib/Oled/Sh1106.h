@@ -0,0 +1,44 @@
+#ifndef SH1106_H
+#define SH1106_H
+
+#include "OledBus.h"
+
+#define OLED_WIDTH 128
+#define OLED_HEIGHT 64
+#define OLED_PAGES (OLED_HEIGHT / 8)
+#define OLED_BUFFER_SIZE (OLED_WIDTH * OLED_PAGES)
+
+/*the SH1106 has 132 columns of RAM and the 1.3" panels show columns 2..129*/
+#define SH1106_RAM_WIDTH 132
+#define SH1106_COLUMN_OFFSET 2
+
+/*what begin() sets*/
+#define SH1106_DEFAULT_CONTRAST 0xCF
+
+/*Command level driver for the SH1106. Display RAM is organised in 8 pages
+of 8 pixel rows, one byte holds one column of a page with the top row in
+bit 0*/
+class Sh1106 {
+ public:
+  explicit Sh1106(OledBus &bus) : bus(bus) {}
+
+  /*init sequence for a 128x64 panel with the internal DC-DC converter*/
+  void begin();
+
+  /*writes len bytes to page starting at visible column.
+  column may be negative down to -SH1106_COLUMN_OFFSET to reach the hidden
+  RAM columns*/
+  void writePage(uint8_t page, int column, const uint8_t *data, size_t len);
+
+  void setContrast(uint8_t contrast);
+  void setPower(bool on);
+  /*RAM row shown on the top line of the panel, 0..63*/
+  void setStartLine(uint8_t line);
+
+  OledBus &getBus() { return bus; }
+
+ private:
+  OledBus &bus;
+};
+
+#endif
@@ -0,0 +1,61 @@
+#include "Sh1106Emulator.h"
+
+#include <string.h>
+
+Sh1106Emulator::Sh1106Emulator(){
+  memset(ram, 0, sizeof(ram));
+}
+
+void Sh1106Emulator::sendCommand(const uint8_t *bytes, size_t len){
+  for(size_t i = 0; i < len; i++){
+    uint8_t c = bytes[i];
+    if(c <= 0x0F){
+      column = (column & 0xF0) | c;
+    }else if(c >= 0x10 && c <= 0x1F){
+      column = (column & 0x0F) | ((c & 0x0F) << 4);
+    }else if(c >= 0x40 && c <= 0x7F){
+      startLine = c & 0x3F;
+    }else if(c >= 0xB0 && c <= 0xB7){
+      page = c & 0x07;
+    }else if(c == 0xAE || c == 0xAF){
+      on = c == 0xAF;
+    }else if(c == 0x81 && i + 1 < len){
+      contrast = bytes[++i];
+    }else if((c == 0xD5 || c == 0xA8 || c == 0xD3 || c == 0xAD || c == 0xDA || c == 0xD9 || c == 0xDB) && i + 1 < len){
+      /*two byte commands whose setting doesn't change the picture here*/
+      i++;
+    }else if(c == 0xA0 || c == 0xA1 || c == 0xC0 || c == 0xC8 || c == 0xA4 || c == 0xA5 || c == 0xA6 || c == 0xA7){
+      /*orientation and inversion, the driver always uses the same ones*/
+    }else{
+      unknownCommands++;
+    }
+  }
+}
+
+void Sh1106Emulator::sendData(const uint8_t *bytes, size_t len){
+  for(size_t i = 0; i < len; i++){
+    if(column < SH1106_RAM_WIDTH){
+      ram[page][column] = bytes[i];
+    }
+    /*the column address stops advancing at the end of the RAM*/
+    if(column < SH1106_RAM_WIDTH - 1){
+      column++;
+    }
+  }
+}
+
+bool Sh1106Emulator::visiblePixel(int x, int y) const {
+  int row = (y + startLine) % OLED_HEIGHT;
+  return (ram[row / 8][x + SH1106_COLUMN_OFFSET] >> (row & 7)) & 1;
+}
+
+void Sh1106Emulator::frame(uint8_t *out) const {
+  memset(out, 0, OLED_BUFFER_SIZE);
+  for(int y = 0; y < OLED_HEIGHT; y++){
+    for(int x = 0; x < OLED_WIDTH; x++){
+      if(visiblePixel(x, y)){
+        out[x + (y / 8) * OLED_WIDTH] |= 1 << (y & 7);
+      }
+    }
+  }
+}
@@ -0,0 +1,33 @@
+#ifndef SH1106_EMULATOR_H
+#define SH1106_EMULATOR_H
+
+#include "OledBus.h"
+#include "Sh1106.h"
+
+/*Software SH1106 for running display code on a PC. Interprets the command
+stream the way the controller does (page and column addressing, start line,
+contrast, power) and keeps the 132x64 display RAM, so what the panel would
+show can be read back with visiblePixel() or frame()*/
+class Sh1106Emulator : public OledBus {
+ public:
+  Sh1106Emulator();
+
+  /*pixel on the panel at x, y, after start line and column offset*/
+  bool visiblePixel(int x, int y) const;
+  /*the visible 128x64 area in the same page layout as the frame buffers*/
+  void frame(uint8_t *out) const;
+
+  uint8_t ram[OLED_PAGES][SH1106_RAM_WIDTH];
+  uint8_t page = 0;
+  uint8_t column = 0;
+  uint8_t startLine = 0;
+  uint8_t contrast = 0x80;
+  bool on = false;
+  uint32_t unknownCommands = 0;
+
+ protected:
+  void sendCommand(const uint8_t *bytes, size_t len) override;
+  void sendData(const uint8_t *bytes, size_t len) override;
+};
+
+#endif
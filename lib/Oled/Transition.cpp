@@ -0,0 +1,83 @@
+#include "Transition.h"
+
+#include <string.h>
+
+void Transition::begin(TransitionType t, uint8_t *r, const uint8_t *n, uint8_t pixels){
+  type = t;
+  ram = r;
+  next = n;
+  stepPixels = pixels > 0 ? pixels : 1;
+  done = 0;
+}
+
+bool Transition::step(){
+  if(type == TRANSITION_NONE){
+    return false;
+  }
+  uint8_t previous = done;
+  uint8_t limit = (type == TRANSITION_SLIDE_UP || type == TRANSITION_SLIDE_DOWN) ? OLED_HEIGHT : OLED_WIDTH;
+  done = previous + stepPixels >= limit ? limit : previous + stepPixels;
+
+  if(limit == OLED_HEIGHT){
+    slideStep(previous);
+  }else{
+    wipeStep(previous);
+  }
+
+  if(done == limit){
+    type = TRANSITION_NONE;
+    return false;
+  }
+  return true;
+}
+
+/*sends only the columns from..to-1 of a page where wanted differs from ram*/
+void Transition::writeSpan(uint8_t page, const uint8_t *wanted, int from, int to){
+  uint8_t *have = ram + page * OLED_WIDTH;
+  while(from < to && have[from] == wanted[from]) from++;
+  while(to > from && have[to - 1] == wanted[to - 1]) to--;
+  if(from == to){
+    return;
+  }
+  memcpy(have + from, wanted + from, to - from);
+  panel.writePage(page, from, have + from, to - from);
+}
+
+/*With start line s, RAM row r is on screen at row (r - s) % 64. For a
+slide up s runs 0..64 and RAM rows below s must hold the new screen, for a
+slide down s runs 64..0 and rows from s up hold the new screen. Rows whose
+owner changed in this step are rewritten, then the start line moves*/
+void Transition::slideStep(uint8_t previous){
+  bool up = type == TRANSITION_SLIDE_UP;
+  int startLine = up ? done : (OLED_HEIGHT - done);
+  int oldStart = up ? previous : (OLED_HEIGHT - previous);
+  int firstRow = up ? oldStart : startLine;
+  int lastRow = up ? startLine : oldStart; //exclusive
+
+  for(int page = firstRow / 8; page * 8 < lastRow; page++){
+    uint8_t merged[OLED_WIDTH];
+    /*bits of this page that belong to the new screen*/
+    uint8_t newMask = 0;
+    for(int bit = 0; bit < 8; bit++){
+      int row = page * 8 + bit;
+      bool isNew = up ? row < startLine : row >= startLine;
+      if(isNew) newMask |= 1 << bit;
+    }
+    const uint8_t *have = ram + page * OLED_WIDTH;
+    const uint8_t *want = next + page * OLED_WIDTH;
+    for(int x = 0; x < OLED_WIDTH; x++){
+      merged[x] = (want[x] & newMask) | (have[x] & ~newMask);
+    }
+    writeSpan(page, merged, 0, OLED_WIDTH);
+  }
+  panel.setStartLine(startLine % OLED_HEIGHT);
+}
+
+void Transition::wipeStep(uint8_t previous){
+  bool left = type == TRANSITION_WIPE_LEFT;
+  int from = left ? OLED_WIDTH - done : previous;
+  int to = left ? OLED_WIDTH - previous : done;
+  for(uint8_t page = 0; page < OLED_PAGES; page++){
+    writeSpan(page, next + page * OLED_WIDTH, from, to);
+  }
+}
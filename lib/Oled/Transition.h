@@ -0,0 +1,56 @@
+#ifndef TRANSITION_H
+#define TRANSITION_H
+
+#include "Sh1106.h"
+
+enum TransitionType {
+  TRANSITION_NONE,
+  TRANSITION_SLIDE_UP,   //new screen pushes the old one out at the top
+  TRANSITION_SLIDE_DOWN, //new screen pushes the old one out at the bottom
+  TRANSITION_WIPE_LEFT,  //new screen is uncovered from the right edge
+  TRANSITION_WIPE_RIGHT  //new screen is uncovered from the left edge
+};
+
+/*Screen transitions done by the controller instead of by redrawing.
+
+Slides use the SH1106 display start line: with start line s the panel shows
+RAM row (row + s) % 64 on each row, so moving s scrolls the whole panel in
+hardware and the new screen only has to be written into the rows that just
+wrapped around. Each step costs one start line command plus the part of one
+page that changed, instead of a whole frame.
+
+The SH1106 has no horizontal scroll and only 4 RAM columns outside the
+visible area, so horizontal transitions are wipes: each step writes the next
+band of columns of the new screen, which adds up to one frame of data for
+the whole transition.
+
+ram must mirror what the controller RAM holds and is updated as the
+transition writes to it, at the end it holds the new screen and the start
+line is back at 0*/
+class Transition {
+ public:
+  explicit Transition(Sh1106 &panel) : panel(panel) {}
+
+  /*stepPixels is how far the screen moves per step*/
+  void begin(TransitionType type, uint8_t *ram, const uint8_t *next, uint8_t stepPixels);
+
+  /*does one step, returns false when the transition is finished*/
+  bool step();
+
+  bool active() const { return type != TRANSITION_NONE; }
+  uint8_t progress() const { return done; }
+
+ private:
+  void writeSpan(uint8_t page, const uint8_t *wanted, int from, int to);
+  void slideStep(uint8_t previous);
+  void wipeStep(uint8_t previous);
+
+  Sh1106 &panel;
+  TransitionType type = TRANSITION_NONE;
+  uint8_t *ram = nullptr;
+  const uint8_t *next = nullptr;
+  uint8_t stepPixels = 1;
+  uint8_t done = 0; //rows or columns moved so far
+};
+
+#endif
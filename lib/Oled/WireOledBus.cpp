@@ -0,0 +1,22 @@
+#include "WireOledBus.h"
+
+/*Wire buffers 128 bytes per transaction on the ESP32, one of them
+goes to the control byte*/
+#define WIRE_CHUNK 64
+
+void WireOledBus::sendCommand(const uint8_t *bytes, size_t len){
+  send(0x00, bytes, len);
+}
+
+void WireOledBus::sendData(const uint8_t *bytes, size_t len){
+  send(0x40, bytes, len);
+}
+
+void WireOledBus::send(uint8_t control, const uint8_t *bytes, size_t len){
+  while(len > 0){
+    size_t chunk = len > WIRE_CHUNK ? WIRE_CHUNK : len;
+    write(control, bytes, chunk);
+    bytes += chunk;
+    len -= chunk;
+  }
+}
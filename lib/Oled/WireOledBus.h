@@ -0,0 +1,22 @@
+#ifndef WIRE_OLED_BUS_H
+#define WIRE_OLED_BUS_H
+
+#include <I2cBus.h>
+#include "OledBus.h"
+
+/*SH1106 over I2C. Every transaction starts with a control byte telling
+whether commands (0x00) or display data (0x40) follow. The bus is shared
+with the I2C sensors, each chunk takes its turn on it*/
+class WireOledBus : public OledBus, private I2cDevice {
+ public:
+  WireOledBus(I2cBus &bus, uint8_t address) : I2cDevice(bus, address, "oled") {}
+
+ protected:
+  void sendCommand(const uint8_t *bytes, size_t len) override;
+  void sendData(const uint8_t *bytes, size_t len) override;
+
+ private:
+  void send(uint8_t control, const uint8_t *bytes, size_t len);
+};
+
+#endif
@@ -0,0 +1,162 @@
+#include "DeltaOta.h"
+
+#include <esp_image_format.h>
+#include <esp_partition.h>
+#include <esp_timer.h>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+DeltaOta::DeltaOta()
+  : running(NULL), target(NULL), handle(0), patch(NULL), window(NULL), size(0), pending(false), publicKey(NULL),
+    startedAt(0){
+  id[0] = '\0';
+  memset(&s, 0, sizeof(s));
+}
+
+bool DeltaOta::begin(const uint8_t *publicKey){
+  this->publicKey = publicKey;
+  running = esp_ota_get_running_partition();
+  if(running == NULL){
+    return false;
+  }
+  esp_partition_pos_t pos = {running->address, running->size};
+  esp_image_metadata_t meta;
+  if(esp_image_get_metadata(&pos, &meta) != ESP_OK){
+    return false;
+  }
+  size = meta.image_len;
+
+  /*the image as it is in flash, which is firmware.bin byte for byte*/
+  Sha256 hash;
+  uint8_t chunk[DELTA_CHUNK];
+  for(uint32_t at = 0; at < size; at += sizeof(chunk)){
+    size_t n = size - at < sizeof(chunk) ? size - at : sizeof(chunk);
+    if(esp_partition_read(running, at, chunk, n) != ESP_OK){
+      return false;
+    }
+    hash.update(chunk, n);
+  }
+  hash.finish(digest);
+  for(int i = 0; i < 8; i++){
+    snprintf(id + 2 * i, 3, "%02x", digest[i]);
+  }
+
+  esp_ota_img_states_t state;
+  pending = esp_ota_get_state_partition(running, &state) == ESP_OK && state == ESP_OTA_IMG_PENDING_VERIFY;
+  return true;
+}
+
+bool DeltaOta::start(){
+  if(patch != NULL){
+    abort();
+  }
+  target = esp_ota_get_next_update_partition(NULL);
+  if(running == NULL || target == NULL || publicKey == NULL){
+    return false;
+  }
+  /*sectors are erased as the image reaches them, not all up front*/
+#ifdef OTA_WITH_SEQUENTIAL_WRITES
+  esp_err_t e = esp_ota_begin(target, OTA_WITH_SEQUENTIAL_WRITES, &handle);
+#else
+  esp_err_t e = esp_ota_begin(target, OTA_SIZE_UNKNOWN, &handle);
+#endif
+  if(e != ESP_OK){
+    return false;
+  }
+  window = (uint8_t *)malloc(DELTA_OTA_WINDOW);
+  patch = window != NULL ? new (std::nothrow) DeltaPatch(*this, window, DELTA_OTA_WINDOW) : NULL;
+  if(patch == NULL){
+    free(window);
+    window = NULL;
+    esp_ota_abort(handle);
+    return false;
+  }
+  /*so the patch doesn't read the whole image again when its header comes*/
+  patch->setOldHash(digest);
+  startedAt = esp_timer_get_time() / 1000;
+  s.applyUs = 0;
+  return true;
+}
+
+DeltaResult DeltaOta::feed(const uint8_t *data, size_t len){
+  if(patch == NULL){
+    return DELTA_ERROR;
+  }
+  int64_t started = esp_timer_get_time();
+  DeltaResult r = patch->feed(data, len);
+  s.applyUs += esp_timer_get_time() - started;
+  return r;
+}
+
+bool DeltaOta::finish(){
+  if(patch == NULL){
+    return false;
+  }
+  if(!patch->done() || !patch->checkSignature(publicKey)){
+    abort();
+    return false;
+  }
+  bool ok = esp_ota_end(handle) == ESP_OK && esp_ota_set_boot_partition(target) == ESP_OK;
+  end(ok);
+  return ok;
+}
+
+void DeltaOta::abort(){
+  if(patch == NULL){
+    return;
+  }
+  esp_ota_abort(handle);
+  end(false);
+}
+
+void DeltaOta::end(bool ok){
+  s.lastOk = ok;
+  s.lastError = patch->done() || patch->error() != DELTA_OK ? patch->error() : DELTA_TRUNCATED;
+  s.patchBytes = patch->bytesIn();
+  s.imageBytes = patch->bytesOut();
+  s.elapsedMs = esp_timer_get_time() / 1000 - startedAt;
+  if(ok){
+    s.updates++;
+  }else{
+    s.failures++;
+  }
+  delete patch;
+  patch = NULL;
+  free(window);
+  window = NULL;
+}
+
+void DeltaOta::confirm(){
+  if(pending && esp_ota_mark_app_valid_cancel_rollback() == ESP_OK){
+    pending = false;
+  }
+}
+
+void DeltaOta::rollback(){
+  esp_ota_mark_app_invalid_rollback_and_reboot();
+}
+
+bool DeltaOta::readOld(uint32_t offset, uint8_t *data, size_t len){
+  return esp_partition_read(running, offset, data, len) == ESP_OK;
+}
+
+bool DeltaOta::writeNew(const uint8_t *data, size_t len){
+  return esp_ota_write(handle, data, len) == ESP_OK;
+}
+
+void DeltaOta::printStats(Print &out) const {
+  out.printf("running %s (%s), %lu bytes in %s\n", id, pending ? "not confirmed yet" : "confirmed",
+             (unsigned long)size, running != NULL ? running->label : "?");
+  out.printf("%lu updates, %lu failed\n", (unsigned long)s.updates, (unsigned long)s.failures);
+  if(s.updates + s.failures == 0){
+    return;
+  }
+  const char *result = s.lastOk ? "boots next" : s.lastError != DELTA_OK ? DeltaPatch::errorName(s.lastError)
+                                                                        : "image check failed";
+  out.printf("last: %lu byte patch for a %lu byte image (%.1f %%), %s, applied in %lu ms of %lu ms\n",
+             (unsigned long)s.patchBytes, (unsigned long)s.imageBytes,
+             s.imageBytes > 0 ? 100.0 * s.patchBytes / s.imageBytes : 0.0, result,
+             (unsigned long)(s.applyUs / 1000), (unsigned long)s.elapsedMs);
+}
@@ -0,0 +1,95 @@
+#ifndef DELTA_OTA_H
+#define DELTA_OTA_H
+
+#include <Print.h>
+#include <esp_ota_ops.h>
+#include <DeltaPatch.h>
+
+/*inflater window for gzip patches, mkdelta --window 13 by default*/
+#ifndef DELTA_OTA_WINDOW
+#define DELTA_OTA_WINDOW 8192
+#endif
+
+/*Firmware updates as deltas against the running image. A patch from
+tools/delta/mkdelta is applied with lib/Delta as it downloads: old bytes
+are read from the running partition and the new image goes straight into
+the other OTA partition, so RAM use is the DeltaPatch and its inflater
+window, about DELTA_OTA_WINDOW + 2 kB, whatever the image size.
+
+The running image is named by the first 8 bytes of its SHA-256 in hex,
+the same name mkdelta prints for the old image it was given, so a server
+only has to keep one patch per build that is out in the field.
+
+A new image boots in the pending state. It has to confirm() itself once
+it has shown it works, otherwise rollback() (or a crash before confirming)
+brings the old image back. This needs the bootloader's rollback support,
+which the Arduino core's bootloader has.
+
+Every patch carries an Ed25519 signature over its header, which holds the
+hash of the new image. finish() only sets the new image to boot if the
+image matches that hash and the signature checks out against the public
+key given to begin(), so a patch from anywhere but the holder of the
+secret seed is thrown away, whatever the transport*/
+
+struct DeltaOtaStats {
+  uint32_t updates;     //images written and set to boot
+  uint32_t failures;
+  bool lastOk;
+  DeltaError lastError; //DELTA_OK on a failure means the image check failed
+  uint32_t patchBytes;  //of the last update, as downloaded
+  uint32_t imageBytes;
+  uint32_t applyUs;     //in feed(), the download excluded
+  uint32_t elapsedMs;   //start() to finish()
+};
+
+class DeltaOta : public DeltaImages {
+ public:
+  DeltaOta();
+
+  /*hashes the running image and reads whether it's waiting for confirm().
+  publicKey is kept, it has to outlive the DeltaOta*/
+  bool begin(const uint8_t *publicKey);
+  /*16 hex digits, empty before begin()*/
+  const char *imageId() const { return id; }
+  uint32_t imageSize() const { return size; }
+  bool pendingVerify() const { return pending; }
+
+  /*opens the other OTA partition for a new image*/
+  bool start();
+  bool updating() const { return patch != NULL; }
+  DeltaResult feed(const uint8_t *data, size_t len);
+  /*for a finished patch with a good signature, validates the new image
+  and boots it after the next restart. Anything else, or a failed check, aborts and the running
+  image stays*/
+  bool finish();
+  void abort();
+
+  /*the running image works, keep it*/
+  void confirm();
+  /*back to the image before the update, restarts*/
+  void rollback();
+
+  const DeltaOtaStats &stats() const { return s; }
+  void printStats(Print &out) const;
+
+  bool readOld(uint32_t offset, uint8_t *data, size_t len) override;
+  bool writeNew(const uint8_t *data, size_t len) override;
+
+ private:
+  void end(bool ok);
+
+  const esp_partition_t *running;
+  const esp_partition_t *target;
+  esp_ota_handle_t handle;
+  DeltaPatch *patch;
+  uint8_t *window;
+  uint32_t size;
+  bool pending;
+  const uint8_t *publicKey;
+  uint8_t digest[SHA256_BYTES]; //of the running image, handed to each patch
+  char id[17];
+  uint32_t startedAt;
+  DeltaOtaStats s;
+};
+
+#endif
@@ -0,0 +1,90 @@
+#include "LinkQuality.h"
+
+/*weight of a new sample in the moving averages, about the last 5*/
+#define LINK_WEIGHT 0.2f
+/*share of requests without an answer that makes the link a bucket worse*/
+#define LINK_BAD_FAILURES 0.25f
+
+static const uint8_t stretches[LINK_BUCKETS] = {1, 2, 4};
+static const uint8_t batches[LINK_BUCKETS] = {1, 4, 8};
+static const char *const bucketNames[LINK_BUCKETS] = {"good", "fair", "poor"};
+
+void LinkQuality::sampleRssi(int rssi, uint32_t now){
+  if(!sampled){
+    sampled = true;
+    since = now;
+  }
+  if(rssi != 0){
+    avgRssi = avgRssi == 0 ? rssi : avgRssi + LINK_WEIGHT * (rssi - avgRssi);
+  }
+  signal = fromRssi();
+  update(now);
+}
+
+void LinkQuality::request(bool failed, uint32_t bytes, uint32_t ms){
+  LinkBucketStats &b = buckets[current];
+  avgTime = avgTime == 0 ? ms : avgTime + LINK_WEIGHT * ((float)ms - avgTime);
+  avgFailures += LINK_WEIGHT * ((failed ? 1.0f : 0.0f) - avgFailures);
+  b.requests++;
+  if(failed){
+    b.failed++;
+  }
+  b.bytes += bytes;
+  b.airtimeMs += ms;
+}
+
+void LinkQuality::datagram(uint8_t frames, uint32_t bytes, uint32_t ms){
+  LinkBucketStats &b = buckets[current];
+  b.datagrams++;
+  b.frames += frames;
+  b.bytes += bytes;
+  b.airtimeMs += ms;
+}
+
+uint8_t LinkQuality::stretch() const {
+  return stretches[current];
+}
+
+uint8_t LinkQuality::batch() const {
+  return batches[current];
+}
+
+LinkBucketStats LinkQuality::stats(int bucket, uint32_t now) const {
+  LinkBucketStats s = buckets[bucket];
+  if(sampled && bucket == current){
+    s.timeMs += now - since;
+  }
+  return s;
+}
+
+const char *LinkQuality::bucketName(int bucket){
+  return bucket >= 0 && bucket < LINK_BUCKETS ? bucketNames[bucket] : "?";
+}
+
+/*the bucket only gets better once the average is hysteresis dB past the
+threshold it crossed on the way down*/
+LinkBucket LinkQuality::fromRssi() const {
+  if(avgRssi == 0){
+    return LINK_GOOD;
+  }
+  if(avgRssi < poorRssi){
+    return LINK_POOR;
+  }
+  if(avgRssi < fairRssi){
+    return signal == LINK_POOR && avgRssi < poorRssi + hysteresis ? LINK_POOR : LINK_FAIR;
+  }
+  return signal != LINK_GOOD && avgRssi < fairRssi + hysteresis ? LINK_FAIR : LINK_GOOD;
+}
+
+void LinkQuality::update(uint32_t now){
+  LinkBucket next = signal;
+  if(next < LINK_POOR && (avgFailures > LINK_BAD_FAILURES || avgTime > slowRequest)){
+    next = (LinkBucket)(next + 1);
+  }
+  if(next != current){
+    buckets[current].timeMs += now - since;
+    since = now;
+    current = next;
+    changes++;
+  }
+}
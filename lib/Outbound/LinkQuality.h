@@ -0,0 +1,81 @@
+#ifndef LINK_QUALITY_H
+#define LINK_QUALITY_H
+
+#include <stdint.h>
+
+/*How good the WiFi link is lately, and how much of the uplink went out
+at each quality. Three things are followed as moving averages: the RSSI
+sampled every pass, the share of requests that got no answer, and how
+long requests took. RSSI picks the bucket, with hysteresis so a signal
+sitting on a threshold doesn't flap. A link that loses a quarter of its
+requests or takes longer than slowRequest per request is one bucket worse
+than its RSSI says, whatever the cause.
+
+Station asks it how far to stretch non-urgent traffic: uploads average
+more passes and go less often, forecasts that are still good are kept
+longer, and collector frames are sent several to a datagram. Each costs
+the radio the same wake-up whatever it carries, so on a poor link fewer,
+bigger sends spend less airtime on retries. When the link is good again
+stretch() is back to 1 and whatever waited goes out at once.
+
+Plain C++, RSSI 0 means unknown and counts as good*/
+
+enum LinkBucket { LINK_GOOD, LINK_FAIR, LINK_POOR, LINK_BUCKETS };
+
+/*uplink traffic while the link was in one bucket*/
+struct LinkBucketStats {
+  uint32_t requests;
+  uint32_t failed;    //HTTP requests without an answer
+  uint32_t datagrams; //collector datagrams
+  uint32_t frames;    //collector frames in them
+  uint32_t bytes;     //sent and received, HTTP bodies and UDP payloads
+  uint32_t airtimeMs; //radio busy with a request or datagram
+  uint32_t timeMs;    //time spent in the bucket
+};
+
+class LinkQuality {
+ public:
+  /*dBm at which the link drops to fair and to poor, it comes back
+  hysteresis dB above them*/
+  int8_t fairRssi = -67, poorRssi = -78;
+  uint8_t hysteresis = 3;
+  /*average request time that counts as slow*/
+  uint32_t slowRequest = 4000;
+
+  /*a sample every pass while WiFi is up*/
+  void sampleRssi(int rssi, uint32_t now);
+  /*an HTTP request finished. failed is true if there was no answer*/
+  void request(bool failed, uint32_t bytes, uint32_t ms);
+  /*a collector datagram carrying frames went out*/
+  void datagram(uint8_t frames, uint32_t bytes, uint32_t ms);
+
+  LinkBucket bucket() const { return current; }
+  /*factor for upload and forecast intervals, 1, 2 or 4*/
+  uint8_t stretch() const;
+  /*collector frames per datagram, 1, 4 or 8*/
+  uint8_t batch() const;
+
+  /*averages, rssi 0 before the first sample*/
+  float rssi() const { return avgRssi; }
+  float failureRate() const { return avgFailures; }
+  float requestTime() const { return avgTime; }
+
+  /*stats of a bucket with the time up to now counted in*/
+  LinkBucketStats stats(int bucket, uint32_t now) const;
+  uint32_t changes = 0; //bucket changes
+
+  static const char *bucketName(int bucket);
+
+ private:
+  LinkBucket fromRssi() const;
+  void update(uint32_t now);
+
+  LinkBucket current = LINK_GOOD;
+  LinkBucket signal = LINK_GOOD;
+  bool sampled = false;
+  float avgRssi = 0, avgFailures = 0, avgTime = 0;
+  uint32_t since = 0;
+  LinkBucketStats buckets[LINK_BUCKETS] = {};
+};
+
+#endif
@@ -0,0 +1,179 @@
+#include "OutboundScheduler.h"
+
+#include <string.h>
+
+#define WAITED_TOKEN 1
+#define WAITED_SLOT 2
+
+OutboundScheduler::OutboundScheduler() : hostTotal(0), sequence(0){
+  memset(hosts, 0, sizeof(hosts));
+  memset(queue, 0, sizeof(queue));
+}
+
+int OutboundScheduler::addHost(const char *name, uint32_t interval, uint8_t burst, uint32_t now){
+  if(hostTotal >= OUTBOUND_MAX_HOSTS || interval == 0 || burst == 0){
+    return -1;
+  }
+  OutboundHost &h = hosts[hostTotal];
+  h.name = name;
+  h.interval = interval;
+  h.burst = burst;
+  h.credit = interval * burst;
+  h.refilledAt = now;
+  return hostTotal++;
+}
+
+bool OutboundScheduler::submit(int host, uint8_t priority, uint16_t key, uint32_t now){
+  (void)now;
+  OutboundHost &h = hosts[host];
+  int free = -1;
+  uint32_t waiting = 0;
+  for(int i = 0; i < OUTBOUND_QUEUE_SIZE; i++){
+    Entry &e = queue[i];
+    if(!e.used){
+      if(free < 0) free = i;
+      continue;
+    }
+    if(e.host != host){
+      continue;
+    }
+    if(e.key == key){
+      /*keeps its place in the queue, but a more urgent copy moves it up*/
+      if(priority < e.priority) e.priority = priority;
+      h.stats.coalesced++;
+      return true;
+    }
+    waiting++;
+  }
+  if(free < 0){
+    return false;
+  }
+  Entry &e = queue[free];
+  e.used = true;
+  e.host = host;
+  e.priority = priority;
+  e.key = key;
+  e.waited = 0;
+  e.deferrals = 0;
+  e.sequence = sequence++;
+  if(waiting + 1 > h.stats.maxQueued){
+    h.stats.maxQueued = waiting + 1;
+  }
+  return true;
+}
+
+bool OutboundScheduler::queued(int host, uint16_t key) const {
+  for(int i = 0; i < OUTBOUND_QUEUE_SIZE; i++){
+    if(queue[i].used && queue[i].host == host && queue[i].key == key){
+      return true;
+    }
+  }
+  return false;
+}
+
+void OutboundScheduler::refill(OutboundHost &h, uint32_t now){
+  uint32_t full = h.interval * h.burst;
+  uint32_t elapsed = now - h.refilledAt;
+  h.credit = elapsed >= full - h.credit ? full : h.credit + elapsed;
+  h.refilledAt = now;
+}
+
+bool OutboundScheduler::hostOpen(OutboundHost &h, uint32_t now){
+  if(h.blocked && (int32_t)(now - h.blockedUntil) < 0){
+    return false;
+  }
+  h.blocked = false;
+  return true;
+}
+
+bool OutboundScheduler::next(uint32_t now, OutboundRequest &request){
+  int busy = 0;
+  for(int i = 0; i < hostTotal; i++){
+    if(hosts[i].inFlight) busy++;
+  }
+
+  /*walks the queue in priority order. A request that can't go doesn't
+  hold up the ones behind it that are for another host*/
+  bool tried[OUTBOUND_QUEUE_SIZE] = {};
+  for(;;){
+    int best = -1;
+    for(int i = 0; i < OUTBOUND_QUEUE_SIZE; i++){
+      const Entry &e = queue[i];
+      if(!e.used || tried[i]) continue;
+      if(best < 0 || e.priority < queue[best].priority ||
+         (e.priority == queue[best].priority && (int32_t)(e.sequence - queue[best].sequence) < 0)){
+        best = i;
+      }
+    }
+    if(best < 0){
+      return false;
+    }
+    tried[best] = true;
+
+    Entry &e = queue[best];
+    OutboundHost &h = hosts[e.host];
+    bool slotTaken = !h.inFlight && busy >= maxInFlight;
+    if(h.inFlight || slotTaken || !hostOpen(h, now)){
+      if(!(e.waited & WAITED_SLOT)){
+        e.waited |= WAITED_SLOT;
+        h.stats.deferred++;
+      }
+      /*another host's request has the slot, after aging of those this one
+      moves up so a host that always has something queued can't starve it*/
+      if(slotTaken && aging > 0 && e.priority > 0 && ++e.deferrals >= aging){
+        e.priority--;
+        e.deferrals = 0;
+      }
+      continue;
+    }
+    refill(h, now);
+    if(h.credit < h.interval){
+      if(!(e.waited & WAITED_TOKEN)){
+        e.waited |= WAITED_TOKEN;
+        h.stats.throttled++;
+      }
+      continue;
+    }
+
+    h.credit -= h.interval;
+    h.inFlight = true;
+    h.stats.sent++;
+    request.host = e.host;
+    request.priority = e.priority;
+    request.key = e.key;
+    e.used = false;
+    return true;
+  }
+}
+
+void OutboundScheduler::finished(int host, int status, int32_t retryAfter, uint32_t now){
+  OutboundHost &h = hosts[host];
+  h.inFlight = false;
+  /*no tokens come back while a request is out, the interval counts from
+  when it ended. Otherwise one that stalled until its deadline lands just
+  before the next one*/
+  h.refilledAt = now;
+
+  /*a day at most, more would wrap the ms below and no server means it*/
+  if(retryAfter > OUTBOUND_MAX_RETRY_AFTER){
+    retryAfter = OUTBOUND_MAX_RETRY_AFTER;
+  }
+  uint32_t wait = 0;
+  if(status == 429){
+    h.stats.rejected++;
+    /*whatever was saved up is spent, the server counts differently*/
+    h.credit = 0;
+    h.refilledAt = now;
+    wait = retryAfter >= 0 ? (uint32_t)retryAfter * 1000 : backoff;
+  }else if(retryAfter > 0){
+    /*503 and friends may ask for a pause too*/
+    wait = (uint32_t)retryAfter * 1000;
+  }
+  if(wait > 0){
+    uint32_t until = now + wait;
+    if(!h.blocked || (int32_t)(until - h.blockedUntil) > 0){
+      h.blockedUntil = until;
+    }
+    h.blocked = true;
+  }
+}
@@ -0,0 +1,115 @@
+#ifndef OUTBOUND_SCHEDULER_H
+#define OUTBOUND_SCHEDULER_H
+
+#include <stdint.h>
+
+/*Decides when outbound HTTP requests may go, so API quotas hold whatever
+the loop timing does. It doesn't send anything itself: the caller queues a
+request with submit(), asks next() what may be sent now and reports the
+answer back with finished().
+
+Every upstream host has a token bucket. A request takes one token, tokens
+come back one per interval and at most burst of them are saved up, so in
+any window of T ms a host sees at most burst + T/interval requests. The
+time a request is out doesn't count, the interval starts when it ends, so
+the gap between two answers the server sees is at least interval too. A 429
+answer, or Retry-After on any answer, closes the host until the time the
+server asked for, or for backoff when it didn't say.
+
+Requests are identified by host and key. Submitting one that is already
+queued is coalesced into it instead of queueing a second copy, so the
+caller should build the request's contents when it is sent, not when it
+is queued. Lower priority numbers go first, equal ones in queueing order.
+A host has at most one request in flight and all hosts together at most
+maxInFlight. A request held back aging times because another host's
+request took the last slot moves up one priority, so the urgent host
+can't keep the others waiting for good.
+
+Plain C++ with no Arduino dependency, tools/replay uses it as it is*/
+
+#define OUTBOUND_MAX_HOSTS 4
+#define OUTBOUND_QUEUE_SIZE 12
+/*s, longer Retry-After values are cut to it*/
+#define OUTBOUND_MAX_RETRY_AFTER 86400
+
+/*what the scheduler did, per host*/
+struct OutboundStats {
+  uint32_t sent;
+  uint32_t coalesced; //submits merged into a request already queued
+  uint32_t throttled; //requests that had to wait for a token
+  uint32_t deferred;  //requests that waited for Retry-After or a free slot
+  uint32_t rejected;  //429 answers
+  uint32_t maxQueued; //most requests waiting for this host at once
+};
+
+struct OutboundHost {
+  const char *name;
+  uint32_t interval; //ms per token
+  uint8_t burst;
+  bool inFlight;
+  bool blocked;
+  uint32_t credit; //ms of saved up time, interval per token
+  uint32_t refilledAt;
+  uint32_t blockedUntil;
+  OutboundStats stats;
+};
+
+struct OutboundRequest {
+  uint8_t host;
+  uint8_t priority;
+  uint16_t key;
+};
+
+class OutboundScheduler {
+ public:
+  OutboundScheduler();
+
+  /*returns the host's index for the other calls, -1 if there is no room.
+  The bucket starts full*/
+  int addHost(const char *name, uint32_t interval, uint8_t burst, uint32_t now);
+
+  /*queues a request, returns false if the queue is full*/
+  bool submit(int host, uint8_t priority, uint16_t key, uint32_t now);
+  bool queued(int host, uint16_t key) const;
+
+  /*takes the first request that may be sent now out of the queue and
+  marks its host in flight, false if none may*/
+  bool next(uint32_t now, OutboundRequest &request);
+
+  /*the host's request is over. status is the HTTP status, or negative
+  if there was no answer. retryAfter is in seconds, -1 if not sent*/
+  void finished(int host, int status, int32_t retryAfter, uint32_t now);
+
+  bool inFlight(int host) const { return hosts[host].inFlight; }
+  int hostCount() const { return hostTotal; }
+  const OutboundHost &host(int index) const { return hosts[index]; }
+
+  /*requests in flight at once over all hosts*/
+  uint8_t maxInFlight = 2;
+  /*times a queued request is passed over for a free slot before it moves
+  up a priority, 0 never*/
+  uint8_t aging = 2;
+  /*how long a host is closed after a 429 without Retry-After*/
+  uint32_t backoff = 60000;
+
+ private:
+  struct Entry {
+    bool used;
+    uint8_t host;
+    uint8_t priority;
+    uint8_t waited; //WAITED_* bits, so stats count each request once
+    uint8_t deferrals; //passed over for a slot since it last moved up
+    uint16_t key;
+    uint32_t sequence;
+  };
+
+  void refill(OutboundHost &h, uint32_t now);
+  bool hostOpen(OutboundHost &h, uint32_t now);
+
+  OutboundHost hosts[OUTBOUND_MAX_HOSTS];
+  int hostTotal;
+  Entry queue[OUTBOUND_QUEUE_SIZE];
+  uint32_t sequence;
+};
+
+#endif
@@ -0,0 +1,150 @@
+#include "GlyphCache.h"
+
+#include <math.h>
+#include <string.h>
+
+#define FRAME_WIDTH 128
+#define FRAME_PAGES 8
+
+/*draws one character into a 12x16 page layout scratch area*/
+class GlyphRaster : public Adafruit_GFX {
+ public:
+  GlyphRaster() : Adafruit_GFX(12, 16) { clear(); }
+
+  void drawPixel(int16_t x, int16_t y, uint16_t color) override {
+    if(x < 0 || x >= 12 || y < 0 || y >= 16 || color == 0){
+      return;
+    }
+    pixels[(y / 8) * 12 + x] |= 1 << (y & 7);
+  }
+
+  void clear() { memset(pixels, 0, sizeof(pixels)); }
+
+  uint8_t pixels[12 * 2];
+};
+
+void GlyphCache::begin(){
+  GlyphRaster raster;
+  raster.setTextColor(1);
+  raster.setTextWrap(false);
+  raster.cp437(true);
+  uint16_t offset = 0;
+  for(size_t i = 0; i < GLYPH_COUNT; i++){
+    bool degree = i == GLYPH_COUNT - 1;
+    uint8_t size = degree ? 1 : 2;
+    raster.clear();
+    raster.setTextSize(size);
+    raster.setCursor(0, 0);
+    raster.write(degree ? GLYPH_DEGREE : (uint8_t)GLYPH_CHARS[i]);
+
+    Glyph &g = glyphs[i];
+    g.width = 6 * size;
+    g.pages = size;
+    g.offset = offset;
+    for(uint8_t page = 0; page < g.pages; page++){
+      memcpy(data + offset, raster.pixels + page * 12, g.width);
+      offset += g.width;
+    }
+  }
+  rasterized = true;
+}
+
+const GlyphCache::Glyph *GlyphCache::find(char c) const {
+  if((uint8_t)c == GLYPH_DEGREE){
+    return &glyphs[GLYPH_COUNT - 1];
+  }
+  const char *at = strchr(GLYPH_CHARS, c);
+  return at != NULL && c != '\0' ? &glyphs[at - GLYPH_CHARS] : NULL;
+}
+
+int16_t GlyphCache::draw(uint8_t *buffer, int16_t x, int16_t y, const char *text) const {
+  if(!rasterized){
+    return -1;
+  }
+  for(const char *c = text; *c; c++){
+    if(find(*c) == NULL){
+      return -1;
+    }
+  }
+  int16_t width = 0;
+  for(const char *c = text; *c; c++){
+    const Glyph &g = *find(*c);
+    blit(buffer, x + width, y, g);
+    width += g.width;
+  }
+  return width;
+}
+
+/*on a page boundary every glyph byte lands on one buffer byte, otherwise
+each column is shifted down across one more page*/
+void GlyphCache::blit(uint8_t *buffer, int16_t x, int16_t y, const Glyph &g) const {
+  const uint8_t *src = data + g.offset;
+  if(x < 0 || x + g.width > FRAME_WIDTH || y < 0 || y + g.pages * 8 > FRAME_PAGES * 8){
+    /*partly off screen, not worth a fast path*/
+    for(uint8_t page = 0; page < g.pages; page++){
+      for(uint8_t col = 0; col < g.width; col++){
+        uint8_t bits = src[page * g.width + col];
+        int16_t px = x + col;
+        for(uint8_t bit = 0; bit < 8; bit++){
+          int16_t py = y + page * 8 + bit;
+          if((bits >> bit) & 1 && px >= 0 && px < FRAME_WIDTH && py >= 0 && py < FRAME_PAGES * 8){
+            buffer[px + (py / 8) * FRAME_WIDTH] |= 1 << (py & 7);
+          }
+        }
+      }
+    }
+    return;
+  }
+
+  uint8_t shift = y & 7;
+  uint8_t *dst = buffer + (y / 8) * FRAME_WIDTH + x;
+  for(uint8_t page = 0; page < g.pages; page++){
+    if(shift == 0){
+      for(uint8_t col = 0; col < g.width; col++){
+        dst[col] |= src[col];
+      }
+    }else{
+      for(uint8_t col = 0; col < g.width; col++){
+        dst[col] |= src[col] << shift;
+        dst[col + FRAME_WIDTH] |= src[col] >> (8 - shift);
+      }
+    }
+    dst += FRAME_WIDTH;
+    src += g.width;
+  }
+}
+
+int formatFixed(char *out, int32_t value, uint8_t decimals){
+  char digits[12];
+  int n = 0;
+  uint32_t magnitude = value < 0 ? -(uint32_t)value : value;
+  do{
+    digits[n++] = '0' + magnitude % 10;
+    magnitude /= 10;
+  }while(magnitude > 0 || n <= decimals);
+
+  int len = 0;
+  if(value < 0){
+    out[len++] = '-';
+  }
+  while(n > 0){
+    if(n == decimals){
+      out[len++] = '.';
+    }
+    out[len++] = digits[--n];
+  }
+  out[len] = '\0';
+  return len;
+}
+
+bool toFixed(float value, uint8_t decimals, int32_t &out){
+  if(isnan(value) || isinf(value) || fabsf(value) >= 1000000){
+    return false;
+  }
+  double scaled = value;
+  for(uint8_t i = 0; i < decimals; i++){
+    scaled *= 10;
+  }
+  out = (int32_t)(scaled < 0 ? scaled - 0.5 : scaled + 0.5);
+  return true;
+}
@@ -0,0 +1,51 @@
+#ifndef GLYPH_CACHE_H
+#define GLYPH_CACHE_H
+
+#include <Adafruit_GFX.h>
+
+/*characters a readout can be made of, text size 2. The degree sign
+(cp437 167) is the one drawn at text size 1 like on the screens*/
+#define GLYPH_CHARS "0123456789-. %C"
+#define GLYPH_DEGREE 167
+#define GLYPH_COUNT (sizeof(GLYPH_CHARS) - 1 + 1)
+
+/*Pre-rasterized readout characters. Adafruit GFX draws scaled text one
+fillRect per font pixel, here every character is rasterized once into
+page layout columns and later ORed into the frame buffer a byte at a time,
+which gives the same pixels as printing the text onto a cleared area*/
+class GlyphCache {
+ public:
+  /*rasterizes the glyphs with the built in Adafruit GFX font*/
+  void begin();
+  bool ready() const { return rasterized; }
+
+  /*draws text with the cursor at x, y into a 128x64 page layout
+  buffer and returns its width, what GFX text would move the cursor by.
+  -1 if text has a character that is not cached, nothing is drawn then*/
+  int16_t draw(uint8_t *buffer, int16_t x, int16_t y, const char *text) const;
+
+ private:
+  struct Glyph {
+    uint8_t width;  //cursor advance, blank columns included
+    uint8_t pages;  //1 at text size 1, 2 at size 2
+    uint16_t offset;
+  };
+
+  const Glyph *find(char c) const;
+  void blit(uint8_t *buffer, int16_t x, int16_t y, const Glyph &glyph) const;
+
+  Glyph glyphs[GLYPH_COUNT];
+  uint8_t data[(GLYPH_COUNT - 1) * 12 * 2 + 6];
+  bool rasterized = false;
+};
+
+/*value with decimals digits after the point, 2150 with 2 is "21.50".
+out needs room for 13 characters, returns the length*/
+int formatFixed(char *out, int32_t value, uint8_t decimals);
+
+/*float to fixed point rounded half away from zero like Print rounds.
+false for NaN, infinity and values past +-1000000. Values that round to
+zero lose their sign where Print would show "-0.00"*/
+bool toFixed(float value, uint8_t decimals, int32_t &out);
+
+#endif
@@ -0,0 +1,137 @@
+#include "ScreenCache.h"
+#include "GlyphCache.h"
+
+#include <math.h>
+#include <string.h>
+
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME 16777619u
+
+ScreenKey::ScreenKey(uint8_t kind) : screen(kind), hash(FNV_OFFSET){
+  addBytes(&kind, 1);
+}
+
+ScreenKey &ScreenKey::addText(const char *text){
+  if(text == NULL){
+    text = "";
+  }
+  return addBytes(text, strlen(text) + 1);
+}
+
+ScreenKey &ScreenKey::addReading(float value, uint8_t decimals){
+  int32_t fixed;
+  if(toFixed(value, decimals, fixed)){
+    return add(true).add(fixed);
+  }
+  if(isnan(value)){
+    value = NAN;
+  }
+  return add(false).add(value);
+}
+
+ScreenKey &ScreenKey::addBytes(const void *data, size_t len){
+  const uint8_t *bytes = (const uint8_t *)data;
+  for(size_t i = 0; i < len; i++){
+    hash = (hash ^ bytes[i]) * FNV_PRIME;
+  }
+  return *this;
+}
+
+ScreenCache::ScreenCache() : uses(0){
+  clear();
+  memset(kinds, 0, sizeof(kinds));
+}
+
+bool ScreenCache::fetch(const ScreenKey &key, uint8_t *frame){
+  for(int i = 0; i < SCREEN_CACHE_FRAMES; i++){
+    Entry &e = entries[i];
+    if(e.used && e.kind == key.kind() && e.hash == key.value()){
+      e.lastUse = ++uses;
+      memcpy(frame, e.frame, SCREEN_FRAME_BYTES);
+      return true;
+    }
+  }
+  return false;
+}
+
+void ScreenCache::store(const ScreenKey &key, const uint8_t *frame){
+  Entry *victim = &entries[0];
+  for(int i = 0; i < SCREEN_CACHE_FRAMES; i++){
+    Entry &e = entries[i];
+    if(!e.used){
+      victim = &e;
+      break;
+    }
+    if(e.lastUse < victim->lastUse){
+      victim = &e;
+    }
+  }
+  victim->used = true;
+  victim->kind = key.kind();
+  victim->hash = key.value();
+  victim->lastUse = ++uses;
+  memcpy(victim->frame, frame, SCREEN_FRAME_BYTES);
+}
+
+void ScreenCache::clear(){
+  for(int i = 0; i < SCREEN_CACHE_FRAMES; i++){
+    entries[i].used = false;
+    entries[i].lastUse = 0;
+  }
+}
+
+void ScreenCache::countHit(uint8_t kind, uint32_t us){
+  if(kind < SCREEN_CACHE_KINDS){
+    kinds[kind].hits++;
+    kinds[kind].copyUs += us;
+  }
+}
+
+void ScreenCache::countMiss(uint8_t kind, uint32_t us){
+  if(kind < SCREEN_CACHE_KINDS){
+    kinds[kind].misses++;
+    kinds[kind].renderUs += us;
+  }
+}
+
+ScreenCacheStats ScreenCache::stats(uint8_t kind) const {
+  ScreenCacheStats s = {};
+  if(kind < SCREEN_CACHE_KINDS){
+    s = kinds[kind];
+  }
+  return s;
+}
+
+uint64_t ScreenCache::savedUs(uint8_t kind) const {
+  ScreenCacheStats s = stats(kind);
+  if(s.misses == 0){
+    return 0;
+  }
+  uint64_t render = s.renderUs * s.hits / s.misses;
+  return render > s.copyUs ? render - s.copyUs : 0;
+}
+
+void ScreenCache::printStats(Print &out, const char *const *names, int count) const {
+  out.printf("%-9s %7s %7s %6s %9s %8s %10s\n", "screen", "hits", "misses", "hit %", "draw us", "copy us",
+             "saved ms");
+  uint32_t hits = 0, misses = 0;
+  uint64_t saved = 0;
+  for(int kind = 0; kind < count && kind < SCREEN_CACHE_KINDS; kind++){
+    const ScreenCacheStats &s = kinds[kind];
+    uint32_t shown = s.hits + s.misses;
+    if(shown == 0){
+      continue;
+    }
+    out.printf("%-9s %7lu %7lu %6.1f %9lu %8lu %10lu\n", names[kind], (unsigned long)s.hits,
+               (unsigned long)s.misses, 100.0 * s.hits / shown,
+               (unsigned long)(s.misses > 0 ? s.renderUs / s.misses : 0),
+               (unsigned long)(s.hits > 0 ? s.copyUs / s.hits : 0), (unsigned long)(savedUs(kind) / 1000));
+    hits += s.hits;
+    misses += s.misses;
+    saved += savedUs(kind);
+  }
+  uint32_t shown = hits + misses;
+  out.printf("%lu of %lu screens from the cache (%.1f %%), %lu ms of drawing saved, %d frames of %d bytes\n",
+             (unsigned long)hits, (unsigned long)shown, shown > 0 ? 100.0 * hits / shown : 0.0,
+             (unsigned long)(saved / 1000), SCREEN_CACHE_FRAMES, SCREEN_FRAME_BYTES);
+}
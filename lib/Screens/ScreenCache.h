@@ -0,0 +1,87 @@
+#ifndef SCREEN_CACHE_H
+#define SCREEN_CACHE_H
+
+#include <Print.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*frames kept, 1 KB of RAM each. One per screen in the rotation: inside,
+derived, outside, a forecast screen per location and the summary*/
+#ifndef SCREEN_CACHE_FRAMES
+#define SCREEN_CACHE_FRAMES 6
+#endif
+/*screen kinds counted apart, the DeviceIo::Screen values*/
+#define SCREEN_CACHE_KINDS 8
+#define SCREEN_FRAME_BYTES (128 * 64 / 8)
+
+/*What a screen is drawn from: its kind and a 32-bit FNV-1a hash of every
+value that ends up on it. Add fields one by one rather than whole structs,
+padding bytes would make equal screens look different*/
+class ScreenKey {
+ public:
+  explicit ScreenKey(uint8_t kind);
+
+  template <typename T> ScreenKey &add(const T &value) { return addBytes(&value, sizeof(value)); }
+  /*the text and its terminator, NULL counts as an empty string*/
+  ScreenKey &addText(const char *text);
+  /*a reading as drawReading() shows it, the value rounded to decimals
+  with toFixed(), so readings that draw the same share a frame. What
+  toFixed() refuses goes in as it is, every NaN alike*/
+  ScreenKey &addReading(float value, uint8_t decimals);
+  ScreenKey &addBytes(const void *data, size_t len);
+
+  uint8_t kind() const { return screen; }
+  uint32_t value() const { return hash; }
+
+ private:
+  uint8_t screen;
+  uint32_t hash;
+};
+
+struct ScreenCacheStats {
+  uint32_t hits;
+  uint32_t misses;
+  uint64_t renderUs; //drawing on misses
+  uint64_t copyUs;   //copying cached frames back on hits
+};
+
+/*Fully drawn frames, most recently used kept. A screen whose values didn't
+change since it was last drawn is copied back into the frame buffer instead
+of drawn again with text and bitmaps. The saved time is estimated from the
+average draw time of that kind of screen. Plain C++*/
+class ScreenCache {
+ public:
+  ScreenCache();
+
+  /*copies the frame drawn for key into frame, false if there is none*/
+  bool fetch(const ScreenKey &key, uint8_t *frame);
+  /*keeps frame as drawn for key, in place of the least recently used*/
+  void store(const ScreenKey &key, const uint8_t *frame);
+  /*forgets every frame, the counters stay*/
+  void clear();
+
+  void countHit(uint8_t kind, uint32_t us);
+  void countMiss(uint8_t kind, uint32_t us);
+
+  ScreenCacheStats stats(uint8_t kind) const;
+  /*draw time the hits of kind didn't spend, copying them back deducted*/
+  uint64_t savedUs(uint8_t kind) const;
+
+  /*a line per kind that was shown, names indexed by kind*/
+  void printStats(Print &out, const char *const *names, int count) const;
+
+ private:
+  struct Entry {
+    bool used;
+    uint8_t kind;
+    uint32_t hash;
+    uint32_t lastUse;
+    uint8_t frame[SCREEN_FRAME_BYTES];
+  };
+
+  Entry entries[SCREEN_CACHE_FRAMES];
+  uint32_t uses;
+  ScreenCacheStats kinds[SCREEN_CACHE_KINDS];
+};
+
+#endif
@@ -0,0 +1,296 @@
+#include "Screens.h"
+#include "GlyphCache.h"
+#include <ForecastStream.h>
+#include <Icons.h>
+#include <IconsSmall.h>
+#include <stdio.h>
+#include <string.h>
+
+/*Adafruit GFX colour for a lit pixel*/
+#define SCREEN_ON 1
+
+/*" \xA7C" would read as one hex escape*/
+#define UNIT_CELSIUS " \xA7" "C"
+#define UNIT_PERCENT " %"
+
+static GlyphCache glyphCache;
+static uint8_t *screenBuffer = NULL;
+
+void setScreenBuffer(uint8_t *buffer){
+  screenBuffer = buffer;
+  if(buffer != NULL && !glyphCache.ready()){
+    glyphCache.begin();
+  }
+}
+
+/*value with two decimals and unit at the cursor in text size 2, the
+degree sign is drawn at size 1. Leaves the cursor after the unit*/
+static void drawReading(Adafruit_GFX &gfx, float value, const char *unit){
+  int32_t fixed;
+  if(screenBuffer != NULL && toFixed(value, 2, fixed)){
+    char text[24];
+    int len = formatFixed(text, fixed, 2);
+    strcpy(text + len, unit);
+    int16_t x = gfx.getCursorX();
+    int16_t y = gfx.getCursorY();
+    int16_t width = glyphCache.draw(screenBuffer, x, y, text);
+    if(width >= 0){
+      gfx.setCursor(x + width, y);
+      gfx.setTextSize(2);
+      gfx.cp437(true);
+      return;
+    }
+  }
+  /*NaN and friends are printed the way Print does it*/
+  gfx.setTextSize(2);
+  gfx.print(value);
+  for(const char *c = unit; *c; c++){
+    if((uint8_t)*c == GLYPH_DEGREE){
+      gfx.setTextSize(1);
+      gfx.cp437(true);
+      gfx.write(*c);
+      gfx.setTextSize(2);
+    }else{
+      gfx.write(*c);
+    }
+  }
+}
+
+void drawConnectScreen(Adafruit_GFX &gfx, bool connected){
+  gfx.fillScreen(0);
+  gfx.drawBitmap(30, 10, wifi_icon, wifi_icon_width, wifi_icon_height, SCREEN_ON);
+  gfx.setCursor(0,0);
+  gfx.setTextSize(1);
+  gfx.print(connected ? "Connected!" : "Connecting...");
+}
+
+void drawInsideScreen(Adafruit_GFX &gfx, float insideTemp, float hum){
+  gfx.fillScreen(0);
+  // display temperature
+  gfx.drawBitmap(0,0,  temperature_icon, temperature_width, temperature_height, SCREEN_ON);
+  gfx.setTextSize(1);
+  gfx.setCursor(24,22);
+  gfx.print("in");
+  gfx.setCursor(32,0);
+  drawReading(gfx, insideTemp, UNIT_CELSIUS);
+
+  // display humidity
+  gfx.drawBitmap(0,32, humidity_icon, humidity_width, humidity_height, SCREEN_ON);
+  gfx.setCursor(32,45);
+  drawReading(gfx, hum, UNIT_PERCENT);
+}
+
+void drawOutsideScreen(Adafruit_GFX &gfx, float outsideTemp){
+  gfx.fillScreen(0);
+  // display temperature
+  gfx.drawBitmap(0,0,  temperature_icon, temperature_width, temperature_height, SCREEN_ON);
+  gfx.setTextSize(1);
+  gfx.setCursor(24,22);
+  gfx.print("out");
+  gfx.setCursor(32,0);
+  drawReading(gfx, outsideTemp, UNIT_CELSIUS);
+}
+
+/*where one slot's time, icon and temperature go in its column, an x of
+-1 centres it in the column*/
+struct ForecastLayoutSpec {
+  uint8_t slots;
+  uint8_t columnWidth;
+  uint8_t iconSize;
+  int8_t timeX, timeY;
+  int8_t iconX, iconY;
+  int8_t tempX, tempY;
+  int8_t placeY;
+  const char *unit;
+};
+
+static const ForecastLayoutSpec forecastLayouts[] = {
+  /*1-up is the old single slot screen, the place is right of the icon,
+  which ends at x=94*/
+  {1, 128, 64, 0, 0, 30, 5, 90, 50, 0, UNIT_CELSIUS},
+  {3, 42, 32, -1, 0, -1, 9, -1, 44, 56, UNIT_CELSIUS},
+  /*with the space, -12 C is wider than the column*/
+  {4, 32, 24, -1, 0, -1, 10, -1, 38, 56, "\xA7" "C"},
+};
+
+int forecastLayoutSlots(ForecastLayout layout){
+  return forecastLayouts[layout].slots;
+}
+
+static int16_t columnOffset(const ForecastLayoutSpec &spec, int8_t x, int16_t width){
+  return x >= 0 ? x : (spec.columnWidth - width + 1) / 2;
+}
+
+void drawForecastScreen(Adafruit_GFX &gfx, const ForecastSlot *slots, int count, ForecastLayout layout,
+                        const char *place){
+  const ForecastLayoutSpec &spec = forecastLayouts[layout];
+  gfx.fillScreen(0);
+  gfx.setTextSize(1);
+  gfx.cp437(true);
+  for(int i = 0; i < count && i < spec.slots; i++){
+    const ForecastSlot &slot = slots[i];
+    int16_t column = i * spec.columnWidth;
+    gfx.setCursor(column + columnOffset(spec, spec.timeX, strlen(slot.time) * 6), spec.timeY);
+    gfx.print(slot.time);
+
+    char temperature[12];
+    int length = snprintf(temperature, sizeof(temperature), "%d%s", slot.temperature, spec.unit);
+    gfx.setCursor(column + columnOffset(spec, spec.tempX, length * 6), spec.tempY);
+    gfx.print(temperature);
+
+    const unsigned char *icon = forecastIcon(slot.weatherId, spec.iconSize);
+    if(icon != NULL){
+      gfx.drawBitmap(column + columnOffset(spec, spec.iconX, spec.iconSize), spec.iconY, icon,
+                     spec.iconSize, spec.iconSize, SCREEN_ON);
+    }
+  }
+  if(place != NULL){
+    int length = strnlen(place, 5);
+    gfx.setCursor(128 - length * 6, spec.placeY);
+    for(int i = 0; i < length; i++){
+      gfx.write(place[i]);
+    }
+  }
+}
+
+/*one label and value line at text size 1, the value right aligned with
+one decimal from hundredths*/
+static void drawDerivedLine(Adafruit_GFX &gfx, int16_t y, const char *label, int32_t hundredths, const char *unit){
+  char text[24];
+  int32_t tenths = hundredths < 0 ? -((-hundredths + 5) / 10) : (hundredths + 5) / 10;
+  int len = formatFixed(text, tenths, 1);
+  strcpy(text + len, unit);
+  gfx.setCursor(0, y);
+  gfx.print(label);
+  gfx.setCursor(128 - (int16_t)strlen(text) * 6, y);
+  gfx.print(text);
+}
+
+void drawDerivedScreen(Adafruit_GFX &gfx, const DerivedMetrics &metrics){
+  gfx.fillScreen(0);
+  gfx.setTextSize(1);
+  gfx.cp437(true);
+  if(metrics.dewPoint < 0){
+    drawDerivedLine(gfx, 4, "Frost point", metrics.frostPoint, UNIT_CELSIUS);
+  }else{
+    drawDerivedLine(gfx, 4, "Dew point", metrics.dewPoint, UNIT_CELSIUS);
+  }
+  drawDerivedLine(gfx, 28, "Abs. hum.", metrics.absoluteHumidity, " g/m3");
+  drawDerivedLine(gfx, 52, "Feels like", metrics.heatIndex, UNIT_CELSIUS);
+}
+
+/*whole degrees from tenths, rounded*/
+static int wholeDegrees(int16_t tenths){
+  return tenths < 0 ? -((-tenths + 5) / 10) : (tenths + 5) / 10;
+}
+
+void drawSummaryScreen(Adafruit_GFX &gfx, const ForecastDay *days, int count){
+  static const char *weekdays[] = {"Thu", "Fri", "Sat", "Sun", "Mon", "Tue", "Wed"};
+  /*25 px, four characters and a pixel between columns*/
+  const int columnWidth = 128 / STATION_SUMMARY_DAYS;
+
+  gfx.fillScreen(0);
+  gfx.setTextSize(1);
+  gfx.cp437(true);
+  gfx.drawFastHLine(0, 10, 128, SCREEN_ON);
+  for(int i = 0; i < count && i < STATION_SUMMARY_DAYS; i++){
+    const ForecastDay &d = days[i];
+    int16_t x = i * columnWidth;
+    gfx.setCursor(x, 0);
+    gfx.print(weekdays[((d.day % 7) + 7) % 7]); //1970-01-01 was a Thursday
+    gfx.setCursor(x, 16);
+    gfx.print(wholeDegrees(d.maxTemp));
+    gfx.write(167);
+    gfx.setCursor(x, 28);
+    gfx.print(wholeDegrees(d.minTemp));
+    gfx.write(167);
+    gfx.setCursor(x, 46);
+    gfx.print(conditionName(d.weatherId));
+  }
+}
+
+/*range 200-299 = thunderstorm class
+  range 300-399 = drizzle class
+  range 500-599 = rain class
+  range 600-699 = snow class
+  range 700-799 = describes atmostphere (fog etc.)
+  value 800 = clear sky
+  range 801-899 = clouds class
+light and moderate rain (500, 501) use the drizzle icon, heavier rain and
+the atmosphere class have no icon*/
+static int weatherIcon(int id){
+  if(inRange(id,200,299)) return 0;
+  if(inRange(id,300,501)) return 1;
+  if(inRange(id,600,699)) return 2;
+  if(id == 800) return 3;
+  if(id == 801) return 4;
+  if(id == 802) return 5;
+  if(id == 803 || id == 804) return 6;
+  return -1;
+}
+
+/*64, 32 and 24 pixels*/
+static const unsigned char *const weatherIcons[][3] = {
+  {thunderstorm, thunderstorm_32, thunderstorm_24},
+  {drizzle, drizzle_32, drizzle_24},
+  {snow, snow_32, snow_24},
+  {clear_sky, clear_sky_32, clear_sky_24},
+  {cloud1, cloud1_32, cloud1_24},
+  {cloud2, cloud2_32, cloud2_24},
+  {cloud3, cloud3_32, cloud3_24},
+};
+
+const unsigned char *forecastIcon(int id, int size){
+  int icon = weatherIcon(id);
+  if(icon < 0){
+    return NULL;
+  }
+  return weatherIcons[icon][size == 32 ? 1 : size == 24 ? 2 : 0];
+}
+
+/*function inRange() checks if value is between given min and max
+returns boolean true or false*/
+bool inRange(int val, int min, int max){
+  return ((min <= val) && (val <= max));
+}
+
+bool benchmarkReadouts(Adafruit_GFX &gfx, uint8_t *buffer, Print &out, uint32_t (*clockUs)()){
+  static const struct {
+    const char *name;
+    float value;
+    const char *unit;
+    int16_t x, y;
+  } readouts[] = {
+    {"inside temp", 21.56f, UNIT_CELSIUS, 32, 0},
+    {"humidity", 45.3f, UNIT_PERCENT, 32, 45},
+    {"outside temp", -3.25f, UNIT_CELSIUS, 32, 0},
+  };
+  const int rounds = 50;
+
+  uint8_t *saved = screenBuffer;
+  bool same = true;
+  for(size_t i = 0; i < sizeof(readouts) / sizeof(readouts[0]); i++){
+    uint32_t took[2];
+    int16_t endX[2], endY[2];
+    for(int cached = 0; cached < 2; cached++){
+      setScreenBuffer(cached ? buffer : NULL);
+      uint32_t started = clockUs();
+      for(int n = 0; n < rounds; n++){
+        gfx.setCursor(readouts[i].x, readouts[i].y);
+        drawReading(gfx, readouts[i].value, readouts[i].unit);
+      }
+      took[cached] = (clockUs() - started) / rounds;
+      endX[cached] = gfx.getCursorX();
+      endY[cached] = gfx.getCursorY();
+    }
+    out.printf("%-12s gfx text %5lu us, glyph cache %4lu us", readouts[i].name,
+               (unsigned long)took[0], (unsigned long)took[1]);
+    if(endX[0] != endX[1] || endY[0] != endY[1]){
+      out.printf(", CURSOR: text leaves it at %d,%d, the cache at %d,%d", endX[0], endY[0], endX[1], endY[1]);
+      same = false;
+    }
+    out.printf("\n");
+  }
+  screenBuffer = saved;
+  return same;
+}
@@ -0,0 +1,55 @@
+#ifndef SCREENS_H
+#define SCREENS_H
+
+#include <Adafruit_GFX.h>
+#include <Station.h>
+
+/*The station screens. They draw into any Adafruit_GFX and leave pushing
+the frame to the panel to the caller, so tools/oledsim can render the same
+code on a PC*/
+
+/*"Connecting..." while waiting for WiFi, "Connected!" once it is up*/
+void drawConnectScreen(Adafruit_GFX &gfx, bool connected);
+void drawInsideScreen(Adafruit_GFX &gfx, float insideTemp, float humidity);
+void drawOutsideScreen(Adafruit_GFX &gfx, float outsideTemp);
+/*How forecast slots share the screen. 1-up is one slot with the full
+64x64 icon, the others put the slots side by side in columns with the
+icons shrunk at build time (tools/icons/shrinkicons.py)*/
+enum ForecastLayout {
+  FORECAST_LAYOUT_1UP,
+  FORECAST_LAYOUT_3UP, //42 px columns, 32x32 icons
+  FORECAST_LAYOUT_4UP  //32 px columns, 24x24 icons
+};
+
+int forecastLayoutSlots(ForecastLayout layout);
+
+/*up to forecastLayoutSlots(layout) slots: time, weather icon and
+temperature. place, when given, is cut to 5 characters and goes to the
+top right corner in 1-up and the bottom right corner otherwise*/
+void drawForecastScreen(Adafruit_GFX &gfx, const ForecastSlot *slots, int count, ForecastLayout layout,
+                        const char *place = NULL);
+
+/*dew or frost point, absolute humidity and what the temperature feels like*/
+void drawDerivedScreen(Adafruit_GFX &gfx, const DerivedMetrics &metrics);
+
+/*up to 5 days side by side: weekday, high, low and the condition*/
+void drawSummaryScreen(Adafruit_GFX &gfx, const ForecastDay *days, int count);
+
+/*size x size icon for an OpenWeatherMap weather id, NULL if there is
+none. Sizes are 64, 32 and 24*/
+const unsigned char *forecastIcon(int weatherId, int size = 64);
+
+bool inRange(int val, int min, int max);
+
+/*frame buffer (page layout, 128x64) behind the gfx the screens are drawn
+to. When set the temperature and humidity readouts are blitted from a
+glyph cache instead of drawn as scaled text, NULL goes back to GFX text*/
+void setScreenBuffer(uint8_t *buffer);
+
+/*draws every readout a number of times through GFX text and through the
+glyph cache and prints the average time of each. Leaves readouts drawn in
+buffer, the next screen clears them. false if the two ways leave the
+cursor in different places*/
+bool benchmarkReadouts(Adafruit_GFX &gfx, uint8_t *buffer, Print &out, uint32_t (*clockUs)());
+
+#endif
@@ -0,0 +1,117 @@
+#include "Bme280Sensor.h"
+
+#include <Arduino.h>
+
+#define BME280_CHIP_ID 0xd0
+#define BME280_CALIBRATION 0x88
+#define BME280_HUMIDITY_CALIBRATION 0xe1
+#define BME280_CTRL_HUM 0xf2
+#define BME280_STATUS 0xf3
+#define BME280_CTRL_MEAS 0xf4
+#define BME280_DATA 0xf7
+/*8 ms typical at 1x oversampling of all three, 9.3 ms at most*/
+#define BME280_TYPICAL_MS 8
+#define BME280_MEASURE_MS 10
+
+static uint16_t u16(const uint8_t *p){
+  return p[0] | p[1] << 8;
+}
+
+bool Bme280Sensor::writeRegister(uint8_t reg, uint8_t value){
+  return write(reg, &value, 1);
+}
+
+bool Bme280Sensor::begin(){
+  uint8_t id;
+  if(!readRegister(BME280_CHIP_ID, &id, 1) || id != 0x60){
+    return false;
+  }
+  uint8_t c[26], h[7];
+  if(!readRegister(BME280_CALIBRATION, c, sizeof(c)) || !readRegister(BME280_HUMIDITY_CALIBRATION, h, sizeof(h))){
+    return false;
+  }
+  t1 = u16(c);
+  t2 = u16(c + 2);
+  t3 = u16(c + 4);
+  p1 = u16(c + 6);
+  p2 = u16(c + 8);
+  p3 = u16(c + 10);
+  p4 = u16(c + 12);
+  p5 = u16(c + 14);
+  p6 = u16(c + 16);
+  p7 = u16(c + 18);
+  p8 = u16(c + 20);
+  p9 = u16(c + 22);
+  h1 = c[25];
+  h2 = u16(h);
+  h3 = h[2];
+  h4 = (int16_t)((int8_t)h[3] * 16 | (h[4] & 0x0f));
+  h5 = (int16_t)((int8_t)h[5] * 16 | h[4] >> 4);
+  h6 = (int8_t)h[6];
+  /*humidity oversampling only takes effect with the next ctrl_meas write*/
+  return writeRegister(BME280_CTRL_HUM, 0x01);
+}
+
+bool Bme280Sensor::start(){
+  startedAt = millis();
+  /*temperature and pressure 1x, forced mode*/
+  return writeRegister(BME280_CTRL_MEAS, 0x25);
+}
+
+/*the status register is only asked from the typical time on, ready()
+is polled in a loop and every question is a bus transaction*/
+bool Bme280Sensor::ready(){
+  uint32_t elapsed = millis() - startedAt;
+  if(elapsed >= BME280_MEASURE_MS){
+    return true;
+  }
+  uint8_t status;
+  return elapsed >= BME280_TYPICAL_MS && readRegister(BME280_STATUS, &status, 1) && !(status & 0x08);
+}
+
+bool Bme280Sensor::read(SensorReading &out){
+  clear(out);
+  uint8_t d[8];
+  if(!readRegister(BME280_DATA, d, sizeof(d))){
+    return false;
+  }
+  int32_t adcP = (int32_t)d[0] << 12 | d[1] << 4 | d[2] >> 4;
+  int32_t adcT = (int32_t)d[3] << 12 | d[4] << 4 | d[5] >> 4;
+  int32_t adcH = (int32_t)d[6] << 8 | d[7];
+  if(adcT == 0x80000){
+    /*the reset value, nothing was measured*/
+    return false;
+  }
+
+  /*datasheet 4.2.3, temperature in 0.01 C*/
+  int32_t var1 = ((((adcT >> 3) - ((int32_t)t1 << 1))) * t2) >> 11;
+  int32_t var2 = (((((adcT >> 4) - (int32_t)t1) * ((adcT >> 4) - (int32_t)t1)) >> 12) * t3) >> 14;
+  int32_t tFine = var1 + var2;
+  out.temperature = ((tFine * 5 + 128) >> 8) / 100.0f;
+
+  /*pressure in Pa, Q24.8*/
+  int64_t v1 = (int64_t)tFine - 128000;
+  int64_t v2 = v1 * v1 * p6;
+  v2 += (v1 * p5) << 17;
+  v2 += (int64_t)p4 << 35;
+  v1 = ((v1 * v1 * p3) >> 8) + ((v1 * p2) << 12);
+  v1 = ((((int64_t)1 << 47) + v1) * p1) >> 33;
+  if(v1 != 0){
+    int64_t p = 1048576 - adcP;
+    p = (((p << 31) - v2) * 3125) / v1;
+    v1 = ((int64_t)p9 * (p >> 13) * (p >> 13)) >> 25;
+    v2 = ((int64_t)p8 * p) >> 19;
+    p = ((p + v1 + v2) >> 8) + ((int64_t)p7 << 4);
+    out.pressure = p / 25600.0f;
+  }
+
+  /*humidity in %, Q22.10*/
+  int32_t x = tFine - 76800;
+  x = (((((adcH << 14) - ((int32_t)h4 << 20) - ((int32_t)h5 * x)) + 16384) >> 15) *
+       (((((((x * h6) >> 10) * (((x * (int32_t)h3) >> 11) + 32768)) >> 10) + 2097152) * h2 + 8192) >> 14));
+  x -= ((((x >> 15) * (x >> 15)) >> 7) * (int32_t)h1) >> 4;
+  x = x < 0 ? 0 : x;
+  x = x > 419430400 ? 419430400 : x;
+  out.humidity = (x >> 12) / 1024.0f;
+  return true;
+}
@@ -0,0 +1,33 @@
+#ifndef BME280_SENSOR_H
+#define BME280_SENSOR_H
+
+#include <I2cBus.h>
+#include "Sensor.h"
+
+/*Bosch BME280 pressure, temperature and humidity on the shared I2C bus,
+0x76 or 0x77. Forced mode with 1x oversampling: start() triggers one
+measurement, about 10 ms, then the sensor sleeps again. ready() asks its
+status register. The trimming parameters are read once in begin() and
+the datasheet's integer compensation turns raw values into readings*/
+class Bme280Sensor : public Sensor, private I2cDevice {
+ public:
+  Bme280Sensor(I2cBus &bus, uint8_t address = 0x76) : I2cDevice(bus, address, "bme280") {}
+
+  const char *name() const override { return "bme280"; }
+  bool begin() override;
+  bool start() override;
+  bool ready() override;
+  bool read(SensorReading &out) override;
+
+ private:
+  bool writeRegister(uint8_t reg, uint8_t value);
+
+  uint16_t t1, p1;
+  int16_t t2, t3, p2, p3, p4, p5, p6, p7, p8, p9;
+  uint8_t h1, h3;
+  int16_t h2, h4, h5;
+  int8_t h6;
+  uint32_t startedAt = 0;
+};
+
+#endif
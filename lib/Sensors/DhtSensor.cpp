@@ -0,0 +1,13 @@
+#include "DhtSensor.h"
+
+bool DhtSensor::begin(){
+  dht.begin();
+  return true;
+}
+
+bool DhtSensor::read(SensorReading &out){
+  clear(out);
+  out.humidity = dht.readHumidity();
+  out.temperature = dht.readTemperature();
+  return !isnan(out.humidity) && !isnan(out.temperature);
+}
@@ -0,0 +1,24 @@
+#ifndef DHT_SENSOR_H
+#define DHT_SENSOR_H
+
+#include <DHT.h>
+#include "Sensor.h"
+
+/*DHT22 on its own pin. The library bit-bangs the answer with interrupts
+off, so there is nothing to wait for in the background, read() takes the
+5 ms the transfer needs*/
+class DhtSensor : public Sensor {
+ public:
+  explicit DhtSensor(DHT &dht) : dht(dht) {}
+
+  const char *name() const override { return "dht22"; }
+  bool begin() override;
+  bool start() override { return true; }
+  bool ready() override { return true; }
+  bool read(SensorReading &out) override;
+
+ private:
+  DHT &dht;
+};
+
+#endif
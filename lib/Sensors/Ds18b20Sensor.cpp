@@ -0,0 +1,27 @@
+#include "Ds18b20Sensor.h"
+
+#include <Arduino.h>
+
+bool Ds18b20Sensor::begin(){
+  sensors.begin();
+  sensors.setResolution(12);
+  sensors.setWaitForConversion(false);
+  conversionMs = sensors.millisToWaitForConversion(12);
+  return true;
+}
+
+bool Ds18b20Sensor::start(){
+  startedAt = millis();
+  sensors.requestTemperatures();
+  return true;
+}
+
+bool Ds18b20Sensor::ready(){
+  return millis() - startedAt >= conversionMs || sensors.isConversionComplete();
+}
+
+bool Ds18b20Sensor::read(SensorReading &out){
+  clear(out);
+  out.temperature = sensors.getTempCByIndex(0);
+  return out.temperature != DEVICE_DISCONNECTED_C;
+}
@@ -0,0 +1,26 @@
+#ifndef DS18B20_SENSOR_H
+#define DS18B20_SENSOR_H
+
+#include <DallasTemperature.h>
+#include "Sensor.h"
+
+/*The first DS18B20 on a 1-Wire bus at 12 bits. A conversion takes up to
+750 ms, the bus is asked whether it's done instead of waiting it out*/
+class Ds18b20Sensor : public Sensor {
+ public:
+  explicit Ds18b20Sensor(DallasTemperature &sensors) : sensors(sensors) {}
+
+  const char *name() const override { return "ds18b20"; }
+  bool begin() override;
+  bool start() override;
+  bool ready() override;
+  /*a disconnected sensor reads DEVICE_DISCONNECTED_C*/
+  bool read(SensorReading &out) override;
+
+ private:
+  DallasTemperature &sensors;
+  uint32_t startedAt = 0;
+  uint32_t conversionMs = 750;
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef SENSOR_H
+#define SENSOR_H
+
+#include <math.h>
+#include <stdint.h>
+
+/*what one measurement gave, NAN for what the sensor doesn't measure*/
+struct SensorReading {
+  float temperature; //C
+  float humidity;    //%
+  float pressure;    //hPa
+};
+
+/*A sensor measured in three steps so nothing waits for a conversion:
+start() kicks one off, ready() is polled between other work and read()
+fetches the result. Sensors that can't measure in the background are
+ready right away and take their time in read(). ready() turns true after
+the longest conversion the datasheet gives even if the sensor never says
+so, read() then fails*/
+class Sensor {
+ public:
+  virtual ~Sensor() {}
+
+  virtual const char *name() const = 0;
+  /*checks the sensor answers and sets it up, false if it doesn't*/
+  virtual bool begin() = 0;
+  /*false if the sensor didn't take the command*/
+  virtual bool start() = 0;
+  virtual bool ready() = 0;
+  /*false for no answer or a broken reading, out still gets whatever
+  value the sensor gave*/
+  virtual bool read(SensorReading &out) = 0;
+
+ protected:
+  static void clear(SensorReading &out){
+    out.temperature = out.humidity = out.pressure = NAN;
+  }
+};
+
+#endif
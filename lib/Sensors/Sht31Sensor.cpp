@@ -0,0 +1,54 @@
+#include "Sht31Sensor.h"
+
+#include <Arduino.h>
+
+#define SHT31_SINGLE_SHOT_HIGH 0x2400
+#define SHT31_SOFT_RESET 0x30a2
+#define SHT31_MEASURE_MS 16
+
+/*CRC-8 over each 16 bit word, polynomial 0x31 from 0xff*/
+static uint8_t crc8(const uint8_t *bytes, size_t len){
+  uint8_t crc = 0xff;
+  for(size_t i = 0; i < len; i++){
+    crc ^= bytes[i];
+    for(int bit = 0; bit < 8; bit++){
+      crc = crc & 0x80 ? (crc << 1) ^ 0x31 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+bool Sht31Sensor::command(uint16_t code){
+  uint8_t low = code & 0xff;
+  return write(code >> 8, &low, 1);
+}
+
+bool Sht31Sensor::begin(){
+  if(!command(SHT31_SOFT_RESET)){
+    return false;
+  }
+  delay(2);
+  return true;
+}
+
+bool Sht31Sensor::start(){
+  startedAt = millis();
+  return command(SHT31_SINGLE_SHOT_HIGH);
+}
+
+bool Sht31Sensor::ready(){
+  return millis() - startedAt >= SHT31_MEASURE_MS;
+}
+
+bool Sht31Sensor::read(SensorReading &out){
+  clear(out);
+  uint8_t raw[6];
+  if(!I2cDevice::read(raw, sizeof(raw)) || crc8(raw, 2) != raw[2] || crc8(raw + 3, 2) != raw[5]){
+    return false;
+  }
+  uint16_t t = raw[0] << 8 | raw[1];
+  uint16_t h = raw[3] << 8 | raw[4];
+  out.temperature = -45 + 175 * (t / 65535.0f);
+  out.humidity = 100 * (h / 65535.0f);
+  return true;
+}
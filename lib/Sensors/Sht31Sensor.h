@@ -0,0 +1,27 @@
+#ifndef SHT31_SENSOR_H
+#define SHT31_SENSOR_H
+
+#include <I2cBus.h>
+#include "Sensor.h"
+
+/*Sensirion SHT31 temperature and humidity on the shared I2C bus, 0x44
+or 0x45. Single shots at high repeatability without clock stretching, so
+the sensor doesn't hold the bus while it measures. The datasheet gives
+15 ms for one, the result is read after that*/
+class Sht31Sensor : public Sensor, private I2cDevice {
+ public:
+  Sht31Sensor(I2cBus &bus, uint8_t address = 0x44) : I2cDevice(bus, address, "sht31") {}
+
+  const char *name() const override { return "sht31"; }
+  bool begin() override;
+  bool start() override;
+  bool ready() override;
+  bool read(SensorReading &out) override;
+
+ private:
+  bool command(uint16_t code);
+
+  uint32_t startedAt = 0;
+};
+
+#endif
@@ -0,0 +1,33 @@
+#include "LogRing.h"
+
+#include <string.h>
+
+bool LogRing::push(const char *data, uint32_t len){
+  uint32_t h = head;
+  uint32_t t = __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+  if(len > capacity() - (h - t)){
+    return false;
+  }
+  uint32_t at = h & mask;
+  uint32_t first = len < capacity() - at ? len : capacity() - at;
+  memcpy(buffer + at, data, first);
+  memcpy(buffer, data + first, len - first);
+  __atomic_store_n(&head, h + len, __ATOMIC_RELEASE);
+  return true;
+}
+
+uint32_t LogRing::pop(char *out, uint32_t max){
+  uint32_t t = tail;
+  uint32_t h = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+  uint32_t len = h - t < max ? h - t : max;
+  uint32_t at = t & mask;
+  uint32_t first = len < capacity() - at ? len : capacity() - at;
+  memcpy(out, buffer + at, first);
+  memcpy(out + first, buffer, len - first);
+  __atomic_store_n(&tail, t + len, __ATOMIC_RELEASE);
+  return len;
+}
+
+uint32_t LogRing::used() const {
+  return __atomic_load_n(&head, __ATOMIC_ACQUIRE) - __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+}
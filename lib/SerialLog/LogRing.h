@@ -0,0 +1,36 @@
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*Byte ring between one writer and one reader that never locks. The
+writer only moves head and the reader only moves tail, each reads the
+other's index with acquire and publishes its own with release, so the
+bytes are in place before the other side sees them.
+
+push() takes a whole message or nothing, a line is never cut in the
+middle because the reader was slow. Plain C++*/
+
+class LogRing {
+ public:
+  /*size has to be a power of two*/
+  LogRing(uint8_t *storage, uint32_t size) : buffer(storage), mask(size - 1) {}
+
+  /*writer side, false and nothing written if len bytes don't fit*/
+  bool push(const char *data, uint32_t len);
+  /*reader side, copies out up to max bytes and returns how many*/
+  uint32_t pop(char *out, uint32_t max);
+
+  uint32_t used() const;
+  uint32_t capacity() const { return mask + 1; }
+
+ private:
+  uint8_t *buffer;
+  uint32_t mask;
+  /*free running, the difference is what's in the ring*/
+  uint32_t head = 0;
+  uint32_t tail = 0;
+};
+
+#endif
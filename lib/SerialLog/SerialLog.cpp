@@ -0,0 +1,93 @@
+#include "SerialLog.h"
+
+#include <stdarg.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "LogRing.h"
+
+static uint8_t storage[LOG_BUFFER_SIZE];
+static LogRing ring(storage, LOG_BUFFER_SIZE);
+static LogStats stats;
+static Print *output = NULL;
+static TaskHandle_t task = NULL;
+
+/*wait between looks at an empty ring*/
+#define LOG_DRAIN_MS 20
+
+static void drainTask(void *context){
+  (void)context;
+  char chunk[128];
+  for(;;){
+    uint32_t n = ring.pop(chunk, sizeof(chunk));
+    if(n == 0){
+      vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_MS));
+      continue;
+    }
+    output->write((const uint8_t *)chunk, n);
+  }
+}
+
+void logBegin(Print &out){
+  if(task != NULL){
+    return;
+  }
+  output = &out;
+  /*loop() runs on core 1. Priority 1 like the display flush, WiFi and
+  lwIP are well above*/
+  xTaskCreatePinnedToCore(drainTask, "log", 2048, NULL, 1, &task, 0);
+}
+
+static void account(bool pushed, uint32_t len, uint32_t started){
+  if(pushed){
+    stats.lines++;
+  }else{
+    stats.dropped++;
+    stats.droppedBytes += len;
+  }
+  uint32_t used = ring.used();
+  if(used > stats.highWater) stats.highWater = used;
+  uint32_t took = micros() - started;
+  if(took > stats.maxCallUs) stats.maxCallUs = took;
+}
+
+void logPrintf(const char *format, ...){
+  uint32_t started = micros();
+  char line[LOG_MAX_LINE];
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(line, sizeof(line) - 1, format, args);
+  va_end(args);
+  if(n < 0){
+    return;
+  }
+  if((size_t)n >= sizeof(line) - 1){
+    stats.truncated++;
+    n = sizeof(line) - 2;
+  }
+  line[n++] = '\n';
+  account(ring.push(line, n), n, started);
+}
+
+void logText(const char *prefix, const char *text, size_t len){
+  uint32_t started = micros();
+  size_t prefixLen = strlen(prefix);
+  uint32_t total = prefixLen + len + 1;
+  /*the three parts have to go in together, check the room first. Only
+  this task writes, so it can't shrink in between*/
+  bool fits = total <= ring.capacity() - ring.used();
+  if(fits){
+    ring.push(prefix, prefixLen);
+    ring.push(text, len);
+    ring.push("\n", 1);
+  }
+  account(fits, total, started);
+}
+
+const LogStats &logStats(){
+  return stats;
+}
+
+uint32_t logPending(){
+  return ring.used();
+}
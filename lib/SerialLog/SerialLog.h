@@ -0,0 +1,78 @@
+#ifndef SERIAL_LOG_H
+#define SERIAL_LOG_H
+
+#include <Arduino.h>
+
+/*Logging that doesn't wait for the UART. LOG_ERROR() .. LOG_DEBUG() format
+into a LogRing and return, a task on core 0 writes the ring to Serial in
+the background. A line that doesn't fit in the ring is dropped and
+counted, the caller never waits for room.
+
+Levels above LOG_LEVEL are compiled out, arguments and all, so a debug
+line costs nothing in a normal build. Set it for the whole build in
+platformio.ini, e.g. -D LOG_LEVEL=4 for debug.
+
+The ring has one writer: log from the loop task only. Answers to serial
+commands are printed straight to Serial, they were asked for*/
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+/*bytes buffered, a power of two*/
+#ifndef LOG_BUFFER_SIZE
+#define LOG_BUFFER_SIZE 4096
+#endif
+/*longer formatted lines are cut, logText() isn't*/
+#define LOG_MAX_LINE 160
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) logPrintf(__VA_ARGS__)
+#else
+#define LOG_ERROR(...) do{}while(0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(...) logPrintf(__VA_ARGS__)
+#else
+#define LOG_WARN(...) do{}while(0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) logPrintf(__VA_ARGS__)
+#else
+#define LOG_INFO(...) do{}while(0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) logPrintf(__VA_ARGS__)
+#define LOG_DEBUG_TEXT(prefix, text, len) logText(prefix, text, len)
+#else
+#define LOG_DEBUG(...) do{}while(0)
+#define LOG_DEBUG_TEXT(prefix, text, len) do{}while(0)
+#endif
+
+struct LogStats {
+  uint32_t lines;     //lines that made it into the ring
+  uint32_t dropped;   //lines that didn't fit
+  uint32_t droppedBytes;
+  uint32_t truncated; //formatted lines cut at LOG_MAX_LINE
+  uint32_t highWater; //most bytes waiting at once
+  uint32_t maxCallUs; //longest a log call took
+};
+
+/*starts the task writing to out, lines logged before are kept until then*/
+void logBegin(Print &out);
+
+/*one line, printf style, the newline is added*/
+void logPrintf(const char *format, ...) __attribute__((format(printf, 1, 2)));
+/*prefix and len bytes of text as one line, for text too long to format*/
+void logText(const char *prefix, const char *text, size_t len);
+
+const LogStats &logStats();
+uint32_t logPending();
+
+#endif
@@ -0,0 +1,91 @@
+#include "SampleFilter.h"
+
+#include <math.h>
+
+SampleFilter::SampleFilter(float measurementNoise, float processNoise, float tolerance)
+  : r(measurementNoise * measurementNoise), q(processNoise * processNoise), tolerance(tolerance){
+  x[0] = x[1] = 0;
+  p[0][0] = p[0][1] = p[1][0] = p[1][1] = 0;
+}
+
+float SampleFilter::estimate(uint32_t time) const {
+  return x[0] + x[1] * ((int32_t)(time - updatedAt) / 1000.0f);
+}
+
+float SampleFilter::update(uint32_t time, float value){
+  readings++;
+  if(!initialized){
+    initialized = true;
+    updatedAt = time;
+    x[0] = value;
+    x[1] = 0;
+    /*nothing is known about the trend yet, allow tolerance per 10 s*/
+    p[0][0] = r;
+    p[0][1] = p[1][0] = 0;
+    p[1][1] = (tolerance / 10) * (tolerance / 10);
+    return x[0];
+  }
+
+  /*predict to now*/
+  float dt = (int32_t)(time - updatedAt) / 1000.0f;
+  updatedAt = time;
+  x[0] += dt * x[1];
+  float p01 = p[0][1] + dt * p[1][1] + q * dt * dt / 2;
+  p[0][0] += dt * (p[0][1] + p[1][0]) + dt * dt * p[1][1] + q * dt * dt * dt / 3;
+  p[0][1] = p[1][0] = p01;
+  p[1][1] += q * dt;
+
+  float innovation = value - x[0];
+  errorSquares += (double)innovation * innovation;
+  errorCount++;
+
+  float s = p[0][0] + r;
+  if(innovation * innovation > 9 * s){
+    /*the model missed a change, let the rate move as fast as this jump*/
+    surprises++;
+    surprised = true;
+    float jumpRate = dt > 0 ? innovation / dt : innovation;
+    if(jumpRate * jumpRate > p[1][1]){
+      p[1][1] = jumpRate * jumpRate;
+    }
+    p[0][0] += innovation * innovation;
+    s = p[0][0] + r;
+  }
+
+  float k0 = p[0][0] / s;
+  float k1 = p[1][0] / s;
+  x[0] += k0 * innovation;
+  x[1] += k1 * innovation;
+
+  float p00 = p[0][0], p10 = p[1][0];
+  p[0][0] = (1 - k0) * p00;
+  p[0][1] = p[1][0] = (1 - k0) * p10;
+  p[1][1] -= k1 * p10;
+  return x[0];
+}
+
+void SampleFilter::miss(){
+  misses++;
+  surprised = true;
+}
+
+uint32_t SampleFilter::period(uint32_t minPeriod, uint32_t maxPeriod){
+  uint32_t next = minPeriod;
+  if(initialized && !surprised){
+    float speed = fabsf(x[1]) + sqrtf(p[1][1]);
+    float ms = speed > 0 ? tolerance / speed * 1000 : maxPeriod;
+    next = ms >= maxPeriod ? maxPeriod : (uint32_t)ms;
+    if(lastPeriod > 0 && next > 2 * lastPeriod){
+      next = 2 * lastPeriod;
+    }
+  }
+  surprised = false;
+  if(next < minPeriod) next = minPeriod;
+  if(next > maxPeriod) next = maxPeriod;
+  lastPeriod = next;
+  return next;
+}
+
+float SampleFilter::reconstructionError() const {
+  return errorCount > 0 ? sqrt(errorSquares / errorCount) : 0;
+}
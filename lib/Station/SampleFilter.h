@@ -0,0 +1,62 @@
+#ifndef SAMPLE_FILTER_H
+#define SAMPLE_FILTER_H
+
+#include <stdint.h>
+
+/*Level and trend of one sensor channel, a two state Kalman filter with a
+constant rate model. The filtered level is what the display shows, the
+trend decides how long the next reading can wait: roughly the time it
+takes the value to move by tolerance, counting the rate's own uncertainty
+so a filter that has seen little doesn't stretch the period.
+
+A reading far off the prediction (more than 3 sigma) means the model
+missed a change, the rate uncertainty is opened up so the filter catches
+up and the next reading comes as soon as allowed. Invalid readings (NaN,
+a disconnected probe) are left out and also bring the next reading
+forward.
+
+Every reading is also compared with what the filter predicted for that
+moment, which is what was shown while the sensor wasn't read. The RMS of
+those differences is the reconstruction error reported next to the
+effective sample rate*/
+class SampleFilter {
+ public:
+  /*measurementNoise is the sensor's standard deviation, processNoise how
+  fast the rate is expected to drift (units/s per sqrt(s)), tolerance how
+  far the shown value may move between readings, all in sensor units*/
+  SampleFilter(float measurementNoise, float processNoise, float tolerance);
+
+  /*folds in a reading taken at time ms, returns the filtered level*/
+  float update(uint32_t time, float value);
+  /*a reading that couldn't be used*/
+  void miss();
+  /*level predicted for time, only meaningful once valid()*/
+  float estimate(uint32_t time) const;
+  bool valid() const { return initialized; }
+  /*units per second*/
+  float rate() const { return x[1]; }
+
+  /*ms until the next reading is worth taking, within minPeriod and
+  maxPeriod and at most twice the previous period*/
+  uint32_t period(uint32_t minPeriod, uint32_t maxPeriod);
+
+  uint32_t readings = 0;
+  uint32_t misses = 0;
+  uint32_t surprises = 0;
+  uint32_t lastPeriod = 0;
+
+  /*RMS of reading minus prediction over the readings so far*/
+  float reconstructionError() const;
+
+ private:
+  float r, q, tolerance;
+  bool initialized = false;
+  bool surprised = false;
+  uint32_t updatedAt = 0;
+  float x[2];    //level, rate per second
+  float p[2][2]; //covariance
+  double errorSquares = 0;
+  uint32_t errorCount = 0;
+};
+
+#endif
@@ -0,0 +1,314 @@
+#include "Station.h"
+
+#include <math.h>
+#include <string.h>
+
+Station::Station(StationIo &io)
+  : insideTempFilter(0.05f, 0.0001f, 0.1f), humidityFilter(0.3f, 0.0003f, 1.0f),
+    outsideTempFilter(0.03f, 0.0001f, 0.1f),
+    io(io), lastInsideTemp(NAN), lastHumidity(NAN), lastOutsideTemp(NAN){
+  lastUpload = io.now();
+  startedAt = lastUpload;
+  memset(forecasts, 0, sizeof(forecasts));
+  outbound.addHost("api.openweathermap.org", 2000, 10, startedAt);
+  outbound.addHost("api.thingspeak.com", 16000, 1, startedAt);
+  outbound.maxInFlight = 1;
+  energy.begin(startedAt);
+  for(int i = 0; i < STATION_MAX_LOCATIONS; i++){
+    forecasts[i].nextFetch = startedAt;
+  }
+}
+
+void Station::runPass(){
+  uint32_t measurementStart = io.now();
+
+  /*requests go out first and are answered while the sensors are read,
+  so a slow or unreachable API doesn't stop the display*/
+  for(int host = 0; host < outbound.hostCount(); host++){
+    if(outbound.inFlight(host)){
+      collectResult(host);
+    }
+  }
+  bool connected = wifiUp();
+  if(connected){
+    link.sampleRssi(io.linkRssi(), measurementStart);
+  }
+  queueRequests(measurementStart);
+  int fetching = connected ? sendRequests(measurementStart) : -1;
+
+  measureInside(measurementStart);
+  measureOutside(measurementStart);
+  passes++;
+
+  if(!wifiUp()){
+    return;
+  }
+
+  io.sendCollectorFrame(lastOutsideTemp, lastInsideTemp, lastHumidity);
+
+  if(fetching >= 0){
+    finishFetch(fetching);
+  }
+  showForecasts();
+}
+
+/*WiFi state for the energy meter too, it only changes at these checks*/
+bool Station::wifiUp(){
+  bool connected = io.wifiConnected();
+  uint32_t now = io.now();
+  energy.set(ENERGY_WIFI_ASSOCIATED, connected, now);
+  energy.set(ENERGY_WIFI_SEARCH, !connected, now);
+  return connected;
+}
+
+/*time since start went to waiting, on screens or for the network*/
+void Station::idleSince(uint32_t start){
+  energy.add(ENERGY_CPU_IDLE, io.now() - start);
+}
+
+/*Due work is queued even while WiFi is down. An upload that is still
+waiting when the next one comes due is coalesced with it, which is
+right since the averages are taken when it's sent. On a weak link both
+wait longer, and go as soon as it is good again since the wait is worked
+out here every pass*/
+void Station::queueRequests(uint32_t now){
+  uint32_t stretch = link.stretch();
+  for(int i = 0; i < locationCount && i < STATION_MAX_LOCATIONS; i++){
+    const LocationForecast &f = forecasts[i];
+    uint32_t late = f.valid && f.failures == 0 ? (stretch - 1) * forecastRefresh : 0;
+    if((int32_t)(now - f.nextFetch) >= (int32_t)late && !outbound.queued(STATION_HOST_WEATHER, i)){
+      outbound.submit(STATION_HOST_WEATHER, STATION_PRIORITY_FORECAST, i, now);
+    }
+  }
+  if(now - lastUpload > updateInterval * stretch){
+    outbound.submit(STATION_HOST_THINGSPEAK, STATION_PRIORITY_UPLOAD, 0, now);
+    lastUpload = now;
+  }
+}
+
+/*starts whatever outbound lets go, returns the location whose forecast
+was requested or -1. One request is in flight at most, so that is never
+more than one location a pass. The firmware's own hosts are started
+through io, a request that is over as soon as it's sent frees its slot
+for the next one*/
+int Station::sendRequests(uint32_t now){
+  int fetching = -1;
+  OutboundRequest request;
+  while(outbound.next(now, request)){
+    if(request.host == STATION_HOST_THINGSPEAK){
+      startUpload();
+    }else if(request.host == STATION_HOST_WEATHER){
+      fetching = request.key;
+      io.startForecast(fetching);
+    }else{
+      int status = io.startRequest(request.host, request.key);
+      if(status != 0){
+        outbound.finished(request.host, status, -1, now);
+      }
+    }
+  }
+  return fetching;
+}
+
+void Station::collectResult(int host){
+  int32_t retryAfter = -1;
+  int status = io.requestResult(host, retryAfter);
+  if(status != 0){
+    outbound.finished(host, status, retryAfter, io.now());
+    if(host == STATION_HOST_WEATHER || host == STATION_HOST_THINGSPEAK){
+      energy.add(host == STATION_HOST_WEATHER ? ENERGY_HTTP_FORECAST : ENERGY_HTTP_UPLOAD, io.requestTime(host));
+    }
+    if(io.requestSent(host)){
+      link.request(status < 0, io.requestBytes(host), io.requestTime(host));
+    }
+  }
+}
+
+void Station::finishFetch(int location){
+  LocationForecast &f = forecasts[location];
+  ForecastSlot slots[STATION_FORECAST_SLOTS];
+  uint32_t waitStart = io.now();
+  bool fetched = io.finishForecast(slots, STATION_FORECAST_SLOTS) >= STATION_FORECAST_SLOTS;
+  idleSince(waitStart);
+  if(fetched){
+    memcpy(f.slots, slots, sizeof(slots));
+    int days = io.forecastDays(f.days, STATION_SUMMARY_DAYS);
+    f.dayCount = days > 0 ? days : 0;
+    f.valid = true;
+  }else{
+    forecastFailures++;
+  }
+  collectResult(STATION_HOST_WEATHER);
+  scheduleFetch(location, io.now(), fetched);
+}
+
+/*Location i has its own place in the refresh window, startedAt plus i
+windows/locationCount plus whole windows. After a fetch the next one is
+the first of those at least half a window away, so the first round
+fetched right after boot settles into the even spacing by itself*/
+void Station::scheduleFetch(int location, uint32_t now, bool fetched){
+  LocationForecast &f = forecasts[location];
+  if(!fetched){
+    uint32_t wait = forecastRetry;
+    for(uint8_t i = 0; i < f.failures && wait < forecastRefresh; i++){
+      wait *= 2;
+    }
+    f.nextFetch = now + (wait < forecastRefresh ? wait : forecastRefresh);
+    if(f.failures < 255) f.failures++;
+    return;
+  }
+  f.failures = 0;
+  uint32_t phase = startedAt + location * (forecastRefresh / locationCount);
+  int32_t ahead = (now + forecastRefresh / 2) - phase;
+  if(ahead < 0){
+    f.nextFetch = phase;
+  }else{
+    f.nextFetch = phase + (ahead / forecastRefresh + 1) * forecastRefresh;
+  }
+}
+
+/*next location in turn that has a forecast to show*/
+void Station::showForecasts(){
+  for(int k = 0; k < locationCount; k++){
+    int location = (shownLocation + k) % locationCount;
+    const LocationForecast &f = forecasts[location];
+    if(!f.valid){
+      continue;
+    }
+    /*the screens mostly wait out their time, drawing is counted as idle too*/
+    uint32_t showStart = io.now();
+    int perScreen = io.forecastSlotsPerScreen();
+    if(perScreen < 1){
+      perScreen = 1;
+    }
+    int screens = (STATION_FORECAST_SLOTS + perScreen - 1) / perScreen;
+    uint32_t share = (forecastShowTime + 1000) / screens;
+    for(int first = 0; first < STATION_FORECAST_SLOTS; first += perScreen){
+      int count = STATION_FORECAST_SLOTS - first < perScreen ? STATION_FORECAST_SLOTS - first : perScreen;
+      bool last = first + count == STATION_FORECAST_SLOTS;
+      io.showForecast(location, first, f.slots + first, count, last && share > 1000 ? share - 1000 : share);
+    }
+    if(f.dayCount > 0){
+      io.showSummary(location, f.days, f.dayCount, 3000);
+    }
+    idleSince(showStart);
+    shownLocation = (location + 1) % locationCount;
+    return;
+  }
+}
+
+/*hundredths for the fixed point metrics, false for NaN*/
+static bool toHundredths(float value, int32_t &out){
+  if(isnan(value) || value < -1e6f || value > 1e6f){
+    return false;
+  }
+  out = (int32_t)lroundf(value * 100);
+  return true;
+}
+
+static bool deriveFrom(float temperature, float humidity, DerivedMetrics &metrics){
+  int32_t t, rh;
+  return toHundredths(temperature, t) && toHundredths(humidity, rh) && deriveMetrics(t, rh, metrics);
+}
+
+/*With maxSamplePeriod 0 every slot reads the sensor as before*/
+bool Station::sampleDue(uint32_t nextSample, uint32_t now){
+  return maxSamplePeriod == 0 || (int32_t)(now - nextSample) >= 0;
+}
+
+/* This loop is used to measure inside temp and humidity 3 times
+between 2 second intervals and display them. DHT22 updates sensor 
+values every 2 seconds so requesting values more often would be useless.
+The sensor is only read when the filters say the value may have moved,
+in between the filtered estimate is shown and averaged instead*/
+void Station::measureInside(uint32_t &measurementStart){
+  for(int measurementCnt = 0; measurementCnt < 3; measurementCnt++){
+    uint32_t waitStart = io.now();
+    io.waitUntil(measurementStart + dhtInterval + 1);
+    idleSince(waitStart);
+
+    uint32_t now = io.now();
+    float temperature, humidity;
+    if(sampleDue(nextInsideSample, now) || !insideTempFilter.valid()){
+      io.readInside(temperature, humidity);
+      energy.add(ENERGY_DHT, io.now() - now);
+      if(isnan(temperature) || isnan(humidity)){
+        insideTempFilter.miss();
+        humidityFilter.miss();
+      }else{
+        temperature = insideTempFilter.update(now, temperature);
+        humidity = humidityFilter.update(now, humidity);
+      }
+      uint32_t temperaturePeriod = insideTempFilter.period(dhtInterval, maxSamplePeriod);
+      uint32_t humidityPeriod = humidityFilter.period(dhtInterval, maxSamplePeriod);
+      nextInsideSample = now + (temperaturePeriod < humidityPeriod ? temperaturePeriod : humidityPeriod);
+    }else{
+      temperature = insideTempFilter.estimate(now);
+      humidity = humidityFilter.estimate(now);
+      insideSkipped++;
+    }
+    measurementStart = io.now();
+    insideTempSum += temperature;
+    humiditySum += humidity;
+    insideTotalCnt++;
+    lastInsideTemp = temperature;
+    lastHumidity = humidity;
+    DerivedMetrics metrics;
+    if(deriveFrom(temperature, humidity, metrics)){
+      derived = metrics;
+      derivedValid = true;
+    }
+    if(measurementCnt == 2 && derivedValid){
+      io.showDerived(temperature, humidity, derived);
+    }else{
+      io.showInside(temperature, humidity);
+    }
+  }
+}
+
+/*This loop is used to measure outside temp 5 times with 1s intervals
+DS18B20 is capable of doing so with 12bit resolution*/
+void Station::measureOutside(uint32_t &measurementStart){
+  for(int measurementCnt = 0; measurementCnt < 5; measurementCnt++){
+    uint32_t waitStart = io.now();
+    io.waitUntil(measurementStart + dallasTempInterval + 1);
+    idleSince(waitStart);
+
+    uint32_t now = io.now();
+    float outsideTemp;
+    if(sampleDue(nextOutsideSample, now) || !outsideTempFilter.valid()){
+      outsideTemp = io.readOutside();
+      energy.add(ENERGY_DS18B20, io.now() - now);
+      if(outsideTemp <= -127){
+        outsideTempFilter.miss();
+      }else{
+        outsideTemp = outsideTempFilter.update(now, outsideTemp);
+      }
+      nextOutsideSample = now + outsideTempFilter.period(dallasTempInterval, maxSamplePeriod);
+    }else{
+      outsideTemp = outsideTempFilter.estimate(now);
+      outsideSkipped++;
+    }
+    io.showOutside(outsideTemp);
+    measurementStart = io.now();
+    outsideTempSum += outsideTemp;
+    outsideTotalCnt++;
+    lastOutsideTemp = outsideTemp;
+  }
+}
+
+void Station::startUpload(){
+  float humiditySend = humiditySum/insideTotalCnt;
+  float insideTempSend = insideTempSum/insideTotalCnt;
+  float outsideTempSend = outsideTempSum/outsideTotalCnt;
+
+  DerivedMetrics metrics;
+  bool derivedSend = deriveFrom(insideTempSend, humiditySend, metrics);
+  io.startUpload(outsideTempSend, insideTempSend, humiditySend, derivedSend ? &metrics : NULL);
+  uploads++;
+  outsideTempSum = 0;
+  insideTempSum = 0;
+  humiditySum = 0;
+  insideTotalCnt = 0;
+  outsideTotalCnt = 0;
+}
@@ -0,0 +1,229 @@
+#ifndef STATION_H
+#define STATION_H
+
+#include <stdint.h>
+#include <OutboundScheduler.h>
+#include <LinkQuality.h>
+#include <DerivedMetrics.h>
+#include <EnergyMeter.h>
+#include "SampleFilter.h"
+
+/*Station logic that used to live in loop(): sampling, averaging, forecast
+refresh and upload timing. It doesn't touch Arduino APIs directly, all
+hardware and network access goes through StationIo, so the same code runs
+on the ESP32 and under the virtual clock in tools/replay*/
+
+/*one 3-hour forecast as shown on the display*/
+struct ForecastSlot {
+  int weatherId;
+  char time[6]; //HH:MM
+  int temperature; //celsius
+};
+
+/*slots kept per location and shown every pass, -D STATION_FORECAST_SLOTS=4
+in build_flags for a full 4-up forecast screen*/
+#ifndef STATION_FORECAST_SLOTS
+#define STATION_FORECAST_SLOTS 3
+#endif
+
+/*one day of the 5 day forecast reduced to what the summary screen shows*/
+struct ForecastDay {
+  int32_t day;       //local days since 1970-01-01
+  int16_t minTemp;   //0.1 celsius
+  int16_t maxTemp;
+  int16_t weatherId; //most common condition of the day
+  uint8_t samples;   //3-hour forecasts that fell on this day
+};
+
+/*upstream hosts and request priorities in Station::outbound, uploads go
+before forecast refreshes. Hosts the firmware adds after these, the
+collector and the update server, queue as background work behind both*/
+enum StationHost { STATION_HOST_WEATHER, STATION_HOST_THINGSPEAK };
+enum StationPriority { STATION_PRIORITY_UPLOAD, STATION_PRIORITY_FORECAST, STATION_PRIORITY_BACKGROUND };
+
+#define STATION_MAX_LOCATIONS 8
+#define STATION_SUMMARY_DAYS 5
+
+/*what is kept of one location's forecast between fetches, about 120
+bytes, the response itself is never kept*/
+struct LocationForecast {
+  uint32_t nextFetch; //now() at which it is due again
+  bool valid;
+  uint8_t failures; //fetches failed in a row
+  uint8_t dayCount;
+  ForecastSlot slots[STATION_FORECAST_SLOTS];
+  ForecastDay days[STATION_SUMMARY_DAYS];
+};
+
+class StationIo {
+ public:
+  virtual ~StationIo() {}
+
+  /*milliseconds since boot*/
+  virtual uint32_t now() = 0;
+  /*returns once now() has reached deadline*/
+  virtual void waitUntil(uint32_t deadline) = 0;
+
+  virtual void readInside(float &temperature, float &humidity) = 0;
+  /*DS18B20 gives -127 when the probe doesn't answer*/
+  virtual float readOutside() = 0;
+  virtual bool wifiConnected() = 0;
+
+  /*starts the forecast request for a location, it runs in the background
+  while the station keeps sampling and drawing*/
+  virtual void startForecast(int location) = 0;
+  /*waits for the request started by startForecast() to finish, fills up to
+  count slots and returns how many were filled, or -1 if the request or
+  parsing failed. The request's own deadline bounds the wait*/
+  virtual int finishForecast(ForecastSlot *slots, int count) = 0;
+  /*daily summary of the forecast finishForecast() just read, if it had one*/
+  virtual int forecastDays(ForecastDay *days, int max) { (void)days; (void)max; return 0; }
+  /*starts an upload and returns, it completes in the background. derived
+  is NULL when the averages had no valid inside reading*/
+  virtual void startUpload(float outsideTemp, float insideTemp, float humidity,
+                           const DerivedMetrics *derived) = 0;
+  /*0 while the last request to a StationHost is still running, then its
+  HTTP status, or a negative number if there was no answer. retryAfter
+  gets the answer's Retry-After in seconds, -1 if it had none*/
+  virtual int requestResult(int host, int32_t &retryAfter) = 0;
+  /*ms the radio spent on the last finished request to host*/
+  virtual uint32_t requestTime(int host) { (void)host; return 0; }
+  /*bytes it sent and received, 0 if not known*/
+  virtual uint32_t requestBytes(int host) { (void)host; return 0; }
+  /*false if it never went out, like uploads without an API key*/
+  virtual bool requestSent(int host) { (void)host; return true; }
+  /*sends what outbound let go on a host that isn't a StationHost, one the
+  firmware added itself. Returns like requestResult(): 0 if it goes on in
+  the background, otherwise how it ended, right away for a datagram*/
+  virtual int startRequest(int host, uint16_t key) { (void)host; (void)key; return -1; }
+  /*signal strength of the WiFi link in dBm, 0 if not known*/
+  virtual int linkRssi() { return 0; }
+  virtual void sendCollectorFrame(float outsideTemp, float insideTemp, float humidity) = 0;
+
+  virtual void showInside(float temperature, float humidity) = 0;
+  /*the last inside slot of a pass, dew point and the rest worked out
+  from the reading. Displays without room for them show the reading*/
+  virtual void showDerived(float temperature, float humidity, const DerivedMetrics &metrics){
+    (void)metrics;
+    showInside(temperature, humidity);
+  }
+  virtual void showOutside(float temperature) = 0;
+  /*how many forecast slots one screen has room for*/
+  virtual int forecastSlotsPerScreen() { return 1; }
+  /*shows count slots of a location side by side, slot number first and
+  the ones after it, and returns after durationMs*/
+  virtual void showForecast(int location, int first, const ForecastSlot *slots, int count, uint32_t durationMs) = 0;
+  /*shows the daily summary of a location and returns after durationMs*/
+  virtual void showSummary(int location, const ForecastDay *days, int count, uint32_t durationMs){
+    (void)location; (void)days; (void)count; (void)durationMs;
+  }
+};
+
+class Station {
+ public:
+  explicit Station(StationIo &io);
+
+  /*one pass of the old loop(): 3 inside readings, 5 outside readings,
+  the forecast of the next location and upload when it's time*/
+  void runPass();
+
+  /*Forecast locations, shown one per pass in turn. Every location is
+  fetched once per forecastRefresh and the fetches are spread evenly over
+  it, location i at i/locationCount of the window, so there is never
+  more than one request at a time. A failed fetch is retried after
+  forecastRetry, doubled for every further failure up to forecastRefresh,
+  and the last good forecast is shown meanwhile. At most
+  STATION_MAX_LOCATIONS*/
+  int locationCount = 1;
+  uint32_t forecastRefresh = 600000; //OpenWeather updates every 10 minutes
+  uint32_t forecastRetry = 60000;
+  /*the forecast screens of a pass share this. The last one is a second
+  shorter, it stays up while the next pass reads the inside sensor*/
+  uint32_t forecastShowTime = 5000;
+
+  /*intervals for timers. updateInterval defines in which interval sensor
+  readings are updated to ThingsSpeak, dhtInterval rate of dht measurements
+  and dallasTempInterval rate of DS18B20 measurements. Loop takes 17s to get
+  to update sequence so any interval under that is good as nothing. ThingsSpeak
+  doesn't allow more than 1 request /15s for free subscription, outbound
+  holds uploads back to that whatever the interval*/
+  uint32_t updateInterval = 600000; //10 minutes
+  uint32_t dhtInterval = 2000;
+  uint32_t dallasTempInterval = 1000;
+
+  /*Adaptive sampling. The measurement slots keep their timing, but a
+  sensor is only read when its filter expects the value to have moved by
+  the filter's tolerance, at most every dhtInterval / dallasTempInterval
+  and at least every maxSamplePeriod. Slots in between show and average
+  the filtered estimate. 0 reads the sensors on every slot*/
+  uint32_t maxSamplePeriod = 60000;
+  /*DHT22 temperature and humidity, DS18B20. Tolerances 0.1 C and 1 %*/
+  SampleFilter insideTempFilter, humidityFilter, outsideTempFilter;
+  /*slots served from the filters instead of the sensor*/
+  uint32_t insideSkipped = 0, outsideSkipped = 0;
+
+  /*worked out from every inside reading, valid is false until there
+  has been one with a number in it*/
+  DerivedMetrics derived;
+  bool derivedValid = false;
+
+  /*on-time of everything that draws current, counted from construction.
+  Station sees the sensors, waits, WiFi state and requests, the firmware
+  adds what only it knows about (initial WiFi connect, collector frames)*/
+  EnergyMeter energy;
+
+  /*counters that tools/replay reports*/
+  uint32_t passes = 0;
+  uint32_t forecastFailures = 0;
+  uint32_t uploads = 0;
+
+  /*every request goes through here. ThingSpeak gets one token per 16 s, a
+  second more than its free tier limit so the request still arrives late
+  enough. OpenWeatherMap free allows 60 calls a minute, a token per 2 s
+  with 10 saved up stays well under that. Only one request is in flight
+  at a time over all hosts, so when several are due the priorities decide
+  which one gets the radio: an upload, then a forecast, then background
+  work. An upload that is still running keeps a due forecast back until
+  the next pass, which is what putting uploads first means*/
+  OutboundScheduler outbound;
+
+  /*On a fair or poor link uploads are due link.stretch() times
+  updateInterval apart and average that many more passes, a location with
+  a good forecast waits the same factor of forecastRefresh, and the
+  firmware packs link.batch() collector frames into a datagram. Missing
+  forecasts and retries aren't held back*/
+  LinkQuality link;
+
+ private:
+  StationIo &io;
+
+  /*total counts of inside temp and humidity and outside temp measured
+  between updating data to cloud*/
+  int insideTotalCnt = 0, outsideTotalCnt = 0;
+
+  /*variables to hold temporary data*/
+  float outsideTempSum = 0, insideTempSum = 0, humiditySum = 0;
+  float lastInsideTemp, lastHumidity, lastOutsideTemp;
+
+  uint32_t lastUpload;
+  uint32_t nextInsideSample = 0, nextOutsideSample = 0;
+
+  uint32_t startedAt;
+  LocationForecast forecasts[STATION_MAX_LOCATIONS];
+  int shownLocation = 0;
+
+  bool wifiUp();
+  void idleSince(uint32_t start);
+  void queueRequests(uint32_t now);
+  int sendRequests(uint32_t now);
+  void collectResult(int host);
+  void finishFetch(int location);
+  void scheduleFetch(int location, uint32_t now, bool fetched);
+  void showForecasts();
+  bool sampleDue(uint32_t nextSample, uint32_t now);
+  void measureInside(uint32_t &measurementStart);
+  void measureOutside(uint32_t &measurementStart);
+  void startUpload();
+};
+
+#endif
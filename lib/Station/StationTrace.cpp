@@ -0,0 +1,74 @@
+#include "StationTrace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int formatTraceRecord(const TraceRecord &record, char *buf, size_t len){
+  unsigned long time = record.time, duration = record.duration;
+
+  switch(record.kind){
+    case TRACE_DHT:
+      return snprintf(buf, len, STATION_TRACE_PREFIX " %lu DHT %.2f %.2f %lu",
+                      time, record.temperature, record.humidity, duration);
+    case TRACE_DS:
+      return snprintf(buf, len, STATION_TRACE_PREFIX " %lu DS %.2f %lu",
+                      time, record.temperature, duration);
+    case TRACE_UPLOAD:
+      return snprintf(buf, len, STATION_TRACE_PREFIX " %lu UP %d %lu",
+                      time, record.result, duration);
+    case TRACE_FORECAST:
+      break;
+  }
+
+  int n = snprintf(buf, len, STATION_TRACE_PREFIX " %lu FC %d %lu", time, record.result, duration);
+  for(int i = 0; i < record.result && i < STATION_FORECAST_SLOTS && n >= 0 && (size_t)n < len; i++){
+    const ForecastSlot &slot = record.slots[i];
+    n += snprintf(buf + n, len - n, " %d %s %d", slot.weatherId, slot.time, slot.temperature);
+  }
+  return n;
+}
+
+bool parseTraceRecord(const char *line, TraceRecord &record){
+  const char *p = strstr(line, STATION_TRACE_PREFIX " ");
+  if(p == NULL){
+    return false;
+  }
+  p += strlen(STATION_TRACE_PREFIX) + 1;
+
+  memset(&record, 0, sizeof(record));
+  unsigned long time, duration;
+  char kind[4];
+  int used = 0;
+  if(sscanf(p, "%lu %3s %n", &time, kind, &used) != 2){
+    return false;
+  }
+  record.time = time;
+  p += used;
+
+  if(strcmp(kind, "DHT") == 0){
+    record.kind = TRACE_DHT;
+    if(sscanf(p, "%f %f %lu", &record.temperature, &record.humidity, &duration) != 3) return false;
+  }else if(strcmp(kind, "DS") == 0){
+    record.kind = TRACE_DS;
+    if(sscanf(p, "%f %lu", &record.temperature, &duration) != 2) return false;
+  }else if(strcmp(kind, "UP") == 0){
+    record.kind = TRACE_UPLOAD;
+    if(sscanf(p, "%d %lu", &record.result, &duration) != 2) return false;
+  }else if(strcmp(kind, "FC") == 0){
+    record.kind = TRACE_FORECAST;
+    if(sscanf(p, "%d %lu %n", &record.result, &duration, &used) != 2) return false;
+    p += used;
+    for(int i = 0; i < record.result && i < STATION_FORECAST_SLOTS; i++){
+      ForecastSlot &slot = record.slots[i];
+      if(sscanf(p, "%d %5s %d %n", &slot.weatherId, slot.time, &slot.temperature, &used) != 3){
+        return false;
+      }
+      p += used;
+    }
+  }else{
+    return false;
+  }
+  record.duration = duration;
+  return true;
+}
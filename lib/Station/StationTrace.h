@@ -0,0 +1,47 @@
+#ifndef STATION_TRACE_H
+#define STATION_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Station.h"
+
+/*Trace of what the station saw, one line per sensor read or HTTP request.
+Built with STATION_TRACE the firmware prints these to Serial next to its
+normal output, tools/replay picks out the lines starting with "@T" and feeds
+them back through Station under a virtual clock.
+
+  @T <ms> DHT <temperature> <humidity> <duration>
+  @T <ms> DS <temperature> <duration>
+  @T <ms> FC <result> <duration> [<id> <HH:MM> <temperature>]...
+  @T <ms> UP <code> <duration>
+
+<ms> is millis() when the operation started, <duration> how long it took.
+For FC <result> is the number of forecast slots or -1 on failure*/
+
+#define STATION_TRACE_PREFIX "@T"
+
+enum TraceKind {
+  TRACE_DHT,
+  TRACE_DS,
+  TRACE_FORECAST,
+  TRACE_UPLOAD
+};
+
+struct TraceRecord {
+  TraceKind kind;
+  uint32_t time;
+  uint32_t duration;
+  float temperature;
+  float humidity;
+  int result;
+  ForecastSlot slots[STATION_FORECAST_SLOTS];
+};
+
+/*returns the length written like snprintf*/
+int formatTraceRecord(const TraceRecord &record, char *buf, size_t len);
+
+/*returns false for lines that aren't trace records*/
+bool parseTraceRecord(const char *line, TraceRecord &record);
+
+#endif
@@ -0,0 +1,68 @@
+#include "StationFrame.h"
+
+static void put16(uint8_t *p, uint16_t v){
+  p[0] = v & 0xFF;
+  p[1] = v >> 8;
+}
+
+static void put32(uint8_t *p, uint32_t v){
+  put16(p, v & 0xFFFF);
+  put16(p + 2, v >> 16);
+}
+
+static uint16_t get16(const uint8_t *p){
+  return p[0] | (p[1] << 8);
+}
+
+static uint32_t get32(const uint8_t *p){
+  return get16(p) | ((uint32_t)get16(p + 2) << 16);
+}
+
+uint16_t stationFrameCrc(const uint8_t *data, size_t len){
+  uint16_t crc = 0xFFFF;
+  for(size_t i = 0; i < len; i++){
+    crc ^= (uint16_t)data[i] << 8;
+    for(int bit = 0; bit < 8; bit++){
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+size_t encodeStationFrame(const StationFrame &frame, uint8_t *out){
+  put16(out, STATION_FRAME_MAGIC);
+  out[2] = STATION_FRAME_VERSION;
+  out[3] = frame.flags;
+  put32(out + 4, frame.stationId);
+  put32(out + 8, frame.sequence);
+  put16(out + 12, (uint16_t)frame.outsideTemp);
+  put16(out + 14, (uint16_t)frame.insideTemp);
+  put16(out + 16, frame.humidity);
+  put16(out + 18, stationFrameCrc(out, 18));
+  return STATION_FRAME_SIZE;
+}
+
+bool decodeStationFrame(const uint8_t *in, size_t len, StationFrame &frame){
+  if(len != STATION_FRAME_SIZE || get16(in) != STATION_FRAME_MAGIC || in[2] != STATION_FRAME_VERSION){
+    return false;
+  }
+  if(get16(in + 18) != stationFrameCrc(in, 18)){
+    return false;
+  }
+  frame.flags = in[3];
+  frame.stationId = get32(in + 4);
+  frame.sequence = get32(in + 8);
+  frame.outsideTemp = (int16_t)get16(in + 12);
+  frame.insideTemp = (int16_t)get16(in + 14);
+  frame.humidity = get16(in + 16);
+  return true;
+}
+
+bool toCentiUnits(float value, int16_t &out){
+  /*NaN fails both comparisons so it ends up here too*/
+  if(!(value > -327.0f && value < 327.0f)){
+    return false;
+  }
+  out = (int16_t)(value >= 0 ? value * 100.0f + 0.5f : value * 100.0f - 0.5f);
+  return true;
+}
@@ -0,0 +1,55 @@
+#ifndef STATION_FRAME_H
+#define STATION_FRAME_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*Compact binary frame that stations send to the fleet collector over UDP.
+Everything is little endian and temperatures and humidity are sent as
+hundredths, so one reading is 20 bytes on the wire instead of a ThingSpeak
+query string. Layout:
+
+  0  magic     uint16  0x5753 ("WS")
+  2  version   uint8
+  3  flags     uint8   STATION_FRAME_* bits below
+  4  stationId uint32
+  8  sequence  uint32  increments every frame, collector uses it to count losses
+  12 outside   int16   0.01 C
+  14 inside    int16   0.01 C
+  16 humidity  uint16  0.01 %
+  18 crc16     uint16  CRC-16/CCITT-FALSE over bytes 0..17 */
+
+#define STATION_FRAME_MAGIC 0x5753
+#define STATION_FRAME_VERSION 1
+#define STATION_FRAME_SIZE 20
+/*a datagram carries up to this many frames back to back*/
+#define STATION_FRAME_MAX_BATCH 8
+
+/*flag bits telling which values were valid when the frame was built*/
+#define STATION_FRAME_HAS_OUTSIDE 0x01
+#define STATION_FRAME_HAS_INSIDE 0x02
+#define STATION_FRAME_HAS_HUMIDITY 0x04
+
+struct StationFrame {
+  uint8_t flags;
+  uint32_t stationId;
+  uint32_t sequence;
+  int16_t outsideTemp;
+  int16_t insideTemp;
+  uint16_t humidity;
+};
+
+/*writes frame to out, which must hold STATION_FRAME_SIZE bytes.
+Returns number of bytes written*/
+size_t encodeStationFrame(const StationFrame &frame, uint8_t *out);
+
+/*returns false if length, magic, version or checksum doesn't match*/
+bool decodeStationFrame(const uint8_t *in, size_t len, StationFrame &frame);
+
+/*converts a float reading to hundredths, NaN and out of range values
+return false so the caller can leave the flag bit unset*/
+bool toCentiUnits(float value, int16_t &out);
+
+uint16_t stationFrameCrc(const uint8_t *data, size_t len);
+
+#endif
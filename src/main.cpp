@@ -2,16 +2,37 @@
 #include <SPI.h>
 #include <Wire.h>
 #include <Adafruit_GFX.h>
-#include <Adafruit_SH1106.h>
 #include <DHT.h>
 #include <Adafruit_Sensor.h>
 #include <OneWire.h>
 #include <DallasTemperature.h>
-#include <elapsedMillis.h>
 #include <Arduino_JSON.h>
+#include <cjson/cJSON.h>
+#include <esp_heap_caps.h>
 #include <WiFi.h>
-#include <HTTPClient.h>
-#include <Icons.h>
+#include <WiFiUdp.h>
+#include <Screens.h>
+#include <ScreenCache.h>
+#include <StationFrame.h>
+#include <Station.h>
+#include <ForecastStream.h>
+#include <StationTrace.h>
+#include <HeapStats.h>
+#include <AsyncHttp.h>
+#include <JsonArena.h>
+#include <GzipInflater.h>
+#include <SerialLog.h>
+#include <FlightRecorder.h>
+#include <I2cBus.h>
+#include <DhtSensor.h>
+#include <Ds18b20Sensor.h>
+#include <Sht31Sensor.h>
+#include <Bme280Sensor.h>
+#include <WireOledBus.h>
+#include <BufferedDisplay.h>
+#include <DisplayPower.h>
+#include <DeltaOta.h>
+#include <UpstreamCerts.h>
 #include <config.h>
 
 #define OLED_SDA 21
@@ -29,547 +50,1603 @@ const char* ssid = MY_SSID;
 const char* password = MY_PASSWORD;
 
 String weatherApiKey = MY_WEATHER_APIKEY;
+
+/*ThingSpeak is optional when readings go to the fleet collector instead,
+leave MY_THINGS_APIKEY undefined in config.h to stop uploading there*/
+#ifdef MY_THINGS_APIKEY
 String thingsApiKey = MY_THINGS_APIKEY;
+#endif
+
+/*Both upstreams are reached over HTTPS. Point these at a local server to
+compare full and resumed handshakes, see the README. Servers are checked
+against the roots in lib/Certs, or against the PEM certificates in
+TLS_CA_CERTS if config.h defines it. When those don't parse no https
+request goes out at all*/
+#ifndef WEATHER_SERVER
+#define WEATHER_SERVER "https://api.openweathermap.org"
+#endif
+#ifndef THINGSPEAK_SERVER
+#define THINGSPEAK_SERVER "https://api.thingspeak.com"
+#endif
+#ifndef TLS_CA_CERTS
+#define TLS_CA_CERTS upstreamCaCerts
+#endif
+
+/*handshakes per host, full and resumed, for the t command*/
+struct TlsStats {
+  uint32_t count[2];
+  uint32_t totalMs[2];
+  uint32_t maxMs[2];
+  uint32_t maxHeap[2];
+  uint32_t failed;
+};
+TlsStats tlsStats[OUTBOUND_MAX_HOSTS];
+
+/*The energy estimate's current model, see lib/Energy/EnergyMeter.h for
+the uses and defaults. Measure the board and list what differs in
+config.h, e.g.
+#define ENERGY_CURRENT_MODEL {"board", 4}, {"oled", 14}*/
+struct CurrentModelEntry {
+  const char *use;
+  float milliamps;
+};
+#ifdef ENERGY_CURRENT_MODEL
+const CurrentModelEntry currentModel[] = { ENERGY_CURRENT_MODEL };
+#endif
+
+/*Define COLLECTOR_HOST in config.h to send every measurement round as a
+20 byte StationFrame over UDP to the collector in tools/collector*/
+#ifndef COLLECTOR_PORT
+#define COLLECTOR_PORT 4210
+#endif
 
-String httpGETRequest(const char* serverName);
 void displayInsideTemp(float insideTemp, float hum);
 void displayOutsideTemp(float outsideTemp);
-void displayFirstForecast(int forecastInterval, int weatherID, const char * time_1, int temperature1);
-void displaySecondForecast(int forecastInterval, int weatherID, const char * time_2, int temperature2);
-void displayThirdForecast(int forecastInterval, int weatherID, const char * time_3, int temperature3);
-bool inRange(int val, int min, int max);
-
-String city = "Helsinki";
-String countryCode = "FI";
-
-/*defines how many 3-hour forecasts are requested from API.
-Note that changing this value has effect on displaying forecast*/
-int timeStamps = 3; 
-
-/*intervals for timers. Updateinterval defines in which interval sensor
-readings are updated to ThingsSpeak, dhtInterval rate of dht measurements
-and dallasTempInterval rate of DS18B20 measurements. Loop takes 17s to get
-to update sequence so any interval under that is good as nothing. Also ThingsSpeak
-doesn't allow more than 1 request /15s anyways for free subscription*/
-int updateInterval = 600000; //10 minutes
-int dhtInterval = 2000; 
-int dallasTempInterval = 1000;
-
-/*variables to hold counters for measurements done in loop, total counts of
-inside temp and humidity and outside temp measured between updating data to cloud*/
-int measurementCnt = 0, insideTotalCnt = 0, outsideTotalCnt = 0;
-
-/*variables to hold temporary data and data to send*/
-float outsideTempSum = 0, insideTempSum = 0, humiditySum = 0,
-      outsideTempSend, insideTempSend, humiditySend;
+void displayForecast(int forecastInterval, const ForecastSlot *slots, int count, const char *place = NULL);
+int parseForecast(ForecastSlot *slots, int count);
+int readForecast(ForecastSlot *slots, int count);
+void printJsonStats();
+void countTransfer(const AsyncHttpRequest &request);
+void printTransferStats();
+void printLogStats();
+void printFlightRecorder();
+void beginSensors();
+void serviceSensors();
+void printSensors();
+void beginDisplayPower();
+int localMinute();
+void printDisplayPower();
+void printScreenCache();
+void beginOta();
+void serviceOta();
+void confirmFirmware();
+void printOta();
+void wifiEvent(arduino_event_id_t event, arduino_event_info_t info);
+void serviceRequests();
+void printRequestResult(const AsyncHttpRequest &request);
+int requestResult(const AsyncHttpRequest &request);
+void countHandshake(int host, const AsyncHttpRequest &request);
+void printTlsStats();
+void sendCollectorFrame(float outsideTemp, float insideTemp, float humidity);
+int sendCollectorBatch();
+int startOta();
+void traceRecord(const TraceRecord &record);
+void handleSerialCommands();
+void printOutboundStats();
+void printLinkStats();
+void printSamplingStats();
+void printDerivedMetrics();
+void printEnergy();
+void applyCurrentModel();
+uint32_t clockUs();
+
+/*places whose forecast is shown, one per pass in turn. Define
+FORECAST_LOCATIONS in config.h to show more than one, e.g.
+#define FORECAST_LOCATIONS {"Helsinki", "FI"}, {"Oulu", "FI"}
+Each one costs a LocationForecast in Station and one request per
+10 minutes, spread evenly over that time*/
+struct Location {
+  const char *city;
+  const char *countryCode;
+};
+#ifndef FORECAST_LOCATIONS
+#define FORECAST_LOCATIONS {"Helsinki", "FI"}
+#endif
+const Location locations[] = { FORECAST_LOCATIONS };
+const int locationCount = sizeof(locations) / sizeof(locations[0]);
+
+/*How the forecast slots share the screen: FORECAST_LAYOUT_1UP shows them
+one by one with the big icons, FORECAST_LAYOUT_3UP all three in one
+frame and FORECAST_LAYOUT_4UP four narrower ones. Add
+-D STATION_FORECAST_SLOTS=4 to build_flags to fill the 4-up screen,
+that many 3-hour forecasts are requested from the API*/
+#ifndef FORECAST_LAYOUT
+#define FORECAST_LAYOUT FORECAST_LAYOUT_3UP
+#endif
+
+#ifndef FORECAST_SUMMARY
+int timeStamps = STATION_FORECAST_SLOTS;
+#else
+/*Define FORECAST_SUMMARY in config.h to request the whole 5 day forecast
+and show a daily summary after the three slots. The answer is ~16 kB, so
+instead of buffering and parsing it, ForecastStream reads it as it
+arrives and keeps only the slots and the days. FORECAST_UTC_OFFSET is the
+local time offset in seconds until the first answer has told it*/
+int timeStamps = 40;
+#ifndef FORECAST_UTC_OFFSET
+#define FORECAST_UTC_OFFSET 0
+#endif
+ForecastStream forecastStream(FORECAST_UTC_OFFSET);
+ForecastSlot streamedSlots[STATION_FORECAST_SLOTS];
+#endif
 
 String jsonBuffer;
 
+/*The forecast's cJSON tree is built in jsonArena and dropped in one go
+after the slots have been read. JSON_ARENA_FACTOR is arena bytes per byte
+of answer, the tree takes about 3.6. Define JSON_NO_ARENA in config.h to
+parse with malloc() like before, the j command shows both the same way*/
+#ifndef JSON_ARENA_FACTOR
+#define JSON_ARENA_FACTOR 4
+#endif
+JsonArena jsonArena;
+
+struct JsonParseStats {
+  uint32_t totalUs, maxUs;
+  uint32_t minLargestBlock; //largest free heap block after a parse, lowest seen
+};
+JsonParseStats jsonStats = {0, 0, UINT32_MAX};
+
+/*The forecast is asked for with Accept-Encoding: gzip. It's the same keys
+over and over and comes in at a tenth of the size, so the radio is on for
+less time. The answer is inflated as it arrives into the same parser
+callbacks, GZIP_WINDOW is how far back the inflater can reach. The whole
+answer is always enough, which is about 1.3 kB for 3 slots and 16 kB for
+FORECAST_SUMMARY's 40. If a server reaches further the request fails and
+the forecast is asked for uncompressed from then on. Define
+FORECAST_NO_GZIP in config.h to always ask for plain JSON, the z command
+shows both the same way*/
+#ifndef FORECAST_NO_GZIP
+#ifndef GZIP_WINDOW
+#ifdef FORECAST_SUMMARY
+#define GZIP_WINDOW 16384
+#else
+#define GZIP_WINDOW 2048
+#endif
+#endif
+uint8_t gzipWindow[GZIP_WINDOW];
+GzipInflater gzipInflater(gzipWindow, GZIP_WINDOW);
+bool gzipForecast = true;
+uint32_t gzipFarthest = 0;
+#endif
+
+struct TransferStats {
+  uint32_t fetches;
+  uint64_t wireBytes, bodyBytes;
+  uint64_t totalMs;
+};
+TransferStats transferStats[2]; //plain, gzip
+
+void *jsonMalloc(size_t size){
+  return jsonArena.allocate(size);
+}
+
+void jsonFree(void *ptr){
+  jsonArena.release(ptr);
+}
+
+/*every HTTP request has to finish within this many milliseconds. The
+forecast is requested at the start of a pass and the upload at the end, so
+both run while the sensors are read and a dead API costs no display time*/
+#define HTTP_REQUEST_TIMEOUT 10000
+
 /*creating instances of sensors and timers*/
 OneWire oneWire(oneWireBus);
 DallasTemperature outTempSens(&oneWire);
 DHT dht(DHTPIN, DHTTYPE); //init DHT22 sensor
-elapsedMillis displayTimer; //timer for each diplay item
-elapsedMillis measurementTimer; //timer for each temp request from DS18B20
-elapsedMillis updateSensorsTime; //Timer for HTTP POST requests
-
-HTTPClient http;
-
-Adafruit_SH1106 display(OLED_SDA, OLED_SCL); //construct a display object
-
-
-void setup()   {                
-  Serial.begin(115200);
-  /* initialize OLED with I2C address 0x3C */
-  display.begin(SH1106_SWITCHCAPVCC, 0x3C); 
-  display.clearDisplay();
-  delay(2000);
-
-  display.setTextSize(1);
-  display.setTextColor(WHITE);
-
-  dht.begin();
-  outTempSens.begin();
-  outTempSens.setResolution(12); //Setting outside temperature to use 12bit resolution. 
 
-  WiFi.begin(ssid, password);
-  Serial.print("Connecting...");
-  
-  while(WiFi.status() != WL_CONNECTED){
-    display.setCursor(0,0);
-    display.setTextSize(1);
-    display.print("Connecting...");
-    display.drawBitmap(30, 10,  wifi_icon, wifi_icon_width, wifi_icon_height, 1);
-    display.display();
-    delay(500);
-    Serial.print(".");
+/*Every sensor is a Sensor, so they can be swapped in config.h. I2C
+sensors share the display's bus (OLED_SDA/OLED_SCL) through i2cBus and
+are enabled with their address:
+#define SENSOR_SHT31 0x44
+#define SENSOR_BME280 0x76
+INSIDE_SENSOR picks the one giving the inside temperature and humidity,
+e.g. #define INSIDE_SENSOR sht31Sensor, the DHT22 by default. The others
+are measured in the background every EXTRA_SENSOR_PERIOD ms, the b
+command shows their last readings, and a BME280's pressure goes to
+ThingSpeak as field8*/
+I2cBus i2cBus(Wire);
+DhtSensor dhtSensor(dht);
+Ds18b20Sensor outsideSensor(outTempSens);
+#ifdef SENSOR_SHT31
+Sht31Sensor sht31Sensor(i2cBus, SENSOR_SHT31);
+#endif
+#ifdef SENSOR_BME280
+Bme280Sensor bme280Sensor(i2cBus, SENSOR_BME280);
+#endif
+#ifndef INSIDE_SENSOR
+#define INSIDE_SENSOR dhtSensor
+#endif
+Sensor &insideSensor = INSIDE_SENSOR;
+
+#ifndef EXTRA_SENSOR_PERIOD
+#define EXTRA_SENSOR_PERIOD 30000
+#endif
+struct ExtraSensor {
+  Sensor *sensor;
+  bool present, measuring;
+  uint32_t startedAt, readAt;
+  uint32_t failures;
+  SensorReading reading;
+};
+/*the inside sensor is skipped here*/
+ExtraSensor extraSensors[] = {
+  {&dhtSensor},
+#ifdef SENSOR_SHT31
+  {&sht31Sensor},
+#endif
+#ifdef SENSOR_BME280
+  {&bme280Sensor},
+#endif
+};
+float pressure = NAN; //hPa, the last one any sensor gave
+
+AsyncHttpRequest forecastRequest;
+AsyncHttpRequest uploadRequest;
+bool uploadPending = false;
+WiFiUDP collectorUdp;
+uint32_t collectorSequence = 0;
+/*frames waiting for a datagram while the link is weak*/
+uint8_t collectorBatch[STATION_FRAME_MAX_BATCH * STATION_FRAME_SIZE];
+uint8_t collectorPending = 0;
+/*the collector and the update server in station.outbound, -1 when off*/
+int collectorHost = -1;
+int otaHost = -1;
+
+/*construct a display object. Drawing goes to a buffer in RAM and a
+background task sends changed frames to the panel at most OLED_MAX_FPS
+times per second*/
+#define OLED_MAX_FPS 20
+/*screen changes scroll in through the controller start line,
+OLED_TRANSITION_PX pixels every OLED_TRANSITION_MS*/
+#ifndef OLED_TRANSITION_PX
+#define OLED_TRANSITION_PX 4
+#endif
+#ifndef OLED_TRANSITION_MS
+#define OLED_TRANSITION_MS 15
+#endif
+WireOledBus oledBus(i2cBus, 0x3C);
+Sh1106 oledPanel(oledBus);
+BufferedDisplay display(oledPanel);
+
+/*Frames already drawn, see lib/Screens/ScreenCache.h. Define
+SCREEN_CACHE_FRAMES in build_flags for more than one forecast location*/
+ScreenCache screenCache;
+
+/*draws a screen into the back buffer and publishes it. When key is the
+same as the last time the frame comes from the cache and draw isn't run*/
+template <typename Draw> void displayCached(const ScreenKey &key, Draw draw){
+  uint32_t started = clockUs();
+  if(screenCache.fetch(key, display.getBuffer())){
+    display.markChanged();
+    screenCache.countHit(key.kind(), clockUs() - started);
+  }else{
+    draw();
+    screenCache.countMiss(key.kind(), clockUs() - started);
+    screenCache.store(key, display.getBuffer());
   }
-  display.clearDisplay();
-  display.drawBitmap(30, 10,  wifi_icon, wifi_icon_width, wifi_icon_height, 1);
-  display.setCursor(0,0);
-  display.print("Connected!");
   display.display();
-  Serial.println("");
-  Serial.print("Connected to WiFi network with IP Address: ");
-  Serial.println(WiFi.localIP());
-  delay(1000);
 }
 
-void loop() { 
-  /* TODO!
-
-  Make timer for API calls! Now they are requested every 15s,
-  but OpenWeather only updates them every 10 minutes!
-  
-  */
-  measurementTimer = 0;
-
-  /* This loop is used to measure inside temp and humidity 3 times
-  between 2 second intervals and display them. DHT22 updates sensor 
-  values every 2 seconds so requesting values more often would be useless*/
-
-  while(measurementCnt<3){
-
-    if(measurementTimer > dhtInterval){
-      float humidity = dht.readHumidity();
-      float temperature = dht.readTemperature();
-      measurementCnt++;
-      measurementTimer = 0; 
-      insideTempSum += temperature;
-      humiditySum += humidity;
-      insideTotalCnt++;
-      displayInsideTemp(temperature, humidity);
-
-      if(isnan(humidity) || isnan(temperature)){
-        Serial.println("Failed to read from DHT sensor!");
-      }  
+/*Display power, see lib/DisplayPower/DisplayPower.h. Times are local
+hhmm, the clock is set over NTP for the POSIX time zone DISPLAY_TZ. The
+panel is off from DISPLAY_NIGHT_FROM to DISPLAY_NIGHT_UNTIL and at
+DISPLAY_DIM_CONTRAST from DISPLAY_DIM_FROM to DISPLAY_DIM_UNTIL.
+DISPLAY_WAKE_PIN is a button to ground, or with DISPLAY_WAKE_LEVEL HIGH a
+PIR motion sensor. It turns the panel on for DISPLAY_WAKE_MS at night,
+and with one the panel also goes off after DISPLAY_IDLE_MS without
+anybody around during the day. DISPLAY_LIGHT_PIN is an analog light
+sensor (an LDR divider) that the contrast follows instead of the clock,
+DISPLAY_LIGHT_DARK and DISPLAY_LIGHT_BRIGHT are its readings in a dark
+and a bright room. The picture moves a pixel every DISPLAY_SHIFT_MS, 0
+keeps it still. Set DISPLAY_NIGHT_FROM and DISPLAY_NIGHT_UNTIL equal to
+keep the panel on all night*/
+#ifndef DISPLAY_TZ
+#define DISPLAY_TZ "EET-2EEST,M3.5.0/3,M10.5.0/4"
+#endif
+#ifndef DISPLAY_NIGHT_FROM
+#define DISPLAY_NIGHT_FROM 2300
+#define DISPLAY_NIGHT_UNTIL 600
+#endif
+#ifndef DISPLAY_DIM_FROM
+#define DISPLAY_DIM_FROM 2000
+#define DISPLAY_DIM_UNTIL 800
+#endif
+#ifndef DISPLAY_CONTRAST
+#define DISPLAY_CONTRAST SH1106_DEFAULT_CONTRAST
+#endif
+#ifndef DISPLAY_DIM_CONTRAST
+#define DISPLAY_DIM_CONTRAST 0x10
+#endif
+#ifndef DISPLAY_WAKE_LEVEL
+#define DISPLAY_WAKE_LEVEL LOW
+#endif
+#ifndef DISPLAY_WAKE_MS
+#define DISPLAY_WAKE_MS 30000
+#endif
+#ifndef DISPLAY_IDLE_MS
+#define DISPLAY_IDLE_MS 300000
+#endif
+#ifndef DISPLAY_LIGHT_DARK
+#define DISPLAY_LIGHT_DARK 100
+#define DISPLAY_LIGHT_BRIGHT 2000
+#endif
+#ifndef DISPLAY_SHIFT_MS
+#define DISPLAY_SHIFT_MS 60000
+#endif
+DisplayPower displayPower;
+
+/*Firmware updates as binary deltas, see lib/Ota/DeltaOta.h. Define OTA_URL
+in config.h, e.g. #define OTA_URL "http://192.168.1.10:8000/ota", and the
+station asks for OTA_URL/<image id>.delta once connected and then every
+OTA_CHECK_MS. 404 means there is nothing newer. The patch goes into the
+other OTA partition as it downloads and the station restarts into the new
+image once its hash and signature check out. The new image has
+OTA_VERIFY_MS to fetch a forecast, otherwise the old one comes back.
+
+Patches are signed, so OTA_PUBLIC_KEY has to be set along with OTA_URL:
+tools/delta/mkdelta --genkey prints the line for config.h, e.g.
+#define OTA_PUBLIC_KEY {0x3d, 0x40, ...}. A patch that isn't signed with
+the matching seed is never booted, which is why plain http is fine here*/
+#ifndef OTA_CHECK_MS
+#define OTA_CHECK_MS 3600000UL
+#endif
+#ifndef OTA_VERIFY_MS
+#define OTA_VERIFY_MS 600000UL
+#endif
+#ifndef OTA_TIMEOUT_MS
+#define OTA_TIMEOUT_MS 300000UL
+#endif
+#ifdef OTA_URL
+#ifndef OTA_PUBLIC_KEY
+#error "OTA_URL needs OTA_PUBLIC_KEY, see tools/delta/mkdelta --genkey"
+#endif
+const uint8_t otaPublicKey[ED25519_PUBLIC_BYTES] = OTA_PUBLIC_KEY;
+DeltaOta ota;
+AsyncHttpRequest otaRequest;
+bool otaDue = true;
+bool otaFailed = false;
+uint32_t otaCheckedAt = 0;
+
+/*the core would otherwise confirm a new image as soon as it boots*/
+extern "C" bool verifyRollbackLater(){
+  return true;
+}
+#endif
+
+/*DeviceIo connects the station logic in lib/Station to the real sensors,
+WiFi and display. Built with -D STATION_TRACE every sensor read and HTTP
+request is also printed as a trace line for tools/replay*/
+class DeviceIo : public StationIo {
+ public:
+  /*also the arg of the flight recorder's render events*/
+  enum Screen { SCREEN_NONE, SCREEN_INSIDE, SCREEN_DERIVED, SCREEN_OUTSIDE, SCREEN_FORECAST, SCREEN_SUMMARY };
+
+  uint32_t now() override { return millis(); }
+
+  /*delay(1) rather than yield() between rounds: yield() only lets tasks
+  of the loop's priority run, a tick of sleep lets everything else on
+  the core have its turn, the idle task included*/
+  void waitUntil(uint32_t deadline) override {
+    FlightScope scope(FLIGHT_WAIT);
+    while((int32_t)(millis() - deadline) < 0){
+      serviceRequests();
+      serviceSensors();
+      servicePower();
+      delay(1);
     }
   }
-  measurementCnt = 0;
-
-  /*This loop is used to measure outside temp 5 times with 1s intervals
-  DS18B20 is capable of doing so with 12bit resolution*/
-
-  while(measurementCnt < 5){
 
-    if(measurementTimer > dallasTempInterval){
-      outTempSens.requestTemperatures();
-      float outsideTemp = outTempSens.getTempCByIndex(0);
-      displayOutsideTemp(outsideTemp);
-      measurementCnt++;
-      measurementTimer = 0;
-      outsideTempSum += outsideTemp;
-      outsideTotalCnt++;
+  void readInside(float &temperature, float &humidity) override;
+  float readOutside() override;
+  bool wifiConnected() override { return WiFi.status() == WL_CONNECTED; }
+  void startForecast(int location) override;
+  int finishForecast(ForecastSlot *slots, int count) override;
+  void startUpload(float outsideTemp, float insideTemp, float humidity, const DerivedMetrics *derived) override;
+  int requestResult(int host, int32_t &retryAfter) override;
+  uint32_t requestTime(int host) override {
+    const AsyncHttpRequest *request = requestOf(host);
+    return request != NULL ? request->elapsed() : 0;
+  }
+  uint32_t requestBytes(int host) override {
+    const AsyncHttpRequest *request = requestOf(host);
+    return request != NULL ? request->sentBytes() + request->bodyBytes() : 0;
+  }
+  bool requestSent(int host) override {
+    const AsyncHttpRequest *request = requestOf(host);
+    return request != NULL && request->getState() != ASYNC_HTTP_IDLE;
+  }
+  int startRequest(int host, uint16_t key) override {
+    (void)key;
+    if(host == otaHost){
+      return startOta();
     }
-
+    if(host == collectorHost){
+      return sendCollectorBatch();
+    }
+    return -ASYNC_HTTP_CANCELLED;
   }
+  int linkRssi() override { return WiFi.RSSI(); }
 
-  measurementCnt = 0;
-
-
-  if(WiFi.status() == WL_CONNECTED){
-
-
-    String weatherServerPath = "http://api.openweathermap.org/data/2.5/forecast?q=" + city + "," + countryCode 
-                        + "&cnt="+ timeStamps + "&APPID=" + weatherApiKey;
-
-    jsonBuffer = httpGETRequest(weatherServerPath.c_str());
+  void sendCollectorFrame(float outsideTemp, float insideTemp, float humidity) override {
+    ::sendCollectorFrame(outsideTemp, insideTemp, humidity);
+  }
 
-    JSONVar weatherForecast = JSON.parse(jsonBuffer);
+  void showInside(float temperature, float humidity) override {
+    lastInsideTemp = temperature;
+    lastHumidity = humidity;
+    if(panelOff()){
+      return;
+    }
+    HeapTagScope scope(HEAP_TAG_DISPLAY);
+    FlightScope render(FLIGHT_RENDER, SCREEN_INSIDE);
+    enterScreen(SCREEN_INSIDE, TRANSITION_SLIDE_UP);
+    displayInsideTemp(temperature, humidity);
+  }
 
-    if(JSON.typeof(weatherForecast) == "undefined"){
-      Serial.println("Parsing JSON failed!");
+  void showDerived(float temperature, float humidity, const DerivedMetrics &metrics) override {
+    (void)temperature;
+    (void)humidity;
+    if(panelOff()){
       return;
-    }else{
-      Serial.print("JSON object = ");
-      Serial.println(weatherForecast);
-
-      /*to display time of the forecasted weather access to
-      dt_txt variable of JSON is needed. This contains the date and
-      the time but only time is needed. Time is in form HH:MM:SS 
-      but this is too long to be displayed in small oled. That's
-      why it's parsed to HH:MM form*/
-
-      /*pointers to memory where date and time of forecasts
-      are stored*/
-      const char *dateOne = weatherForecast["list"][0]["dt_txt"];
-      const char *dateTwo = weatherForecast["list"][1]["dt_txt"];
-      const char *dateThree = weatherForecast["list"][2]["dt_txt"];
-
-
-
-      /*pointers to access elements of arrays */
-      const char *p1 = dateOne;
-      const char *p2 = dateTwo;
-      const char *p3 = dateThree;
-
-      
-      /*each char takes 1 byte of program memory so time + 11 should
-      end up to first element of time part of the dt_txt, as long as
-      openWeather doesn't change api. Increasing value of pointer to match 
-      memory location of first element of time */
-      p1 += 11; 
-      p2 += 11;
-      p3 += 11;
-
-      /*array to store parsed time. Since this is a C string it needs
-      one extra element for terminating null character*/
-      char time1[6];
-      char time2[6];
-      char time3[6];
-
-      /*parsing array to contain only hours and minutes*/
-      for(int i = 0; i < 5; i++){
-        time1[i] = *p1;
-        time2[i] = *p2;
-        time3[i] = *p3;
-        p1++;
-        p2++;
-        p3++;
-      }
-      time1[5] = '\0';
-      time2[5] = '\0';
-      time3[5] = '\0';
+    }
+    HeapTagScope scope(HEAP_TAG_DISPLAY);
+    FlightScope render(FLIGHT_RENDER, SCREEN_DERIVED);
+    enterScreen(SCREEN_DERIVED, TRANSITION_SLIDE_UP);
+    ScreenKey key(SCREEN_DERIVED);
+    key.add(metrics.dewPoint).add(metrics.frostPoint).add(metrics.absoluteHumidity).add(metrics.heatIndex);
+    displayCached(key, [&]{ drawDerivedScreen(display, metrics); });
+  }
 
-      /*weatherId is unique ID number from API to define weather.
-      weatherId is passed as a parameter to function displayForecast
-      to determine the weather icon*/
+  void showOutside(float temperature) override {
+    if(panelOff()){
+      return;
+    }
+    HeapTagScope scope(HEAP_TAG_DISPLAY);
+    FlightScope render(FLIGHT_RENDER, SCREEN_OUTSIDE);
+    enterScreen(SCREEN_OUTSIDE, TRANSITION_SLIDE_UP);
+    displayOutsideTemp(temperature);
+  }
 
-      int weatherId1 = weatherForecast["list"][0]["weather"][0]["id"]; 
-      int weatherId2 = weatherForecast["list"][1]["weather"][0]["id"];
-      int weatherId3 = weatherForecast["list"][2]["weather"][0]["id"];
+  int forecastSlotsPerScreen() override { return forecastLayoutSlots(FORECAST_LAYOUT); }
+  void showForecast(int location, int first, const ForecastSlot *slots, int count, uint32_t durationMs) override;
+#ifdef FORECAST_SUMMARY
+  int forecastDays(ForecastDay *days, int max) override;
+  void showSummary(int location, const ForecastDay *days, int count, uint32_t durationMs) override;
+#endif
 
-      int forecastTemp1 = weatherForecast["list"][0]["main"]["temp"];
-      int forecastTemp2 = weatherForecast["list"][1]["main"]["temp"];
-      int forecastTemp3 = weatherForecast["list"][2]["main"]["temp"];
+  void servicePower();
 
-      forecastTemp1 -= 273;
-      forecastTemp2 -= 273;
-      forecastTemp3 -= 273;
+  uint32_t skippedScreens = 0;
 
-    
-      displayFirstForecast(2000, weatherId1, time1, forecastTemp1);
-      displaySecondForecast(2000, weatherId2, time2, forecastTemp2);
-      displayThirdForecast(1000, weatherId3, time3, forecastTemp3); //third forecast is already displayed for 2s because of measurementTimer
-      
+ private:
+  /*nothing is drawn while the panel is off. The next screen comes in
+  without a transition, and waking up shows the inside reading*/
+  bool panelOff(){
+    if(displayPower.on()){
+      return false;
     }
+    screen = SCREEN_NONE;
+    skippedScreens++;
+    stale = true;
+    return true;
+  }
+  void powerChanged();
 
-    if(updateSensorsTime > updateInterval){
+  /*the HTTP request behind an outbound host, NULL for the collector's
+  datagrams*/
+  AsyncHttpRequest *requestOf(int host){
+    if(host == STATION_HOST_WEATHER){
+      return &forecastRequest;
+    }
+    if(host == STATION_HOST_THINGSPEAK){
+      return &uploadRequest;
+    }
+#ifdef OTA_URL
+    if(host == otaHost){
+      return &otaRequest;
+    }
+#endif
+    return NULL;
+  }
 
-      humiditySend = humiditySum/insideTotalCnt;
-      insideTempSend = insideTempSum/insideTotalCnt;
-      outsideTempSend = outsideTempSum/outsideTotalCnt;
-      
+  /*one measurement, the conversion is waited out like any other wait so
+  requests, the extra sensors and the panel go on meanwhile*/
+  bool measure(Sensor &sensor, SensorReading &out){
+    if(!sensor.start()){
+      out.temperature = out.humidity = out.pressure = NAN;
+      return false;
+    }
+    while(!sensor.ready()){
+      waitUntil(millis() + 1);
+    }
+    return sensor.read(out);
+  }
 
-      String thingsServerPath = "http://api.thingspeak.com/update?api_key=" + thingsApiKey + "&field1=" + outsideTempSend
-                              + "&field2=" + insideTempSend + "&field3=" + humiditySend;
-      httpGETRequest(thingsServerPath.c_str());
-      updateSensorsTime = 0;
-      outsideTempSum = 0;
-      insideTempSum = 0;
-      humiditySum = 0;
-      insideTotalCnt = 0;
-      outsideTotalCnt = 0;
-    }  
+  /*repeated readings redraw the same screen in place, only a
+  different screen comes in with a transition*/
+  void enterScreen(Screen next, TransitionType type){
+    if(next != screen && screen != SCREEN_NONE){
+      display.setTransition(type);
+    }
+    screen = next;
   }
-}
 
-// Method to get weather forecast for today from OpenWeather API
+  Screen screen = SCREEN_NONE;
+  int shownLocation = -1;
 
-String httpGETRequest(const char* serverName){ 
-  
-  http.begin(serverName);
+  float lastInsideTemp = NAN, lastHumidity = NAN;
+  bool stale = false;
+  uint32_t powerCheckedAt = 0;
+};
 
-  int httpWeatherResponseCode = http.GET();
+DeviceIo deviceIo;
+Station station(deviceIo);
 
-  String payload = "{}";
 
-  if (httpWeatherResponseCode>0){
-    Serial.print("HTTP Response code: ");
-    Serial.print(httpWeatherResponseCode);
-    payload = http.getString();
-  }else{
-    Serial.print("Error code:");
-    Serial.print(httpWeatherResponseCode);
+void setup()   {                
+  esp_reset_reason_t resetReason = esp_reset_reason();
+  flightStart(resetReason);
+  Serial.begin(115200);
+  logBegin(Serial);
+  if(resetReason != ESP_RST_POWERON){
+    LOG_WARN("Reset reason %d, type f for what led up to it", (int)resetReason);
   }
+  /* initialize OLED with I2C address 0x3C */
+  Wire.begin(OLED_SDA, OLED_SCL);
+  Wire.setClock(400000);
+  i2cBus.begin();
+  display.begin(OLED_MAX_FPS); 
+  beginDisplayPower();
+  display.setTransitionSpeed(OLED_TRANSITION_PX, OLED_TRANSITION_MS);
+  station.locationCount = locationCount < STATION_MAX_LOCATIONS ? locationCount : STATION_MAX_LOCATIONS;
+  applyCurrentModel();
+  if(!asyncHttpSetCaCerts(TLS_CA_CERTS)){
+    LOG_ERROR("TLS_CA_CERTS didn't parse, https requests are refused");
+  }
+  /*readouts are blitted from pre-rasterized digits*/
+  setScreenBuffer(display.getBuffer());
+  display.clearDisplay();
+  delay(2000);
 
-  http.end();
+  display.setTextSize(1);
+  display.setTextColor(WHITE);
 
-  return payload;
+  beginSensors();
+  beginOta();
+#ifdef COLLECTOR_HOST
+  collectorHost = station.outbound.addHost("collector", 1000, 4, millis());
+#endif
 
+  WiFi.onEvent(wifiEvent);
+  WiFi.begin(ssid, password);
+  configTzTime(DISPLAY_TZ, "pool.ntp.org");
+  LOG_INFO("Connecting to %s...", ssid);
+  uint32_t connectStart = millis();
+  
+  while(WiFi.status() != WL_CONNECTED){
+    drawConnectScreen(display, false);
+    display.display();
+    delay(500);
+  }
+  station.energy.add(ENERGY_WIFI_SEARCH, millis() - connectStart);
+  drawConnectScreen(display, true);
+  display.display();
+  LOG_INFO("Connected to WiFi network in %lu ms with IP Address: %s", (unsigned long)(millis() - connectStart),
+           WiFi.localIP().toString().c_str());
+  delay(1000);
 }
 
+void loop() { 
+  {
+    FlightScope scope(FLIGHT_PASS);
+    station.runPass();
+  }
+  heapStatsSample();
+  handleSerialCommands();
+}
 
-//Method to display inside temperature
-
-void displayInsideTemp(float insideTemp, float hum){
+uint32_t clockUs(){
+  return micros();
+}
 
-    display.clearDisplay();
-     // display temperature
-    display.drawBitmap(0,0,  temperature_icon, temperature_width, temperature_height, 1);
-    display.setTextSize(1);
-    display.setCursor(24,22);
-    display.print("in");
-    display.setTextSize(2);
-    display.setCursor(32,0);
-    display.print(insideTemp);
-    display.print(" ");
-    display.setTextSize(1);
-    display.cp437(true);
-    display.write(167);
-    display.setTextSize(2);
-    display.print("C");
-
-    // display humidity
-    display.drawBitmap(0,32, humidity_icon, humidity_width, humidity_height, 1);
-    display.setTextSize(2);
-    display.setCursor(32,45);
-    display.print(hum);
-    display.print(" %"); 
-           
-    display.display();         
-   
+/*single character commands from the serial monitor:
+h = heap statistics for the last passes
+d = display flush statistics
+o = outbound requests per host: sent, coalesced, throttled, deferred, 429s
+s = adaptive sampling: reads, current period, trend and reconstruction error
+m = derived metrics now, and fixed point against double timing and error
+e = energy: on-time, events and mAh per use, and the estimated mAh per day
+t = TLS handshakes per host, full against resumed: time and heap
+j = forecast JSON parses: time, allocations, arena use and largest free block
+z = forecast transfers, gzip against plain: bytes on the wire and inflated, fetch time
+l = log lines buffered and dropped, longest log call
+f = flight recorder, the last events before now and before the last reset
+b = I2C bus: busy time, transactions and waits per device, and the extra sensors' last readings
+p = display power: on-time, wakes, contrast and pixel shift
+g = readout draw time, GFX text against the glyph cache
+c = screen cache: hits, misses and draw time saved per screen
+u = firmware update: the running image, the last patch's size and apply time, and a check for a new one now
+w = WiFi link: signal, failures and request time now, and traffic and airtime per link quality*/
+void handleSerialCommands(){
+  while(Serial.available() > 0){
+    switch(Serial.read()){
+      case 'h':
+        heapStatsDump(Serial);
+        break;
+      case 'd':
+        display.printStats(Serial);
+        break;
+      case 'o':
+        printOutboundStats();
+        break;
+      case 's':
+        printSamplingStats();
+        break;
+      case 'm':
+        printDerivedMetrics();
+        break;
+      case 'e':
+        printEnergy();
+        break;
+      case 't':
+        printTlsStats();
+        break;
+      case 'j':
+        printJsonStats();
+        break;
+      case 'z':
+        printTransferStats();
+        break;
+      case 'l':
+        printLogStats();
+        break;
+      case 'f':
+        printFlightRecorder();
+        break;
+      case 'b':
+        printSensors();
+        break;
+      case 'p':
+        printDisplayPower();
+        break;
+      case 'g':
+        benchmarkReadouts(display, display.getBuffer(), Serial, clockUs);
+        break;
+      case 'c':
+        printScreenCache();
+        break;
+      case 'u':
+        printOta();
+        break;
+      case 'w':
+        printLinkStats();
+        break;
+    }
   }
+}
 
-//Method to display outside temperature
-
-void displayOutsideTemp(float outsideTemp){
+void DeviceIo::readInside(float &temperature, float &humidity){
+  TraceRecord record = {};
+  record.kind = TRACE_DHT;
+  record.time = millis();
 
-  display.clearDisplay();
-    // display temperature
-  display.drawBitmap(0,0,  temperature_icon, temperature_width, temperature_height, 1);
-  display.setTextSize(1);
-  display.setCursor(24,22);
-  display.print("out");
-  display.setTextSize(2);
-  display.setCursor(32,0);
-  display.print(outsideTemp);
-  display.print(" ");
-  display.setTextSize(1);
-  display.cp437(true);
-  display.write(167);
-  display.setTextSize(2);
-  display.print("C");
-  display.display();      
+  FlightScope scope(FLIGHT_DHT);
+  SensorReading reading;
+  if(!measure(insideSensor, reading)){
+    LOG_WARN("Failed to read from %s sensor!", insideSensor.name());
+  }
+  humidity = reading.humidity;
+  temperature = reading.temperature;
+  if(!isnan(reading.pressure)){
+    pressure = reading.pressure;
+  }
 
- }
-  
-  
+  record.duration = millis() - record.time;
+  record.temperature = temperature;
+  record.humidity = humidity;
+  traceRecord(record);
+}
 
+float DeviceIo::readOutside(){
+  TraceRecord record = {};
+  record.kind = TRACE_DS;
+  record.time = millis();
+
+  FlightScope scope(FLIGHT_DS18B20);
+  /*a disconnected sensor still gives -127, the station checks for it*/
+  SensorReading reading;
+  measure(outsideSensor, reading);
+  float outsideTemp = reading.temperature;
+
+  record.duration = millis() - record.time;
+  record.temperature = outsideTemp;
+  traceRecord(record);
+  return outsideTemp;
+}
 
-void displayFirstForecast(int forecastInterval, int id, const char * time_1, int temperature1){
-  displayTimer = 0;
-  display.clearDisplay();
-  display.setCursor(0,0);
-  display.setTextSize(1);
-  display.print(time_1);
-  display.setCursor(90,50);
-  display.print(temperature1);
-  display.print(" ");
-  display.cp437(true);
-  display.write(167);
-  display.print("C");
+/*response body goes straight into jsonBuffer as it arrives. The headers
+are all in by the first piece, Content-Length only tells the size of a
+plain answer, a gzip one inflates to several times it*/
+void appendToBuffer(const uint8_t *data, size_t len, void *context){
+  String &buffer = *(String *)context;
+  if(buffer.length() == 0 && !forecastRequest.compressed() && forecastRequest.contentLength() > 0){
+    buffer.reserve(forecastRequest.contentLength());
+  }
+  buffer.concat((const char *)data, len);
+}
 
+void DeviceIo::startForecast(int location){
+  HeapTagScope scope(HEAP_TAG_STRINGS);
+  String weatherServerPath = String(WEATHER_SERVER "/data/2.5/forecast?q=") + locations[location].city
+                      + "," + locations[location].countryCode
+                      + "&cnt="+ timeStamps + "&APPID=" + weatherApiKey;
+#ifndef FORECAST_NO_GZIP
+  forecastRequest.acceptGzip(gzipForecast ? &gzipInflater : NULL);
+#endif
+
+#ifdef FORECAST_SUMMARY
+  forecastStream.begin(streamedSlots, STATION_FORECAST_SLOTS);
+  forecastRequest.onHeader(NULL);
+  forecastRequest.start(weatherServerPath.c_str(), HTTP_REQUEST_TIMEOUT, ForecastStream::bodyCallback, &forecastStream);
+#else
+  jsonBuffer = "";
+  forecastRequest.onHeader(NULL);
+  forecastRequest.start(weatherServerPath.c_str(), HTTP_REQUEST_TIMEOUT, appendToBuffer, &jsonBuffer);
+#endif
+}
 
-  //Serial.println(id);
+int DeviceIo::finishForecast(ForecastSlot *slots, int count){
+  while(forecastRequest.busy()){
+    waitUntil(millis() + 1);
+  }
+  printRequestResult(forecastRequest);
+  countHandshake(STATION_HOST_WEATHER, forecastRequest);
+  countTransfer(forecastRequest);
+
+  TraceRecord record = {};
+  record.kind = TRACE_FORECAST;
+  record.time = millis() - forecastRequest.elapsed();
+  record.duration = forecastRequest.elapsed();
+
+  record.result = -1;
+  if(forecastRequest.getState() == ASYNC_HTTP_DONE && forecastRequest.status() == 200){
+#ifdef FORECAST_SUMMARY
+    if(forecastStream.finish() >= 0){
+      record.result = forecastStream.slotsFilled() < count ? forecastStream.slotsFilled() : count;
+      memcpy(slots, streamedSlots, record.result * sizeof(ForecastSlot));
+    }else{
+      LOG_WARN("Parsing JSON failed!");
+    }
+#else
+    record.result = parseForecast(slots, count);
+#endif
+  }
+  jsonBuffer = "";
 
-  /*range 200-299 = thunderstorm class
-    range 300-399 = drizzle class
-    range 500-599 = rain class
-    range 600-699 = snow class
-    range 700-799 = describes atmostphere (fog etc.)
-    value 800 = clear sky
-    range 801-899 = clouds class */
-  while(displayTimer<forecastInterval){
+  for(int i = 0; i < record.result && i < STATION_FORECAST_SLOTS; i++){
+    record.slots[i] = slots[i];
+  }
+  traceRecord(record);
+  if(record.result > 0){
+    confirmFirmware();
+  }
+  return record.result;
+}
 
-    if(inRange(id,200,299)){ 
+/*field4 dew point, field5 frost point, field6 absolute humidity (g/m3)
+and field7 heat index, add them to the channel to see them*/
+void DeviceIo::startUpload(float outsideTempSend, float insideTempSend, float humiditySend, const DerivedMetrics *derived){
+#ifdef MY_THINGS_APIKEY
+  HeapTagScope scope(HEAP_TAG_STRINGS);
+  String thingsServerPath = String(THINGSPEAK_SERVER "/update?api_key=") + thingsApiKey + "&field1=" + outsideTempSend
+                          + "&field2=" + insideTempSend + "&field3=" + humiditySend;
+  if(derived != NULL){
+    thingsServerPath += String("&field4=") + derived->dewPoint / 100.0f + "&field5=" + derived->frostPoint / 100.0f
+                      + "&field6=" + derived->absoluteHumidity / 100.0f + "&field7=" + derived->heatIndex / 100.0f;
+  }
+  if(!isnan(pressure)){
+    thingsServerPath += String("&field8=") + pressure;
+  }
+  uploadRequest.start(thingsServerPath.c_str(), HTTP_REQUEST_TIMEOUT, NULL, NULL);
+  uploadPending = true;
+#endif
+}
 
-      display.drawBitmap(30, 5,  thunderstorm, 64, 64, 1);
-      display.display();
+int DeviceIo::requestResult(int host, int32_t &retryAfter){
+  AsyncHttpRequest *request = requestOf(host);
+  if(request == NULL){
+    return -ASYNC_HTTP_CANCELLED;
+  }
+  if(request->busy()){
+    return 0;
+  }
+  retryAfter = request->retryAfter();
+  if(request->getState() == ASYNC_HTTP_IDLE){
+    /*nothing was sent, uploads are off without MY_THINGS_APIKEY*/
+    return -ASYNC_HTTP_CANCELLED;
+  }
+#ifdef OTA_URL
+  if(host == otaHost && otaFailed){
+    /*cancelled over a bad patch, the server did answer*/
+    return request->status();
+  }
+#endif
+  return ::requestResult(*request);
+}
 
+void printOutboundStats(){
+  for(int i = 0; i < station.outbound.hostCount(); i++){
+    const OutboundHost &h = station.outbound.host(i);
+    Serial.printf("%s: %lu sent, %lu coalesced, %lu throttled, %lu deferred, %lu rejected, %lu queued at most",
+                  h.name, (unsigned long)h.stats.sent, (unsigned long)h.stats.coalesced,
+                  (unsigned long)h.stats.throttled, (unsigned long)h.stats.deferred,
+                  (unsigned long)h.stats.rejected, (unsigned long)h.stats.maxQueued);
+    if(h.blocked && (int32_t)(millis() - h.blockedUntil) < 0){
+      Serial.printf(", closed for %lu s", (unsigned long)(h.blockedUntil - millis()) / 1000);
     }
+    Serial.println();
+  }
+}
 
-    if(inRange(id,200,299)){ 
-
-      display.drawBitmap(30, 5,  thunderstorm, 64, 64, 1);
-      display.display();
+void printLinkStats(){
+  const LinkQuality &link = station.link;
+  uint32_t now = millis();
+  Serial.printf("link %s, %.0f dBm, %.0f %% failed, %.0f ms a request, %lu changes\n",
+                LinkQuality::bucketName(link.bucket()), link.rssi(), link.failureRate() * 100,
+                link.requestTime(), (unsigned long)link.changes);
+  Serial.printf("%-5s %8s %8s %7s %9s %7s %9s %9s\n", "link", "time s", "requests", "failed", "datagrams",
+                "frames", "bytes", "air ms");
+  for(int i = 0; i < LINK_BUCKETS; i++){
+    LinkBucketStats s = link.stats(i, now);
+    Serial.printf("%-5s %8lu %8lu %7lu %9lu %7lu %9lu %9lu\n", LinkQuality::bucketName(i),
+                  (unsigned long)(s.timeMs / 1000), (unsigned long)s.requests, (unsigned long)s.failed,
+                  (unsigned long)s.datagrams, (unsigned long)s.frames, (unsigned long)s.bytes,
+                  (unsigned long)s.airtimeMs);
+  }
+}
 
-    }
+void printSamplingStats(){
+  const SampleFilter *filters[] = {&station.insideTempFilter, &station.humidityFilter, &station.outsideTempFilter};
+  const char *names[] = {"inside", "humidity", "outside"};
+  float minutes = millis() / 60000.0;
+  for(int i = 0; i < 3; i++){
+    const SampleFilter &f = *filters[i];
+    Serial.printf("%-8s %lu reads (%.2f/min), %lu failed, every %lu ms now, trend %+.3f/h, %.3f rms off at reads, %lu surprises\n",
+                  names[i], (unsigned long)f.readings, minutes > 0 ? f.readings / minutes : 0,
+                  (unsigned long)f.misses, (unsigned long)f.lastPeriod, f.rate() * 3600,
+                  f.reconstructionError(), (unsigned long)f.surprises);
+  }
+  Serial.printf("slots from the filter: %lu inside, %lu outside\n",
+                (unsigned long)station.insideSkipped, (unsigned long)station.outsideSkipped);
+}
 
-    if(inRange(id,300,501)){ 
+void printDerivedMetrics(){
+  if(station.derivedValid){
+    const DerivedMetrics &m = station.derived;
+    Serial.printf("dew point %.2f C, frost point %.2f C, absolute humidity %.2f g/m3, heat index %.2f C\n",
+                  m.dewPoint / 100.0, m.frostPoint / 100.0, m.absoluteHumidity / 100.0, m.heatIndex / 100.0);
+  }
+  /*a coarse grid, the double versions take a while here*/
+  DerivedBenchmark b;
+  benchmarkDerivedMetrics(clockUs, 200, 500, b);
+  Serial.printf("%lu readings: fixed %.1f us, double %.1f us a call, largest error %.2f C %.2f C %.2f g/m3 %.2f C\n",
+                (unsigned long)b.samples, b.fixedUs, b.referenceUs, b.maxError[0] / 100.0, b.maxError[1] / 100.0,
+                b.maxError[2] / 100.0, b.maxError[3] / 100.0);
+
+  /*what the DHT library gives for the same reading*/
+  float t = 25.0f, h = 60.0f;
+  volatile float sink = 0;
+  uint32_t started = micros();
+  for(int i = 0; i < 100; i++){
+    sink = sink + dht.computeHeatIndex(t + i * 0.1f, h, false);
+  }
+  Serial.printf("DHT computeHeatIndex %.1f us a call\n", (micros() - started) / 100.0);
+}
 
-      display.drawBitmap(30, 5,  drizzle, 64, 64, 1);
-      display.display();
+void printLogStats(){
+  const LogStats &s = logStats();
+  Serial.printf("log: %lu lines, %lu dropped (%lu bytes), %lu cut, %lu of %u bytes waiting, %lu at most, longest call %lu us\n",
+                (unsigned long)s.lines, (unsigned long)s.dropped, (unsigned long)s.droppedBytes,
+                (unsigned long)s.truncated, (unsigned long)logPending(), LOG_BUFFER_SIZE,
+                (unsigned long)s.highWater, (unsigned long)s.maxCallUs);
+}
 
+/*printed straight to Serial, the whole ring doesn't fit the log buffer.
+Feed it to tools/trace2chrome*/
+void printFlightRecorder(){
+  char line[64];
+  formatFlightHeader(line, sizeof(line));
+  Serial.println(line);
+  FlightEvent event;
+  for(uint32_t i = 0; i < flightCount(); i++){
+    if(flightGet(i, event)){
+      formatFlightEvent(event, line, sizeof(line));
+      Serial.println(line);
     }
+  }
+}
 
-    if(inRange(id,600,699)){ 
-
-      display.drawBitmap(30, 5,  snow, 64, 64, 1);
-      display.display();
+/*runs in the WiFi event task*/
+void wifiEvent(arduino_event_id_t event, arduino_event_info_t info){
+  if(event == ARDUINO_EVENT_WIFI_STA_GOT_IP){
+    flightRecord(FLIGHT_WIFI_UP, FLIGHT_INSTANT);
+  }else if(event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED){
+    flightRecord(FLIGHT_WIFI_DOWN, FLIGHT_INSTANT, info.wifi_sta_disconnected.reason);
+  }
+}
 
+void beginSensors(){
+  if(!insideSensor.begin()){
+    LOG_ERROR("Inside sensor %s doesn't answer", insideSensor.name());
+  }
+  outsideSensor.begin();
+  for(ExtraSensor &e : extraSensors){
+    if(e.sensor == &insideSensor){
+      continue;
     }
-
-    if(id == 800){ 
-
-      display.drawBitmap(30, 5,  clear_sky, 64, 64, 1);
-      display.display();
-
+    e.present = e.sensor->begin();
+    if(!e.present){
+      LOG_WARN("Sensor %s doesn't answer", e.sensor->name());
     }
+  }
+}
 
-    if(id == 801){
-      display.drawBitmap(30, 5, cloud1, 64, 64, 1);
-      display.display();
+/*extra sensors take turns, one measurement at a time, so their bus use
+is spread out and never stacks up in front of a display flush*/
+void serviceSensors(){
+  for(ExtraSensor &e : extraSensors){
+    if(!e.present || e.sensor == &insideSensor){
+      continue;
     }
-
-    if(id == 802){
-      display.drawBitmap(30, 5, cloud2, 64, 64, 1);
-      display.display();
+    if(e.measuring){
+      if(!e.sensor->ready()){
+        return;
+      }
+      e.measuring = false;
+      if(e.sensor->read(e.reading)){
+        e.readAt = millis();
+        if(!isnan(e.reading.pressure)){
+          pressure = e.reading.pressure;
+        }
+      }else{
+        e.failures++;
+      }
+      return;
+    }
+    if(e.startedAt == 0 || millis() - e.startedAt >= EXTRA_SENSOR_PERIOD){
+      e.startedAt = millis();
+      e.measuring = e.sensor->start();
+      if(!e.measuring){
+        e.failures++;
+      }
+      return;
     }
+  }
+}
 
-    if(id == 803 || id == 804){
-      display.drawBitmap(30, 5, cloud3, 64, 64, 1);
-      display.display();
+void printSensors(){
+  i2cBus.printStats(Serial);
+  for(const ExtraSensor &e : extraSensors){
+    if(e.sensor == &insideSensor){
+      continue;
+    }
+    if(!e.present){
+      Serial.printf("%-8s not found\n", e.sensor->name());
+    }else if(e.readAt == 0){
+      Serial.printf("%-8s no reading yet, %lu failed\n", e.sensor->name(), (unsigned long)e.failures);
+    }else{
+      Serial.printf("%-8s %.2f C %.1f %% %.1f hPa, %lu s ago, %lu failed\n", e.sensor->name(), e.reading.temperature,
+                    e.reading.humidity, e.reading.pressure, (unsigned long)((millis() - e.readAt) / 1000),
+                    (unsigned long)e.failures);
     }
   }
 }
 
-void displaySecondForecast(int forecastInterval, int id, const char * time_2, int temperature2){
-  displayTimer = 0;
-  display.clearDisplay();
-  display.setCursor(0,0);
-  display.setTextSize(1);
-  display.print(time_2);
-  display.setCursor(90,50);
-  display.print(temperature2);
-  display.print(" ");
-  display.cp437(true);
-  display.write(167);
-  display.print("C");
+static uint16_t minuteOf(int hhmm){
+  return (hhmm / 100) * 60 + hhmm % 100;
+}
+
+void beginDisplayPower(){
+  displayPower.nightFrom = minuteOf(DISPLAY_NIGHT_FROM);
+  displayPower.nightUntil = minuteOf(DISPLAY_NIGHT_UNTIL);
+  displayPower.dimFrom = minuteOf(DISPLAY_DIM_FROM);
+  displayPower.dimUntil = minuteOf(DISPLAY_DIM_UNTIL);
+  displayPower.brightContrast = DISPLAY_CONTRAST;
+  displayPower.dimContrast = DISPLAY_DIM_CONTRAST;
+  displayPower.wakeTime = DISPLAY_WAKE_MS;
+  displayPower.lightDark = DISPLAY_LIGHT_DARK;
+  displayPower.lightBright = DISPLAY_LIGHT_BRIGHT;
+  displayPower.shiftPeriod = DISPLAY_SHIFT_MS;
+#ifdef DISPLAY_WAKE_PIN
+  pinMode(DISPLAY_WAKE_PIN, DISPLAY_WAKE_LEVEL == LOW ? INPUT_PULLUP : INPUT);
+  displayPower.idleTimeout = DISPLAY_IDLE_MS;
+#endif
+  displayPower.begin(millis());
+  display.setContrast(displayPower.contrast());
+}
 
-  while(displayTimer<forecastInterval){
+/*-1 until NTP has set the clock*/
+int localMinute(){
+  struct tm now;
+  if(!getLocalTime(&now, 0)){
+    return -1;
+  }
+  return now.tm_hour * 60 + now.tm_min;
+}
 
-    if(inRange(id,200,299)){ 
+void printDisplayPower(){
+  DisplayStats s;
+  display.getStats(s);
+  uint32_t now = millis();
+  int minute = localMinute();
+  if(minute < 0){
+    Serial.printf("panel %s, contrast %u, clock not set\n", displayPower.on() ? "on" : "off",
+                  (unsigned)displayPower.contrast());
+  }else{
+    Serial.printf("panel %s, contrast %u, local time %02d:%02d\n", displayPower.on() ? "on" : "off",
+                  (unsigned)displayPower.contrast(), minute / 60, minute % 60);
+  }
+  Serial.printf("on %lu s of %lu s (%.1f %%), %lu wakes, off %lu times, %lu screens not drawn\n",
+                (unsigned long)(s.panelOnMs / 1000), (unsigned long)(now / 1000),
+                now > 0 ? 100.0 * s.panelOnMs / now : 0.0, (unsigned long)displayPower.wakes,
+                (unsigned long)s.panelOffs, (unsigned long)deviceIo.skippedScreens);
+  int8_t dx, dy;
+  displayPower.shift(now, dx, dy);
+  Serial.printf("pixel shift %d,%d, every %lu s\n", dx, dy, (unsigned long)(DISPLAY_SHIFT_MS / 1000));
+}
 
-      display.drawBitmap(30, 5,  thunderstorm, 64, 64, 1);
-      display.display();
+#ifdef OTA_URL
+/*the patch as it downloads. Anything but a 200 is left for serviceOta()*/
+static void otaBody(const uint8_t *data, size_t len, void *context){
+  (void)context;
+  if(otaFailed || otaRequest.status() != 200){
+    return;
+  }
+  if(!ota.updating() && !ota.start()){
+    LOG_ERROR("OTA: can't open the update partition");
+    otaFailed = true;
+    return;
+  }
+  if(ota.feed(data, len) == DELTA_ERROR){
+    otaFailed = true;
+  }
+}
 
+static void finishOta(){
+  if(otaRequest.getState() == ASYNC_HTTP_DONE && otaRequest.status() == 404){
+    LOG_INFO("OTA: nothing newer for %s", ota.imageId());
+    return;
+  }
+  if(!ota.updating()){
+    if(!otaFailed){
+      printRequestResult(otaRequest);
     }
+    return;
+  }
+  if(otaRequest.getState() == ASYNC_HTTP_DONE && ota.finish()){
+    LOG_INFO("OTA: %lu byte patch applied in %lu ms, restarting", (unsigned long)ota.stats().patchBytes,
+             (unsigned long)(ota.stats().applyUs / 1000));
+    uint32_t started = millis();
+    while(logPending() > 0 && millis() - started < 1000){
+      delay(10);
+    }
+    ESP.restart();
+  }
+  ota.abort();
+  const DeltaOtaStats &s = ota.stats();
+  if(otaRequest.getState() != ASYNC_HTTP_DONE && !otaFailed){
+    printRequestResult(otaRequest);
+  }else if(s.lastError != DELTA_OK){
+    LOG_WARN("OTA: patch failed after %lu bytes: %s", (unsigned long)s.patchBytes, DeltaPatch::errorName(s.lastError));
+  }else{
+    LOG_WARN("OTA: the new image didn't validate");
+  }
+}
+#endif
 
-    if(inRange(id,200,299)){ 
-
-      display.drawBitmap(30, 5,  thunderstorm, 64, 64, 1);
-      display.display();
+void beginOta(){
+#ifdef OTA_URL
+  if(!ota.begin(otaPublicKey)){
+    LOG_ERROR("OTA: can't read the running image");
+    return;
+  }
+  LOG_INFO("Firmware %s, %lu bytes%s", ota.imageId(), (unsigned long)ota.imageSize(),
+           ota.pendingVerify() ? ", new and waiting for a forecast" : "");
+  /*a minute between checks is for the o command, OTA_CHECK_MS spaces
+  out the rest*/
+  otaHost = station.outbound.addHost("update server", 60000, 1, millis());
+#endif
+}
 
+/*runs with the other requests, rolls back an image that hasn't confirmed
+itself in time and queues update checks. They go out when station.outbound
+lets them, behind uploads and forecasts*/
+void serviceOta(){
+#ifdef OTA_URL
+  uint32_t now = millis();
+  if(ota.pendingVerify() && now > OTA_VERIFY_MS){
+    LOG_ERROR("OTA: no forecast in %lu s on the new firmware, rolling back", (unsigned long)(OTA_VERIFY_MS / 1000));
+    ota.rollback();
+  }
+  if(otaRequest.busy()){
+    if(otaFailed){
+      otaRequest.cancel();
+    }else if(otaRequest.poll()){
+      return;
     }
+    countHandshake(otaHost, otaRequest);
+    finishOta();
+    return;
+  }
+  /*one update at a time, a new image confirms itself first*/
+  if(otaHost < 0 || ota.imageId()[0] == '\0' || ota.pendingVerify() || WiFi.status() != WL_CONNECTED ||
+     !(otaDue || now - otaCheckedAt >= OTA_CHECK_MS) || station.outbound.queued(otaHost, 0)){
+    return;
+  }
+  station.outbound.submit(otaHost, STATION_PRIORITY_BACKGROUND, 0, now);
+#endif
+}
 
-    if(inRange(id,300,501)){ 
-
-      display.drawBitmap(30, 5,  drizzle, 64, 64, 1);
-      display.display();
+/*the update check outbound let go, 0 once it's on its way*/
+int startOta(){
+#ifdef OTA_URL
+  otaDue = false;
+  otaCheckedAt = millis();
+  otaFailed = false;
+  String url = String(OTA_URL "/") + ota.imageId() + ".delta";
+  if(!otaRequest.start(url.c_str(), OTA_TIMEOUT_MS, otaBody, NULL)){
+    printRequestResult(otaRequest);
+    return requestResult(otaRequest);
+  }
+  return 0;
+#else
+  return -ASYNC_HTTP_CANCELLED;
+#endif
+}
 
-    }
+/*a forecast came through, so the firmware can reach the network*/
+void confirmFirmware(){
+#ifdef OTA_URL
+  if(ota.pendingVerify()){
+    ota.confirm();
+    LOG_INFO("Firmware %s confirmed", ota.imageId());
+  }
+#endif
+}
 
-    if(inRange(id,600,699)){ 
+void printOta(){
+#ifdef OTA_URL
+  ota.printStats(Serial);
+  if(otaRequest.busy()){
+    Serial.printf("downloading, %lu bytes so far\n", (unsigned long)otaRequest.bodyBytes());
+  }else{
+    otaDue = true;
+    Serial.printf("checking %s/%s.delta\n", OTA_URL, ota.imageId());
+  }
+#else
+  Serial.println("updates off, OTA_URL isn't set");
+#endif
+}
 
-      display.drawBitmap(30, 5,  snow, 64, 64, 1);
-      display.display();
+void printScreenCache(){
+  static const char *const names[] = {"none", "inside", "derived", "outside", "forecast", "summary"};
+  screenCache.printStats(Serial, names, sizeof(names) / sizeof(names[0]));
+}
 
+void applyCurrentModel(){
+#ifdef ENERGY_CURRENT_MODEL
+  for(size_t i = 0; i < sizeof(currentModel) / sizeof(currentModel[0]); i++){
+    if(!station.energy.setCurrent(currentModel[i].use, currentModel[i].milliamps)){
+      LOG_ERROR("ENERGY_CURRENT_MODEL: no use called %s", currentModel[i].use);
     }
+  }
+#endif
+}
 
-    if(id == 800){ 
+void printEnergy(){
+  const EnergyMeter &energy = station.energy;
+  uint32_t now = millis();
+  Serial.printf("%-16s %10s %7s %6s %9s\n", "use", "on ms", "events", "mA", "mAh");
+  for(int i = 0; i < ENERGY_COUNT; i++){
+    EnergyUse use = (EnergyUse)i;
+    char events[12] = "-";
+    if(!EnergyMeter::derived(use)){
+      snprintf(events, sizeof(events), "%lu", (unsigned long)energy.eventCount(use));
+    }
+    Serial.printf("%-16s %10llu %7s %6.1f %9.3f\n", energyUseNames[i], (unsigned long long)energy.onTime(use, now),
+                  events, energy.current[i], energy.milliampHours(use, now));
+  }
+  Serial.printf("%.2f mAh in %lu s, %.0f mAh per day\n", energy.totalMilliampHours(now),
+                (unsigned long)energy.elapsed(now) / 1000, energy.milliampHoursPerDay(now));
+}
 
-      display.drawBitmap(30, 5,  clear_sky, 64, 64, 1);
-      display.display();
+/*advances the background requests, called whenever the station waits*/
+void serviceRequests(){
+  HeapTagScope scope(HEAP_TAG_HTTP);
+  forecastRequest.poll();
+
+  if(uploadPending && !uploadRequest.poll()){
+    uploadPending = false;
+    printRequestResult(uploadRequest);
+    countHandshake(STATION_HOST_THINGSPEAK, uploadRequest);
+
+    TraceRecord record = {};
+    record.kind = TRACE_UPLOAD;
+    record.time = millis() - uploadRequest.elapsed();
+    record.duration = uploadRequest.elapsed();
+    record.result = requestResult(uploadRequest);
+    traceRecord(record);
+  }
+  serviceOta();
+}
 
-    }
+/*HTTP status code, or the AsyncHttpError as a negative number*/
+int requestResult(const AsyncHttpRequest &request){
+  if(request.getState() == ASYNC_HTTP_DONE){
+    return request.status();
+  }
+  return -request.error();
+}
 
-    if(id == 801){
-      display.drawBitmap(30, 5, cloud1, 64, 64, 1);
-      display.display();
-    }
+void printRequestResult(const AsyncHttpRequest &request){
+  if(request.getState() == ASYNC_HTTP_DONE){
+    LOG_INFO("HTTP Response code: %d", request.status());
+  }else if(request.error() == ASYNC_HTTP_TLS_FAILED){
+    LOG_WARN("Error code:%s -0x%04x", AsyncHttpRequest::errorName(request.error()), -request.tlsError());
+  }else{
+    LOG_WARN("Error code:%s", AsyncHttpRequest::errorName(request.error()));
+  }
+}
 
-    if(id == 802){
-      display.drawBitmap(30, 5, cloud2, 64, 64, 1);
-      display.display();
-    }
+void countHandshake(int host, const AsyncHttpRequest &request){
+  if(!request.secure()){
+    return;
+  }
+  TlsStats &stats = tlsStats[host];
+  if(request.handshakeTime() == 0){
+    /*didn't get through the handshake, timeouts and refused
+    connections aren't TLS's fault*/
+    if(request.error() == ASYNC_HTTP_TLS_FAILED) stats.failed++;
+    return;
+  }
+  int kind = request.resumed() ? 1 : 0;
+  stats.count[kind]++;
+  stats.totalMs[kind] += request.handshakeTime();
+  if(request.handshakeTime() > stats.maxMs[kind]) stats.maxMs[kind] = request.handshakeTime();
+  if(request.handshakeHeap() > stats.maxHeap[kind]) stats.maxHeap[kind] = request.handshakeHeap();
+}
 
-    if(id == 803 || id == 804){
-      display.drawBitmap(30, 5, cloud3, 64, 64, 1);
-      display.display();
+void printTlsStats(){
+  const char *kinds[] = {"full", "resumed"};
+  for(int host = 0; host < station.outbound.hostCount(); host++){
+    const TlsStats &stats = tlsStats[host];
+    for(int kind = 0; kind < 2; kind++){
+      Serial.printf("%-22s %-7s %4lu handshakes, %5lu ms average, %5lu ms at most, %6lu bytes heap at most\n",
+                    station.outbound.host(host).name, kinds[kind], (unsigned long)stats.count[kind],
+                    stats.count[kind] ? (unsigned long)(stats.totalMs[kind] / stats.count[kind]) : 0UL,
+                    (unsigned long)stats.maxMs[kind], (unsigned long)stats.maxHeap[kind]);
     }
+    Serial.printf("%-22s %lu failed\n", station.outbound.host(host).name, (unsigned long)stats.failed);
   }
 }
 
-void displayThirdForecast(int forecastInterval, int id, const char * time_3, int temperature3){
-  displayTimer = 0;
-  display.clearDisplay();
-  display.setCursor(0,0);
-  display.setTextSize(1);
-  display.print(time_3);
-  display.setCursor(90,50);
-  display.print(temperature3);
-  display.print(" ");
-  display.cp437(true);
-  display.write(167);
-  display.print("C");
+void DeviceIo::showForecast(int location, int first, const ForecastSlot *slots, int count, uint32_t durationMs){
+  (void)first;
+  if(panelOff()){
+    waitUntil(millis() + durationMs);
+    return;
+  }
+  HeapTagScope scope(HEAP_TAG_DISPLAY);
+  /*ends in displayForecast, before it waits*/
+  flightRecord(FLIGHT_RENDER, FLIGHT_BEGIN, SCREEN_FORECAST);
+  /*forecast screens of one place follow each other sideways, the next
+  place scrolls in from below*/
+  if(screen == SCREEN_FORECAST){
+    display.setTransition(location == shownLocation ? TRANSITION_WIPE_LEFT : TRANSITION_SLIDE_UP);
+  }
+  enterScreen(SCREEN_FORECAST, TRANSITION_SLIDE_UP);
+  shownLocation = location;
+  const char *place = locationCount > 1 ? locations[location].city : NULL;
+  displayForecast(durationMs, slots, count, place);
+}
 
-  while(displayTimer<forecastInterval){
+/*the wake input every time round, the clock and light once a second*/
+void DeviceIo::servicePower(){
+  uint32_t now = millis();
+#ifdef DISPLAY_WAKE_PIN
+  if(digitalRead(DISPLAY_WAKE_PIN) == DISPLAY_WAKE_LEVEL && displayPower.activity(now)){
+    powerChanged();
+  }
+#endif
+  if(now - powerCheckedAt < 1000){
+    return;
+  }
+  powerCheckedAt = now;
+#ifdef DISPLAY_LIGHT_PIN
+  int light = analogRead(DISPLAY_LIGHT_PIN);
+#else
+  int light = -1;
+#endif
+  if(displayPower.update(now, localMinute(), light)){
+    powerChanged();
+  }
+  int8_t dx, dy;
+  displayPower.shift(now, dx, dy);
+  display.setShift(dx, dy);
+}
 
-    if(inRange(id,200,299)){ 
+void DeviceIo::powerChanged(){
+  uint32_t now = millis();
+  display.setContrast(displayPower.contrast());
+  bool on = displayPower.on();
+  if(on && stale && !isnan(lastInsideTemp)){
+    screen = SCREEN_INSIDE;
+    displayInsideTemp(lastInsideTemp, lastHumidity);
+  }
+  stale = false;
+  display.setPower(on);
+  station.energy.set(ENERGY_OLED, on, now);
+}
 
-      display.drawBitmap(30, 5,  thunderstorm, 64, 64, 1);
-      display.display();
+#ifdef FORECAST_SUMMARY
+int DeviceIo::forecastDays(ForecastDay *days, int max){
+  int count = forecastStream.dayCount();
+  if(count > max){
+    count = max;
+  }
+  memcpy(days, forecastStream.getDays(), count * sizeof(ForecastDay));
+  return count;
+}
 
+void DeviceIo::showSummary(int location, const ForecastDay *days, int count, uint32_t durationMs){
+  if(panelOff()){
+    waitUntil(millis() + durationMs);
+    return;
+  }
+  HeapTagScope scope(HEAP_TAG_DISPLAY);
+  {
+    FlightScope render(FLIGHT_RENDER, SCREEN_SUMMARY);
+    enterScreen(SCREEN_SUMMARY, TRANSITION_SLIDE_UP);
+    shownLocation = location;
+    ScreenKey key(SCREEN_SUMMARY);
+    for(int i = 0; i < count; i++){
+      key.add(days[i].day).add(days[i].minTemp).add(days[i].maxTemp).add(days[i].weatherId);
     }
+    displayCached(key, [&]{ drawSummaryScreen(display, days, count); });
+  }
+  waitUntil(millis() + durationMs);
+}
+#endif
+
+void traceRecord(const TraceRecord &record){
+#ifdef STATION_TRACE
+  char line[128];
+  int n = formatTraceRecord(record, line, sizeof(line));
+  /*trace lines are wanted whatever LOG_LEVEL is, replay notices the
+  ones dropped as gaps*/
+  logText("", line, n < (int)sizeof(line) ? n : sizeof(line) - 1);
+#endif
+}
 
-    if(inRange(id,200,299)){ 
+/*Parses the forecast in jsonBuffer and fills count slots. Returns
+number of slots filled or -1 if parsing failed*/
+int parseForecast(ForecastSlot *slots, int count){
+  HeapTagScope scope(HEAP_TAG_JSON);
+  FlightScope flight(FLIGHT_PARSE);
+  /*the answer as it came, printing the tree would build the text again*/
+  LOG_DEBUG_TEXT("JSON object = ", jsonBuffer.c_str(), jsonBuffer.length());
+
+  uint32_t started = micros();
+#ifdef JSON_NO_ARENA
+  jsonArena.begin(0);
+#else
+  jsonArena.begin(jsonBuffer.length() * JSON_ARENA_FACTOR);
+#endif
+  /*only this parse goes to the arena, anything else in the firmware that
+  uses cJSON keeps malloc and free*/
+  cJSON_Hooks hooks = {jsonMalloc, jsonFree};
+  cJSON_InitHooks(&hooks);
+  int filled = readForecast(slots, count);
+  /*the tree is gone with readForecast's JSONVar*/
+  cJSON_InitHooks(NULL);
+  jsonArena.end();
+
+  uint32_t took = micros() - started;
+  jsonStats.totalUs += took;
+  if(took > jsonStats.maxUs) jsonStats.maxUs = took;
+  uint32_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+  if(largest < jsonStats.minLargestBlock) jsonStats.minLargestBlock = largest;
+  return filled;
+}
 
-      display.drawBitmap(30, 5,  thunderstorm, 64, 64, 1);
-      display.display();
+void printJsonStats(){
+  const JsonArenaStats &s = jsonArena.stats();
+  uint32_t parses = s.parses > 0 ? s.parses : 1;
+  Serial.printf("%lu parses, %lu us average, %lu us at most, %lu allocations each, %lu of them from malloc\n",
+                (unsigned long)s.parses, (unsigned long)(jsonStats.totalUs / parses), (unsigned long)jsonStats.maxUs,
+                (unsigned long)(s.allocations / parses), (unsigned long)(s.overflows / parses));
+  Serial.printf("arena %lu bytes, %lu used at most, grown %lu times\n", (unsigned long)jsonArena.size(),
+                (unsigned long)s.highWater, (unsigned long)s.grows);
+  Serial.printf("largest free block %lu now, %lu at least after a parse\n",
+                (unsigned long)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT),
+                (unsigned long)(s.parses > 0 ? jsonStats.minLargestBlock : 0));
+}
 
-    }
+void countTransfer(const AsyncHttpRequest &request){
+#ifndef FORECAST_NO_GZIP
+  if(request.error() == ASYNC_HTTP_INFLATE_FAILED){
+    LOG_WARN("Forecast gzip %s with a %u byte window, asking for plain JSON from now on",
+             GzipInflater::errorName(gzipInflater.error()), GZIP_WINDOW);
+    gzipForecast = false;
+  }
+  if(request.compressed() && gzipInflater.farthest() > gzipFarthest){
+    gzipFarthest = gzipInflater.farthest();
+  }
+#endif
+  if(request.getState() != ASYNC_HTTP_DONE){
+    return;
+  }
+  TransferStats &stats = transferStats[request.compressed() ? 1 : 0];
+  stats.fetches++;
+  stats.wireBytes += request.bodyBytes();
+  stats.bodyBytes += request.inflatedBytes();
+  stats.totalMs += request.elapsed();
+}
 
-    if(inRange(id,300,501)){ 
+void printTransferStats(){
+  static const char *const names[] = {"plain", "gzip"};
+  for(int i = 0; i < 2; i++){
+    const TransferStats &s = transferStats[i];
+    uint32_t fetches = s.fetches > 0 ? s.fetches : 1;
+    Serial.printf("%-5s %lu fetches, %lu bytes on the wire for %lu of JSON each (%.0f %%), %lu ms a fetch\n", names[i],
+                  (unsigned long)s.fetches, (unsigned long)(s.wireBytes / fetches), (unsigned long)(s.bodyBytes / fetches),
+                  s.bodyBytes > 0 ? 100.0 * s.wireBytes / s.bodyBytes : 0.0, (unsigned long)(s.totalMs / fetches));
+  }
+#ifdef FORECAST_NO_GZIP
+  Serial.println("gzip off, FORECAST_NO_GZIP");
+#else
+  Serial.printf("gzip %s, window %u bytes, farthest reference %lu bytes back\n", gzipForecast ? "on" : "off after a failure",
+                GZIP_WINDOW, (unsigned long)gzipFarthest);
+#endif
+}
 
-      display.drawBitmap(30, 5,  drizzle, 64, 64, 1);
-      display.display();
+int readForecast(ForecastSlot *slots, int count){
+  JSONVar weatherForecast = JSON.parse(jsonBuffer);
+
+  /*an error response parses fine but has no list, that must not
+  be read as a forecast*/
+  if(JSON.typeof(weatherForecast) == "undefined" || JSON.typeof(weatherForecast["list"]) != "array"){
+    LOG_WARN("Parsing JSON failed!");
+    return -1;
+  }
 
+  int filled = 0;
+  for(int i = 0; i < count; i++){
+    /*to display time of the forecasted weather access to
+    dt_txt variable of JSON is needed. This contains the date and
+    the time but only time is needed. Time is in form HH:MM:SS 
+    but this is too long to be displayed in small oled. That's
+    why it's parsed to HH:MM form*/
+    const char *date = weatherForecast["list"][i]["dt_txt"];
+    if(date == NULL || strlen(date) < 16){
+      break;
     }
 
-    if(inRange(id,600,699)){ 
+    /*each char takes 1 byte of program memory so time + 11 should
+    end up to first element of time part of the dt_txt, as long as
+    openWeather doesn't change api*/
+    memcpy(slots[i].time, date + 11, 5);
+    slots[i].time[5] = '\0';
 
-      display.drawBitmap(30, 5,  snow, 64, 64, 1);
-      display.display();
+    /*weatherId is unique ID number from API to define weather.
+    weatherId picks the weather icon in drawForecastScreen*/
+    slots[i].weatherId = weatherForecast["list"][i]["weather"][0]["id"];
 
-    }
+    int forecastTemp = weatherForecast["list"][i]["main"]["temp"];
+    slots[i].temperature = forecastTemp - 273;
+    filled++;
+  }
+  return filled;
+}
 
-    if(id == 800){ 
+/*Sends the latest readings to the fleet collector. UDP is fire and forget,
+a lost frame shows up in the collector's loss counter through the sequence
+number. DS18B20 reports -127 when the probe is disconnected so that isn't
+sent as a reading. On a weak link frames wait until station.link.batch()
+of them go in one datagram, the collector splits them again*/
+void sendCollectorFrame(float outsideTemp, float insideTemp, float humidity){
+#ifdef COLLECTOR_HOST
+  StationFrame frame = {};
+  frame.stationId = (uint32_t)ESP.getEfuseMac();
+  frame.sequence = collectorSequence++;
+
+  if(outsideTemp > -127 && toCentiUnits(outsideTemp, frame.outsideTemp)){
+    frame.flags |= STATION_FRAME_HAS_OUTSIDE;
+  }
+  if(toCentiUnits(insideTemp, frame.insideTemp)){
+    frame.flags |= STATION_FRAME_HAS_INSIDE;
+  }
+  int16_t centiHumidity;
+  if(toCentiUnits(humidity, centiHumidity)){
+    frame.humidity = (uint16_t)centiHumidity;
+    frame.flags |= STATION_FRAME_HAS_HUMIDITY;
+  }
 
-      display.drawBitmap(30, 5,  clear_sky, 64, 64, 1);
-      display.display();
+  /*a full batch whose datagram is still held back drops the frame, the
+  collector sees it as lost*/
+  if(collectorPending < STATION_FRAME_MAX_BATCH){
+    encodeStationFrame(frame, collectorBatch + collectorPending * STATION_FRAME_SIZE);
+    collectorPending++;
+  }
+  if(collectorPending < station.link.batch() && collectorPending < STATION_FRAME_MAX_BATCH){
+    return;
+  }
+  if(collectorHost >= 0 && !station.outbound.queued(collectorHost, 0)){
+    station.outbound.submit(collectorHost, STATION_PRIORITY_BACKGROUND, 0, millis());
+  }
+#endif
+}
 
-    }
+/*the datagram outbound let go, with every frame batched up to now. It
+goes at the start of the next pass, or later when an upload or forecast
+takes the radio first*/
+int sendCollectorBatch(){
+#ifdef COLLECTOR_HOST
+  if(collectorPending == 0){
+    return -ASYNC_HTTP_CANCELLED;
+  }
+  size_t len = collectorPending * STATION_FRAME_SIZE;
+  collectorUdp.beginPacket(COLLECTOR_HOST, COLLECTOR_PORT);
+  collectorUdp.write(collectorBatch, len);
+  collectorUdp.endPacket();
+  /*endPacket() returns before the frame is on the air, count the radio
+  waking from modem sleep and sending one short datagram*/
+  station.energy.add(ENERGY_UDP, 2);
+  station.link.datagram(collectorPending, len, 2);
+  collectorPending = 0;
+  /*nothing answers a datagram, it counts as delivered*/
+  return 200;
+#else
+  return -ASYNC_HTTP_CANCELLED;
+#endif
+}
 
-    if(id == 801){
-      display.drawBitmap(30, 5, cloud1, 64, 64, 1);
-      display.display();
-    }
+//Method to display inside temperature
 
-    if(id == 802){
-      display.drawBitmap(30, 5, cloud2, 64, 64, 1);
-      display.display();
-    }
+void displayInsideTemp(float insideTemp, float hum){
+  ScreenKey key(DeviceIo::SCREEN_INSIDE);
+  key.addReading(insideTemp, 2).addReading(hum, 2);
+  displayCached(key, [&]{ drawInsideScreen(display, insideTemp, hum); });
+}
 
-    if(id == 803 || id == 804){
-      display.drawBitmap(30, 5, cloud3, 64, 64, 1);
-      display.display();
-    }
-  }
+//Method to display outside temperature
+
+void displayOutsideTemp(float outsideTemp){
+  ScreenKey key(DeviceIo::SCREEN_OUTSIDE);
+  key.addReading(outsideTemp, 2);
+  displayCached(key, [&]{ drawOutsideScreen(display, outsideTemp); });
 }
 
-/*function inRange() checks if value is between given min and max
-returns boolean true or false*/
-bool inRange(int val, int min, int max){
-  return ((min <= val) && (val <= max));
+/*shows forecast slots in FORECAST_LAYOUT for forecastInterval ms, requests keep
+running while it is on screen*/
+void displayForecast(int forecastInterval, const ForecastSlot *slots, int count, const char *place){
+  ScreenKey key(DeviceIo::SCREEN_FORECAST);
+  key.add((int)FORECAST_LAYOUT).addText(place);
+  for(int i = 0; i < count; i++){
+    key.add(slots[i].weatherId).addText(slots[i].time).add(slots[i].temperature);
+  }
+  displayCached(key, [&]{ drawForecastScreen(display, slots, count, FORECAST_LAYOUT, place); });
+  flightRecord(FLIGHT_RENDER, FLIGHT_END, DeviceIo::SCREEN_FORECAST);
+  deviceIo.waitUntil(millis() + forecastInterval);
 }
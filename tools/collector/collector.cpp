@@ -0,0 +1,393 @@
+/*Fleet collector for YetAnotherESP32WeatherStation.
+
+Stations send a StationFrame (lib/StationFrame) over UDP after every
+measurement round, or on a weak link a few of them back to back in one
+datagram. The collector drains the socket with recvmmsg() from an
+epoll loop, keeps a running aggregate per station in memory and every flush
+interval appends one CSV row per station that reported something to an
+append-only file, all rows of one flush in a single write().
+
+usage: collector [--port 4210] [--out readings.csv] [--flush-ms 1000]
+                 [--stats-s 10]*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "StationFrame.h"
+
+/*datagrams fetched per recvmmsg() call*/
+static const int RECV_BATCH = 64;
+
+struct Options {
+  int port = 4210;
+  const char *outPath = "readings.csv";
+  int flushMs = 1000;
+  int statsSeconds = 10;
+};
+
+/*values collected from one station since the previous flush*/
+struct Channel {
+  int64_t sum = 0;
+  uint32_t count = 0;
+  int16_t min = 0;
+  int16_t max = 0;
+
+  void add(int16_t v){
+    if(count == 0 || v < min) min = v;
+    if(count == 0 || v > max) max = v;
+    sum += v;
+    count++;
+  }
+};
+
+struct StationAgg {
+  uint32_t lastSequence = 0;
+  bool seen = false;
+  uint32_t frames = 0;
+  uint32_t lost = 0;
+  Channel outside, inside, humidity;
+};
+
+struct Totals {
+  uint64_t frames = 0;
+  uint64_t badFrames = 0;
+  uint64_t lost = 0;
+  uint64_t rows = 0;
+  uint64_t bytesWritten = 0;
+  uint64_t flushNanos = 0;
+};
+
+static uint64_t nowMillis(clockid_t clock){
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static bool parseOptions(int argc, char **argv, Options &opt){
+  for(int i = 1; i < argc; i++){
+    const char *arg = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+    if(value == NULL){
+      return false;
+    }
+    if(strcmp(arg, "--port") == 0) opt.port = atoi(value);
+    else if(strcmp(arg, "--out") == 0) opt.outPath = value;
+    else if(strcmp(arg, "--flush-ms") == 0) opt.flushMs = atoi(value);
+    else if(strcmp(arg, "--stats-s") == 0) opt.statsSeconds = atoi(value);
+    else return false;
+    i++;
+  }
+  return opt.port > 0 && opt.flushMs > 0 && opt.statsSeconds > 0;
+}
+
+static int openSocket(int port){
+  int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+  if(fd < 0){
+    return -1;
+  }
+  /*a large receive buffer rides out the time spent in a flush*/
+  int rcvbuf = 32 * 1024 * 1024;
+  setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0){
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static int openTimer(int periodMs){
+  int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+  if(fd < 0){
+    return -1;
+  }
+  struct itimerspec spec;
+  spec.it_interval.tv_sec = periodMs / 1000;
+  spec.it_interval.tv_nsec = (periodMs % 1000) * 1000000L;
+  spec.it_value = spec.it_interval;
+  timerfd_settime(fd, 0, &spec, NULL);
+  return fd;
+}
+
+class Collector {
+ public:
+  explicit Collector(int outFd) : outFd(outFd){
+    stations.reserve(1 << 16);
+    dirty.reserve(1 << 16);
+    rows.reserve(1 << 20);
+  }
+
+  /*a datagram is one or more whole frames*/
+  void handleDatagram(const uint8_t *data, size_t len){
+    if(len == 0 || len % STATION_FRAME_SIZE != 0){
+      totals.badFrames++;
+      return;
+    }
+    for(size_t at = 0; at < len; at += STATION_FRAME_SIZE){
+      handleFrame(data + at, STATION_FRAME_SIZE);
+    }
+  }
+
+  void handleFrame(const uint8_t *data, size_t len){
+    StationFrame frame;
+    if(!decodeStationFrame(data, len, frame)){
+      totals.badFrames++;
+      return;
+    }
+    totals.frames++;
+
+    StationAgg &agg = stations[frame.stationId];
+    if(agg.frames == 0){
+      dirty.push_back(frame.stationId);
+    }
+    if(agg.seen){
+      uint32_t gap = frame.sequence - agg.lastSequence;
+      /*anything that looks like a large step backwards is a station that
+      rebooted and started counting from zero again*/
+      if(gap > 1 && gap < 0x80000000u){
+        agg.lost += gap - 1;
+        totals.lost += gap - 1;
+      }
+    }
+    agg.seen = true;
+    agg.lastSequence = frame.sequence;
+    agg.frames++;
+
+    if(frame.flags & STATION_FRAME_HAS_OUTSIDE) agg.outside.add(frame.outsideTemp);
+    if(frame.flags & STATION_FRAME_HAS_INSIDE) agg.inside.add(frame.insideTemp);
+    if(frame.flags & STATION_FRAME_HAS_HUMIDITY) agg.humidity.add((int16_t)frame.humidity);
+  }
+
+  /*appends one row per station that reported since last flush*/
+  bool flush(){
+    if(dirty.empty()){
+      return true;
+    }
+    uint64_t started = nowNanos();
+    uint64_t stamp = nowMillis(CLOCK_REALTIME);
+
+    rows.clear();
+    for(size_t i = 0; i < dirty.size(); i++){
+      StationAgg &agg = stations[dirty[i]];
+      char line[160];
+      int n = snprintf(line, sizeof(line), "%llu,%u,%u,%u,",
+                       (unsigned long long)stamp, dirty[i], agg.frames, agg.lost);
+      rows.append(line, n);
+      appendChannel(agg.outside, true);
+      appendChannel(agg.inside, false);
+      appendChannel(agg.humidity, false);
+      rows.back() = '\n';
+
+      agg.frames = 0;
+      agg.lost = 0;
+      agg.outside = Channel();
+      agg.inside = Channel();
+      agg.humidity = Channel();
+    }
+    totals.rows += dirty.size();
+    dirty.clear();
+
+    const char *p = rows.data();
+    size_t left = rows.size();
+    while(left > 0){
+      ssize_t written = write(outFd, p, left);
+      if(written < 0){
+        if(errno == EINTR) continue;
+        perror("write");
+        return false;
+      }
+      p += written;
+      left -= written;
+    }
+    totals.bytesWritten += rows.size();
+    totals.flushNanos += nowNanos() - started;
+    return true;
+  }
+
+  size_t stationCount() const { return stations.size(); }
+
+  Totals totals;
+
+ private:
+  static uint64_t nowNanos(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+  }
+
+  static void appendCenti(std::string &out, int64_t v){
+    char buf[24];
+    const char *sign = v < 0 ? "-" : "";
+    if(v < 0) v = -v;
+    int n = snprintf(buf, sizeof(buf), "%s%lld.%02lld", sign, (long long)(v / 100), (long long)(v % 100));
+    out.append(buf, n);
+  }
+
+  /*avg,min,max for outside temperature, avg only for the rest.
+  Every field ends with a comma, flush() turns the last one into newline*/
+  void appendChannel(const Channel &ch, bool withRange){
+    if(ch.count > 0){
+      int64_t avg = ch.sum / (int64_t)ch.count;
+      appendCenti(rows, avg);
+    }
+    rows.push_back(',');
+    if(withRange){
+      if(ch.count > 0) appendCenti(rows, ch.min);
+      rows.push_back(',');
+      if(ch.count > 0) appendCenti(rows, ch.max);
+      rows.push_back(',');
+    }
+  }
+
+  int outFd;
+  std::unordered_map<uint32_t, StationAgg> stations;
+  std::vector<uint32_t> dirty;
+  std::string rows;
+};
+
+static void drainSocket(int fd, Collector &collector){
+  static uint8_t buffers[RECV_BATCH][STATION_FRAME_SIZE * STATION_FRAME_MAX_BATCH];
+  struct mmsghdr msgs[RECV_BATCH];
+  struct iovec iovs[RECV_BATCH];
+
+  for(;;){
+    for(int i = 0; i < RECV_BATCH; i++){
+      iovs[i].iov_base = buffers[i];
+      iovs[i].iov_len = sizeof(buffers[i]);
+      memset(&msgs[i].msg_hdr, 0, sizeof(msgs[i].msg_hdr));
+      msgs[i].msg_hdr.msg_iov = &iovs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    int n = recvmmsg(fd, msgs, RECV_BATCH, MSG_DONTWAIT, NULL);
+    if(n < 0){
+      if(errno == EINTR) continue;
+      if(errno != EAGAIN && errno != EWOULDBLOCK) perror("recvmmsg");
+      return;
+    }
+    for(int i = 0; i < n; i++){
+      /*anything longer than a full batch isn't from a station*/
+      collector.handleDatagram(buffers[i], msgs[i].msg_hdr.msg_flags & MSG_TRUNC ? 0 : msgs[i].msg_len);
+    }
+    if(n < RECV_BATCH){
+      return;
+    }
+  }
+}
+
+int main(int argc, char **argv){
+  Options opt;
+  if(!parseOptions(argc, argv, opt)){
+    fprintf(stderr, "usage: %s [--port N] [--out FILE] [--flush-ms N] [--stats-s N]\n", argv[0]);
+    return 2;
+  }
+
+  int outFd = open(opt.outPath, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if(outFd < 0){
+    perror(opt.outPath);
+    return 1;
+  }
+  int sockFd = openSocket(opt.port);
+  if(sockFd < 0){
+    perror("socket");
+    return 1;
+  }
+  int timerFd = openTimer(opt.flushMs);
+
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGINT);
+  sigaddset(&mask, SIGTERM);
+  sigprocmask(SIG_BLOCK, &mask, NULL);
+  int sigFd = signalfd(-1, &mask, SFD_NONBLOCK);
+
+  int ep = epoll_create1(0);
+  int fds[] = {sockFd, timerFd, sigFd};
+  for(int fd : fds){
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+  }
+
+  fprintf(stderr, "collector listening on udp/%d, writing %s\n", opt.port, opt.outPath);
+
+  Collector collector(outFd);
+  Totals last;
+  uint64_t lastStats = nowMillis(CLOCK_MONOTONIC);
+  bool running = true;
+
+  while(running){
+    struct epoll_event events[4];
+    int n = epoll_wait(ep, events, 4, -1);
+    if(n < 0 && errno != EINTR){
+      perror("epoll_wait");
+      break;
+    }
+    for(int i = 0; i < n; i++){
+      int fd = events[i].data.fd;
+      if(fd == sockFd){
+        drainSocket(sockFd, collector);
+      }else if(fd == timerFd){
+        uint64_t expirations;
+        if(read(timerFd, &expirations, sizeof(expirations)) < 0){
+          continue;
+        }
+        if(!collector.flush()){
+          running = false;
+        }
+      }else if(fd == sigFd){
+        running = false;
+      }
+    }
+
+    uint64_t now = nowMillis(CLOCK_MONOTONIC);
+    if(now - lastStats >= (uint64_t)opt.statsSeconds * 1000){
+      const Totals &t = collector.totals;
+      double seconds = (now - lastStats) / 1000.0;
+      fprintf(stderr, "%.0f frames/s, %llu bad, %llu lost, %zu stations, %llu rows, %.1f KiB written, flush %.2f ms total\n",
+              (t.frames - last.frames) / seconds,
+              (unsigned long long)(t.badFrames - last.badFrames),
+              (unsigned long long)(t.lost - last.lost),
+              collector.stationCount(),
+              (unsigned long long)(t.rows - last.rows),
+              (t.bytesWritten - last.bytesWritten) / 1024.0,
+              (t.flushNanos - last.flushNanos) / 1e6);
+      last = t;
+      lastStats = now;
+    }
+  }
+
+  /*pick up whatever is still queued before exiting*/
+  drainSocket(sockFd, collector);
+  collector.flush();
+  fprintf(stderr, "collector stopped: %llu frames, %llu bad, %llu lost, %llu rows\n",
+          (unsigned long long)collector.totals.frames,
+          (unsigned long long)collector.totals.badFrames,
+          (unsigned long long)collector.totals.lost,
+          (unsigned long long)collector.totals.rows);
+  close(ep);
+  close(sockFd);
+  close(outFd);
+  return 0;
+}
@@ -0,0 +1,201 @@
+/*Load generator for the fleet collector. Emulates a number of stations
+each sending a StationFrame at a fixed rate, with readings that drift like
+real temperatures, and reports how many frames actually went out.
+
+usage: loadgen [--host 127.0.0.1] [--port 4210] [--stations 20000]
+               [--rate 1] [--seconds 30] [--loss 0]
+
+--rate is frames per second per station, --loss is the percentage of frames
+that are skipped (sequence still advances) so the collector's loss counter
+can be checked against it.*/
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "StationFrame.h"
+
+static const int SEND_BATCH = 64;
+
+struct Options {
+  const char *host = "127.0.0.1";
+  int port = 4210;
+  int stations = 20000;
+  double rate = 1.0;
+  int seconds = 30;
+  int lossPercent = 0;
+};
+
+struct FakeStation {
+  uint32_t sequence;
+  float outside;
+  float inside;
+  float humidity;
+};
+
+static bool parseOptions(int argc, char **argv, Options &opt){
+  for(int i = 1; i < argc; i++){
+    const char *arg = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+    if(value == NULL){
+      return false;
+    }
+    if(strcmp(arg, "--host") == 0) opt.host = value;
+    else if(strcmp(arg, "--port") == 0) opt.port = atoi(value);
+    else if(strcmp(arg, "--stations") == 0) opt.stations = atoi(value);
+    else if(strcmp(arg, "--rate") == 0) opt.rate = atof(value);
+    else if(strcmp(arg, "--seconds") == 0) opt.seconds = atoi(value);
+    else if(strcmp(arg, "--loss") == 0) opt.lossPercent = atoi(value);
+    else return false;
+    i++;
+  }
+  return opt.stations > 0 && opt.rate > 0 && opt.seconds > 0;
+}
+
+static double nowSeconds(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*small random step, good enough to make the readings move*/
+static float drift(float value, float step, float lo, float hi){
+  value += step * ((rand() % 201) - 100) / 100.0f;
+  if(value < lo) value = lo;
+  if(value > hi) value = hi;
+  return value;
+}
+
+static void buildFrame(uint32_t id, FakeStation &st, uint8_t *out){
+  st.outside = drift(st.outside, 0.05f, -30, 35);
+  st.inside = drift(st.inside, 0.02f, 15, 28);
+  st.humidity = drift(st.humidity, 0.1f, 10, 90);
+
+  StationFrame frame;
+  frame.flags = 0;
+  frame.stationId = id;
+  frame.sequence = st.sequence++;
+  if(toCentiUnits(st.outside, frame.outsideTemp)) frame.flags |= STATION_FRAME_HAS_OUTSIDE;
+  if(toCentiUnits(st.inside, frame.insideTemp)) frame.flags |= STATION_FRAME_HAS_INSIDE;
+  int16_t hum;
+  if(toCentiUnits(st.humidity, hum)) frame.flags |= STATION_FRAME_HAS_HUMIDITY;
+  frame.humidity = (uint16_t)hum;
+  encodeStationFrame(frame, out);
+}
+
+int main(int argc, char **argv){
+  Options opt;
+  if(!parseOptions(argc, argv, opt)){
+    fprintf(stderr, "usage: %s [--host A] [--port N] [--stations N] [--rate HZ] [--seconds N] [--loss PCT]\n", argv[0]);
+    return 2;
+  }
+
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  int sndbuf = 8 * 1024 * 1024;
+  setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(opt.port);
+  if(inet_pton(AF_INET, opt.host, &addr.sin_addr) != 1){
+    fprintf(stderr, "bad address %s\n", opt.host);
+    return 2;
+  }
+  if(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0){
+    perror("connect");
+    return 1;
+  }
+
+  std::vector<FakeStation> stations(opt.stations);
+  for(size_t i = 0; i < stations.size(); i++){
+    stations[i].sequence = 0;
+    stations[i].outside = (float)(rand() % 4000) / 100.0f - 20.0f;
+    stations[i].inside = 21.0f;
+    stations[i].humidity = 40.0f;
+  }
+
+  uint8_t buffers[SEND_BATCH][STATION_FRAME_SIZE];
+  struct mmsghdr msgs[SEND_BATCH];
+  struct iovec iovs[SEND_BATCH];
+  memset(msgs, 0, sizeof(msgs));
+  for(int i = 0; i < SEND_BATCH; i++){
+    iovs[i].iov_base = buffers[i];
+    iovs[i].iov_len = STATION_FRAME_SIZE;
+    msgs[i].msg_hdr.msg_iov = &iovs[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  /*frames are spread evenly over time: at any moment the number of frames
+  that should have gone out is elapsed * stations * rate, and each station
+  takes its turn round robin so every one of them sends at --rate*/
+  double framesPerSecond = opt.stations * opt.rate;
+  uint64_t due = 0, sent = 0, skipped = 0, errors = 0;
+  uint32_t next = 0;
+  double start = nowSeconds();
+  double end = start + opt.seconds;
+  double lastReport = start;
+  uint64_t lastSent = 0;
+
+  for(;;){
+    double now = nowSeconds();
+    if(now >= end){
+      break;
+    }
+    due = (uint64_t)((now - start) * framesPerSecond);
+
+    while(sent + skipped < due){
+      int batch = 0;
+      while(batch < SEND_BATCH && sent + skipped + batch < due){
+        FakeStation &st = stations[next];
+        if(opt.lossPercent > 0 && rand() % 100 < opt.lossPercent){
+          st.sequence++;
+          skipped++;
+        }else{
+          buildFrame(next, st, buffers[batch]);
+          batch++;
+        }
+        next = (next + 1) % stations.size();
+      }
+      if(batch == 0){
+        continue;
+      }
+      int n = sendmmsg(fd, msgs, batch, 0);
+      if(n < 0){
+        errors++;
+        if(errno != ENOBUFS && errno != EAGAIN){
+          perror("sendmmsg");
+          return 1;
+        }
+        n = 0;
+      }
+      /*frames the kernel didn't take are lost, same as on real WiFi*/
+      sent += n;
+      skipped += batch - n;
+    }
+
+    if(now - lastReport >= 1.0){
+      fprintf(stderr, "%.0f frames/s\n", (sent - lastSent) / (now - lastReport));
+      lastReport = now;
+      lastSent = sent;
+    }
+
+    struct timespec pause = {0, 1000000};
+    nanosleep(&pause, NULL);
+  }
+
+  double elapsed = nowSeconds() - start;
+  fprintf(stderr, "sent %llu frames from %d stations in %.1f s (%.0f frames/s), %llu skipped, %llu send errors\n",
+          (unsigned long long)sent, opt.stations, elapsed, sent / elapsed,
+          (unsigned long long)skipped, (unsigned long long)errors);
+  close(fd);
+  return 0;
+}
@@ -0,0 +1,161 @@
+/*Applies a patch from mkdelta to an image file with lib/Delta, the code
+the station runs, and writes the new image.
+
+The patch is fed --chunk bytes at a time like TCP segments arriving on the
+station, gzip patches through a --window byte inflater window. Reports the
+transfer size against the image, the time spent applying and checking the
+signature, and the memory the patch needed. Exits non-zero if the old
+image isn't the one the patch was made from, the new image's hash doesn't
+match or the patch isn't signed by the key in --public (the .pub file
+mkdelta --genkey wrote).
+
+usage: applydelta OLD PATCH NEW --public KEY.pub [--chunk BYTES] [--window BYTES]*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+
+#include "DeltaPatch.h"
+
+struct Options {
+  const char *files[3] = {NULL, NULL, NULL};
+  const char *publicKey = NULL;
+  size_t chunk = 1460;
+  size_t window = 8192;
+};
+
+static bool parseOptions(int argc, char **argv, Options &opt){
+  int files = 0;
+  for(int i = 1; i < argc; i++){
+    const char *arg = argv[i];
+    if(arg[0] != '-'){
+      if(files == 3){
+        return false;
+      }
+      opt.files[files++] = arg;
+      continue;
+    }
+    const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+    if(value == NULL){
+      return false;
+    }
+    if(strcmp(arg, "--chunk") == 0) opt.chunk = atoi(value);
+    else if(strcmp(arg, "--window") == 0) opt.window = atoi(value);
+    else if(strcmp(arg, "--public") == 0) opt.publicKey = value;
+    else return false;
+    i++;
+  }
+  bool powerOfTwo = opt.window > 0 && opt.window <= 32768 && (opt.window & (opt.window - 1)) == 0;
+  return files == 3 && opt.publicKey != NULL && opt.chunk > 0 && powerOfTwo;
+}
+
+static bool readFile(const char *path, std::vector<uint8_t> &out){
+  FILE *f = fopen(path, "rb");
+  if(f == NULL){
+    perror(path);
+    return false;
+  }
+  uint8_t buf[4096];
+  size_t n;
+  while((n = fread(buf, 1, sizeof(buf), f)) > 0){
+    out.insert(out.end(), buf, buf + n);
+  }
+  fclose(f);
+  return true;
+}
+
+static double nowUs(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/*the old image in memory, the new one collected for the output file*/
+class FileImages : public DeltaImages {
+ public:
+  std::vector<uint8_t> old, written;
+  uint32_t reads = 0, writes = 0;
+
+  bool readOld(uint32_t offset, uint8_t *data, size_t len) override {
+    reads++;
+    if(offset > old.size() || len > old.size() - offset){
+      return false;
+    }
+    memcpy(data, old.data() + offset, len);
+    return true;
+  }
+
+  bool writeNew(const uint8_t *data, size_t len) override {
+    writes++;
+    written.insert(written.end(), data, data + len);
+    return true;
+  }
+};
+
+int main(int argc, char **argv){
+  Options opt;
+  if(!parseOptions(argc, argv, opt)){
+    fprintf(stderr, "usage: %s OLD PATCH NEW --public KEY.pub [--chunk BYTES] [--window BYTES]\n", argv[0]);
+    return 2;
+  }
+  FileImages images;
+  std::vector<uint8_t> patchFile, publicKey;
+  if(!readFile(opt.files[0], images.old) || !readFile(opt.files[1], patchFile) ||
+     !readFile(opt.publicKey, publicKey)){
+    return 2;
+  }
+  if(publicKey.size() != ED25519_PUBLIC_BYTES){
+    fprintf(stderr, "%s: expected a %d byte public key\n", opt.publicKey, ED25519_PUBLIC_BYTES);
+    return 2;
+  }
+
+  std::vector<uint8_t> window(opt.window);
+  DeltaPatch patch(images, window.data(), window.size());
+  DeltaResult r = DELTA_MORE;
+  double started = nowUs();
+  for(size_t at = 0; at < patchFile.size() && r == DELTA_MORE; at += opt.chunk){
+    size_t len = patchFile.size() - at < opt.chunk ? patchFile.size() - at : opt.chunk;
+    r = patch.feed(patchFile.data() + at, len);
+  }
+  double took = nowUs() - started;
+  /*the station checks once the image is written, before it boots it*/
+  double checkStarted = nowUs();
+  if(r == DELTA_DONE && !patch.checkSignature(publicKey.data())){
+    r = DELTA_ERROR;
+  }
+  double checkTook = nowUs() - checkStarted;
+
+  if(patch.compressed()){
+    printf("gzip: %zu bytes inflated to %lu, farthest reference %lu bytes back, window %zu\n",
+           patchFile.size(), (unsigned long)patch.inflater().bytesOut(),
+           (unsigned long)patch.inflater().farthest(), window.size());
+  }
+  if(r != DELTA_DONE){
+    DeltaError e = r == DELTA_MORE ? DELTA_TRUNCATED : patch.error();
+    printf("failed after %lu bytes of the new image: %s", (unsigned long)patch.bytesOut(), DeltaPatch::errorName(e));
+    if(e == DELTA_INFLATE_FAILED){
+      printf(" (%s)", GzipInflater::errorName(patch.inflater().error()));
+    }
+    printf("\n");
+    return 1;
+  }
+
+  FILE *f = fopen(opt.files[2], "wb");
+  if(f == NULL || fwrite(images.written.data(), 1, images.written.size(), f) != images.written.size()){
+    perror(opt.files[2]);
+    return 2;
+  }
+  fclose(f);
+
+  const DeltaHeader &h = patch.header();
+  printf("old %lu bytes, new %lu bytes, hash and signature ok\n", (unsigned long)h.oldSize, (unsigned long)h.newSize);
+  printf("patch %zu bytes, %.1f %% of the new image\n", patchFile.size(), 100.0 * patchFile.size() / h.newSize);
+  printf("applied in %.1f ms (%.1f ns/byte), %lu old reads, %lu writes, %zu byte chunks\n", took / 1000,
+         took * 1000 / h.newSize, (unsigned long)images.reads, (unsigned long)images.writes, opt.chunk);
+  printf("signature checked in %.1f ms\n", checkTook / 1000);
+  printf("memory: DeltaPatch %zu bytes + window %zu\n", sizeof(DeltaPatch), patch.compressed() ? window.size() : 0);
+  return 0;
+}
@@ -0,0 +1,379 @@
+/*Makes a patch from one firmware image to another for lib/Delta.
+
+The blocks are found the way bsdiff finds them: a suffix array of the old
+image gives the longest match for each position of the new one, and each
+match is stretched forwards and backwards as long as at least half the
+bytes still agree. The differences go into add bytes, which are mostly
+zero when code only moved, and what matches nothing goes in as extra
+bytes. The patch is then gzipped with a --window bits deflate window, the
+station inflates it with a 2^bits byte buffer.
+
+The header is signed with the Ed25519 seed in --key, stations only boot
+an image from a patch signed by the key they were built with. --genkey
+makes a new seed file, keep it off the stations and out of the repo. It
+also writes the public key next to it as FILE.pub and prints it as the
+OTA_PUBLIC_KEY line for config.h.
+
+Prints the sizes next to the new image sent whole, plain and gzipped, and
+the name the station asks for the patch under: the first 8 bytes of the
+old image's SHA-256 in hex, plus .delta.
+
+usage: mkdelta OLD NEW PATCH --key SEED [--window BITS]
+       mkdelta --genkey SEED*/
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "DeltaPatch.h"
+
+struct Options {
+  const char *files[3] = {NULL, NULL, NULL};
+  const char *key = NULL;
+  const char *genkey = NULL;
+  int window = 13;
+};
+
+static bool parseOptions(int argc, char **argv, Options &opt){
+  int files = 0;
+  for(int i = 1; i < argc; i++){
+    const char *arg = argv[i];
+    if(arg[0] != '-'){
+      if(files == 3){
+        return false;
+      }
+      opt.files[files++] = arg;
+      continue;
+    }
+    const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+    if(value == NULL){
+      return false;
+    }
+    if(strcmp(arg, "--window") == 0) opt.window = atoi(value);
+    else if(strcmp(arg, "--key") == 0) opt.key = value;
+    else if(strcmp(arg, "--genkey") == 0) opt.genkey = value;
+    else return false;
+    i++;
+  }
+  if(opt.genkey != NULL){
+    return files == 0;
+  }
+  /*zlib turns 8 into 9*/
+  return files == 3 && opt.key != NULL && opt.window >= 9 && opt.window <= 15;
+}
+
+static bool readFile(const char *path, std::vector<uint8_t> &out){
+  FILE *f = fopen(path, "rb");
+  if(f == NULL){
+    perror(path);
+    return false;
+  }
+  uint8_t buf[4096];
+  size_t n;
+  while((n = fread(buf, 1, sizeof(buf), f)) > 0){
+    out.insert(out.end(), buf, buf + n);
+  }
+  fclose(f);
+  return true;
+}
+
+static double nowUs(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/*prefix doubling: sorted by the first k bytes, then 2k, until every
+suffix has a rank of its own*/
+static std::vector<int32_t> suffixArray(const std::vector<uint8_t> &s){
+  int32_t n = s.size();
+  std::vector<int32_t> sa(n), rank(n), next(n);
+  for(int32_t i = 0; i < n; i++){
+    sa[i] = i;
+    rank[i] = s[i];
+  }
+  for(int32_t k = 1; n > 1; k *= 2){
+    auto second = [&](int32_t i) { return i + k < n ? rank[i + k] : -1; };
+    auto before = [&](int32_t a, int32_t b) {
+      return rank[a] != rank[b] ? rank[a] < rank[b] : second(a) < second(b);
+    };
+    std::sort(sa.begin(), sa.end(), before);
+    next[sa[0]] = 0;
+    for(int32_t i = 1; i < n; i++){
+      next[sa[i]] = next[sa[i - 1]] + before(sa[i - 1], sa[i]);
+    }
+    rank.swap(next);
+    if(rank[sa[n - 1]] == n - 1){
+      break;
+    }
+  }
+  return sa;
+}
+
+static int32_t matchLength(const uint8_t *a, int32_t aLen, const uint8_t *b, int32_t bLen){
+  int32_t i = 0;
+  while(i < aLen && i < bLen && a[i] == b[i]){
+    i++;
+  }
+  return i;
+}
+
+/*longest match of target in old, binary search over the suffix array*/
+static int32_t search(const std::vector<int32_t> &sa, const std::vector<uint8_t> &old, const uint8_t *target,
+                      int32_t targetLen, int32_t &pos){
+  int32_t oldLen = old.size();
+  int32_t lo = 0, hi = oldLen - 1;
+  while(hi - lo >= 2){
+    int32_t mid = lo + (hi - lo) / 2;
+    int32_t len = std::min(oldLen - sa[mid], targetLen);
+    if(memcmp(old.data() + sa[mid], target, len) < 0){
+      lo = mid;
+    }else{
+      hi = mid;
+    }
+  }
+  int32_t x = matchLength(old.data() + sa[lo], oldLen - sa[lo], target, targetLen);
+  int32_t y = matchLength(old.data() + sa[hi], oldLen - sa[hi], target, targetLen);
+  pos = x > y ? sa[lo] : sa[hi];
+  return x > y ? x : y;
+}
+
+static void putLe32(std::vector<uint8_t> &out, uint32_t v){
+  for(int i = 0; i < 4; i++){
+    out.push_back(v >> (8 * i));
+  }
+}
+
+struct Counts {
+  uint32_t blocks = 0, addBytes = 0, addZero = 0, extraBytes = 0;
+};
+
+/*bsdiff's block search, written out as lib/Delta blocks*/
+static void diff(const std::vector<uint8_t> &old, const std::vector<uint8_t> &now, std::vector<uint8_t> &out,
+                 Counts &counts){
+  std::vector<int32_t> sa = suffixArray(old);
+  int32_t oldLen = old.size(), newLen = now.size();
+  int32_t scan = 0, len = 0, pos = 0;
+  int32_t lastScan = 0, lastPos = 0, lastOffset = 0;
+  while(scan < newLen){
+    int32_t oldScore = 0;
+    /*moves on until a match is clearly better than carrying on from the
+    last one*/
+    for(int32_t scsc = scan += len; scan < newLen; scan++){
+      len = search(sa, old, now.data() + scan, newLen - scan, pos);
+      for(; scsc < scan + len; scsc++){
+        if(scsc + lastOffset < oldLen && old[scsc + lastOffset] == now[scsc]){
+          oldScore++;
+        }
+      }
+      if((len == oldScore && len != 0) || len > oldScore + 8){
+        break;
+      }
+      if(scan + lastOffset < oldLen && old[scan + lastOffset] == now[scan]){
+        oldScore--;
+      }
+    }
+    if(len == oldScore && scan != newLen){
+      continue;
+    }
+
+    /*how far the last match reaches forwards and this one backwards*/
+    int32_t s = 0, best = 0, lenf = 0;
+    for(int32_t i = 0; lastScan + i < scan && lastPos + i < oldLen;){
+      if(old[lastPos + i] == now[lastScan + i]){
+        s++;
+      }
+      i++;
+      if(s * 2 - i > best * 2 - lenf){
+        best = s;
+        lenf = i;
+      }
+    }
+    int32_t lenb = 0;
+    if(scan < newLen){
+      s = 0;
+      best = 0;
+      for(int32_t i = 1; scan >= lastScan + i && pos >= i; i++){
+        if(old[pos - i] == now[scan - i]){
+          s++;
+        }
+        if(s * 2 - i > best * 2 - lenb){
+          best = s;
+          lenb = i;
+        }
+      }
+    }
+    if(lastScan + lenf > scan - lenb){
+      int32_t overlap = (lastScan + lenf) - (scan - lenb);
+      int32_t lens = 0;
+      s = 0;
+      best = 0;
+      for(int32_t i = 0; i < overlap; i++){
+        if(now[lastScan + lenf - overlap + i] == old[lastPos + lenf - overlap + i]){
+          s++;
+        }
+        if(now[scan - lenb + i] == old[pos - lenb + i]){
+          s--;
+        }
+        if(s > best){
+          best = s;
+          lens = i + 1;
+        }
+      }
+      lenf += lens - overlap;
+      lenb -= lens;
+    }
+
+    int32_t extra = (scan - lenb) - (lastScan + lenf);
+    putLe32(out, lenf);
+    putLe32(out, extra);
+    putLe32(out, (pos - lenb) - (lastPos + lenf));
+    for(int32_t i = 0; i < lenf; i++){
+      uint8_t d = now[lastScan + i] - old[lastPos + i];
+      out.push_back(d);
+      counts.addZero += d == 0;
+    }
+    out.insert(out.end(), now.begin() + lastScan + lenf, now.begin() + lastScan + lenf + extra);
+    counts.blocks++;
+    counts.addBytes += lenf;
+    counts.extraBytes += extra;
+
+    lastScan = scan - lenb;
+    lastPos = pos - lenb;
+    lastOffset = pos - scan;
+  }
+}
+
+static bool gzip(const std::vector<uint8_t> &in, int windowBits, std::vector<uint8_t> &out){
+  z_stream z;
+  memset(&z, 0, sizeof(z));
+  if(deflateInit2(&z, 9, Z_DEFLATED, windowBits + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK){
+    return false;
+  }
+  out.resize(deflateBound(&z, in.size()));
+  z.next_in = (Bytef *)in.data();
+  z.avail_in = in.size();
+  z.next_out = out.data();
+  z.avail_out = out.size();
+  int r = deflate(&z, Z_FINISH);
+  out.resize(z.total_out);
+  deflateEnd(&z);
+  return r == Z_STREAM_END;
+}
+
+static void sha256(const std::vector<uint8_t> &data, uint8_t digest[SHA256_BYTES]){
+  Sha256 hash;
+  hash.update(data.data(), data.size());
+  hash.finish(digest);
+}
+
+static bool writeFile(const char *path, const uint8_t *data, size_t len, int mode){
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, mode);
+  if(fd < 0 || write(fd, data, len) != (ssize_t)len){
+    perror(path);
+    if(fd >= 0) close(fd);
+    return false;
+  }
+  close(fd);
+  return true;
+}
+
+/*a random seed, readable by its owner only, and its public key*/
+static int generateKey(const char *path){
+  uint8_t seed[ED25519_SEED_BYTES], publicKey[ED25519_PUBLIC_BYTES];
+  FILE *random = fopen("/dev/urandom", "rb");
+  if(random == NULL || fread(seed, 1, sizeof(seed), random) != sizeof(seed)){
+    perror("/dev/urandom");
+    return 2;
+  }
+  fclose(random);
+  if(access(path, F_OK) == 0){
+    fprintf(stderr, "%s exists, not overwriting a key\n", path);
+    return 2;
+  }
+  ed25519PublicKey(seed, publicKey);
+  std::string pub = std::string(path) + ".pub";
+  if(!writeFile(path, seed, sizeof(seed), 0600) || !writeFile(pub.c_str(), publicKey, sizeof(publicKey), 0644)){
+    return 2;
+  }
+  printf("#define OTA_PUBLIC_KEY {");
+  for(int i = 0; i < ED25519_PUBLIC_BYTES; i++){
+    printf("%s0x%02x", i > 0 ? ", " : "", publicKey[i]);
+  }
+  printf("}\n");
+  return 0;
+}
+
+int main(int argc, char **argv){
+  Options opt;
+  if(!parseOptions(argc, argv, opt)){
+    fprintf(stderr, "usage: %s OLD NEW PATCH --key SEED [--window BITS]\n"
+                    "       %s --genkey SEED\n", argv[0], argv[0]);
+    return 2;
+  }
+  if(opt.genkey != NULL){
+    return generateKey(opt.genkey);
+  }
+  std::vector<uint8_t> old, now, seed;
+  if(!readFile(opt.files[0], old) || !readFile(opt.files[1], now) || !readFile(opt.key, seed)){
+    return 2;
+  }
+  if(seed.size() != ED25519_SEED_BYTES){
+    fprintf(stderr, "%s: expected a %d byte seed from --genkey\n", opt.key, ED25519_SEED_BYTES);
+    return 2;
+  }
+  if(old.empty()){
+    fprintf(stderr, "%s is empty\n", opt.files[0]);
+    return 2;
+  }
+
+  double started = nowUs();
+  std::vector<uint8_t> raw(DELTA_MAGIC, DELTA_MAGIC + 4);
+  putLe32(raw, old.size());
+  putLe32(raw, now.size());
+  uint8_t oldHash[SHA256_BYTES], newHash[SHA256_BYTES];
+  sha256(old, oldHash);
+  sha256(now, newHash);
+  raw.insert(raw.end(), oldHash, oldHash + SHA256_BYTES);
+  raw.insert(raw.end(), newHash, newHash + SHA256_BYTES);
+  uint8_t signature[ED25519_SIGNATURE_BYTES];
+  ed25519Sign(seed.data(), raw.data(), DELTA_SIGNED_SIZE, signature);
+  raw.insert(raw.end(), signature, signature + ED25519_SIGNATURE_BYTES);
+  Counts counts;
+  diff(old, now, raw, counts);
+  std::vector<uint8_t> patch, whole;
+  if(!gzip(raw, opt.window, patch) || !gzip(now, 15, whole)){
+    fprintf(stderr, "deflate failed\n");
+    return 1;
+  }
+  double took = nowUs() - started;
+
+  FILE *f = fopen(opt.files[2], "wb");
+  if(f == NULL || fwrite(patch.data(), 1, patch.size(), f) != patch.size()){
+    perror(opt.files[2]);
+    return 2;
+  }
+  fclose(f);
+
+  printf("old %zu bytes, new %zu bytes, made in %.0f ms\n", old.size(), now.size(), took / 1000);
+  printf("%lu blocks: %lu add bytes (%.1f %% zero), %lu extra bytes\n", (unsigned long)counts.blocks,
+         (unsigned long)counts.addBytes, counts.addBytes ? 100.0 * counts.addZero / counts.addBytes : 0.0,
+         (unsigned long)counts.extraBytes);
+  printf("patch %zu bytes, gzipped with a %d byte window %zu bytes\n", raw.size(), 1 << opt.window, patch.size());
+  printf("transfer %.1f %% of the new image, %.1f %% of it gzipped (%zu bytes)\n",
+         100.0 * patch.size() / now.size(), 100.0 * patch.size() / whole.size(), whole.size());
+  printf("serve as ");
+  for(int i = 0; i < 8; i++){
+    printf("%02x", oldHash[i]);
+  }
+  printf(".delta\n");
+  return 0;
+}
@@ -0,0 +1,508 @@
+/*A day of forecast parses on a model of the station's heap, with and
+without lib/JsonArena.
+
+cJSON isn't available on the PC, so the parse is done here the way cJSON
+allocates on the ESP32: a 40 byte item for every value, a copy of every
+key and string value, freed children first by cJSON_Delete. Its malloc
+and free go through the same hooks as in main.cpp, into a JsonArena sized
+JSON_ARENA_FACTOR times the answer, or with --no-arena straight to malloc
+the way JSON_NO_ARENA builds do.
+
+malloc, realloc and free are wrapped at link time (like lib/HeapStats on
+the station) and served first fit from a --heap byte region with an 8 byte
+header per block, roughly what the ESP-IDF heap does. The rest of the
+firmware is on that heap too: the answer is appended to a String a TCP
+segment at a time, every segment sits in a pbuf until it has been copied,
+and WiFi, lwIP and logging allocate and free small blocks every pass, now
+and then one that stays for hours. Some of those land while the tree is
+being built, the way the WiFi task on the other core does. All of it is
+drawn from --seed, so both runs see the same day.
+
+Reports for each run the peak of allocated bytes, the largest free block
+after each parse (lowest, and at the end) and the arena's overflows, which
+is how much fragmentation the parses leave behind.
+
+usage: arenabench [--hours 24] [--heap BYTES] [--slots CNT] [--refresh S] [--pass S]
+                  [--factor N] [--chunk BYTES] [--seed N] [--no-arena]*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "JsonArena.h"
+
+struct Options {
+  uint32_t hours = 24;
+  uint32_t heap = 120000;
+  int slots = 3;
+  uint32_t refreshS = 600;
+  uint32_t passS = 30;
+  uint32_t factor = 4;
+  size_t chunk = 1460;
+  uint32_t seed = 1;
+  bool both = true;
+};
+
+/*cJSON's item on a 32 bit target, and what lwIP adds to a segment*/
+static const size_t CJSON_ITEM_BYTES = 40;
+static const size_t PBUF_OVERHEAD = 60;
+
+/*first fit over one region, blocks in address order, neighbours merged
+when freed*/
+class ModelHeap {
+ public:
+  static const uint32_t HEADER = 8;
+  static const uint32_t ALIGN = 4;
+  static const uint32_t MIN_SPLIT = 16;
+
+  explicit ModelHeap(uint32_t bytes) : memory(bytes) {
+    blocks[0] = Block{bytes, true};
+  }
+
+  void *allocate(size_t size){
+    uint32_t need = round(size);
+    for(std::map<uint32_t, Block>::iterator b = blocks.begin(); b != blocks.end(); ++b){
+      if(b->second.free && b->second.size >= need){
+        take(b, need);
+        return memory.data() + b->first + HEADER;
+      }
+    }
+    failed++;
+    return NULL;
+  }
+
+  void release(void *ptr){
+    if(ptr == NULL){
+      return;
+    }
+    std::map<uint32_t, Block>::iterator b = blocks.find(offset(ptr));
+    used -= b->second.size;
+    b->second.free = true;
+    std::map<uint32_t, Block>::iterator next = b;
+    if(++next != blocks.end() && next->second.free){
+      b->second.size += next->second.size;
+      blocks.erase(next);
+    }
+    if(b != blocks.begin()){
+      std::map<uint32_t, Block>::iterator prev = b;
+      --prev;
+      if(prev->second.free){
+        prev->second.size += b->second.size;
+        blocks.erase(b);
+      }
+    }
+  }
+
+  /*grows in place into a free neighbour if it can, moves otherwise*/
+  void *resize(void *ptr, size_t size){
+    if(ptr == NULL){
+      return allocate(size);
+    }
+    uint32_t need = round(size);
+    std::map<uint32_t, Block>::iterator b = blocks.find(offset(ptr));
+    if(b->second.size >= need){
+      return ptr;
+    }
+    std::map<uint32_t, Block>::iterator next = b;
+    if(++next != blocks.end() && next->second.free && b->second.size + next->second.size >= need){
+      uint32_t grow = need - b->second.size;
+      uint32_t rest = next->second.size - grow;
+      uint32_t at = next->first;
+      blocks.erase(next);
+      if(rest >= MIN_SPLIT){
+        blocks[at + grow] = Block{rest, true};
+      }else{
+        grow += rest;
+      }
+      b->second.size += grow;
+      used += grow;
+      peak = used > peak ? used : peak;
+      return ptr;
+    }
+    void *moved = allocate(size);
+    if(moved != NULL){
+      memcpy(moved, ptr, b->second.size - HEADER);
+      release(ptr);
+    }
+    return moved;
+  }
+
+  uint32_t largestFree() const {
+    uint32_t largest = 0;
+    for(std::map<uint32_t, Block>::const_iterator b = blocks.begin(); b != blocks.end(); ++b){
+      if(b->second.free && b->second.size > largest){
+        largest = b->second.size;
+      }
+    }
+    return largest > HEADER ? largest - HEADER : 0;
+  }
+
+  uint32_t used = 0, peak = 0, failed = 0;
+
+ private:
+  struct Block {
+    uint32_t size; //header included
+    bool free;
+  };
+
+  static uint32_t round(size_t size){
+    return (uint32_t)((size + ALIGN - 1) & ~(size_t)(ALIGN - 1)) + HEADER;
+  }
+
+  uint32_t offset(void *ptr) const {
+    return (uint32_t)((uint8_t *)ptr - memory.data()) - HEADER;
+  }
+
+  void take(std::map<uint32_t, Block>::iterator b, uint32_t need){
+    uint32_t rest = b->second.size - need;
+    if(rest >= MIN_SPLIT){
+      blocks[b->first + need] = Block{rest, true};
+      b->second.size = need;
+    }
+    b->second.free = false;
+    used += b->second.size;
+    peak = used > peak ? used : peak;
+  }
+
+  std::vector<uint8_t> memory;
+  std::map<uint32_t, Block> blocks;
+};
+
+/*everything the bench and JsonArena malloc() lands here, libstdc++ keeps
+the real malloc*/
+static ModelHeap *heap = NULL;
+
+extern "C" {
+void *__real_malloc(size_t size);
+void __real_free(void *ptr);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size){
+  return heap != NULL ? heap->allocate(size) : __real_malloc(size);
+}
+
+void __wrap_free(void *ptr){
+  if(heap != NULL){
+    heap->release(ptr);
+  }else{
+    __real_free(ptr);
+  }
+}
+
+void *__wrap_realloc(void *ptr, size_t size){
+  return heap != NULL ? heap->resize(ptr, size) : __real_realloc(ptr, size);
+}
+}
+
+/*xorshift, the same day for both runs*/
+struct Random {
+  uint32_t state;
+  explicit Random(uint32_t seed) : state(seed != 0 ? seed : 1) {}
+  uint32_t next(){
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+  uint32_t below(uint32_t n){ return next() % n; }
+};
+
+/*the WiFi, lwIP and log traffic: blocks of 16..256 bytes, most gone
+within the pass, some after a few passes, one in a hundred after hours*/
+class Background {
+ public:
+  Background(Random &random, uint32_t passS) : random(random), passS(passS) {}
+
+  void allocate(uint32_t now){
+    uint32_t roll = random.below(100), lifetime;
+    if(roll < 90){
+      lifetime = 0;
+    }else if(roll < 99){
+      lifetime = (1 + random.below(20)) * passS;
+    }else{
+      lifetime = (1 + random.below(12)) * 3600;
+    }
+    void *ptr = malloc(16 + random.below(241));
+    if(ptr != NULL){
+      blocks.insert(std::make_pair(now + lifetime, ptr));
+    }
+  }
+
+  void expire(uint32_t now){
+    while(!blocks.empty() && blocks.begin()->first <= now){
+      free(blocks.begin()->second);
+      blocks.erase(blocks.begin());
+    }
+  }
+
+  void clear(){
+    expire(UINT32_MAX);
+  }
+
+ private:
+  Random &random;
+  uint32_t passS;
+  std::multimap<uint32_t, void *> blocks;
+};
+
+/*the parse hooks, like jsonMalloc and jsonFree in main.cpp*/
+static JsonArena *arena = NULL;
+static Background *parseNoise = NULL;
+static Random *parseRandom = NULL;
+static uint32_t parseNow = 0;
+
+static void *jsonMalloc(size_t size){
+  /*the other core allocates now and then while the tree is built*/
+  if(parseRandom->below(8) == 0){
+    parseNoise->allocate(parseNow);
+  }
+  return arena->allocate(size);
+}
+
+static void jsonFree(void *ptr){
+  arena->release(ptr);
+}
+
+/*the blocks cJSON makes for one item, freed children first*/
+struct Item {
+  void *node, *key, *value;
+  std::vector<Item> children;
+};
+
+static void deleteItem(Item &item){
+  for(size_t i = 0; i < item.children.size(); i++){
+    deleteItem(item.children[i]);
+  }
+  jsonFree(item.value);
+  jsonFree(item.key);
+  jsonFree(item.node);
+}
+
+static size_t stringLength(const char *&p){
+  const char *start = ++p;
+  while(*p && *p != '"'){
+    p += *p == '\\' && p[1] ? 2 : 1;
+  }
+  size_t len = p - start;
+  if(*p) p++;
+  return len;
+}
+
+static void skipSpace(const char *&p){
+  while(*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t') p++;
+}
+
+/*builds item's value at p, item.node is already allocated*/
+static void parseValue(const char *&p, Item &item){
+  skipSpace(p);
+  if(*p == '"'){
+    item.value = jsonMalloc(stringLength(p) + 1);
+  }else if(*p == '{' || *p == '['){
+    char close = *p == '{' ? '}' : ']';
+    bool object = *p == '{';
+    p++;
+    skipSpace(p);
+    while(*p && *p != close){
+      Item child = {jsonMalloc(CJSON_ITEM_BYTES), NULL, NULL, std::vector<Item>()};
+      if(object){
+        skipSpace(p);
+        child.key = jsonMalloc(stringLength(p) + 1);
+        skipSpace(p);
+        if(*p == ':') p++;
+      }
+      parseValue(p, child);
+      item.children.push_back(child);
+      skipSpace(p);
+      if(*p == ',') p++;
+      skipSpace(p);
+    }
+    if(*p) p++;
+  }else{
+    while(*p && *p != ',' && *p != '}' && *p != ']') p++;
+  }
+}
+
+/*an OpenWeatherMap /forecast answer, numbers moving a little between
+fetches like the real ones, as tools/forecast/forecastsum makes them*/
+static std::string forecastAnswer(int cnt, uint32_t fetch, Random &random){
+  static const int ids[] = {800, 801, 802, 804, 500, 501, 300, 600, 211, 741};
+  time_t start = 1700006400 + (time_t)fetch * 600;
+  std::string json = "{\"cod\":\"200\",\"message\":0,\"cnt\":" + std::to_string(cnt) + ",\"list\":[";
+  for(int i = 0; i < cnt; i++){
+    time_t dt = start + i * 3 * 3600;
+    struct tm tm;
+    gmtime_r(&dt, &tm);
+    char date[32], entry[768];
+    strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &tm);
+    double temp = 260 + random.below(3000) / 100.0;
+    int id = ids[random.below(10)];
+    snprintf(entry, sizeof(entry),
+      "%s{\"dt\":%ld,\"main\":{\"temp\":%.2f,\"feels_like\":%.2f,\"temp_min\":%.2f,\"temp_max\":%.2f,"
+      "\"pressure\":%u,\"sea_level\":%u,\"grnd_level\":1008,\"humidity\":%u,\"temp_kf\":0},"
+      "\"weather\":[{\"id\":%d,\"main\":\"Clouds\",\"description\":\"broken clouds\",\"icon\":\"04n\"}],"
+      "\"clouds\":{\"all\":%u},\"wind\":{\"speed\":%.2f,\"deg\":%u,\"gust\":%.1f},\"visibility\":10000,"
+      "\"pop\":%.2f,\"sys\":{\"pod\":\"n\"},\"dt_txt\":\"%s\"}",
+      i > 0 ? "," : "", (long)dt, temp, temp - 2, temp, temp, 990 + random.below(40), 990 + random.below(40),
+      random.below(101), id, random.below(101), random.below(1500) / 100.0, random.below(360),
+      random.below(300) / 10.0, random.below(101) / 100.0, date);
+    json += entry;
+  }
+  json += "],\"city\":{\"id\":658225,\"name\":\"Helsinki\",\"coord\":{\"lat\":60.1699,\"lon\":24.9384},"
+          "\"country\":\"FI\",\"population\":558457,\"timezone\":7200,\"sunrise\":1699942436,\"sunset\":1699969113}}";
+  return json;
+}
+
+struct RunResult {
+  uint32_t parses, allocations, overflows, failed;
+  uint32_t peak, minLargest, endLargest, endUsed;
+  uint32_t arenaBytes, highWater;
+};
+
+/*the String the answer is appended to, grown to exactly what it holds
+the way Arduino's String::concat does*/
+struct Buffer {
+  char *data = NULL;
+  size_t capacity = 0, length = 0;
+
+  void reserve(size_t size){
+    if(size > capacity){
+      char *grown = (char *)realloc(data, size + 1);
+      if(grown != NULL){
+        data = grown;
+        capacity = size;
+      }
+    }
+  }
+};
+
+static RunResult run(const Options &opt, bool useArena){
+  ModelHeap model(opt.heap);
+  heap = &model;
+  RunResult r = {};
+  r.minLargest = UINT32_MAX;
+  {
+    Random random(opt.seed);
+    Background background(random, opt.passS);
+    JsonArena jsonArena;
+    arena = &jsonArena;
+    parseNoise = &background;
+    parseRandom = &random;
+    Buffer jsonBuffer;
+
+    uint32_t end = opt.hours * 3600, fetch = 0;
+    for(uint32_t now = 0; now < end; now += opt.passS){
+      background.expire(now);
+      for(int i = 0; i < 20; i++){
+        background.allocate(now);
+      }
+      if(now % opt.refreshS != 0){
+        continue;
+      }
+
+      /*the download: reserve for the gzip Content-Length, then every
+      segment goes through a pbuf into the String*/
+      std::string answer = forecastAnswer(opt.slots, fetch++, random);
+      jsonBuffer.length = 0;
+      jsonBuffer.reserve(answer.size() / 10);
+      for(size_t at = 0; at < answer.size(); at += opt.chunk){
+        size_t n = answer.size() - at < opt.chunk ? answer.size() - at : opt.chunk;
+        void *pbuf = malloc(n + PBUF_OVERHEAD);
+        background.allocate(now);
+        jsonBuffer.reserve(jsonBuffer.length + n);
+        if(jsonBuffer.data != NULL && jsonBuffer.length + n <= jsonBuffer.capacity){
+          memcpy(jsonBuffer.data + jsonBuffer.length, answer.data() + at, n);
+          jsonBuffer.length += n;
+        }
+        free(pbuf);
+      }
+
+      /*parseForecast*/
+      parseNow = now;
+      jsonArena.begin(useArena ? jsonBuffer.length * opt.factor : 0);
+      const char *p = answer.c_str();
+      Item root = {jsonMalloc(CJSON_ITEM_BYTES), NULL, NULL, std::vector<Item>()};
+      parseValue(p, root);
+      deleteItem(root);
+      jsonArena.end();
+
+      uint32_t largest = model.largestFree();
+      if(largest < r.minLargest) r.minLargest = largest;
+    }
+
+    const JsonArenaStats &s = jsonArena.stats();
+    r.parses = s.parses;
+    r.allocations = s.allocations;
+    r.overflows = s.overflows;
+    r.arenaBytes = jsonArena.size();
+    r.highWater = s.highWater;
+    r.endLargest = model.largestFree();
+    r.endUsed = model.used;
+    background.clear();
+    free(jsonBuffer.data);
+  }
+  r.failed = model.failed;
+  r.peak = model.peak;
+  heap = NULL;
+  return r;
+}
+
+static bool parseOptions(int argc, char **argv, Options &opt){
+  for(int i = 1; i < argc; i++){
+    const char *arg = argv[i];
+    if(strcmp(arg, "--no-arena") == 0){
+      opt.both = false;
+      continue;
+    }
+    const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+    if(value == NULL){
+      return false;
+    }
+    if(strcmp(arg, "--hours") == 0) opt.hours = atoi(value);
+    else if(strcmp(arg, "--heap") == 0) opt.heap = atoi(value);
+    else if(strcmp(arg, "--slots") == 0) opt.slots = atoi(value);
+    else if(strcmp(arg, "--refresh") == 0) opt.refreshS = atoi(value);
+    else if(strcmp(arg, "--pass") == 0) opt.passS = atoi(value);
+    else if(strcmp(arg, "--factor") == 0) opt.factor = atoi(value);
+    else if(strcmp(arg, "--chunk") == 0) opt.chunk = atoi(value);
+    else if(strcmp(arg, "--seed") == 0) opt.seed = atoi(value);
+    else return false;
+    i++;
+  }
+  return opt.heap >= 4096 && opt.slots > 0 && opt.passS > 0 && opt.refreshS >= opt.passS && opt.chunk > 0;
+}
+
+static void print(const char *name, const RunResult &r){
+  uint32_t parses = r.parses > 0 ? r.parses : 1;
+  printf("%-9s %6lu %8lu %9lu %8lu %11lu %10lu %10lu %7lu\n", name, (unsigned long)r.parses,
+         (unsigned long)(r.allocations / parses), (unsigned long)r.overflows, (unsigned long)r.peak,
+         (unsigned long)r.minLargest, (unsigned long)r.endLargest, (unsigned long)r.endUsed,
+         (unsigned long)r.failed);
+}
+
+int main(int argc, char **argv){
+  Options opt;
+  if(!parseOptions(argc, argv, opt)){
+    fprintf(stderr, "usage: %s [--hours 24] [--heap BYTES] [--slots CNT] [--refresh S] [--pass S]\n"
+                    "       [--factor N] [--chunk BYTES] [--seed N] [--no-arena]\n", argv[0]);
+    return 2;
+  }
+
+  printf("%lu h, %lu byte heap, %d slots every %lu s, passes every %lu s\n\n", (unsigned long)opt.hours,
+         (unsigned long)opt.heap, opt.slots, (unsigned long)opt.refreshS, (unsigned long)opt.passS);
+  printf("%-9s %6s %8s %9s %8s %11s %10s %10s %7s\n", "", "parses", "allocs", "malloced", "peak",
+         "min largest", "end largest", "end used", "failed");
+  RunResult plain = run(opt, false);
+  print("malloc", plain);
+  if(opt.both){
+    RunResult arenaRun = run(opt, true);
+    print("arena", arenaRun);
+    printf("\narena %lu bytes, %lu used at most\n", (unsigned long)arenaRun.arenaBytes,
+           (unsigned long)arenaRun.highWater);
+  }
+  return 0;
+}
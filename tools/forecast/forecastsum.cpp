@@ -0,0 +1,166 @@
+/*Runs lib/Forecast/ForecastStream over a forecast response on a PC.
+
+Reads an OpenWeatherMap /forecast JSON file, or makes one up with
+--generate CNT in the same shape as the API answer, and feeds it to the
+parser --chunk bytes at a time the way TCP segments arrive on the station.
+Prints the first three slots, the daily summary, parse time and the size
+of the parser, which is all the memory it needs whatever CNT is.
+
+A gzip file goes through lib/Gzip first with a --window byte window, the
+way the station inflates a compressed answer, and the report adds the
+compressed size and how far back the compressor reached. Save one with
+  curl -H 'Accept-Encoding: gzip' -o forecast.json.gz 'https://api.openweathermap.org/...'
+to see what window a real answer needs.
+
+usage: forecastsum [FILE | --generate CNT] [--chunk BYTES] [--offset SECONDS] [--window BYTES]*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+#include "ForecastStream.h"
+#include "GzipInflater.h"
+
+struct Options {
+  const char *file = NULL;
+  int generate = 0;
+  size_t chunk = 1460;
+  long offset = 0;
+  size_t window = 32768;
+};
+
+static bool parseOptions(int argc, char **argv, Options &opt){
+  for(int i = 1; i < argc; i++){
+    const char *arg = argv[i];
+    if(arg[0] != '-'){
+      opt.file = arg;
+      continue;
+    }
+    const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+    if(value == NULL){
+      return false;
+    }
+    if(strcmp(arg, "--generate") == 0) opt.generate = atoi(value);
+    else if(strcmp(arg, "--chunk") == 0) opt.chunk = atoi(value);
+    else if(strcmp(arg, "--offset") == 0) opt.offset = atol(value);
+    else if(strcmp(arg, "--window") == 0) opt.window = atoi(value);
+    else return false;
+    i++;
+  }
+  bool powerOfTwo = opt.window > 0 && opt.window <= 32768 && (opt.window & (opt.window - 1)) == 0;
+  return (opt.file != NULL) != (opt.generate > 0) && opt.chunk > 0 && powerOfTwo;
+}
+
+static bool readFile(const char *path, std::string &out){
+  FILE *f = fopen(path, "rb");
+  if(f == NULL){
+    perror(path);
+    return false;
+  }
+  char buf[4096];
+  size_t n;
+  while((n = fread(buf, 1, sizeof(buf), f)) > 0){
+    out.append(buf, n);
+  }
+  fclose(f);
+  return true;
+}
+
+/*same fields and nesting as the real answer, with a daily temperature
+swing and changing weather*/
+static std::string generate(int cnt){
+  static const int ids[] = {800, 801, 802, 804, 500, 501, 300, 600, 211, 741};
+  time_t start = 1700006400; //2023-11-15 00:00 UTC
+  std::string json = "{\"cod\":\"200\",\"message\":0,\"cnt\":" + std::to_string(cnt) + ",\"list\":[";
+  for(int i = 0; i < cnt; i++){
+    time_t dt = start + i * 3 * 3600;
+    struct tm tm;
+    gmtime_r(&dt, &tm);
+    char date[32], entry[768];
+    strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &tm);
+    double temp = 275.15 + 2 * ((i % 8) < 4 ? (i % 8) : 8 - (i % 8)) - i * 0.1;
+    int id = ids[(i * 7 / 3) % 10];
+    snprintf(entry, sizeof(entry),
+      "%s{\"dt\":%ld,\"main\":{\"temp\":%.2f,\"feels_like\":%.2f,\"temp_min\":%.2f,\"temp_max\":%.2f,"
+      "\"pressure\":1012,\"sea_level\":1012,\"grnd_level\":1008,\"humidity\":81,\"temp_kf\":0},"
+      "\"weather\":[{\"id\":%d,\"main\":\"Clouds\",\"description\":\"broken clouds\",\"icon\":\"04n\"}],"
+      "\"clouds\":{\"all\":75},\"wind\":{\"speed\":4.12,\"deg\":231,\"gust\":9.3},\"visibility\":10000,"
+      "\"pop\":0.2,\"sys\":{\"pod\":\"n\"},\"dt_txt\":\"%s\"}",
+      i > 0 ? "," : "", (long)dt, temp, temp - 2, temp, temp, id, date);
+    json += entry;
+  }
+  json += "],\"city\":{\"id\":658225,\"name\":\"Helsinki\",\"coord\":{\"lat\":60.1699,\"lon\":24.9384},"
+          "\"country\":\"FI\",\"population\":558457,\"timezone\":7200,\"sunrise\":1699942436,\"sunset\":1699969113}}";
+  return json;
+}
+
+static double nowUs(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static const char *weekday(int32_t day){
+  static const char *names[] = {"Thu", "Fri", "Sat", "Sun", "Mon", "Tue", "Wed"};
+  return names[((day % 7) + 7) % 7];
+}
+
+int main(int argc, char **argv){
+  Options opt;
+  if(!parseOptions(argc, argv, opt)){
+    fprintf(stderr, "usage: %s [FILE | --generate CNT] [--chunk BYTES] [--offset SECONDS] [--window BYTES]\n",
+            argv[0]);
+    return 2;
+  }
+  std::string json;
+  if(opt.file ? !readFile(opt.file, json) : (json = generate(opt.generate), false)){
+    return 2;
+  }
+
+  ForecastStream stream(opt.offset);
+  ForecastSlot slots[STATION_FORECAST_SLOTS];
+  stream.begin(slots, STATION_FORECAST_SLOTS);
+  bool gzip = json.size() >= 2 && (uint8_t)json[0] == 0x1f && (uint8_t)json[1] == 0x8b;
+  std::vector<uint8_t> window(opt.window);
+  GzipInflater inflater(window.data(), window.size());
+  inflater.begin(ForecastStream::bodyCallback, &stream);
+  double started = nowUs();
+  for(size_t at = 0; at < json.size(); at += opt.chunk){
+    size_t len = json.size() - at < opt.chunk ? json.size() - at : opt.chunk;
+    if(!gzip){
+      stream.feed((const uint8_t *)json.data() + at, len);
+    }else if(inflater.feed((const uint8_t *)json.data() + at, len) == GZIP_ERROR){
+      break;
+    }
+  }
+  int entries = stream.finish();
+  double took = nowUs() - started;
+
+  if(gzip){
+    printf("gzip: %zu bytes inflated to %lu (%.1f %%), %s, farthest reference %lu bytes back, window %zu\n",
+           json.size(), (unsigned long)inflater.bytesOut(), 100.0 * json.size() / (inflater.bytesOut() ? inflater.bytesOut() : 1),
+           inflater.done() ? "checksum ok" : GzipInflater::errorName(inflater.error()),
+           (unsigned long)inflater.farthest(), window.size());
+  }
+  size_t parsed = gzip ? inflater.bytesOut() : json.size();
+  printf("%zu bytes, %d entries, %.0f us (%.1f ns/byte), parser %zu bytes\n",
+         parsed, entries, took, took * 1000 / (parsed ? parsed : 1), sizeof(ForecastStream));
+  if(entries < 0){
+    printf("not a forecast\n");
+    return 1;
+  }
+  for(int i = 0; i < stream.slotsFilled(); i++){
+    printf("slot %d: %s %d C, id %d\n", i, slots[i].time, slots[i].temperature, slots[i].weatherId);
+  }
+  for(int i = 0; i < stream.dayCount(); i++){
+    const ForecastDay &d = stream.getDays()[i];
+    printf("%s: %5.1f .. %5.1f C, %s (%d), %d forecasts\n", weekday(d.day),
+           d.minTemp / 10.0, d.maxTemp / 10.0, conditionName(d.weatherId), d.weatherId, d.samples);
+  }
+  printf("next response uses UTC offset %ld s\n", (long)stream.getUtcOffset());
+  return 0;
+}
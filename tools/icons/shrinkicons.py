@@ -0,0 +1,129 @@
+"""Downscales the 64x64 weather icons in lib/Icons/Icons.h for the
+multi-slot forecast layouts and writes them as IconsSmall.h.
+
+Every output pixel covers a square of the original, it is lit when at
+least THRESHOLD of that square is. Lower keeps thin lines, higher keeps
+outlines from running together. An icon NAME becomes NAME_32 and NAME_24.
+
+PlatformIO runs this before every firmware build (extra_scripts in
+platformio.ini) and puts the header in the build directory, CMake does
+the same for oledsim. By hand:
+
+    python3 tools/icons/shrinkicons.py lib/Icons/Icons.h IconsSmall.h [--preview]
+
+--preview prints every icon at each size as text."""
+
+import os
+import re
+import sys
+
+SOURCE_SIZE = 64
+SIZES = (32, 24)
+THRESHOLD = 0.3
+
+ICON = re.compile(r"const\s+unsigned\s+char\s+(\w+)\s*\[\s*\]\s*PROGMEM\s*=\s*\{(.*?)\};", re.S)
+
+
+def read_icons(path):
+    """(name, rows of 0/1) for every 64x64 bitmap in the header"""
+    with open(path) as f:
+        text = f.read()
+    icons = []
+    for name, body in ICON.findall(text):
+        data = [int(v, 0) for v in re.findall(r"0[xX][0-9a-fA-F]+|\d+", body)]
+        if len(data) != SOURCE_SIZE * SOURCE_SIZE // 8:
+            continue
+        stride = SOURCE_SIZE // 8
+        rows = [[(data[y * stride + x // 8] >> (7 - x % 8)) & 1 for x in range(SOURCE_SIZE)]
+                for y in range(SOURCE_SIZE)]
+        icons.append((name, rows))
+    return icons
+
+
+def coverage(rows, x0, y0, x1, y1):
+    """lit share of the square [x0, x1) x [y0, y1), partial pixels counted
+    by how much of them is inside"""
+    lit = 0.0
+    for y in range(int(y0), min(int(-(-y1 // 1)), SOURCE_SIZE)):
+        h = min(y + 1, y1) - max(y, y0)
+        for x in range(int(x0), min(int(-(-x1 // 1)), SOURCE_SIZE)):
+            if rows[y][x]:
+                lit += h * (min(x + 1, x1) - max(x, x0))
+    return lit / ((x1 - x0) * (y1 - y0))
+
+
+def shrink(rows, size):
+    scale = SOURCE_SIZE / size
+    return [[1 if coverage(rows, x * scale, y * scale, (x + 1) * scale, (y + 1) * scale) >= THRESHOLD else 0
+             for x in range(size)] for y in range(size)]
+
+
+def pack(rows):
+    """Adafruit GFX drawBitmap() layout, rows of bytes, leftmost pixel in
+    the top bit"""
+    out = []
+    for row in rows:
+        for x in range(0, len(row), 8):
+            byte = 0
+            for bit in range(8):
+                if x + bit < len(row) and row[x + bit]:
+                    byte |= 0x80 >> bit
+            out.append(byte)
+    return out
+
+
+def header(icons, source):
+    lines = ["/*Generated by tools/icons/shrinkicons.py from %s, don't edit*/" % os.path.basename(source),
+             "#pragma once", ""]
+    for name, rows in icons:
+        for size in SIZES:
+            data = pack(shrink(rows, size))
+            stride = (size + 7) // 8
+            lines.append("const unsigned char %s_%d[] PROGMEM = {" % (name, size))
+            for y in range(size):
+                lines.append("  " + ",".join("0x%02X" % b for b in data[y * stride:(y + 1) * stride]) + ",")
+            lines.append("};")
+            lines.append("")
+    return "\n".join(lines)
+
+
+def generate(source, target):
+    """writes target only when it changes, so the screens aren't rebuilt
+    every time"""
+    text = header(read_icons(source), source)
+    if os.path.exists(target):
+        with open(target) as f:
+            if f.read() == text:
+                return
+    directory = os.path.dirname(target)
+    if directory and not os.path.isdir(directory):
+        os.makedirs(directory)
+    with open(target, "w") as f:
+        f.write(text)
+
+
+def preview(source):
+    for name, rows in read_icons(source):
+        for size in SIZES:
+            print("%s_%d" % (name, size))
+            for row in shrink(rows, size):
+                print("".join("#" if p else "." for p in row))
+            print()
+
+
+try:
+    Import("env")  # noqa: F821, only defined when PlatformIO runs the script
+except NameError:
+    env = None
+
+if env is not None:
+    generated = os.path.join(env.subst("$BUILD_DIR"), "generated")
+    generate(os.path.join(env.subst("$PROJECT_DIR"), "lib", "Icons", "Icons.h"),
+             os.path.join(generated, "IconsSmall.h"))
+    env.Append(CPPPATH=[generated])
+elif __name__ == "__main__":
+    if len(sys.argv) < 3:
+        sys.exit("usage: shrinkicons.py ICONS_H OUT_H [--preview]")
+    generate(sys.argv[1], sys.argv[2])
+    if "--preview" in sys.argv[3:]:
+        preview(sys.argv[1])
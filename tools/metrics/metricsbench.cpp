@@ -0,0 +1,68 @@
+/*Checks lib/Metrics/DerivedMetrics against its double precision
+reference on a PC. Every temperature from -40 to 60 C and humidity from
+1 to 100 % is run through both, --step-t and --step-rh in hundredths set
+the grid. Prints the largest error of each metric and the time per call,
+the numbers quoted in DerivedMetrics.h come from the default grid.
+
+usage: metricsbench [--step-t 10] [--step-rh 10] [--at T RH]*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "DerivedMetrics.h"
+
+static uint32_t clockUs(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)(ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+/*one reading through both, to look at a single point*/
+static int showPoint(double temperature, double humidity){
+  DerivedMetrics fixed;
+  DerivedMetricsReference reference;
+  if(!deriveMetrics((int32_t)(temperature * 100), (int32_t)(humidity * 100), fixed) ||
+     !deriveMetricsReference(temperature, humidity, reference)){
+    fprintf(stderr, "%.2f C %.2f %% is out of range\n", temperature, humidity);
+    return 1;
+  }
+  printf("                   fixed  reference\n");
+  printf("dew point        %7.2f  %9.3f C\n", fixed.dewPoint / 100.0, reference.dewPoint);
+  printf("frost point      %7.2f  %9.3f C\n", fixed.frostPoint / 100.0, reference.frostPoint);
+  printf("absolute hum.    %7.2f  %9.3f g/m3\n", fixed.absoluteHumidity / 100.0, reference.absoluteHumidity);
+  printf("heat index       %7.2f  %9.3f C\n", fixed.heatIndex / 100.0, reference.heatIndex);
+  return 0;
+}
+
+int main(int argc, char **argv){
+  int32_t stepT = 10, stepRh = 10;
+  for(int i = 1; i < argc; i++){
+    if(strcmp(argv[i], "--at") == 0 && i + 2 < argc){
+      return showPoint(atof(argv[i + 1]), atof(argv[i + 2]));
+    }
+    if(i + 1 >= argc){
+      fprintf(stderr, "usage: %s [--step-t 10] [--step-rh 10] [--at T RH]\n", argv[0]);
+      return 2;
+    }
+    if(strcmp(argv[i], "--step-t") == 0) stepT = atoi(argv[++i]);
+    else if(strcmp(argv[i], "--step-rh") == 0) stepRh = atoi(argv[++i]);
+    else{
+      fprintf(stderr, "usage: %s [--step-t 10] [--step-rh 10] [--at T RH]\n", argv[0]);
+      return 2;
+    }
+  }
+  if(stepT <= 0 || stepRh <= 0){
+    fprintf(stderr, "steps must be positive\n");
+    return 2;
+  }
+
+  DerivedBenchmark b;
+  benchmarkDerivedMetrics(clockUs, stepT, stepRh, b);
+  printf("%u readings, -40..60 C every %.2f C, 1..100 %% every %.2f %%\n", b.samples, stepT / 100.0, stepRh / 100.0);
+  printf("largest error: dew point %.2f C, frost point %.2f C, absolute humidity %.2f g/m3, heat index %.2f C\n",
+         b.maxError[0] / 100.0, b.maxError[1] / 100.0, b.maxError[2] / 100.0, b.maxError[3] / 100.0);
+  printf("per call: fixed %.3f us, double %.3f us\n", b.fixedUs, b.referenceUs);
+  return 0;
+}
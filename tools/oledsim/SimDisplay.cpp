@@ -0,0 +1,39 @@
+#include "SimDisplay.h"
+
+SimDisplay::SimDisplay() : Adafruit_GFX(OLED_WIDTH, OLED_HEIGHT), panel(controller){
+  memset(back, 0, sizeof(back));
+  memset(front, 0, sizeof(front));
+  panel.begin();
+  for(uint8_t page = 0; page < OLED_PAGES; page++){
+    panel.writePage(page, 0, front + page * OLED_WIDTH, OLED_WIDTH);
+  }
+}
+
+void SimDisplay::drawPixel(int16_t x, int16_t y, uint16_t color){
+  if(x < 0 || x >= OLED_WIDTH || y < 0 || y >= OLED_HEIGHT){
+    return;
+  }
+  uint8_t *p = &back[x + (y / 8) * OLED_WIDTH];
+  uint8_t bit = 1 << (y & 7);
+  switch(color){
+    case 0: *p &= ~bit; break;
+    case 2: *p ^= bit; break;
+    default: *p |= bit; break;
+  }
+}
+
+void SimDisplay::fillScreen(uint16_t color){
+  memset(back, color == 0 ? 0x00 : 0xFF, sizeof(back));
+}
+
+void SimDisplay::display(){
+  for(uint8_t page = 0; page < OLED_PAGES; page++){
+    uint8_t *from = back + page * OLED_WIDTH;
+    uint8_t *to = front + page * OLED_WIDTH;
+    if(memcmp(from, to, OLED_WIDTH) != 0){
+      memcpy(to, from, OLED_WIDTH);
+      panel.writePage(page, 0, to, OLED_WIDTH);
+      pagesSent++;
+    }
+  }
+}
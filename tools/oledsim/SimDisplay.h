@@ -0,0 +1,33 @@
+#ifndef SIM_DISPLAY_H
+#define SIM_DISPLAY_H
+
+#include <Adafruit_GFX.h>
+
+#include "Sh1106.h"
+#include "Sh1106Emulator.h"
+
+/*BufferedDisplay without the task: the same frame buffer and drawPixel,
+and display() sends the changed pages straight to an emulated SH1106, so
+the bus traffic is what the flush task would send for the same frames*/
+class SimDisplay : public Adafruit_GFX {
+ public:
+  SimDisplay();
+
+  void drawPixel(int16_t x, int16_t y, uint16_t color) override;
+  void fillScreen(uint16_t color) override;
+  void display();
+  uint8_t *getBuffer() { return back; }
+
+  /*what the emulated panel shows*/
+  void frame(uint8_t *out) const { controller.frame(out); }
+
+  Sh1106Emulator controller;
+  uint32_t pagesSent = 0;
+
+ private:
+  Sh1106 panel;
+  uint8_t back[OLED_BUFFER_SIZE];
+  uint8_t front[OLED_BUFFER_SIZE];
+};
+
+#endif
@@ -0,0 +1,165 @@
+#include "Adafruit_GFX.h"
+
+/*5 columns per character, bit 0 at the top, the 6th column and 8th row
+are the gap to the next one*/
+static const uint8_t font[][5] = {
+  {0x00, 0x00, 0x00, 0x00, 0x00}, {0x00, 0x00, 0x5F, 0x00, 0x00}, {0x00, 0x07, 0x00, 0x07, 0x00}, // !"
+  {0x14, 0x7F, 0x14, 0x7F, 0x14}, {0x24, 0x2A, 0x7F, 0x2A, 0x12}, {0x23, 0x13, 0x08, 0x64, 0x62}, //#$%
+  {0x36, 0x49, 0x56, 0x20, 0x50}, {0x00, 0x08, 0x07, 0x03, 0x00}, {0x00, 0x1C, 0x22, 0x41, 0x00}, //&'(
+  {0x00, 0x41, 0x22, 0x1C, 0x00}, {0x2A, 0x1C, 0x7F, 0x1C, 0x2A}, {0x08, 0x08, 0x3E, 0x08, 0x08}, //)*+
+  {0x00, 0x80, 0x70, 0x30, 0x00}, {0x08, 0x08, 0x08, 0x08, 0x08}, {0x00, 0x00, 0x60, 0x60, 0x00}, //,-.
+  {0x20, 0x10, 0x08, 0x04, 0x02}, {0x3E, 0x51, 0x49, 0x45, 0x3E}, {0x00, 0x42, 0x7F, 0x40, 0x00}, ///01
+  {0x72, 0x49, 0x49, 0x49, 0x46}, {0x21, 0x41, 0x49, 0x4D, 0x33}, {0x18, 0x14, 0x12, 0x7F, 0x10}, //234
+  {0x27, 0x45, 0x45, 0x45, 0x39}, {0x3C, 0x4A, 0x49, 0x49, 0x31}, {0x41, 0x21, 0x11, 0x09, 0x07}, //567
+  {0x36, 0x49, 0x49, 0x49, 0x36}, {0x46, 0x49, 0x49, 0x29, 0x1E}, {0x00, 0x00, 0x14, 0x00, 0x00}, //89:
+  {0x00, 0x40, 0x34, 0x00, 0x00}, {0x00, 0x08, 0x14, 0x22, 0x41}, {0x14, 0x14, 0x14, 0x14, 0x14}, //;<=
+  {0x00, 0x41, 0x22, 0x14, 0x08}, {0x02, 0x01, 0x59, 0x09, 0x06}, {0x3E, 0x41, 0x5D, 0x59, 0x4E}, //>?@
+  {0x7C, 0x12, 0x11, 0x12, 0x7C}, {0x7F, 0x49, 0x49, 0x49, 0x36}, {0x3E, 0x41, 0x41, 0x41, 0x22}, //ABC
+  {0x7F, 0x41, 0x41, 0x41, 0x3E}, {0x7F, 0x49, 0x49, 0x49, 0x41}, {0x7F, 0x09, 0x09, 0x09, 0x01}, //DEF
+  {0x3E, 0x41, 0x41, 0x51, 0x73}, {0x7F, 0x08, 0x08, 0x08, 0x7F}, {0x00, 0x41, 0x7F, 0x41, 0x00}, //GHI
+  {0x20, 0x40, 0x41, 0x3F, 0x01}, {0x7F, 0x08, 0x14, 0x22, 0x41}, {0x7F, 0x40, 0x40, 0x40, 0x40}, //JKL
+  {0x7F, 0x02, 0x1C, 0x02, 0x7F}, {0x7F, 0x04, 0x08, 0x10, 0x7F}, {0x3E, 0x41, 0x41, 0x41, 0x3E}, //MNO
+  {0x7F, 0x09, 0x09, 0x09, 0x06}, {0x3E, 0x41, 0x51, 0x21, 0x5E}, {0x7F, 0x09, 0x19, 0x29, 0x46}, //PQR
+  {0x26, 0x49, 0x49, 0x49, 0x32}, {0x03, 0x01, 0x7F, 0x01, 0x03}, {0x3F, 0x40, 0x40, 0x40, 0x3F}, //STU
+  {0x1F, 0x20, 0x40, 0x20, 0x1F}, {0x3F, 0x40, 0x38, 0x40, 0x3F}, {0x63, 0x14, 0x08, 0x14, 0x63}, //VWX
+  {0x03, 0x04, 0x78, 0x04, 0x03}, {0x61, 0x59, 0x49, 0x4D, 0x43}, {0x00, 0x7F, 0x41, 0x41, 0x41}, //YZ[
+  {0x02, 0x04, 0x08, 0x10, 0x20}, {0x00, 0x41, 0x41, 0x41, 0x7F}, {0x04, 0x02, 0x01, 0x02, 0x04}, //\]^
+  {0x40, 0x40, 0x40, 0x40, 0x40}, {0x00, 0x03, 0x07, 0x08, 0x00}, {0x20, 0x54, 0x54, 0x78, 0x40}, //_`a
+  {0x7F, 0x28, 0x44, 0x44, 0x38}, {0x38, 0x44, 0x44, 0x44, 0x28}, {0x38, 0x44, 0x44, 0x28, 0x7F}, //bcd
+  {0x38, 0x54, 0x54, 0x54, 0x18}, {0x00, 0x08, 0x7E, 0x09, 0x02}, {0x18, 0xA4, 0xA4, 0x9C, 0x78}, //efg
+  {0x7F, 0x08, 0x04, 0x04, 0x78}, {0x00, 0x44, 0x7D, 0x40, 0x00}, {0x20, 0x40, 0x40, 0x3D, 0x00}, //hij
+  {0x7F, 0x10, 0x28, 0x44, 0x00}, {0x00, 0x41, 0x7F, 0x40, 0x00}, {0x7C, 0x04, 0x78, 0x04, 0x78}, //klm
+  {0x7C, 0x08, 0x04, 0x04, 0x78}, {0x38, 0x44, 0x44, 0x44, 0x38}, {0xFC, 0x18, 0x24, 0x24, 0x18}, //nop
+  {0x18, 0x24, 0x24, 0x18, 0xFC}, {0x7C, 0x08, 0x04, 0x04, 0x08}, {0x48, 0x54, 0x54, 0x54, 0x24}, //qrs
+  {0x04, 0x04, 0x3F, 0x44, 0x24}, {0x3C, 0x40, 0x40, 0x20, 0x7C}, {0x1C, 0x20, 0x40, 0x20, 0x1C}, //tuv
+  {0x3C, 0x40, 0x30, 0x40, 0x3C}, {0x44, 0x28, 0x10, 0x28, 0x44}, {0x4C, 0x90, 0x90, 0x90, 0x7C}, //wxy
+  {0x44, 0x64, 0x54, 0x4C, 0x44}, {0x00, 0x08, 0x36, 0x41, 0x00}, {0x00, 0x00, 0x77, 0x00, 0x00}, //z{|
+  {0x00, 0x41, 0x36, 0x08, 0x00}, {0x02, 0x01, 0x02, 0x04, 0x02}                                  //}~
+};
+static const uint8_t degree[5] = {0x00, 0x06, 0x09, 0x09, 0x06};
+
+static const uint8_t *glyph(unsigned char c){
+  if(c >= 0x20 && c <= 0x7E){
+    return font[c - 0x20];
+  }
+  return c == 0xA7 ? degree : NULL;
+}
+
+Adafruit_GFX::Adafruit_GFX(int16_t w, int16_t h)
+  : WIDTH(w), HEIGHT(h), cursor_x(0), cursor_y(0), textcolor(0xFFFF), textbgcolor(0xFFFF), textsize(1), wrap(true),
+    _cp437(false){
+}
+
+void Adafruit_GFX::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color){
+  for(int16_t i = x; i < x + w; i++){
+    drawFastVLine(i, y, h, color);
+  }
+}
+
+void Adafruit_GFX::fillScreen(uint16_t color){
+  fillRect(0, 0, WIDTH, HEIGHT, color);
+}
+
+void Adafruit_GFX::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color){
+  for(int16_t i = 0; i < w; i++){
+    drawPixel(x + i, y, color);
+  }
+}
+
+void Adafruit_GFX::drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color){
+  for(int16_t i = 0; i < h; i++){
+    drawPixel(x, y + i, color);
+  }
+}
+
+void Adafruit_GFX::drawBitmap(int16_t x, int16_t y, const uint8_t bitmap[], int16_t w, int16_t h, uint16_t color){
+  int16_t byteWidth = (w + 7) / 8;
+  for(int16_t j = 0; j < h; j++){
+    for(int16_t i = 0; i < w; i++){
+      if(pgm_read_byte(&bitmap[j * byteWidth + i / 8]) & (0x80 >> (i & 7))){
+        drawPixel(x + i, y + j, color);
+      }
+    }
+  }
+}
+
+void Adafruit_GFX::drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg, uint8_t size){
+  if(x >= WIDTH || y >= HEIGHT || x + 6 * size - 1 < 0 || y + 8 * size - 1 < 0){
+    return;
+  }
+  /*the library's font without cp437() is one off from 176 up*/
+  if(!_cp437 && c >= 176){
+    c++;
+  }
+  const uint8_t *columns = glyph(c);
+  for(int8_t i = 0; i < 5; i++){
+    uint8_t line = columns != NULL ? columns[i] : 0;
+    for(int8_t j = 0; j < 8; j++, line >>= 1){
+      if(line & 1){
+        fillRect(x + i * size, y + j * size, size, size, color);
+      }else if(bg != color){
+        fillRect(x + i * size, y + j * size, size, size, bg);
+      }
+    }
+  }
+  if(bg != color){
+    fillRect(x + 5 * size, y, size, 8 * size, bg);
+  }
+}
+
+size_t Adafruit_GFX::write(uint8_t c){
+  if(c == '\n'){
+    cursor_x = 0;
+    cursor_y += textsize * 8;
+  }else if(c != '\r'){
+    if(wrap && cursor_x + textsize * 6 > WIDTH){
+      cursor_x = 0;
+      cursor_y += textsize * 8;
+    }
+    drawChar(cursor_x, cursor_y, c, textcolor, textbgcolor, textsize);
+    cursor_x += textsize * 6;
+  }
+  return 1;
+}
+
+/*one line of text is 6 * size per character wide and 8 * size high,
+lines end at '\n' or, with wrap, at the right edge*/
+void Adafruit_GFX::getTextBounds(const char *str, int16_t x, int16_t y, int16_t *x1, int16_t *y1, uint16_t *w,
+                                 uint16_t *h){
+  int16_t cx = x, cy = y, maxx = -1, maxy = -1;
+  for(; *str; str++){
+    if(*str == '\n'){
+      cx = 0;
+      cy += textsize * 8;
+      continue;
+    }
+    if(*str == '\r'){
+      continue;
+    }
+    if(wrap && cx + textsize * 6 > WIDTH){
+      cx = 0;
+      cy += textsize * 8;
+    }
+    if(cx + textsize * 6 - 1 > maxx){
+      maxx = cx + textsize * 6 - 1;
+    }
+    if(cy + textsize * 8 - 1 > maxy){
+      maxy = cy + textsize * 8 - 1;
+    }
+    cx += textsize * 6;
+  }
+  *x1 = x;
+  *y1 = y;
+  *w = maxx >= x ? maxx - x + 1 : 0;
+  *h = maxy >= y ? maxy - y + 1 : 0;
+}
+
+void Adafruit_GFX::getTextBounds(const String &str, int16_t x, int16_t y, int16_t *x1, int16_t *y1, uint16_t *w,
+                                 uint16_t *h){
+  getTextBounds(str.c_str(), x, y, x1, y1, w, h);
+}
+
+void Adafruit_GFX::getTextBounds(const __FlashStringHelper *s, int16_t x, int16_t y, int16_t *x1, int16_t *y1,
+                                 uint16_t *w, uint16_t *h){
+  getTextBounds((const char *)s, x, y, x1, y1, w, h);
+}
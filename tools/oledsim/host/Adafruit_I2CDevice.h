@@ -0,0 +1 @@
+/*Adafruit GFX includes the BusIO headers, nothing from them is used on a PC*/
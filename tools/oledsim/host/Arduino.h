@@ -0,0 +1,41 @@
+/*Just enough of the Arduino core for Adafruit GFX and lib/Screens to build
+on a PC for oledsim. Flash is ordinary memory here, so PROGMEM is empty and
+the pgm_read helpers are plain loads*/
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+#define pgm_read_pointer(addr) (*(void * const *)(addr))
+
+#define DEC 10
+#define HEX 16
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+class __FlashStringHelper;
+#define F(s) ((const __FlashStringHelper *)(s))
+
+class String {
+ public:
+  String(const char *s = "") : s(s) {}
+  const char *c_str() const { return s.c_str(); }
+  unsigned int length() const { return s.length(); }
+
+ private:
+  std::string s;
+};
+
+#include "Print.h"
+
+#endif
@@ -0,0 +1,110 @@
+#include "Arduino.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+
+size_t Print::write(const uint8_t *buffer, size_t size){
+  size_t n = 0;
+  while(size--){
+    n += write(*buffer++);
+  }
+  return n;
+}
+
+size_t Print::write(const char *str){
+  return str == NULL ? 0 : write((const uint8_t *)str, strlen(str));
+}
+
+size_t Print::print(const char *str){
+  return write(str);
+}
+
+size_t Print::print(char c){
+  return write((uint8_t)c);
+}
+
+size_t Print::print(int n, int base){
+  return print((long)n, base);
+}
+
+size_t Print::print(unsigned int n, int base){
+  return print((unsigned long)n, base);
+}
+
+size_t Print::print(long n, int base){
+  if(base == 10 && n < 0){
+    size_t t = print('-');
+    return t + printNumber(-(unsigned long)n, 10);
+  }
+  return printNumber(n, base);
+}
+
+size_t Print::print(unsigned long n, int base){
+  return printNumber(n, base);
+}
+
+size_t Print::print(double n, int digits){
+  return printFloat(n, digits);
+}
+
+size_t Print::printf(const char *format, ...){
+  char buf[256];
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(buf, sizeof(buf), format, args);
+  va_end(args);
+  if(len < 0){
+    return 0;
+  }
+  return write((const uint8_t *)buf, len < (int)sizeof(buf) ? len : sizeof(buf) - 1);
+}
+
+size_t Print::printNumber(unsigned long n, uint8_t base){
+  char buf[8 * sizeof(long) + 1];
+  char *str = &buf[sizeof(buf) - 1];
+  *str = '\0';
+  if(base < 2){
+    base = 10;
+  }
+  do{
+    char c = n % base;
+    n /= base;
+    *--str = c < 10 ? c + '0' : c + 'A' - 10;
+  }while(n);
+  return write(str);
+}
+
+/*same rounding and limits as the ESP32 Arduino core*/
+size_t Print::printFloat(double number, uint8_t digits){
+  size_t n = 0;
+  if(isnan(number)) return print("nan");
+  if(isinf(number)) return print("inf");
+  if(number > 4294967040.0) return print("ovf");
+  if(number < -4294967040.0) return print("ovf");
+
+  if(number < 0.0){
+    n += print('-');
+    number = -number;
+  }
+
+  double rounding = 0.5;
+  for(uint8_t i = 0; i < digits; ++i){
+    rounding /= 10.0;
+  }
+  number += rounding;
+
+  unsigned long intPart = (unsigned long)number;
+  double remainder = number - (double)intPart;
+  n += print(intPart);
+
+  if(digits > 0){
+    n += print('.');
+  }
+  while(digits-- > 0){
+    remainder *= 10.0;
+    unsigned int toPrint = (unsigned int)remainder;
+    n += print(toPrint);
+    remainder -= toPrint;
+  }
+  return n;
+}
@@ -0,0 +1,340 @@
+/*Renders the station screens from lib/Screens on a PC through the real
+SH1106 driver into an emulated controller, and reports what each screen
+costs on the bus.
+
+Every screen is measured twice: cold, drawn onto a blank panel, and in
+rotation, after the screen that comes before it on the device, where only
+the pages that changed are sent. I2C time is estimated for 400 kHz.
+Screens are drawn with the glyph cache like on the device, every screen is
+also drawn through plain GFX text and has to come out the same, and the
+readout draw times of both are printed at the end.
+
+  --dump DIR      write what the emulated panel shows as DIR/<screen>.pbm,
+                  plus the bus cost of every screen to DIR/costs.txt
+  --compare DIR   compare against a dump made earlier, fails when a screen
+                  looks different, costs more bytes on the bus or isn't
+                  in the dump
+  --tolerance PCT bus cost growth still accepted by --compare, default 0
+
+The PBM files show lit pixels white like the panel does. golden/ holds
+a dump of every screen, ctest compares against it. A change that is meant
+to look different dumps there again and commits the new frames with it.
+
+usage: oledsim [--dump DIR | --compare DIR] [--tolerance PCT]*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <map>
+#include <string>
+
+#include "Screens.h"
+#include "SimDisplay.h"
+
+/*I2C at 400 kHz, 9 clocks per byte*/
+static const double I2C_US_PER_BYTE = 9 * 1e6 / 400000;
+/*address and control byte that start every transaction*/
+static const int I2C_BYTES_PER_TRANSACTION = 2;
+
+struct Options {
+  const char *dumpDir = NULL;
+  const char *compareDir = NULL;
+  double tolerance = 0;
+};
+
+static const ForecastSlot forecastSlots[] = {
+  {800, "12:00", 21}, {802, "15:00", 19}, {500, "18:00", 14}, {211, "21:00", -17}
+};
+static const ForecastSlot otherSlots[] = {
+  {211, "21:00", 17}, {601, "00:00", -2}, {801, "03:00", 9}, {804, "06:00", 10}, {741, "09:00", 12}
+};
+
+/*screens in the order the device shows them*/
+struct ScreenCase {
+  const char *name;
+  void (*draw)(Adafruit_GFX &gfx);
+};
+
+static const ScreenCase screens[] = {
+  {"connecting", [](Adafruit_GFX &g){ drawConnectScreen(g, false); }},
+  {"connected", [](Adafruit_GFX &g){ drawConnectScreen(g, true); }},
+  {"inside", [](Adafruit_GFX &g){ drawInsideScreen(g, 21.5f, 45.3f); }},
+  /*the next DHT reading, same screen with new numbers*/
+  {"inside_update", [](Adafruit_GFX &g){ drawInsideScreen(g, 21.56f, 44.9f); }},
+  {"derived", [](Adafruit_GFX &g){
+    DerivedMetrics m;
+    deriveMetrics(2150, 4530, m);
+    drawDerivedScreen(g, m);
+  }},
+  {"derived_frost", [](Adafruit_GFX &g){
+    DerivedMetrics m;
+    deriveMetrics(-800, 8500, m);
+    drawDerivedScreen(g, m);
+  }},
+  {"outside", [](Adafruit_GFX &g){ drawOutsideScreen(g, -3.25f); }},
+  {"forecast1", [](Adafruit_GFX &g){ drawForecastScreen(g, forecastSlots, 1, FORECAST_LAYOUT_1UP); }},
+  {"forecast2", [](Adafruit_GFX &g){ drawForecastScreen(g, forecastSlots + 1, 1, FORECAST_LAYOUT_1UP); }},
+  {"forecast3", [](Adafruit_GFX &g){ drawForecastScreen(g, forecastSlots + 2, 1, FORECAST_LAYOUT_1UP); }},
+  /*the icons the three slots above don't use*/
+  {"forecast_thunderstorm", [](Adafruit_GFX &g){ drawForecastScreen(g, otherSlots, 1, FORECAST_LAYOUT_1UP); }},
+  {"forecast_snow", [](Adafruit_GFX &g){ drawForecastScreen(g, otherSlots + 1, 1, FORECAST_LAYOUT_1UP); }},
+  {"forecast_cloud1", [](Adafruit_GFX &g){ drawForecastScreen(g, otherSlots + 2, 1, FORECAST_LAYOUT_1UP); }},
+  {"forecast_cloud3", [](Adafruit_GFX &g){ drawForecastScreen(g, otherSlots + 3, 1, FORECAST_LAYOUT_1UP); }},
+  {"forecast_fog", [](Adafruit_GFX &g){ drawForecastScreen(g, otherSlots + 4, 1, FORECAST_LAYOUT_1UP); }},
+  {"forecast_place", [](Adafruit_GFX &g){ drawForecastScreen(g, forecastSlots, 1, FORECAST_LAYOUT_1UP, "Helsinki"); }},
+  /*the same slots side by side, each layout once with every icon*/
+  {"forecast_3up", [](Adafruit_GFX &g){ drawForecastScreen(g, forecastSlots, 3, FORECAST_LAYOUT_3UP); }},
+  {"forecast_3up_other", [](Adafruit_GFX &g){ drawForecastScreen(g, otherSlots, 3, FORECAST_LAYOUT_3UP); }},
+  {"forecast_3up_place", [](Adafruit_GFX &g){
+    drawForecastScreen(g, otherSlots + 2, 3, FORECAST_LAYOUT_3UP, "Helsinki");
+  }},
+  {"forecast_4up", [](Adafruit_GFX &g){ drawForecastScreen(g, forecastSlots, 4, FORECAST_LAYOUT_4UP); }},
+  {"forecast_4up_other", [](Adafruit_GFX &g){ drawForecastScreen(g, otherSlots + 1, 4, FORECAST_LAYOUT_4UP); }},
+  {"summary", [](Adafruit_GFX &g){
+    static const ForecastDay days[] = {
+      {19676, 21, 96, 500, 5}, {19677, 12, 88, 804, 8}, {19678, -4, 80, 501, 8},
+      {19679, -125, -38, 601, 8}, {19680, 104, 231, 211, 8}, {19681, 150, 180, 800, 3}
+    };
+    drawSummaryScreen(g, days, 6);
+  }},
+};
+static const int SCREEN_COUNT = sizeof(screens) / sizeof(screens[0]);
+
+struct BusCost {
+  uint32_t pages, data, command, transactions;
+
+  uint32_t wire() const { return data + command + transactions * I2C_BYTES_PER_TRANSACTION; }
+  double ms() const { return wire() * I2C_US_PER_BYTE / 1000; }
+};
+
+static bool parseOptions(int argc, char **argv, Options &opt){
+  for(int i = 1; i < argc; i++){
+    const char *arg = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+    if(value == NULL){
+      return false;
+    }
+    if(strcmp(arg, "--dump") == 0) opt.dumpDir = value;
+    else if(strcmp(arg, "--compare") == 0) opt.compareDir = value;
+    else if(strcmp(arg, "--tolerance") == 0) opt.tolerance = atof(value);
+    else return false;
+    i++;
+  }
+  return !(opt.dumpDir && opt.compareDir) && opt.tolerance >= 0;
+}
+
+static double nowUs(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+struct StdoutPrint : public Print {
+  size_t write(uint8_t c) override { return putchar(c) == EOF ? 0 : 1; }
+};
+
+static uint32_t clockUs(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*draws and sends one screen, returns what went over the bus*/
+static BusCost render(SimDisplay &sim, const ScreenCase &screen, double &renderUs, bool glyphs = true){
+  const Sh1106Emulator &c = sim.controller;
+  setScreenBuffer(glyphs ? sim.getBuffer() : NULL);
+  BusCost before = {sim.pagesSent, c.dataBytes, c.commandBytes, c.transactions};
+  double started = nowUs();
+  screen.draw(sim);
+  renderUs = nowUs() - started;
+  sim.display();
+  BusCost cost = {sim.pagesSent - before.pages, c.dataBytes - before.data,
+                  c.commandBytes - before.command, c.transactions - before.transactions};
+  return cost;
+}
+
+static bool pixel(const uint8_t *frame, int x, int y){
+  return (frame[x + (y / 8) * OLED_WIDTH] >> (y & 7)) & 1;
+}
+
+/*P4 bitmap, 1 is black so unlit pixels are written as 1*/
+static bool writePbm(const std::string &path, const uint8_t *frame){
+  FILE *f = fopen(path.c_str(), "wb");
+  if(f == NULL){
+    perror(path.c_str());
+    return false;
+  }
+  fprintf(f, "P4\n%d %d\n", OLED_WIDTH, OLED_HEIGHT);
+  for(int y = 0; y < OLED_HEIGHT; y++){
+    uint8_t row[OLED_WIDTH / 8];
+    for(int x = 0; x < OLED_WIDTH; x += 8){
+      uint8_t bits = 0;
+      for(int b = 0; b < 8; b++){
+        if(!pixel(frame, x + b, y)) bits |= 0x80 >> b;
+      }
+      row[x / 8] = bits;
+    }
+    fwrite(row, 1, sizeof(row), f);
+  }
+  return fclose(f) == 0;
+}
+
+static bool readPbm(const std::string &path, uint8_t *frame){
+  FILE *f = fopen(path.c_str(), "rb");
+  if(f == NULL){
+    return false;
+  }
+  int w = 0, h = 0;
+  bool ok = fscanf(f, "P4 %d %d", &w, &h) == 2 && w == OLED_WIDTH && h == OLED_HEIGHT && fgetc(f) != EOF;
+  memset(frame, 0, OLED_BUFFER_SIZE);
+  for(int y = 0; ok && y < OLED_HEIGHT; y++){
+    uint8_t row[OLED_WIDTH / 8];
+    if(fread(row, 1, sizeof(row), f) != sizeof(row)){
+      ok = false;
+      break;
+    }
+    for(int x = 0; x < OLED_WIDTH; x++){
+      if(!(row[x / 8] & (0x80 >> (x & 7)))){
+        frame[x + (y / 8) * OLED_WIDTH] |= 1 << (y & 7);
+      }
+    }
+  }
+  fclose(f);
+  return ok;
+}
+
+/*costs.txt lines: screen cold_wire_bytes rotation_wire_bytes*/
+static std::map<std::string, std::pair<uint32_t, uint32_t> > readCosts(const std::string &path){
+  std::map<std::string, std::pair<uint32_t, uint32_t> > costs;
+  FILE *f = fopen(path.c_str(), "r");
+  if(f == NULL){
+    return costs;
+  }
+  char line[256], name[128];
+  unsigned cold, rotation;
+  while(fgets(line, sizeof(line), f)){
+    if(line[0] != '#' && sscanf(line, "%127s %u %u", name, &cold, &rotation) == 3){
+      costs[name] = std::make_pair(cold, rotation);
+    }
+  }
+  fclose(f);
+  return costs;
+}
+
+static bool costGrew(uint32_t now, uint32_t reference, double tolerance){
+  return now > reference + reference * tolerance / 100;
+}
+
+int main(int argc, char **argv){
+  Options opt;
+  if(!parseOptions(argc, argv, opt)){
+    fprintf(stderr, "usage: %s [--dump DIR | --compare DIR] [--tolerance PCT]\n", argv[0]);
+    return 2;
+  }
+
+  std::map<std::string, std::pair<uint32_t, uint32_t> > reference;
+  if(opt.compareDir){
+    reference = readCosts(std::string(opt.compareDir) + "/costs.txt");
+  }
+  FILE *costFile = NULL;
+  if(opt.dumpDir){
+    std::string path = std::string(opt.dumpDir) + "/costs.txt";
+    costFile = fopen(path.c_str(), "w");
+    if(costFile == NULL){
+      perror(path.c_str());
+      return 2;
+    }
+    fprintf(costFile, "# screen cold_wire_bytes rotation_wire_bytes\n");
+  }
+
+  printf("%-22s %25s %25s %10s\n", "", "cold", "in rotation", "");
+  printf("%-22s %5s %6s %5s %7s %5s %6s %5s %7s %10s\n", "screen",
+         "pages", "data", "cmd", "ms", "pages", "data", "cmd", "ms", "render us");
+
+  SimDisplay rotation;
+  int failures = 0;
+  BusCost total = {0, 0, 0, 0};
+  for(int i = 0; i < SCREEN_COUNT; i++){
+    const ScreenCase &screen = screens[i];
+    double coldUs, rotationUs;
+    SimDisplay fresh;
+    BusCost cold = render(fresh, screen, coldUs);
+    BusCost warm = render(rotation, screen, rotationUs);
+    total.pages += warm.pages;
+    total.data += warm.data;
+    total.command += warm.command;
+    total.transactions += warm.transactions;
+
+    printf("%-22s %5u %6u %5u %7.2f %5u %6u %5u %7.2f %10.1f\n", screen.name,
+           cold.pages, cold.data, cold.command, cold.ms(),
+           warm.pages, warm.data, warm.command, warm.ms(), coldUs);
+
+    uint8_t shown[OLED_BUFFER_SIZE], asText[OLED_BUFFER_SIZE];
+    fresh.frame(shown);
+    SimDisplay plain;
+    double plainUs;
+    render(plain, screen, plainUs, false);
+    plain.frame(asText);
+    if(memcmp(shown, asText, sizeof(shown)) != 0){
+      printf("  GLYPHS: glyph cache and GFX text draw this screen differently\n");
+      failures++;
+    }
+    if(opt.dumpDir){
+      if(!writePbm(std::string(opt.dumpDir) + "/" + screen.name + ".pbm", shown)){
+        return 2;
+      }
+      fprintf(costFile, "%s %u %u\n", screen.name, cold.wire(), warm.wire());
+    }
+    if(opt.compareDir){
+      uint8_t golden[OLED_BUFFER_SIZE];
+      if(!readPbm(std::string(opt.compareDir) + "/" + screen.name + ".pbm", golden)){
+        printf("  MISSING: no golden frame, --dump one\n");
+        failures++;
+        continue;
+      }
+      int wrong = 0;
+      for(int y = 0; y < OLED_HEIGHT; y++){
+        for(int x = 0; x < OLED_WIDTH; x++){
+          if(pixel(shown, x, y) != pixel(golden, x, y)) wrong++;
+        }
+      }
+      if(wrong > 0){
+        printf("  RENDER: %d pixels differ\n", wrong);
+        failures++;
+      }
+      std::map<std::string, std::pair<uint32_t, uint32_t> >::const_iterator ref = reference.find(screen.name);
+      if(ref == reference.end()){
+        printf("  MISSING: no bus cost in costs.txt, --dump again\n");
+        failures++;
+      }else{
+        if(costGrew(cold.wire(), ref->second.first, opt.tolerance)){
+          printf("  BUS: cold %u wire bytes, was %u\n", cold.wire(), ref->second.first);
+          failures++;
+        }
+        if(costGrew(warm.wire(), ref->second.second, opt.tolerance)){
+          printf("  BUS: in rotation %u wire bytes, was %u\n", warm.wire(), ref->second.second);
+          failures++;
+        }
+      }
+    }
+  }
+  printf("%-22s %5s %6s %5s %7s %5u %6u %5u %7.2f\n", "rotation total", "", "", "", "",
+         total.pages, total.data, total.command, total.ms());
+
+  if(costFile){
+    fclose(costFile);
+  }
+
+  printf("\nreadouts\n");
+  SimDisplay bench;
+  StdoutPrint out;
+  if(!benchmarkReadouts(bench, bench.getBuffer(), out, clockUs)){
+    failures++;
+  }
+  if(opt.compareDir){
+    printf("%d regression%s\n", failures, failures == 1 ? "" : "s");
+  }
+  return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,150 @@
+/*Runs the screen transitions from lib/Oled/Transition.h against the
+emulated SH1106 and reports what they cost on the bus.
+
+After every step the picture the emulated panel shows is compared with what
+the transition should look like at that point, so a wrong start line or a
+page written too early shows up as a mismatch. The bus cost is compared to
+redrawing the whole frame for every step, which is what a software
+animation through the frame buffer would send.
+
+usage: oledtransitions [--step 4] [--seed N]
+
+Exits with 1 if any step showed the wrong picture.*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Sh1106.h"
+#include "Sh1106Emulator.h"
+#include "Transition.h"
+
+/*I2C at 400 kHz, 9 clocks per byte*/
+static const double I2C_US_PER_BYTE = 9 * 1e6 / 400000;
+/*address and control byte that start every transaction*/
+static const int I2C_BYTES_PER_TRANSACTION = 2;
+
+struct Options {
+  int step = 4;
+  unsigned seed = 1;
+};
+
+static bool parseOptions(int argc, char **argv, Options &opt){
+  for(int i = 1; i < argc; i++){
+    const char *arg = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+    if(value == NULL){
+      return false;
+    }
+    if(strcmp(arg, "--step") == 0) opt.step = atoi(value);
+    else if(strcmp(arg, "--seed") == 0) opt.seed = atoi(value);
+    else return false;
+    i++;
+  }
+  return opt.step > 0 && opt.step <= OLED_WIDTH;
+}
+
+static bool pixel(const uint8_t *frame, int x, int y){
+  return (frame[x + (y / 8) * OLED_WIDTH] >> (y & 7)) & 1;
+}
+
+/*something screen like: blocks of set and clear columns with empty rows
+between them, so some pages are blank as on the real screens*/
+static void makeScreen(uint8_t *frame){
+  memset(frame, 0, OLED_BUFFER_SIZE);
+  for(int page = 0; page < OLED_PAGES; page++){
+    if(rand() % 4 == 0){
+      continue;
+    }
+    int from = rand() % 64;
+    int to = from + 16 + rand() % 64;
+    for(int x = from; x < to && x < OLED_WIDTH; x++){
+      frame[x + page * OLED_WIDTH] = rand() & 0xFF;
+    }
+  }
+}
+
+/*what the panel should show after moved rows or columns*/
+static bool expectedPixel(TransitionType type, const uint8_t *from, const uint8_t *to, int moved, int x, int y){
+  switch(type){
+    case TRANSITION_SLIDE_UP:
+      return y < OLED_HEIGHT - moved ? pixel(from, x, y + moved) : pixel(to, x, y - (OLED_HEIGHT - moved));
+    case TRANSITION_SLIDE_DOWN:
+      return y < moved ? pixel(to, x, y + OLED_HEIGHT - moved) : pixel(from, x, y - moved);
+    case TRANSITION_WIPE_LEFT:
+      return x >= OLED_WIDTH - moved ? pixel(to, x, y) : pixel(from, x, y);
+    case TRANSITION_WIPE_RIGHT:
+      return x < moved ? pixel(to, x, y) : pixel(from, x, y);
+    default:
+      return pixel(to, x, y);
+  }
+}
+
+static int runOne(const char *name, TransitionType type, const Options &opt){
+  uint8_t from[OLED_BUFFER_SIZE], to[OLED_BUFFER_SIZE], ram[OLED_BUFFER_SIZE];
+  makeScreen(from);
+  makeScreen(to);
+
+  Sh1106Emulator emulator;
+  Sh1106 panel(emulator);
+  panel.begin();
+  for(uint8_t page = 0; page < OLED_PAGES; page++){
+    panel.writePage(page, 0, from + page * OLED_WIDTH, OLED_WIDTH);
+  }
+  memcpy(ram, from, sizeof(ram));
+
+  uint32_t data0 = emulator.dataBytes, cmd0 = emulator.commandBytes, tr0 = emulator.transactions;
+  Transition transition(panel);
+  transition.begin(type, ram, to, opt.step);
+  int steps = 0, mismatches = 0;
+  bool more;
+  do{
+    more = transition.step();
+    steps++;
+    int moved = more ? transition.progress() : (type == TRANSITION_WIPE_LEFT || type == TRANSITION_WIPE_RIGHT ? OLED_WIDTH : OLED_HEIGHT);
+    for(int y = 0; y < OLED_HEIGHT; y++){
+      for(int x = 0; x < OLED_WIDTH; x++){
+        if(emulator.visiblePixel(x, y) != expectedPixel(type, from, to, moved, x, y)){
+          mismatches++;
+        }
+      }
+    }
+  }while(more);
+
+  if(memcmp(ram, to, sizeof(ram)) != 0 || emulator.startLine != 0){
+    printf("%s: did not end on the new screen\n", name);
+    mismatches++;
+  }
+
+  uint32_t data = emulator.dataBytes - data0;
+  uint32_t cmd = emulator.commandBytes - cmd0;
+  uint32_t transactions = emulator.transactions - tr0;
+  uint32_t wire = data + cmd + transactions * I2C_BYTES_PER_TRANSACTION;
+  /*whole frame per step: 8 pages of data plus page and column commands*/
+  uint32_t redraw = steps * OLED_PAGES * (OLED_WIDTH + 3 + 2 * I2C_BYTES_PER_TRANSACTION);
+
+  printf("%-11s %3d steps %6u data %5u cmd %5u wire bytes %7.1f ms  redraw %6u bytes %7.1f ms  %s\n",
+         name, steps, data, cmd, wire, wire * I2C_US_PER_BYTE / 1000,
+         redraw, redraw * I2C_US_PER_BYTE / 1000,
+         mismatches == 0 ? "ok" : "MISMATCH");
+  if(mismatches > 0){
+    printf("  %d wrong pixels\n", mismatches);
+  }
+  return mismatches;
+}
+
+int main(int argc, char **argv){
+  Options opt;
+  if(!parseOptions(argc, argv, opt)){
+    fprintf(stderr, "usage: %s [--step N] [--seed N]\n", argv[0]);
+    return 2;
+  }
+  srand(opt.seed);
+
+  int failed = 0;
+  failed += runOne("slide_up", TRANSITION_SLIDE_UP, opt) > 0;
+  failed += runOne("slide_down", TRANSITION_SLIDE_DOWN, opt) > 0;
+  failed += runOne("wipe_left", TRANSITION_WIPE_LEFT, opt) > 0;
+  failed += runOne("wipe_right", TRANSITION_WIPE_RIGHT, opt) > 0;
+  return failed > 0 ? 1 : 0;
+}
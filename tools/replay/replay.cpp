@@ -0,0 +1,680 @@
+/*Replays a station trace through lib/Station under a virtual clock.
+
+The firmware built with -D STATION_TRACE prints "@T" lines for every sensor
+read and HTTP request (see lib/Station/StationTrace.h). Save the serial
+output to a file and pass it with --trace. Recorded values are handed out in
+order and the trace starts over when it runs out, so a few minutes of
+recording can drive a whole simulated day. Without --trace constant
+readings are used, or with --synthetic a day of weather: a daily swing
+outside with a 6 C cold front at 14:00, a shower's worth of humidity at
+07:00, and sensor noise on top.
+
+Waits in the station logic jump the virtual clock forward instead of
+sleeping, so a 24 hour day runs in well under a second.
+
+Faults are scripted in a file given with --faults, one per line:
+
+  # from_s to_s fault [probability]
+  3600  3900  dht_nan
+  7200  7300  ds_disconnected 0.5
+  0     86400 http_timeout 0.05
+  10000 10600 http_429
+  20000 20100 wifi_down
+  30000 40000 weak_signal
+
+Times are seconds of virtual time. Faults: dht_nan, ds_disconnected (-127),
+http_timeout (request fails at its 10 s deadline), http_429 (answered with
+Retry-After: 60), wifi_down and weak_signal (RSSI -84 dBm instead of -55).
+The report shows the requests and airtime at each link quality.
+
+--locations N runs the forecast carousel with N places, the report then
+shows how evenly the fetches were spread.
+
+--slots-per-screen N shows N forecast slots per screen like the 3-up and
+4-up layouts do, fewer screens are drawn and flushed per pass.
+
+--upload-interval S overrides the 10 minute upload interval, so the
+ThingSpeak token bucket can be seen holding uploads back. The report checks
+every request against the free tier quotas (ThingSpeak one per 15 s,
+OpenWeatherMap 60 a minute) and the exit status is 1 if one was exceeded.
+
+--current USE=MA changes one current of the energy model (see
+lib/Energy/EnergyMeter.h for the names), it can be given more than once.
+The report ends with the estimated mAh per day and where it goes.
+
+--max-sample-period S sets how long adaptive sampling may leave a sensor
+unread, 0 reads it on every slot. With --synthetic the report compares
+every value shown with the weather it was generated from.
+
+usage: replay [--trace FILE] [--faults FILE] [--hours 24] [--seed N]
+              [--render-ms N] [--locations N] [--slots-per-screen N] [--upload-interval S]
+              [--synthetic] [--max-sample-period S] [--current USE=MA]...
+              [--verbose]*/
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "AsyncHttp.h"
+#include "Station.h"
+#include "StationTrace.h"
+
+/*deadline the firmware gives every HTTP request*/
+static const uint32_t REQUEST_DEADLINE_MS = 10000;
+
+/*free tier limits the requests are checked against*/
+static const uint32_t THINGSPEAK_MIN_GAP_MS = 15000;
+static const uint32_t WEATHER_PER_MINUTE = 60;
+static const int32_t RETRY_AFTER_S = 60;
+/*dBm reported with and without weak_signal*/
+static const int STRONG_RSSI = -55;
+static const int WEAK_RSSI = -84;
+
+enum FaultType {
+  FAULT_DHT_NAN,
+  FAULT_DS_DISCONNECTED,
+  FAULT_HTTP_TIMEOUT,
+  FAULT_HTTP_429,
+  FAULT_WIFI_DOWN,
+  FAULT_WEAK_SIGNAL,
+  FAULT_COUNT
+};
+
+static const char *faultNames[FAULT_COUNT] = {
+  "dht_nan", "ds_disconnected", "http_timeout", "http_429", "wifi_down", "weak_signal"
+};
+
+struct Fault {
+  FaultType type;
+  uint32_t from;
+  uint32_t to;
+  double probability;
+};
+
+struct Options {
+  const char *tracePath = NULL;
+  const char *faultPath = NULL;
+  double hours = 24;
+  unsigned seed = 1;
+  uint32_t renderMs = 0;
+  int locations = 1;
+  int slotsPerScreen = 1;
+  double uploadInterval = 0;
+  double maxSamplePeriod = -1;
+  bool synthetic = false;
+  bool verbose = false;
+  std::vector<std::string> currents;
+};
+
+/*what the replay saw, printed at the end*/
+struct Report {
+  uint32_t dhtReads = 0, dhtNan = 0;
+  uint32_t dsReads = 0, dsDisconnected = 0;
+  uint32_t forecastRequests = 0, forecastFailed = 0;
+  uint32_t uploadRequests = 0, uploadFailed = 0;
+  uint32_t uploadsWithNan = 0, uploadsWithProbeError = 0;
+  uint32_t minUploadGap = UINT32_MAX, maxUploadGap = 0;
+  /*between any two forecast requests, and between two of one location.
+  The first refresh window is left out, after boot every location is
+  fetched right away*/
+  uint32_t minForecastGap = UINT32_MAX, maxForecastGap = 0;
+  uint32_t minLocationGap = UINT32_MAX, maxLocationGap = 0;
+  uint32_t forecastsShown[STATION_MAX_LOCATIONS] = {};
+  uint32_t forecastScreens = 0;
+  uint32_t maxRequestsPerHour = 0;
+  /*quota checks: closest two uploads, most forecasts in a minute*/
+  uint32_t minThingSpeakGap = UINT32_MAX;
+  uint32_t maxWeatherPerMinute = 0;
+  /*--synthetic: every shown value against the generated weather*/
+  double shownError[3] = {}, maxShownError[3] = {};
+  uint32_t shown[3] = {};
+  uint32_t injected[FAULT_COUNT] = {};
+};
+
+static bool parseOptions(int argc, char **argv, Options &opt){
+  for(int i = 1; i < argc; i++){
+    const char *arg = argv[i];
+    if(strcmp(arg, "--verbose") == 0){
+      opt.verbose = true;
+      continue;
+    }
+    if(strcmp(arg, "--synthetic") == 0){
+      opt.synthetic = true;
+      continue;
+    }
+    const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+    if(value == NULL){
+      return false;
+    }
+    if(strcmp(arg, "--trace") == 0) opt.tracePath = value;
+    else if(strcmp(arg, "--faults") == 0) opt.faultPath = value;
+    else if(strcmp(arg, "--hours") == 0) opt.hours = atof(value);
+    else if(strcmp(arg, "--seed") == 0) opt.seed = atoi(value);
+    else if(strcmp(arg, "--render-ms") == 0) opt.renderMs = atoi(value);
+    else if(strcmp(arg, "--locations") == 0) opt.locations = atoi(value);
+    else if(strcmp(arg, "--slots-per-screen") == 0) opt.slotsPerScreen = atoi(value);
+    else if(strcmp(arg, "--upload-interval") == 0) opt.uploadInterval = atof(value);
+    else if(strcmp(arg, "--max-sample-period") == 0) opt.maxSamplePeriod = atof(value);
+    else if(strcmp(arg, "--current") == 0) opt.currents.push_back(value);
+    else return false;
+    i++;
+  }
+  return opt.hours > 0 && opt.locations > 0 && opt.locations <= STATION_MAX_LOCATIONS && opt.uploadInterval >= 0 &&
+         opt.slotsPerScreen > 0;
+}
+
+static bool loadTrace(const char *path, std::vector<TraceRecord> *channels){
+  FILE *f = fopen(path, "r");
+  if(f == NULL){
+    perror(path);
+    return false;
+  }
+  char line[512];
+  int count = 0;
+  while(fgets(line, sizeof(line), f)){
+    TraceRecord record;
+    if(parseTraceRecord(line, record)){
+      channels[record.kind].push_back(record);
+      count++;
+    }
+  }
+  fclose(f);
+  fprintf(stderr, "loaded %d trace records from %s\n", count, path);
+  return true;
+}
+
+static bool loadFaults(const char *path, std::vector<Fault> &faults){
+  FILE *f = fopen(path, "r");
+  if(f == NULL){
+    perror(path);
+    return false;
+  }
+  char line[256];
+  int lineNo = 0;
+  while(fgets(line, sizeof(line), f)){
+    lineNo++;
+    char *hash = strchr(line, '#');
+    if(hash) *hash = '\0';
+
+    double from, to, probability = 1.0;
+    char name[32];
+    int n = sscanf(line, "%lf %lf %31s %lf", &from, &to, name, &probability);
+    if(n <= 0){
+      continue;
+    }
+    if(n < 3){
+      fprintf(stderr, "%s:%d: expected <from_s> <to_s> <fault> [probability]\n", path, lineNo);
+      fclose(f);
+      return false;
+    }
+    int type = 0;
+    while(type < FAULT_COUNT && strcmp(faultNames[type], name) != 0) type++;
+    if(type == FAULT_COUNT){
+      fprintf(stderr, "%s:%d: unknown fault %s\n", path, lineNo, name);
+      fclose(f);
+      return false;
+    }
+    Fault fault = {(FaultType)type, (uint32_t)(from * 1000), (uint32_t)(to * 1000), probability};
+    faults.push_back(fault);
+  }
+  fclose(f);
+  return true;
+}
+
+/*--synthetic weather at virtual time ms, without sensor noise*/
+enum SyntheticChannel { SYNTH_INSIDE, SYNTH_HUMIDITY, SYNTH_OUTSIDE };
+
+static double ramp(double hours, double from, double length){
+  double x = (hours - from) / length;
+  return x < 0 ? 0 : x > 1 ? 1 : x;
+}
+
+static double syntheticValue(SyntheticChannel channel, uint32_t ms){
+  double hours = fmod(ms / 3600000.0, 24);
+  double day = sin(2 * M_PI * (hours - 9) / 24);
+  switch(channel){
+    case SYNTH_INSIDE:
+      return 21 + 0.5 * day;
+    case SYNTH_HUMIDITY:
+      /*up 10 % in 10 minutes, back down over an hour*/
+      return 40 - 3 * day + 10 * (ramp(hours, 7, 1 / 6.0) - ramp(hours, 7 + 1 / 6.0, 1));
+    default:
+      /*cold front at 14:00, 6 C down in half an hour, back up from 20:00*/
+      return 5 + 4 * day - 6 * (ramp(hours, 14, 0.5) - ramp(hours, 20, 2));
+  }
+}
+
+class ReplayIo : public StationIo {
+ public:
+  ReplayIo(const Options &opt, std::vector<TraceRecord> *channels, const std::vector<Fault> &faults)
+    : opt(opt), channels(channels), faults(faults), rng(opt.seed){}
+
+  uint32_t now() override { return clock; }
+
+  void waitUntil(uint32_t deadline) override {
+    if((int32_t)(deadline - clock) > 0){
+      clock = deadline;
+    }
+  }
+
+  void readInside(float &temperature, float &humidity) override {
+    TraceRecord r = next(TRACE_DHT, 21.0f, 40.0f, 5);
+    temperature = r.temperature;
+    humidity = r.humidity;
+    if(opt.synthetic){
+      temperature = syntheticValue(SYNTH_INSIDE, clock) + noise(0.05);
+      humidity = syntheticValue(SYNTH_HUMIDITY, clock) + noise(0.3);
+    }
+    if(faultActive(FAULT_DHT_NAN)){
+      temperature = humidity = NAN;
+    }
+    clock += r.duration;
+    report.dhtReads++;
+    if(isnan(temperature) || isnan(humidity)){
+      report.dhtNan++;
+      nanSinceUpload = true;
+    }
+  }
+
+  float readOutside() override {
+    TraceRecord r = next(TRACE_DS, 5.0f, 0, 750);
+    float temperature = r.temperature;
+    if(opt.synthetic){
+      temperature = syntheticValue(SYNTH_OUTSIDE, clock) + noise(0.03);
+    }
+    if(faultActive(FAULT_DS_DISCONNECTED)){
+      temperature = -127;
+    }
+    clock += r.duration;
+    report.dsReads++;
+    if(temperature <= -127){
+      report.dsDisconnected++;
+      probeErrorSinceUpload = true;
+    }
+    return temperature;
+  }
+
+  bool wifiConnected() override {
+    return !faultActive(FAULT_WIFI_DOWN);
+  }
+
+  int linkRssi() override {
+    return faultActive(FAULT_WEAK_SIGNAL) ? WEAK_RSSI : STRONG_RSSI;
+  }
+
+  /*the request runs in the background, finishForecast() only waits
+  for whatever is left of it*/
+  void startForecast(int location) override {
+    countRequest();
+    report.forecastRequests++;
+    if(report.forecastRequests > 1 && (int32_t)(lastForecastAt - steadyFrom) >= 0){
+      gap(clock - lastForecastAt, report.minForecastGap, report.maxForecastGap);
+    }
+    lastForecastAt = clock;
+    if(locationFetched[location] && (int32_t)(locationFetchedAt[location] - steadyFrom) >= 0){
+      gap(clock - locationFetchedAt[location], report.minLocationGap, report.maxLocationGap);
+    }
+    locationFetched[location] = true;
+    locationFetchedAt[location] = clock;
+    weatherWindow.push_back(clock);
+    while(clock - weatherWindow.front() >= 60000) weatherWindow.pop_front();
+    if(weatherWindow.size() > report.maxWeatherPerMinute) report.maxWeatherPerMinute = weatherWindow.size();
+    TraceRecord r = next(TRACE_FORECAST, 0, 0, 300);
+
+    pendingForecast = r;
+    if(channels[TRACE_FORECAST].empty()){
+      pendingForecast.result = STATION_FORECAST_SLOTS;
+      for(int i = 0; i < STATION_FORECAST_SLOTS; i++){
+        ForecastSlot &slot = pendingForecast.slots[i];
+        slot.weatherId = 800;
+        snprintf(slot.time, sizeof(slot.time), "%02d:00", (i * 3) % 24);
+        slot.temperature = 5;
+      }
+    }
+
+    forecastStatus = 200;
+    forecastTime = r.duration;
+    if(faultActive(FAULT_HTTP_TIMEOUT)){
+      forecastTime = REQUEST_DEADLINE_MS;
+      forecastReadyAt = clock + REQUEST_DEADLINE_MS;
+      pendingForecast.result = -1;
+      forecastStatus = -ASYNC_HTTP_TIMEOUT;
+    }else{
+      forecastReadyAt = clock + r.duration;
+      /*OpenWeather answers 429 with a small JSON error object,
+      which has no forecast list in it*/
+      if(faultActive(FAULT_HTTP_429)){
+        pendingForecast.result = -1;
+        forecastStatus = 429;
+      }
+    }
+  }
+
+  int finishForecast(ForecastSlot *slots, int count) override {
+    waitUntil(forecastReadyAt);
+    int result = pendingForecast.result;
+    for(int i = 0; i < result && i < count; i++){
+      slots[i] = pendingForecast.slots[i];
+    }
+    if(result < count) report.forecastFailed++;
+    log("forecast %s", result >= count ? "ok" : "failed");
+    return result;
+  }
+
+  uint32_t requestTime(int host) override {
+    return host == STATION_HOST_WEATHER ? forecastTime : uploadTime;
+  }
+
+  /*uploads complete in the background and don't hold up the station*/
+  void startUpload(float outsideTemp, float insideTemp, float humidity, const DerivedMetrics *derived) override {
+    countRequest();
+    report.uploadRequests++;
+    if(report.uploadRequests > 1){
+      uint32_t gap = clock - lastUploadAt;
+      if(gap < report.minUploadGap) report.minUploadGap = gap;
+      if(gap > report.maxUploadGap) report.maxUploadGap = gap;
+      /*ThingSpeak counts from when the last update arrived*/
+      uint32_t sinceArrival = clock - lastUploadDoneAt;
+      if(sinceArrival < report.minThingSpeakGap) report.minThingSpeakGap = sinceArrival;
+    }
+    lastUploadAt = clock;
+
+    if(isnan(insideTemp) || isnan(humidity) || isnan(outsideTemp)) report.uploadsWithNan++;
+    if(probeErrorSinceUpload) report.uploadsWithProbeError++;
+    nanSinceUpload = probeErrorSinceUpload = false;
+
+    TraceRecord r = next(TRACE_UPLOAD, 0, 0, 300);
+    int code = channels[TRACE_UPLOAD].empty() ? 200 : r.result;
+    if(faultActive(FAULT_HTTP_TIMEOUT)){
+      code = -ASYNC_HTTP_TIMEOUT;
+    }else if(faultActive(FAULT_HTTP_429)){
+      code = 429;
+    }
+    if(code != 200) report.uploadFailed++;
+    uploadStatus = code;
+    uploadTime = code == -ASYNC_HTTP_TIMEOUT ? REQUEST_DEADLINE_MS : r.duration;
+    uploadDoneAt = clock + uploadTime;
+    lastUploadDoneAt = uploadDoneAt;
+    if(derived != NULL){
+      log("upload out %.2f in %.2f hum %.2f dew %.2f abs %.2f feels %.2f -> %d", outsideTemp, insideTemp, humidity,
+          derived->dewPoint / 100.0, derived->absoluteHumidity / 100.0, derived->heatIndex / 100.0, code);
+    }else{
+      log("upload out %.2f in %.2f hum %.2f -> %d", outsideTemp, insideTemp, humidity, code);
+    }
+  }
+
+  int requestResult(int host, int32_t &retryAfter) override {
+    bool weather = host == STATION_HOST_WEATHER;
+    if((int32_t)(clock - (weather ? forecastReadyAt : uploadDoneAt)) < 0){
+      return 0;
+    }
+    int status = weather ? forecastStatus : uploadStatus;
+    retryAfter = status == 429 ? RETRY_AFTER_S : -1;
+    return status;
+  }
+
+  void sendCollectorFrame(float, float, float) override {}
+
+  void showInside(float temperature, float humidity) override {
+    compare(SYNTH_INSIDE, temperature);
+    compare(SYNTH_HUMIDITY, humidity);
+    clock += opt.renderMs;
+  }
+  void showOutside(float temperature) override {
+    compare(SYNTH_OUTSIDE, temperature);
+    clock += opt.renderMs;
+  }
+
+  int forecastSlotsPerScreen() override { return opt.slotsPerScreen; }
+  void showForecast(int location, int first, const ForecastSlot *, int, uint32_t durationMs) override {
+    if(first == 0) report.forecastsShown[location]++;
+    report.forecastScreens++;
+    clock += opt.renderMs;
+    waitUntil(clock + durationMs);
+  }
+
+  Report report;
+  uint32_t steadyFrom = 0;
+
+ private:
+  /*next recorded value of a kind, or the given defaults if the trace has none*/
+  TraceRecord next(TraceKind kind, float temperature, float humidity, uint32_t duration){
+    std::vector<TraceRecord> &records = channels[kind];
+    if(records.empty()){
+      TraceRecord r;
+      memset(&r, 0, sizeof(r));
+      r.kind = kind;
+      r.temperature = temperature;
+      r.humidity = humidity;
+      r.duration = duration;
+      r.result = 200;
+      return r;
+    }
+    TraceRecord r = records[cursor[kind]];
+    cursor[kind] = (cursor[kind] + 1) % records.size();
+    return r;
+  }
+
+  bool faultActive(FaultType type){
+    for(size_t i = 0; i < faults.size(); i++){
+      const Fault &f = faults[i];
+      if(f.type != type || clock < f.from || clock >= f.to) continue;
+      if(f.probability >= 1.0 || (rand_r(&rng) / (RAND_MAX + 1.0)) < f.probability){
+        report.injected[type]++;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /*gaussian sensor noise*/
+  double noise(double sigma){
+    double u1 = (rand_r(&rng) + 1.0) / (RAND_MAX + 2.0);
+    double u2 = rand_r(&rng) / (RAND_MAX + 1.0);
+    return sigma * sqrt(-2 * ::log(u1)) * cos(2 * M_PI * u2);
+  }
+
+  void compare(SyntheticChannel channel, float shownValue){
+    if(!opt.synthetic || isnan(shownValue) || shownValue <= -127) return;
+    double error = fabs(shownValue - syntheticValue(channel, clock));
+    report.shownError[channel] += error * error;
+    report.shown[channel]++;
+    if(error > report.maxShownError[channel]) report.maxShownError[channel] = error;
+  }
+
+  /*requests are counted per hour of virtual time to check API quotas*/
+  void countRequest(){
+    uint32_t hour = clock / 3600000;
+    if(hour != currentHour){
+      currentHour = hour;
+      requestsThisHour = 0;
+    }
+    requestsThisHour++;
+    if(requestsThisHour > report.maxRequestsPerHour){
+      report.maxRequestsPerHour = requestsThisHour;
+    }
+  }
+
+  void log(const char *fmt, ...) __attribute__((format(printf, 2, 3))){
+    if(!opt.verbose) return;
+    char text[160];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(text, sizeof(text), fmt, args);
+    va_end(args);
+    uint32_t s = clock / 1000;
+    printf("%02u:%02u:%02u.%03u %s\n", s / 3600, (s / 60) % 60, s % 60, clock % 1000, text);
+  }
+
+  const Options &opt;
+  std::vector<TraceRecord> *channels;
+  const std::vector<Fault> &faults;
+  unsigned rng;
+  size_t cursor[4] = {};
+
+  /*setup() spends about 3 s on the display and WiFi before the first pass*/
+  uint32_t clock = 3000;
+  uint32_t lastUploadAt = 0;
+  TraceRecord pendingForecast;
+  uint32_t forecastReadyAt = 0;
+  int forecastStatus = 0;
+  uint32_t forecastTime = 0, uploadTime = 0;
+  uint32_t uploadDoneAt = 0, lastUploadDoneAt = 0;
+  int uploadStatus = 0;
+  uint32_t lastForecastAt = 0;
+  std::deque<uint32_t> weatherWindow;
+  bool locationFetched[STATION_MAX_LOCATIONS] = {};
+  uint32_t locationFetchedAt[STATION_MAX_LOCATIONS] = {};
+
+  static void gap(uint32_t value, uint32_t &min, uint32_t &max){
+    if(value < min) min = value;
+    if(value > max) max = value;
+  }
+  uint32_t currentHour = 0, requestsThisHour = 0;
+  bool nanSinceUpload = false, probeErrorSinceUpload = false;
+};
+
+int main(int argc, char **argv){
+  Options opt;
+  if(!parseOptions(argc, argv, opt)){
+    fprintf(stderr, "usage: %s [--trace FILE] [--faults FILE] [--hours N] [--seed N] [--render-ms N] [--locations N]\n"
+                    "       [--slots-per-screen N] [--upload-interval S] [--synthetic] [--max-sample-period S] [--current USE=MA]... [--verbose]\n",
+            argv[0]);
+    return 2;
+  }
+
+  std::vector<TraceRecord> channels[4];
+  if(opt.tracePath && !loadTrace(opt.tracePath, channels)){
+    return 1;
+  }
+  std::vector<Fault> faults;
+  if(opt.faultPath && !loadFaults(opt.faultPath, faults)){
+    return 1;
+  }
+
+  ReplayIo io(opt, channels, faults);
+  Station station(io);
+  station.locationCount = opt.locations;
+  if(opt.uploadInterval > 0){
+    station.updateInterval = (uint32_t)(opt.uploadInterval * 1000);
+  }
+  if(opt.maxSamplePeriod >= 0){
+    station.maxSamplePeriod = (uint32_t)(opt.maxSamplePeriod * 1000);
+  }
+  for(size_t i = 0; i < opt.currents.size(); i++){
+    std::string name = opt.currents[i];
+    size_t eq = name.find('=');
+    if(eq == std::string::npos || !station.energy.setCurrent(name.substr(0, eq).c_str(), atof(name.c_str() + eq + 1))){
+      fprintf(stderr, "--current %s: expected USE=MA with USE one of", name.c_str());
+      for(int u = 0; u < ENERGY_COUNT; u++) fprintf(stderr, " %s", energyUseNames[u]);
+      fprintf(stderr, "\n");
+      return 2;
+    }
+  }
+  io.steadyFrom = io.now() + station.forecastRefresh;
+
+  uint32_t end = io.now() + (uint32_t)(opt.hours * 3600000);
+  uint32_t minPass = UINT32_MAX, maxPass = 0;
+
+  clock_t started = clock();
+  while((int32_t)(end - io.now()) > 0){
+    uint32_t passStart = io.now();
+    station.runPass();
+    uint32_t passLength = io.now() - passStart;
+    if(passLength < minPass) minPass = passLength;
+    if(passLength > maxPass) maxPass = passLength;
+  }
+  double wall = (double)(clock() - started) / CLOCKS_PER_SEC;
+
+  const Report &r = io.report;
+  double simulated = opt.hours * 3600;
+  printf("simulated %.1f h in %.3f s (%.0fx real time)\n", opt.hours, wall, wall > 0 ? simulated / wall : 0);
+  printf("passes            %u, %.1f s to %.1f s each\n", station.passes, minPass / 1000.0, maxPass / 1000.0);
+  printf("DHT reads         %u, %u NaN\n", r.dhtReads, r.dhtNan);
+  printf("DS18B20 reads     %u, %u disconnected\n", r.dsReads, r.dsDisconnected);
+  printf("sampling          DHT22 every %.1f s, DS18B20 every %.1f s, %u and %u slots from the filter\n",
+         r.dhtReads ? simulated / r.dhtReads : 0, r.dsReads ? simulated / r.dsReads : 0,
+         station.insideSkipped, station.outsideSkipped);
+  const SampleFilter *filters[3] = {&station.insideTempFilter, &station.humidityFilter, &station.outsideTempFilter};
+  const char *channelNames[3] = {"inside", "humidity", "outside"};
+  for(int i = 0; i < 3; i++){
+    printf("%-17s filter %.3f rms off at reads, %u surprises", channelNames[i],
+           filters[i]->reconstructionError(), filters[i]->surprises);
+    if(r.shown[i] > 0){
+      printf(", shown %.3f rms %.3f max off the weather", sqrt(r.shownError[i] / r.shown[i]), r.maxShownError[i]);
+    }
+    printf("\n");
+  }
+  printf("forecast requests %u, %u failed\n", r.forecastRequests, r.forecastFailed);
+  if(r.maxForecastGap > 0){
+    printf("forecast gap      %.1f s to %.1f s\n", r.minForecastGap / 1000.0, r.maxForecastGap / 1000.0);
+  }
+  if(r.maxLocationGap > 0){
+    printf("location refresh  %.1f s to %.1f s\n", r.minLocationGap / 1000.0, r.maxLocationGap / 1000.0);
+  }
+  printf("forecast screens  %u, %d slots per screen\n", r.forecastScreens, opt.slotsPerScreen);
+  if(opt.locations > 1){
+    printf("forecasts shown  ");
+    for(int i = 0; i < opt.locations; i++) printf(" %u", r.forecastsShown[i]);
+    printf("\n");
+  }
+  printf("uploads           %u, %u failed, %u with NaN averages, %u with -127 in the average\n",
+         r.uploadRequests, r.uploadFailed, r.uploadsWithNan, r.uploadsWithProbeError);
+  if(r.uploadRequests > 1){
+    printf("upload interval   %.1f s to %.1f s\n", r.minUploadGap / 1000.0, r.maxUploadGap / 1000.0);
+  }
+  printf("requests per hour %u at most\n", r.maxRequestsPerHour);
+
+  for(int i = 0; i < station.outbound.hostCount(); i++){
+    const OutboundHost &h = station.outbound.host(i);
+    printf("%-22s %u sent, %u coalesced, %u throttled, %u deferred, %u rejected, %u queued at most\n",
+           h.name, h.stats.sent, h.stats.coalesced, h.stats.throttled, h.stats.deferred,
+           h.stats.rejected, h.stats.maxQueued);
+  }
+  for(int i = 0; i < LINK_BUCKETS; i++){
+    LinkBucketStats s = station.link.stats(i, io.now());
+    if(s.timeMs == 0 && s.requests == 0) continue;
+    printf("link %-17s %.1f h, %u requests, %u failed, %.1f s airtime\n", LinkQuality::bucketName(i),
+           s.timeMs / 3600000.0, s.requests, s.failed, s.airtimeMs / 1000.0);
+  }
+  const EnergyMeter &energy = station.energy;
+  uint32_t now = io.now();
+  printf("energy            %.0f mAh per day, of which\n", energy.milliampHoursPerDay(now));
+  for(int i = 0; i < ENERGY_COUNT; i++){
+    EnergyUse use = (EnergyUse)i;
+    float share = energy.totalMilliampHours(now) > 0 ? energy.milliampHours(use, now) / energy.totalMilliampHours(now) * 100 : 0;
+    char events[12] = "-";
+    if(!EnergyMeter::derived(use)){
+      snprintf(events, sizeof(events), "%u", energy.eventCount(use));
+    }
+    printf("  %-16s %9.1f s on, %6s times, %6.1f mA, %5.1f %%\n", energyUseNames[i], energy.onTime(use, now) / 1000.0,
+           events, energy.current[i], share);
+  }
+
+  bool withinQuota = true;
+  if(r.uploadRequests > 1){
+    bool ok = r.minThingSpeakGap >= THINGSPEAK_MIN_GAP_MS;
+    printf("ThingSpeak quota   %.1f s since the last update at least, limit %.0f s: %s\n",
+           r.minThingSpeakGap / 1000.0, THINGSPEAK_MIN_GAP_MS / 1000.0, ok ? "ok" : "EXCEEDED");
+    withinQuota = withinQuota && ok;
+  }
+  if(r.forecastRequests > 0){
+    bool ok = r.maxWeatherPerMinute <= WEATHER_PER_MINUTE;
+    printf("OpenWeather quota  %u requests in a minute at most, limit %u: %s\n",
+           r.maxWeatherPerMinute, WEATHER_PER_MINUTE, ok ? "ok" : "EXCEEDED");
+    withinQuota = withinQuota && ok;
+  }
+  for(int i = 0; i < FAULT_COUNT; i++){
+    if(r.injected[i] > 0){
+      printf("injected %-16s %u\n", faultNames[i], r.injected[i]);
+    }
+  }
+  return withinQuota ? 0 : 1;
+}
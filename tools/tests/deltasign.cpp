@@ -0,0 +1,212 @@
+/*Makes a signed patch with tools/delta/mkdelta and applies it with
+tools/delta/applydelta, which runs lib/Delta the way the station does.
+
+- two images that differ like two builds do (code moved with its
+  addresses shifted, a changed stretch, more code at the end) round trip
+  to the exact new image, fed a byte at a time and in TCP sized chunks
+- a patch checked against another key, or with its signature changed,
+  fails with DELTA_BAD_SIGNATURE
+- a patch whose blocks were changed after signing fails with
+  DELTA_BAD_HASH
+- a patch applied to another old image fails with DELTA_WRONG_BASE
+and none of the failures write the new image.
+
+usage: deltasign MKDELTA APPLYDELTA, exit status 0 if every check passed*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+typedef std::vector<uint8_t> Bytes;
+
+static int failures = 0;
+
+static void check(bool ok, const char *what){
+  printf("%-58s %s\n", what, ok ? "ok" : "FAILED");
+  if(!ok){
+    failures++;
+  }
+}
+
+static bool writeFile(const char *path, const Bytes &data){
+  FILE *f = fopen(path, "wb");
+  if(f == NULL){
+    return false;
+  }
+  bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+  return fclose(f) == 0 && ok;
+}
+
+static Bytes readFile(const char *path){
+  Bytes data;
+  FILE *f = fopen(path, "rb");
+  if(f == NULL){
+    return data;
+  }
+  uint8_t buf[4096];
+  size_t n;
+  while((n = fread(buf, 1, sizeof(buf), f)) > 0){
+    data.insert(data.end(), buf, buf + n);
+  }
+  fclose(f);
+  return data;
+}
+
+/*runs command, its output goes to out. Returns the exit status*/
+static int run(const std::string &command, std::string &out){
+  int status = system((command + " > deltasign.out 2>&1").c_str());
+  Bytes text = readFile("deltasign.out");
+  out.assign(text.begin(), text.end());
+  return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static void put32(Bytes &image, size_t at, uint32_t value){
+  memcpy(&image[at], &value, 4);
+}
+
+static uint32_t get32(const Bytes &image, size_t at){
+  uint32_t value;
+  memcpy(&value, &image[at], 4);
+  return value;
+}
+
+/*random code with a 32 bit address every 16 bytes*/
+static Bytes oldImage(){
+  Bytes image(200000);
+  srand(3);
+  for(size_t i = 0; i < image.size(); i++){
+    image[i] = (uint8_t)(rand() >> 7);
+  }
+  for(size_t at = 0; at + 4 <= image.size(); at += 16){
+    put32(image, at, 0x400d0000 + (uint32_t)(rand() % 200000));
+  }
+  return image;
+}
+
+/*what the next build might look like: 1000 bytes of new code at 50000
+push everything after it along, so the addresses past it change, a
+stretch of code is rewritten and more is added at the end*/
+static Bytes newImage(const Bytes &old){
+  Bytes image(old.begin(), old.begin() + 50000);
+  for(int i = 0; i < 1000; i++){
+    image.push_back((uint8_t)(i * 7));
+  }
+  image.insert(image.end(), old.begin() + 50000, old.end());
+  for(size_t at = 0; at + 4 <= image.size(); at += 16){
+    uint32_t address = get32(image, at);
+    if(address >= 0x400d0000 + 50000 && address < 0x400d0000 + 200000){
+      put32(image, at, address + 1000);
+    }
+  }
+  for(size_t i = 120000; i < 124000; i++){
+    image[i] ^= 0x5a;
+  }
+  for(int i = 0; i < 3000; i++){
+    image.push_back((uint8_t)(rand() >> 7));
+  }
+  return image;
+}
+
+static Bytes gunzip(const Bytes &in){
+  z_stream z;
+  memset(&z, 0, sizeof(z));
+  inflateInit2(&z, 15 + 16);
+  Bytes out(in.size() * 20 + 100000);
+  z.next_in = (Bytes::value_type *)in.data();
+  z.avail_in = in.size();
+  z.next_out = out.data();
+  z.avail_out = out.size();
+  int r = inflate(&z, Z_FINISH);
+  out.resize(r == Z_STREAM_END ? z.total_out : 0);
+  inflateEnd(&z);
+  return out;
+}
+
+/*applies patch to base, true if applydelta failed with message and left
+no new image*/
+static bool failsWith(const std::string &applydelta, const char *base, const char *patch, const char *key,
+                      const char *message){
+  unlink("deltasign.new");
+  std::string out;
+  int status = run(applydelta + " " + base + " " + patch + " deltasign.new --public " + key, out);
+  bool ok = status == 1 && out.find(message) != std::string::npos && access("deltasign.new", F_OK) != 0;
+  if(!ok){
+    printf("%s", out.c_str());
+  }
+  return ok;
+}
+
+int main(int argc, char **argv){
+  if(argc != 3){
+    fprintf(stderr, "usage: %s MKDELTA APPLYDELTA\n", argv[0]);
+    return 2;
+  }
+  std::string mkdelta = argv[1], applydelta = argv[2];
+  Bytes old = oldImage(), now = newImage(old);
+  Bytes otherOld = old;
+  otherOld[100] ^= 1;
+  if(!writeFile("deltasign.old", old) || !writeFile("deltasign.now", now) ||
+     !writeFile("deltasign.other", otherOld)){
+    perror("deltasign: writing the images");
+    return 2;
+  }
+  const char *keys[] = {"deltasign.key", "deltasign.key.pub", "deltasign.wrong", "deltasign.wrong.pub"};
+  for(size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++){
+    unlink(keys[i]);
+  }
+
+  std::string out;
+  check(run(mkdelta + " --genkey deltasign.key", out) == 0 && run(mkdelta + " --genkey deltasign.wrong", out) == 0 &&
+        readFile("deltasign.key.pub").size() == 32 && readFile("deltasign.wrong.pub").size() == 32,
+        "mkdelta --genkey writes two key pairs");
+  check(run(mkdelta + " deltasign.old deltasign.now deltasign.delta --key deltasign.key", out) == 0,
+        "mkdelta makes a signed patch");
+  Bytes patch = readFile("deltasign.delta");
+  printf("%s", out.c_str());
+
+  const char *chunks[] = {"1", "1460"};
+  bool same = !patch.empty();
+  for(size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++){
+    unlink("deltasign.new");
+    std::string command = applydelta + " deltasign.old deltasign.delta deltasign.new --public deltasign.key.pub";
+    same = same && run(command + " --chunk " + chunks[i], out) == 0 && readFile("deltasign.new") == now;
+  }
+  printf("%s", out.c_str());
+  check(same, "applydelta writes the new image, a byte at a time or 1460");
+
+  check(failsWith(applydelta, "deltasign.old", "deltasign.delta", "deltasign.wrong.pub", "bad signature"),
+        "another key: DELTA_BAD_SIGNATURE");
+
+  /*the header is the first thing in the plain patch: magic, sizes,
+  hashes, then the signature. Changed copies go out plain, lib/Delta
+  takes those too*/
+  Bytes plain = gunzip(patch);
+  const size_t signatureAt = 4 + 4 + 4 + 32 + 32;
+  Bytes badSignature = plain, badBlock = plain;
+  if(plain.size() > signatureAt + 64 + 12 + 100){
+    badSignature[signatureAt + 10] ^= 0x01;
+    /*a byte of the first block's add or extra bytes*/
+    badBlock[signatureAt + 64 + 12 + 50] ^= 0x01;
+  }
+  check(!plain.empty() && writeFile("deltasign.badsig", badSignature) && writeFile("deltasign.badblock", badBlock) &&
+        writeFile("deltasign.plain", plain), "the patch inflates with zlib");
+  unlink("deltasign.new");
+  check(run(applydelta + " deltasign.old deltasign.plain deltasign.new --public deltasign.key.pub", out) == 0 &&
+        readFile("deltasign.new") == now, "the plain patch applies the same");
+  check(failsWith(applydelta, "deltasign.old", "deltasign.badsig", "deltasign.key.pub", "bad signature"),
+        "a changed signature: DELTA_BAD_SIGNATURE");
+  check(failsWith(applydelta, "deltasign.old", "deltasign.badblock", "deltasign.key.pub", "new image hash differs"),
+        "a block changed after signing: DELTA_BAD_HASH");
+  check(failsWith(applydelta, "deltasign.other", "deltasign.delta", "deltasign.key.pub", "made for another image"),
+        "another old image: DELTA_WRONG_BASE");
+
+  printf("%s\n", failures == 0 ? "all passed" : "FAILED");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,243 @@
+/*Records into the lib/FlightRecorder ring the way the station does,
+dumps it like the f serial command and runs the dump through
+tools/trace2chrome.
+
+- the ring wraps past the first boot, the trace starts with what came
+  before the oldest boot and shows the next boot as its own process
+- every B has its E, spans still open at a boot or at the end are closed
+  there and marked unfinished
+- HTTP phases are async spans by request number, flushes from another
+  thread land on the display track
+- timestamps never go backwards
+- threads recording flat out while another one reads the ring never make
+  it return an event mixed from two writes
+
+usage: flightring TRACE2CHROME, exit status 0 if every check passed*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FlightRecorder.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char *what){
+  printf("%-62s %s\n", what, ok ? "ok" : "FAILED");
+  if(!ok){
+    failures++;
+  }
+}
+
+/*one line of trace2chrome's output*/
+struct TraceLine {
+  std::string name, ph;
+  int pid = -1, tid = -1;
+  long long ts = 0;
+  bool unfinished = false;
+  std::string text;
+};
+
+static std::string field(const char *line, const char *key){
+  const char *at = strstr(line, key);
+  if(at == NULL){
+    return "";
+  }
+  at += strlen(key);
+  const char *end = at;
+  while(*end && *end != '"' && *end != ',' && *end != '}'){
+    end++;
+  }
+  return std::string(at, end);
+}
+
+static std::vector<TraceLine> readTrace(const char *path){
+  std::vector<TraceLine> lines;
+  FILE *in = fopen(path, "r");
+  if(in == NULL){
+    return lines;
+  }
+  char line[512];
+  while(fgets(line, sizeof(line), in) != NULL){
+    if(strstr(line, "\"ph\":") == NULL){
+      continue;
+    }
+    TraceLine t;
+    t.name = field(line, "\"name\":\"");
+    t.ph = field(line, "\"ph\":\"");
+    t.pid = atoi(field(line, "\"pid\":").c_str());
+    std::string tid = field(line, "\"tid\":");
+    t.tid = tid.empty() ? -1 : atoi(tid.c_str());
+    t.ts = atoll(field(line, "\"ts\":").c_str());
+    t.unfinished = strstr(line, "\"unfinished\":true") != NULL;
+    t.text = line;
+    lines.push_back(t);
+  }
+  fclose(in);
+  return lines;
+}
+
+static int count(const std::vector<TraceLine> &trace, const char *name, const char *ph, int pid = -1){
+  int n = 0;
+  for(size_t i = 0; i < trace.size(); i++){
+    if(trace[i].name == name && trace[i].ph == ph && (pid < 0 || trace[i].pid == pid)){
+      n++;
+    }
+  }
+  return n;
+}
+
+static bool has(const std::vector<TraceLine> &trace, const char *text){
+  for(size_t i = 0; i < trace.size(); i++){
+    if(trace[i].text.find(text) != std::string::npos){
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool unfinished(const std::vector<TraceLine> &trace, const char *name, int pid){
+  for(size_t i = 0; i < trace.size(); i++){
+    if(trace[i].name == name && trace[i].pid == pid && trace[i].unfinished){
+      return true;
+    }
+  }
+  return false;
+}
+
+static void dump(const char *path){
+  FILE *out = fopen(path, "w");
+  char line[96];
+  formatFlightHeader(line, sizeof(line));
+  fprintf(out, "some serial output first\n%s\n", line);
+  FlightEvent event;
+  for(uint32_t i = 0; i < flightCount(); i++){
+    if(flightGet(i, event)){
+      formatFlightEvent(event, line, sizeof(line));
+      fprintf(out, "%s\n", line);
+    }
+  }
+  fclose(out);
+}
+
+static void trace(const char *trace2chrome){
+  flightStart(1);
+  /*more than the ring holds, the first boot falls out of it*/
+  for(int i = 0; i < FLIGHT_RECORDER_EVENTS; i++){
+    FlightScope pass(FLIGHT_PASS);
+    FlightScope wait(FLIGHT_WAIT);
+  }
+  flightRecord(FLIGHT_RENDER, FLIGHT_BEGIN, 3);
+  flightRecord(FLIGHT_HTTP_CONNECT, FLIGHT_BEGIN, 7);
+  flightRecord(FLIGHT_HTTP_CONNECT, FLIGHT_END, 7);
+  flightRecord(FLIGHT_HTTP_BODY, FLIGHT_BEGIN, 7);
+  std::thread flush([]{ FlightScope scope(FLIGHT_FLUSH, 0xff); });
+  flush.join();
+
+  /*a watchdog reset while rendering and downloading*/
+  flightStart(12);
+  flightRecord(FLIGHT_WIFI_UP, FLIGHT_INSTANT);
+  {
+    FlightScope dht(FLIGHT_DHT);
+  }
+  flightRecord(FLIGHT_PASS, FLIGHT_BEGIN);
+
+  dump("flightring.txt");
+  std::string command = std::string(trace2chrome) + " flightring.txt -o flightring.json";
+  check(system(command.c_str()) == 0, "trace2chrome reads the dump");
+  std::vector<TraceLine> t = readTrace("flightring.json");
+
+  check(has(t, "before the oldest boot") && has(t, "boot 1, reset reason 12") && !has(t, "reset reason 1\""),
+        "the ring wrapped past boot 1, boot 2 is process 1");
+  int begins = 0, ends = 0;
+  bool ordered = true;
+  long long last = 0;
+  for(size_t i = 0; i < t.size(); i++){
+    if(t[i].ph == "B") begins++;
+    if(t[i].ph == "E") ends++;
+    if(t[i].ph != "M"){
+      ordered = ordered && t[i].ts >= last;
+      last = t[i].ts;
+    }
+  }
+  check(begins > 0 && begins == ends, "every B has its E");
+  int passes = count(t, "pass", "B", 0);
+  check(passes > FLIGHT_RECORDER_EVENTS / 5 && abs(count(t, "wait", "B", 0) - passes) <= 1,
+        "the passes and waits held by the ring are in the trace");
+  check(unfinished(t, "render", 0) && unfinished(t, "body", 0) && unfinished(t, "pass", 1),
+        "spans open at the boot and at the end are unfinished");
+  check(!unfinished(t, "connect", 0) && !unfinished(t, "flush", 0) && !unfinished(t, "dht", 1),
+        "closed spans aren't");
+  check(has(t, "{\"name\":\"connect\",\"ph\":\"b\",\"pid\":0,\"tid\":1,") &&
+        has(t, "{\"name\":\"connect\",\"ph\":\"e\",\"pid\":0,\"tid\":1,") && has(t, "\"cat\":\"http\",\"id\":7"),
+        "HTTP phases are async spans by request number");
+  check(has(t, "{\"name\":\"flush\",\"ph\":\"B\",\"pid\":0,\"tid\":2,") &&
+        has(t, "{\"name\":\"wifi_up\",\"ph\":\"i\",\"pid\":1,\"tid\":3,"),
+        "flushes and WiFi events are on their own tracks");
+  check(ordered, "timestamps never go backwards");
+}
+
+/*id and phase follow from arg, an event mixed from two writes breaks
+that. The top bit tells them from what trace() left in the ring*/
+#define WRITER_ARG 0x8000
+
+static FlightEventId expectedId(uint16_t arg){
+  return (FlightEventId)(FLIGHT_DHT + arg % 4);
+}
+
+static void concurrent(){
+  const int writers = 4, events = 200000;
+  std::atomic<int> running(writers);
+  std::atomic<uint32_t> read(0), mixed(0);
+  std::vector<std::thread> threads;
+  for(int w = 0; w < writers; w++){
+    threads.push_back(std::thread([&, w]{
+      for(int i = 0; i < events; i++){
+        uint16_t arg = (uint16_t)(WRITER_ARG | ((i * writers + w) & 0x7fff));
+        flightRecord(expectedId(arg), (FlightPhase)(arg % 3), arg);
+      }
+      running--;
+    }));
+  }
+  threads.push_back(std::thread([&]{
+    while(running > 0){
+      FlightEvent event;
+      for(uint32_t i = 0; i < flightCount(); i++){
+        if(!flightGet(i, event) || !(event.arg & WRITER_ARG)){
+          continue;
+        }
+        read++;
+        if(event.id != expectedId(event.arg) || event.phase != event.arg % 3){
+          mixed++;
+        }
+      }
+    }
+  }));
+  for(size_t i = 0; i < threads.size(); i++){
+    threads[i].join();
+  }
+  printf("%lu events read while %d threads recorded\n", (unsigned long)read, writers);
+  check(read > 0 && mixed == 0, "no event read mixed from two writes");
+  FlightEvent event;
+  bool all = flightCount() == FLIGHT_RECORDER_EVENTS;
+  for(uint32_t i = 0; i < flightCount(); i++){
+    all = all && flightGet(i, event);
+  }
+  check(all, "the whole ring reads back once they're done");
+}
+
+int main(int argc, char **argv){
+  if(argc != 2){
+    fprintf(stderr, "usage: %s TRACE2CHROME\n", argv[0]);
+    return 2;
+  }
+  trace(argv[1]);
+  concurrent();
+  printf("%s\n", failures == 0 ? "all passed" : "FAILED");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,201 @@
+/*Runs lib/Gzip's GzipInflater on real gzip streams made by zlib.
+
+- random bytes, random letters and forecast-like text at levels 0, 1, 6
+  and 9 (stored, fixed and dynamic blocks) inflate to what went in, fed
+  1, 2, 3, 7, 64, 1000 and 4096 bytes at a time and all at once
+- a stream with every optional header field (extra, name, comment,
+  header CRC) inflates whichever byte it is split at
+- a changed CRC or length in the trailer fails with GZIP_BAD_CHECKSUM,
+  a stream cut short is never done(), a changed header fails
+- with a 32 kB window nothing zlib makes reaches too far, with a small
+  one the references past it fail with GZIP_TOO_FAR
+
+usage: gzipinflate, exit status 0 if every check passed*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+#include "GzipInflater.h"
+
+typedef std::vector<uint8_t> Bytes;
+
+static int failures = 0;
+
+static void check(bool ok, const char *what){
+  printf("%-58s %s\n", what, ok ? "ok" : "FAILED");
+  if(!ok){
+    failures++;
+  }
+}
+
+/*gzip at level, with every optional header field if full*/
+static Bytes compress(const Bytes &data, int level, bool full = false){
+  z_stream z;
+  memset(&z, 0, sizeof(z));
+  deflateInit2(&z, level, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY);
+  gz_header header;
+  memset(&header, 0, sizeof(header));
+  static unsigned char extra[] = "station extra field";
+  static unsigned char name[] = "forecast.json";
+  static unsigned char comment[] = "from the test";
+  if(full){
+    header.extra = extra;
+    header.extra_len = sizeof(extra);
+    header.name = name;
+    header.comment = comment;
+    header.hcrc = 1;
+    deflateSetHeader(&z, &header);
+  }
+  Bytes out(deflateBound(&z, data.size()) + 128);
+  z.next_in = (Bytes::value_type *)data.data();
+  z.avail_in = data.size();
+  z.next_out = out.data();
+  z.avail_out = out.size();
+  deflate(&z, Z_FINISH);
+  out.resize(z.total_out);
+  deflateEnd(&z);
+  return out;
+}
+
+static void collect(const uint8_t *data, size_t len, void *context){
+  Bytes &out = *(Bytes *)context;
+  out.insert(out.end(), data, data + len);
+}
+
+struct Inflated {
+  Bytes out;
+  GzipResult result;
+  bool done;
+  GzipError error;
+  uint32_t farthest;
+};
+
+/*feeds stream in pieces of chunk bytes, or split once at splitAt when
+chunk is 0*/
+static Inflated inflate(const Bytes &stream, size_t chunk, size_t splitAt = 0, size_t windowSize = 32768){
+  static uint8_t window[32768];
+  GzipInflater inflater(window, windowSize);
+  Inflated r;
+  inflater.begin(collect, &r.out);
+  r.result = GZIP_MORE;
+  std::vector<size_t> cuts;
+  if(chunk == 0){
+    cuts.push_back(splitAt);
+  }else{
+    for(size_t at = chunk; at < stream.size(); at += chunk){
+      cuts.push_back(at);
+    }
+  }
+  cuts.push_back(stream.size());
+  size_t at = 0;
+  for(size_t i = 0; i < cuts.size() && r.result == GZIP_MORE; i++){
+    r.result = inflater.feed(stream.data() + at, cuts[i] - at);
+    at = cuts[i];
+  }
+  r.done = inflater.done();
+  r.error = inflater.error();
+  r.farthest = inflater.farthest();
+  return r;
+}
+
+/*random over symbols values, 256 doesn't compress and zlib stores it,
+fewer makes dynamic blocks with no repeats to speak of*/
+static Bytes randomBytes(size_t n, int symbols){
+  Bytes b(n);
+  srand(42);
+  for(size_t i = 0; i < n; i++){
+    b[i] = (uint8_t)('a' + (rand() >> 7) % symbols);
+  }
+  return b;
+}
+
+/*something like a 5 day forecast, repetitive but not too much*/
+static Bytes forecastText(int slots){
+  std::string text = "{\"cod\":\"200\",\"message\":0,\"cnt\":40,\"list\":[";
+  srand(7);
+  for(int i = 0; i < slots; i++){
+    char slot[256];
+    snprintf(slot, sizeof(slot),
+             "%s{\"dt\":%d,\"main\":{\"temp\":%d.%02d,\"humidity\":%d},\"weather\":[{\"id\":%d,"
+             "\"main\":\"Clouds\",\"description\":\"scattered clouds\"}],\"dt_txt\":\"2026-10-%02d %02d:00:00\"}",
+             i ? "," : "", 1792396800 + i * 10800, 270 + rand() % 30, rand() % 100, 40 + rand() % 60,
+             800 + rand() % 5, 19 + i / 8, i % 8 * 3);
+    text += slot;
+  }
+  text += "]}";
+  return Bytes(text.begin(), text.end());
+}
+
+int main(){
+  const int levels[] = {0, 1, 6, 9};
+  const size_t chunks[] = {1, 2, 3, 7, 64, 1000, 4096, 1 << 30};
+  struct Input {
+    const char *name;
+    Bytes data;
+  } inputs[] = {{"random", randomBytes(100000, 256)}, {"random letters", randomBytes(100000, 16)},
+                {"text", forecastText(400)}};
+
+  char what[96];
+  for(size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++){
+    for(size_t l = 0; l < sizeof(levels) / sizeof(levels[0]); l++){
+      Bytes stream = compress(inputs[i].data, levels[l]);
+      bool all = true;
+      uint32_t farthest = 0;
+      for(size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++){
+        Inflated r = inflate(stream, chunks[c]);
+        all = all && r.result == GZIP_DONE && r.done && r.out == inputs[i].data;
+        farthest = r.farthest;
+      }
+      snprintf(what, sizeof(what), "%s %lu bytes, level %d, %lu gzip bytes, every chunk size", inputs[i].name,
+               (unsigned long)inputs[i].data.size(), levels[l], (unsigned long)stream.size());
+      check(all && farthest <= 32768, what);
+    }
+  }
+
+  Bytes small = forecastText(12);
+  Bytes full = compress(small, 6, true);
+  bool every = true;
+  for(size_t at = 0; at <= full.size(); at++){
+    Inflated r = inflate(full, 0, at);
+    every = every && r.result == GZIP_DONE && r.out == small;
+  }
+  snprintf(what, sizeof(what), "all header fields, split at each of %lu bytes", (unsigned long)full.size());
+  check(every, what);
+
+  Bytes text = forecastText(400);
+  Bytes stream = compress(text, 9);
+  Bytes badCrc = stream, badLength = stream, badHeader = stream;
+  badCrc[stream.size() - 8] ^= 0x01;
+  badLength[stream.size() - 1] ^= 0x80;
+  badHeader[2] = 7;
+  Inflated r = inflate(badCrc, 1000);
+  check(r.result == GZIP_ERROR && r.error == GZIP_BAD_CHECKSUM && !r.done && r.out.size() == text.size(),
+        "a changed CRC fails after the whole body");
+  r = inflate(badLength, 1);
+  check(r.result == GZIP_ERROR && r.error == GZIP_BAD_CHECKSUM && !r.done, "a changed length fails");
+  r = inflate(badHeader, 64);
+  check(r.result == GZIP_ERROR && r.error == GZIP_BAD_HEADER && r.out.empty(), "a method other than deflate fails");
+  bool cut = true;
+  for(size_t keep = 0; keep < stream.size(); keep += 97){
+    Bytes shorter(stream.begin(), stream.begin() + keep);
+    r = inflate(shorter, 64);
+    cut = cut && r.result == GZIP_MORE && !r.done;
+  }
+  r = inflate(Bytes(stream.begin(), stream.end() - 1), 1);
+  check(cut && r.result == GZIP_MORE && !r.done, "a stream cut short is never done");
+
+  r = inflate(stream, 1000, 0, 1024);
+  bool tooFar = r.result == GZIP_ERROR && r.error == GZIP_TOO_FAR;
+  r = inflate(stream, 1000, 0, 32768);
+  snprintf(what, sizeof(what), "references reach %lu bytes, a 1 kB window fails", (unsigned long)r.farthest);
+  check(tooFar && r.done && r.farthest > 1024, what);
+
+  printf("%s\n", failures == 0 ? "all passed" : "FAILED");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,20 @@
+/*Just enough of the Arduino core for lib/I2cBus and lib/Sensors to run in
+the host tests. millis() is a clock the test sets and delay() moves, so
+conversion times pass without waiting*/
+#ifndef HOST_TEST_ARDUINO_H
+#define HOST_TEST_ARDUINO_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Print.h"
+
+extern uint32_t hostMillis;
+
+inline uint32_t millis() { return hostMillis; }
+inline void delay(uint32_t ms) { hostMillis += ms; }
+inline void yield() {}
+
+#endif
@@ -0,0 +1,50 @@
+#include "freertos/semphr.h"
+
+#include <condition_variable>
+#include <mutex>
+
+static std::mutex critical;
+
+void hostEnterCritical(){
+  critical.lock();
+}
+
+void hostExitCritical(){
+  critical.unlock();
+}
+
+struct HostSemaphore {
+  std::mutex mutex;
+  std::condition_variable given;
+  bool full = false;
+};
+
+SemaphoreHandle_t xSemaphoreCreateBinary(){
+  return new HostSemaphore;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore){
+  delete semaphore;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks){
+  std::unique_lock<std::mutex> lock(semaphore->mutex);
+  if(ticks == portMAX_DELAY){
+    semaphore->given.wait(lock, [semaphore]{ return semaphore->full; });
+  }
+  if(!semaphore->full){
+    return pdFALSE;
+  }
+  semaphore->full = false;
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore){
+  std::lock_guard<std::mutex> lock(semaphore->mutex);
+  if(semaphore->full){
+    return pdFALSE;
+  }
+  semaphore->full = true;
+  semaphore->given.notify_one();
+  return pdTRUE;
+}
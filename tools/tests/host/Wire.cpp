@@ -0,0 +1,42 @@
+#include "Wire.h"
+
+#include <string.h>
+
+void TwoWire::beginTransmission(uint8_t to){
+  address = to & 0x7f;
+  outLen = 0;
+}
+
+size_t TwoWire::write(uint8_t byte){
+  return write(&byte, 1);
+}
+
+size_t TwoWire::write(const uint8_t *bytes, size_t len){
+  size_t n = len < sizeof(out) - outLen ? len : sizeof(out) - outLen;
+  memcpy(out + outLen, bytes, n);
+  outLen += n;
+  return n;
+}
+
+uint8_t TwoWire::endTransmission(bool stop){
+  (void)stop;
+  transactions++;
+  FakeI2cDevice *device = devices[address];
+  return device != NULL && device->written(out, outLen) ? 0 : 2;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t from, uint8_t len){
+  transactions++;
+  FakeI2cDevice *device = devices[from & 0x7f];
+  inAt = 0;
+  inLen = 0;
+  if(device == NULL || len > sizeof(in) || !device->read(in, len)){
+    return 0;
+  }
+  inLen = len;
+  return len;
+}
+
+int TwoWire::read(){
+  return inAt < inLen ? in[inAt++] : -1;
+}
@@ -0,0 +1,43 @@
+/*TwoWire as lib/I2cBus uses it, in front of fake devices. A transaction
+to an address without a device is not acknowledged*/
+#ifndef HOST_TEST_WIRE_H
+#define HOST_TEST_WIRE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Arduino.h"
+
+class FakeI2cDevice {
+ public:
+  virtual ~FakeI2cDevice() {}
+  /*a write transaction, false for no acknowledge*/
+  virtual bool written(const uint8_t *bytes, size_t len) = 0;
+  /*a read of len bytes, false for no acknowledge*/
+  virtual bool read(uint8_t *bytes, size_t len) = 0;
+};
+
+class TwoWire {
+ public:
+  void attach(uint8_t address, FakeI2cDevice *device) { devices[address & 0x7f] = device; }
+
+  void beginTransmission(uint8_t address);
+  size_t write(uint8_t byte);
+  size_t write(const uint8_t *bytes, size_t len);
+  /*0 when acknowledged, 2 (address not acknowledged) otherwise*/
+  uint8_t endTransmission(bool stop = true);
+  uint8_t requestFrom(uint8_t address, uint8_t len);
+  int read();
+
+  uint32_t transactions = 0;
+
+ private:
+  FakeI2cDevice *devices[128] = {};
+  uint8_t address = 0;
+  uint8_t out[64];
+  size_t outLen = 0;
+  uint8_t in[64];
+  size_t inLen = 0, inAt = 0;
+};
+
+#endif
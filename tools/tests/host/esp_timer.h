@@ -0,0 +1,15 @@
+/*esp_timer_get_time() on the host's monotonic clock, the bus statistics
+are taken with real threads*/
+#ifndef HOST_TEST_ESP_TIMER_H
+#define HOST_TEST_ESP_TIMER_H
+
+#include <stdint.h>
+#include <time.h>
+
+inline int64_t esp_timer_get_time(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+#endif
@@ -0,0 +1,25 @@
+/*The FreeRTOS calls lib/I2cBus makes, on std::thread primitives. A
+critical section is one process wide mutex, like interrupts off on a
+single core*/
+#ifndef HOST_TEST_FREERTOS_H
+#define HOST_TEST_FREERTOS_H
+
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+#define pdTRUE 1
+#define pdFALSE 0
+#define portMAX_DELAY 0xffffffffUL
+
+typedef struct {
+  int unused;
+} portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0}
+
+void hostEnterCritical();
+void hostExitCritical();
+#define portENTER_CRITICAL(mux) ((void)(mux), hostEnterCritical())
+#define portEXIT_CRITICAL(mux) ((void)(mux), hostExitCritical())
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef HOST_TEST_SEMPHR_H
+#define HOST_TEST_SEMPHR_H
+
+#include "FreeRTOS.h"
+
+typedef struct HostSemaphore *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateBinary();
+void vSemaphoreDelete(SemaphoreHandle_t semaphore);
+/*only portMAX_DELAY and 0 are told apart*/
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+
+#endif
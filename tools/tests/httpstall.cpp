@@ -0,0 +1,176 @@
+/*Runs lib/AsyncHttp against a local server that stops answering.
+
+A thread listens on 127.0.0.1 and, for each case, accepts the request and
+then sends nothing, stops halfway through the headers, or stops halfway
+through the body. The request must fail with ASYNC_HTTP_TIMEOUT in the
+phase it stalled in, and elapsed() must be the timeout plus at most a
+poll's worth of slack, however long the server keeps the socket open.
+
+Then a port nobody listens on refuses the connection, which must drop the
+cached address so the next request to the host asks DNS again.
+
+usage: httpstall, exit status 0 if every case passed*/
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <thread>
+
+#include "AsyncHttp.h"
+#include "FlightRecorder.h"
+
+/*the request's deadline, and how far past it the failure may come*/
+static const uint32_t TIMEOUT_MS = 300;
+static const uint32_t SLACK_MS = 100;
+/*a hung request ends the test here instead of hanging ctest*/
+static const uint32_t GIVE_UP_MS = 5000;
+
+struct StallCase {
+  const char *name;
+  const char *sent; //before the server goes quiet
+  AsyncHttpState stalledIn;
+  uint32_t bodyBytes;
+};
+
+static const StallCase cases[] = {
+  {"accept", "", ASYNC_HTTP_HEADERS, 0},
+  {"headers", "HTTP/1.0 200 OK\r\nContent-Type: text/plain\r\nContent-Le", ASYNC_HTTP_HEADERS, 0},
+  {"body", "HTTP/1.0 200 OK\r\nContent-Length: 1000\r\n\r\n0123456789", ASYNC_HTTP_BODY, 10},
+};
+static const int caseCount = sizeof(cases) / sizeof(cases[0]);
+
+/*serves the cases in order, one connection each. The socket stays open
+until the client gives up and closes it*/
+static void serve(int listener){
+  for(int i = 0; i < caseCount; i++){
+    int fd = accept(listener, NULL, NULL);
+    if(fd < 0){
+      return;
+    }
+    char buf[512];
+    size_t got = 0;
+    while(got < sizeof(buf) - 1){
+      ssize_t n = recv(fd, buf + got, sizeof(buf) - 1 - got, 0);
+      if(n <= 0){
+        break;
+      }
+      got += n;
+      buf[got] = '\0';
+      if(strstr(buf, "\r\n\r\n") != NULL){
+        break;
+      }
+    }
+    send(fd, cases[i].sent, strlen(cases[i].sent), 0);
+    while(recv(fd, buf, sizeof(buf), 0) > 0){
+    }
+    close(fd);
+  }
+}
+
+static bool run(const StallCase &c, uint16_t port){
+  char url[64];
+  snprintf(url, sizeof(url), "http://127.0.0.1:%u/stall", (unsigned)port);
+  AsyncHttpRequest request;
+  if(!request.start(url, TIMEOUT_MS, NULL, NULL)){
+    printf("%-8s start failed: %s\n", c.name, AsyncHttpRequest::errorName(request.error()));
+    return false;
+  }
+  AsyncHttpState last = request.getState();
+  uint32_t startedAt = asyncHttpMillis();
+  while(request.poll()){
+    last = request.getState();
+    if(asyncHttpMillis() - startedAt > GIVE_UP_MS){
+      request.cancel();
+      printf("%-8s still running after %lu ms\n", c.name, (unsigned long)GIVE_UP_MS);
+      return false;
+    }
+    usleep(1000);
+  }
+
+  bool ok = request.error() == ASYNC_HTTP_TIMEOUT && last == c.stalledIn && request.elapsed() >= TIMEOUT_MS &&
+            request.elapsed() <= TIMEOUT_MS + SLACK_MS && request.bodyBytes() == c.bodyBytes;
+  printf("%-8s %s after %lu ms in state %d with %lu body bytes%s\n", c.name,
+         AsyncHttpRequest::errorName(request.error()), (unsigned long)request.elapsed(), (int)last,
+         (unsigned long)request.bodyBytes(), ok ? "" : "  FAILED");
+  return ok;
+}
+
+/*DNS lookups recorded in the flight recorder so far*/
+static int dnsLookups(){
+  int n = 0;
+  FlightEvent event;
+  for(uint32_t i = 0; i < flightCount(); i++){
+    if(flightGet(i, event) && event.id == FLIGHT_DNS && event.phase == FLIGHT_BEGIN){
+      n++;
+    }
+  }
+  return n;
+}
+
+/*two requests to a closed port, each has to look the host up*/
+static bool refused(){
+  int probe = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(addr);
+  bind(probe, (struct sockaddr *)&addr, sizeof(addr));
+  getsockname(probe, (struct sockaddr *)&addr, &len);
+  close(probe);
+
+  char url[64];
+  snprintf(url, sizeof(url), "http://localhost:%u/closed", (unsigned)ntohs(addr.sin_port));
+  int before = dnsLookups();
+  bool ok = true;
+  for(int i = 0; i < 2; i++){
+    AsyncHttpRequest request;
+    if(request.start(url, TIMEOUT_MS, NULL, NULL)){
+      while(request.poll()){
+        usleep(1000);
+      }
+    }
+    ok = ok && request.error() == ASYNC_HTTP_CONNECT_FAILED;
+  }
+  int lookups = dnsLookups() - before;
+  ok = ok && lookups == 2;
+  printf("%-8s connect failed twice with %d DNS lookups%s\n", "refused", lookups, ok ? "" : "  FAILED");
+  return ok;
+}
+
+int main(){
+  flightStart(0);
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(addr);
+  if(listener < 0 || bind(listener, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listener, 4) < 0 ||
+     getsockname(listener, (struct sockaddr *)&addr, &len) < 0){
+    perror("httpstall: listen");
+    return 1;
+  }
+
+  std::thread server(serve, listener);
+  int failed = 0;
+  for(int i = 0; i < caseCount; i++){
+    if(!run(cases[i], ntohs(addr.sin_port))){
+      failed++;
+    }
+  }
+  /*a case that never connected leaves the server waiting in accept()*/
+  shutdown(listener, SHUT_RDWR);
+  server.join();
+  close(listener);
+
+  printf("%d of %d cases timed out as they should\n", caseCount - failed, caseCount);
+  if(!refused()){
+    failed++;
+  }
+  return failed == 0 ? 0 : 1;
+}
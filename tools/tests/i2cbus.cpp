@@ -0,0 +1,146 @@
+/*Runs the lib/I2cBus ticket lock with real threads standing in for the
+loop and the display's flush task.
+
+- the bus is held by one client at a time, however many hammer it
+- waiting clients get it in the order they asked
+- a client that releases and asks again goes behind one already waiting
+- transactions, failures and waits are counted per client
+- clients past I2C_BUS_MAX_CLIENTS are refused
+
+usage: i2cbus, exit status 0 if every check passed*/
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "I2cBus.h"
+
+uint32_t hostMillis = 0;
+
+static int failures = 0;
+
+static void check(bool ok, const char *what){
+  printf("%-58s %s\n", what, ok ? "ok" : "FAILED");
+  if(!ok){
+    failures++;
+  }
+}
+
+/*the order clients got the bus in*/
+struct Turns {
+  std::mutex mutex;
+  std::vector<int> order;
+
+  void add(int client){
+    std::lock_guard<std::mutex> lock(mutex);
+    order.push_back(client);
+  }
+};
+
+static void exclusion(){
+  TwoWire wire;
+  I2cBus bus(wire);
+  bus.begin();
+  const int threads = 4, rounds = 2000;
+  std::atomic<int> holders(0), overlaps(0), started(0);
+  std::vector<std::thread> workers;
+  for(int t = 0; t < threads; t++){
+    int client = bus.addClient("worker");
+    workers.push_back(std::thread([&, client]{
+      /*all at once, not one after the other as they are created*/
+      started++;
+      while(started < threads){
+      }
+      for(int i = 0; i < rounds; i++){
+        bus.acquire(client);
+        if(holders.fetch_add(1) != 0){
+          overlaps++;
+        }
+        for(volatile int spin = 0; spin < 500; spin++){
+        }
+        holders.fetch_sub(1);
+        bus.release(client, i % 100 != 0);
+      }
+    }));
+  }
+  for(size_t t = 0; t < workers.size(); t++){
+    workers[t].join();
+  }
+
+  check(overlaps == 0, "4 threads x 2000 transactions, never two on the bus");
+  bool counted = true;
+  for(int c = 0; c < threads; c++){
+    I2cClientStats s = bus.clientStats(c);
+    counted = counted && s.transactions == (uint32_t)rounds && s.failed == (uint32_t)rounds / 100 &&
+              s.maxWaitUs * (uint64_t)rounds >= s.waitUs;
+  }
+  check(counted, "transactions, failures and waits counted per client");
+  check(bus.utilization() > 0 && bus.utilization() <= 1, "utilization between 0 and 1");
+}
+
+/*starts a thread that asks for the bus once and gives it back, and waits
+until it's surely queued*/
+static std::thread queue(I2cBus &bus, int client, Turns &turns){
+  std::thread waiter([&bus, client, &turns]{
+    bus.acquire(client);
+    turns.add(client);
+    bus.release(client);
+  });
+  usleep(20000);
+  return waiter;
+}
+
+static void order(){
+  TwoWire wire;
+  I2cBus bus(wire);
+  bus.begin();
+  int holder = bus.addClient("holder");
+  int a = bus.addClient("a"), b = bus.addClient("b"), c = bus.addClient("c");
+  Turns turns;
+
+  bus.acquire(holder);
+  std::thread first = queue(bus, b, turns);
+  std::thread second = queue(bus, c, turns);
+  std::thread third = queue(bus, a, turns);
+  check(turns.order.empty(), "nobody gets the bus while it's held");
+  bus.release(holder);
+  first.join();
+  second.join();
+  third.join();
+  check(turns.order == std::vector<int>({b, c, a}), "waiting clients get the bus in the order they asked");
+
+  /*the holder asks again right after releasing, a is already waiting*/
+  turns.order.clear();
+  bus.acquire(holder);
+  std::thread waiting = queue(bus, a, turns);
+  bus.release(holder);
+  bus.acquire(holder);
+  turns.add(holder);
+  bus.release(holder);
+  waiting.join();
+  check(turns.order == std::vector<int>({a, holder}), "releasing and asking again goes behind a waiting client");
+  check(bus.clientStats(a).maxWaitUs >= 10000, "a queued client's wait is counted");
+}
+
+static void clients(){
+  TwoWire wire;
+  I2cBus bus(wire);
+  bool ok = true;
+  for(int i = 0; i < I2C_BUS_MAX_CLIENTS; i++){
+    ok = ok && bus.addClient("client") == i;
+  }
+  check(ok && bus.addClient("one too many") == -1 && bus.clientCount() == I2C_BUS_MAX_CLIENTS,
+        "clients past I2C_BUS_MAX_CLIENTS are refused");
+}
+
+int main(){
+  exclusion();
+  order();
+  clients();
+  printf("%s\n", failures == 0 ? "all passed" : "FAILED");
+  return failures == 0 ? 0 : 1;
+}
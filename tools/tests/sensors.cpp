@@ -0,0 +1,255 @@
+/*Runs the I2C sensors of lib/Sensors through start(), ready() and read()
+against fake devices on a fake bus, with millis() moved by hand.
+
+SHT31: not ready before its 16 ms, a read while it still converts is not
+acknowledged, the result is decoded and a bad CRC is refused.
+
+BME280: ready() doesn't touch the bus before the typical 8 ms, asks the
+status register until 10 ms and not after, begin() sets humidity
+oversampling before start() triggers forced mode, the readings match the
+datasheet's compensation example and a sensor that measured nothing is
+refused.
+
+Sensors that don't answer fail begin() and start().
+
+usage: sensors, exit status 0 if every check passed*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Bme280Sensor.h"
+#include "Sht31Sensor.h"
+
+uint32_t hostMillis = 1000;
+
+static int failures = 0;
+
+static void check(bool ok, const char *what){
+  printf("%-62s %s\n", what, ok ? "ok" : "FAILED");
+  if(!ok){
+    failures++;
+  }
+}
+
+static bool near(float value, float expected, float tolerance){
+  return fabsf(value - expected) <= tolerance;
+}
+
+static uint8_t crc8(const uint8_t *bytes, size_t len){
+  uint8_t crc = 0xff;
+  for(size_t i = 0; i < len; i++){
+    crc ^= bytes[i];
+    for(int bit = 0; bit < 8; bit++){
+      crc = crc & 0x80 ? (crc << 1) ^ 0x31 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+/*single shots take 15 ms, reading before that isn't acknowledged*/
+class FakeSht31 : public FakeI2cDevice {
+ public:
+  uint16_t temperature = 0x6666, humidity = 0x8000;
+  bool corrupt = false;
+  uint16_t lastCommand = 0;
+
+  bool written(const uint8_t *bytes, size_t len) override {
+    if(len != 2){
+      return false;
+    }
+    lastCommand = bytes[0] << 8 | bytes[1];
+    if(lastCommand == 0x2400){
+      measuring = true;
+      startedAt = millis();
+    }
+    return true;
+  }
+
+  bool read(uint8_t *bytes, size_t len) override {
+    if(len != 6 || !measuring || millis() - startedAt < 15){
+      return false;
+    }
+    measuring = false;
+    bytes[0] = temperature >> 8;
+    bytes[1] = temperature & 0xff;
+    bytes[2] = crc8(bytes, 2) ^ (corrupt ? 1 : 0);
+    bytes[3] = humidity >> 8;
+    bytes[4] = humidity & 0xff;
+    bytes[5] = crc8(bytes + 3, 2);
+    return true;
+  }
+
+ private:
+  bool measuring = false;
+  uint32_t startedAt = 0;
+};
+
+/*registers with an auto-incrementing pointer, a forced measurement
+reports busy in status bit 3 for 9 ms*/
+class FakeBme280 : public FakeI2cDevice {
+ public:
+  uint8_t registers[256];
+  uint32_t statusReads = 0;
+  bool measuredYet = false;
+
+  FakeBme280(){
+    memset(registers, 0, sizeof(registers));
+    registers[0xd0] = 0x60;
+    /*the calibration of the datasheet's compensation example*/
+    static const uint16_t words[] = {27504, 26435, (uint16_t)-1000, 36477, (uint16_t)-10685, 3024, 2855, 140,
+                                     (uint16_t)-7, 15500, (uint16_t)-14600, 6000};
+    for(int i = 0; i < 12; i++){
+      registers[0x88 + 2 * i] = words[i] & 0xff;
+      registers[0x89 + 2 * i] = words[i] >> 8;
+    }
+    registers[0xa1] = 75;
+    /*H2 362, H3 0, H4 313, H5 50, H6 30*/
+    static const uint8_t humidity[] = {0x6a, 0x01, 0x00, 0x13, 0x29, 0x03, 0x1e};
+    memcpy(registers + 0xe1, humidity, sizeof(humidity));
+    /*the reset values of the data registers*/
+    setRaw(0x80000, 0x80000, 0x8000);
+  }
+
+  void setRaw(uint32_t pressure, uint32_t temperature, uint16_t humidity){
+    uint8_t *d = registers + 0xf7;
+    d[0] = pressure >> 12;
+    d[1] = pressure >> 4;
+    d[2] = (pressure & 0x0f) << 4;
+    d[3] = temperature >> 12;
+    d[4] = temperature >> 4;
+    d[5] = (temperature & 0x0f) << 4;
+    d[6] = humidity >> 8;
+    d[7] = humidity & 0xff;
+  }
+
+  bool written(const uint8_t *bytes, size_t len) override {
+    if(len == 0){
+      return false;
+    }
+    pointer = bytes[0];
+    for(size_t i = 1; i < len; i++){
+      registers[(uint8_t)(pointer + i - 1)] = bytes[i];
+      if(pointer + i - 1 == 0xf4 && (bytes[i] & 0x03) == 0x01){
+        forcedAt = millis();
+        forced = true;
+        humidityOn = registers[0xf2] == 0x01;
+      }
+    }
+    return true;
+  }
+
+  bool read(uint8_t *bytes, size_t len) override {
+    if(forced && millis() - forcedAt >= 9){
+      forced = false;
+      measuredYet = true;
+      setRaw(415148, 519888, 30000);
+    }
+    if(pointer == 0xf3){
+      statusReads++;
+      registers[0xf3] = forced ? 0x08 : 0x00;
+    }
+    for(size_t i = 0; i < len; i++){
+      bytes[i] = registers[(uint8_t)(pointer + i)];
+    }
+    return true;
+  }
+
+  bool humidityOn = false;
+
+ private:
+  uint8_t pointer = 0;
+  bool forced = false;
+  uint32_t forcedAt = 0;
+};
+
+static void sht31(){
+  TwoWire wire;
+  I2cBus bus(wire);
+  FakeSht31 device;
+  wire.attach(0x44, &device);
+  Sht31Sensor sensor(bus);
+  SensorReading r;
+
+  check(sensor.begin() && device.lastCommand == 0x30a2, "sht31: begin() soft-resets the sensor");
+  check(sensor.start() && device.lastCommand == 0x2400, "sht31: start() asks for a single shot");
+  check(!sensor.ready(), "sht31: not ready right after start()");
+  check(!sensor.read(r) && isnan(r.temperature) && isnan(r.humidity), "sht31: a read while converting fails");
+  hostMillis += 15;
+  check(!sensor.ready(), "sht31: not ready at 15 ms");
+  hostMillis += 1;
+  check(sensor.ready(), "sht31: ready at 16 ms");
+  check(sensor.read(r) && near(r.temperature, 25.0f, 0.01f) && near(r.humidity, 50.0f, 0.01f) &&
+        isnan(r.pressure), "sht31: reads 25.00 C and 50.00 %");
+
+  device.corrupt = true;
+  sensor.start();
+  hostMillis += 16;
+  check(sensor.ready() && !sensor.read(r) && isnan(r.temperature), "sht31: a bad CRC is refused");
+
+  Sht31Sensor absent(bus, 0x45);
+  check(!absent.begin() && !absent.start(), "sht31: nothing at 0x45, begin() and start() fail");
+  I2cClientStats s = bus.clientStats(0);
+  check(s.transactions > 0 && s.failed > 0, "sht31: its transactions and failures are on the bus stats");
+}
+
+/*the datasheet's floating point compensation of humidity*/
+static double referenceHumidity(double tFine, double adcH){
+  double h = tFine - 76800.0;
+  h = (adcH - (313 * 64.0 + 50 / 16384.0 * h)) *
+      (362 / 65536.0 * (1.0 + 30 / 67108864.0 * h * (1.0 + 0 / 67108864.0 * h)));
+  h = h * (1.0 - 75 * h / 524288.0);
+  return h < 0 ? 0 : h > 100 ? 100 : h;
+}
+
+static void bme280(){
+  TwoWire wire;
+  I2cBus bus(wire);
+  FakeBme280 device;
+  wire.attach(0x76, &device);
+  Bme280Sensor sensor(bus);
+  SensorReading r;
+
+  check(sensor.begin() && device.registers[0xf2] == 0x01, "bme280: begin() reads the trimming, sets ctrl_hum");
+  check(sensor.start() && device.registers[0xf4] == 0x25 && device.humidityOn,
+        "bme280: start() triggers forced mode with humidity on");
+
+  uint32_t before = wire.transactions;
+  check(!sensor.ready() && wire.transactions == before, "bme280: not ready, bus untouched before 8 ms");
+  hostMillis += 7;
+  check(!sensor.ready() && wire.transactions == before, "bme280: still untouched at 7 ms");
+  hostMillis += 1;
+  check(!sensor.ready() && device.statusReads == 1, "bme280: asks the status at 8 ms, still measuring");
+  hostMillis += 1;
+  check(sensor.ready() && device.statusReads == 2, "bme280: done at 9 ms by the status register");
+  hostMillis += 1;
+  before = wire.transactions;
+  check(sensor.ready() && wire.transactions == before, "bme280: ready at 10 ms without asking");
+
+  check(sensor.read(r), "bme280: read() after the measurement");
+  check(near(r.temperature, 25.08f, 0.005f), "bme280: 25.08 C from the datasheet example");
+  check(near(r.pressure, 1006.53f, 0.02f), "bme280: 1006.53 hPa from the datasheet example");
+  /*t_fine of the example is 128422*/
+  double humidity = referenceHumidity(128422, 30000);
+  check(near(r.humidity, (float)humidity, 0.1f), "bme280: humidity matches the floating point formula");
+
+  FakeBme280 fresh;
+  TwoWire otherWire;
+  I2cBus otherBus(otherWire);
+  otherWire.attach(0x77, &fresh);
+  Bme280Sensor unmeasured(otherBus, 0x77);
+  check(unmeasured.begin() && !unmeasured.read(r) && isnan(r.temperature),
+        "bme280: the reset value of the data registers is refused");
+
+  Bme280Sensor absent(bus, 0x77);
+  check(!absent.begin() && !absent.start(), "bme280: nothing at 0x77, begin() and start() fail");
+  device.registers[0xd0] = 0x58;
+  Bme280Sensor bmp(bus);
+  check(!bmp.begin(), "bme280: a BMP280 chip id is refused");
+}
+
+int main(){
+  sht31();
+  bme280();
+  printf("%s\n", failures == 0 ? "all passed" : "FAILED");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,203 @@
+/*Runs the https path of lib/AsyncHttp, built with ASYNC_HTTP_TLS and
+ASYNC_HTTP_TLS_RTC_SESSIONS against the host's mbedtls, against a local
+OpenSSL server.
+
+- https before any CA is set fails with ASYNC_HTTP_NO_CA and the server
+  never sees a connection
+- the first request to a host does a full handshake, the next one offers
+  the cached session and the server resumes it, and resumed() tells them
+  apart
+- with the RAM cache gone, as after deep sleep, the session comes back
+  from the RTC copy
+- a certificate for another name, or one that doesn't chain to the CA
+  given, fails with ASYNC_HTTP_TLS_FAILED and the request never goes out.
+  Setting other CAs drops the cached sessions, so a resumed handshake
+  can't skip the check
+
+It prints the average full and resumed handshake, mostly public key math
+on this machine and nothing like the ESP32's numbers, but the ratio is
+telling.
+
+usage: tlsresume DIR, DIR holds ca.pem, other-ca.pem, server.pem and
+server.key. Exit status 0 if every check passed*/
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+#include <mbedtls/x509_crt.h>
+
+#include "AsyncHttp.h"
+
+static const uint32_t TIMEOUT_MS = 5000;
+/*handshakes of each kind the averages are taken over*/
+static const int ROUNDS = 20;
+
+static int failures = 0;
+/*requests the server read to the end*/
+static std::atomic<int> served(0);
+/*whether the server resumed the last session it answered on, and
+whether resumed() always said the same*/
+static std::atomic<bool> serverResumed(false);
+static bool agreed = true;
+
+static void check(bool ok, const char *what){
+  printf("%-58s %s\n", what, ok ? "ok" : "FAILED");
+  if(!ok){
+    failures++;
+  }
+}
+
+static std::string readFile(const std::string &path){
+  std::string text;
+  FILE *in = fopen(path.c_str(), "r");
+  if(in == NULL){
+    return text;
+  }
+  char buf[1024];
+  size_t n;
+  while((n = fread(buf, 1, sizeof(buf), in)) > 0){
+    text.append(buf, n);
+  }
+  fclose(in);
+  return text;
+}
+
+/*one connection at a time until the listener is shut down. Handshakes
+the client gives up on just end the connection*/
+static void serve(int listener, SSL_CTX *ctx){
+  for(;;){
+    int fd = accept(listener, NULL, NULL);
+    if(fd < 0){
+      return;
+    }
+    SSL *ssl = SSL_new(ctx);
+    SSL_set_fd(ssl, fd);
+    if(SSL_accept(ssl) == 1){
+      char buf[512];
+      std::string request;
+      int n;
+      while(request.find("\r\n\r\n") == std::string::npos && (n = SSL_read(ssl, buf, sizeof(buf))) > 0){
+        request.append(buf, n);
+      }
+      if(request.find("\r\n\r\n") != std::string::npos){
+        serverResumed = SSL_session_reused(ssl) == 1;
+        served++;
+        const char *answer = "HTTP/1.0 200 OK\r\nContent-Length: 2\r\n\r\nok";
+        SSL_write(ssl, answer, strlen(answer));
+      }
+      SSL_shutdown(ssl);
+    }
+    ERR_clear_error();
+    SSL_free(ssl);
+    close(fd);
+  }
+}
+
+static void collect(const uint8_t *data, size_t len, void *context){
+  ((std::string *)context)->append((const char *)data, len);
+}
+
+/*one GET, false if it didn't come back with the server's answer*/
+static bool get(const char *host, uint16_t port, AsyncHttpRequest &request){
+  char url[96];
+  snprintf(url, sizeof(url), "https://%s:%u/", host, (unsigned)port);
+  std::string body;
+  if(!request.start(url, TIMEOUT_MS, collect, &body)){
+    return false;
+  }
+  while(request.poll()){
+    usleep(200);
+  }
+  if(request.error() != ASYNC_HTTP_OK || request.status() != 200 || body != "ok"){
+    return false;
+  }
+  agreed = agreed && request.resumed() == serverResumed;
+  return true;
+}
+
+int main(int argc, char **argv){
+  if(argc != 2){
+    fprintf(stderr, "usage: %s DIR\n", argv[0]);
+    return 2;
+  }
+  std::string dir = argv[1];
+  std::string ca = readFile(dir + "/ca.pem"), otherCa = readFile(dir + "/other-ca.pem");
+
+  SSL_CTX *ctx = SSL_CTX_new(TLS_server_method());
+  if(ctx == NULL || ca.empty() || otherCa.empty() ||
+     SSL_CTX_use_certificate_chain_file(ctx, (dir + "/server.pem").c_str()) != 1 ||
+     SSL_CTX_use_PrivateKey_file(ctx, (dir + "/server.key").c_str(), SSL_FILETYPE_PEM) != 1){
+    fprintf(stderr, "tlsresume: can't load the certificates from %s\n", dir.c_str());
+    return 1;
+  }
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(addr);
+  if(listener < 0 || bind(listener, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listener, 4) < 0 ||
+     getsockname(listener, (struct sockaddr *)&addr, &len) < 0){
+    perror("tlsresume: listen");
+    return 1;
+  }
+  uint16_t port = ntohs(addr.sin_port);
+  std::thread server(serve, listener, ctx);
+
+  AsyncHttpRequest request;
+  check(!get("localhost", port, request) && request.error() == ASYNC_HTTP_NO_CA && served == 0,
+        "no CA set, the request isn't even sent");
+  check(asyncHttpSetCaCerts(ca.c_str()), "the CA certificate parses");
+
+  bool full = get("localhost", port, request) && !request.resumed();
+  check(full, "the first request does a full handshake");
+  bool resumed = get("localhost", port, request) && request.resumed();
+  check(resumed, "the next one resumes the session");
+
+  uint32_t fullMs = 0, resumedMs = 0;
+  for(int i = 0; i < ROUNDS; i++){
+    asyncHttpForgetSessions(true);
+    full = get("localhost", port, request) && !request.resumed() && full;
+    fullMs += request.handshakeTime();
+    resumed = get("localhost", port, request) && request.resumed() && resumed;
+    resumedMs += request.handshakeTime();
+  }
+  check(full && resumed, "forgotten sessions make it full again, every time");
+  printf("handshake over %d rounds: full %.1f ms, resumed %.1f ms on average\n", ROUNDS,
+         (double)fullMs / ROUNDS, (double)resumedMs / ROUNDS);
+
+  asyncHttpForgetSessions(false);
+  check(get("localhost", port, request) && request.resumed(), "after deep sleep the RTC copy resumes");
+  check(agreed, "resumed() matches what the server did, every time");
+
+  int before = served;
+  check(!get("127.0.0.1", port, request) && request.error() == ASYNC_HTTP_TLS_FAILED &&
+        request.tlsError() == MBEDTLS_ERR_X509_CERT_VERIFY_FAILED,
+        "a certificate for another name fails");
+  check(asyncHttpSetCaCerts(otherCa.c_str()), "the other CA certificate parses");
+  check(!get("localhost", port, request) && request.error() == ASYNC_HTTP_TLS_FAILED &&
+        request.tlsError() == MBEDTLS_ERR_X509_CERT_VERIFY_FAILED && !request.resumed(),
+        "with another CA it fails, the old session isn't offered");
+  check(served == before, "neither request reached the server");
+
+  asyncHttpSetCaCerts(ca.c_str());
+  check(get("localhost", port, request) && !request.resumed(), "the right CA again needs a full handshake");
+
+  shutdown(listener, SHUT_RDWR);
+  server.join();
+  close(listener);
+  SSL_CTX_free(ctx);
+  printf("%s\n", failures == 0 ? "all passed" : "FAILED");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,263 @@
+/*Turns a flight recorder dump into a Chrome trace.
+
+Type f in the serial monitor, save what it prints ("@FR" and "@FE" lines,
+see lib/FlightRecorder/FlightRecorder.h) and run this over it. Open the
+result in chrome://tracing or ui.perfetto.dev. Anything else in the file
+is skipped, so a whole serial log will do. With more than one dump in it
+the last one is used.
+
+Each boot in the ring is its own process, with a thread per track: the
+loop's passes, waits, reads and renders nested in each other, the display
+flushes and the WiFi events. HTTP requests overlap the loop and each
+other, they are async spans grouped by request number.
+
+micros() wraps every 71 minutes, event times are taken as the nearest
+to the one before, so the trace is right as long as no two events in a
+row are more than 35 minutes apart. A boot continues the timeline 1 ms
+after the last event before it. A span still open when a boot comes, or
+at the end, was what the station was doing right then. It's closed there
+and marked unfinished.
+
+usage: trace2chrome [FILE] [-o OUT]*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "FlightRecorder.h"
+
+/*where a boot continues after the events before it*/
+static const int64_t BOOT_GAP_US = 1000;
+
+struct Options {
+  const char *file = NULL;
+  const char *out = NULL;
+};
+
+static bool parseOptions(int argc, char **argv, Options &opt){
+  for(int i = 1; i < argc; i++){
+    if(strcmp(argv[i], "-o") == 0 && i + 1 < argc){
+      opt.out = argv[++i];
+    }else if(argv[i][0] != '-' && opt.file == NULL){
+      opt.file = argv[i];
+    }else{
+      return false;
+    }
+  }
+  return true;
+}
+
+struct OpenSpan {
+  int pid;
+  int track;
+  uint8_t id;
+  uint16_t arg;
+};
+
+class TraceWriter {
+ public:
+  explicit TraceWriter(FILE *out) : out(out) {}
+
+  void begin(){
+    fputs("{\"traceEvents\":[\n", out);
+  }
+
+  void add(const FlightEvent &event){
+    if(!started && event.id != FLIGHT_BOOT){
+      names(0, -1);
+    }
+    int64_t time = unwrap(event);
+    const FlightEventInfo &info = flightEvents[event.id];
+    if(event.id == FLIGHT_BOOT){
+      closeAll(pid, last);
+      pid++;
+      names(pid, event.arg);
+    }
+    last = time;
+    int track = info.track;
+
+    if(event.phase == FLIGHT_INSTANT){
+      write(pid, track, info.name, "i", time, event.arg, ",\"s\":\"t\"");
+    }else if(track == FLIGHT_TRACK_HTTP){
+      /*request phases are async spans, one id per request*/
+      char extra[48];
+      snprintf(extra, sizeof(extra), ",\"cat\":\"http\",\"id\":%u", (unsigned)event.arg);
+      if(event.phase == FLIGHT_BEGIN){
+        write(pid, track, info.name, "b", time, event.arg, extra);
+        open.push_back({pid, track, event.id, event.arg});
+      }else if(close(track, event.id, event.arg)){
+        write(pid, track, info.name, "e", time, event.arg, extra);
+      }
+    }else if(event.phase == FLIGHT_BEGIN){
+      write(pid, track, info.name, "B", time, event.arg, "");
+      open.push_back({pid, track, event.id, event.arg});
+    }else if(close(track, event.id, event.arg)){
+      write(pid, track, info.name, "E", time, event.arg, "");
+    }
+    /*an end without its begin started before the oldest event held*/
+  }
+
+  void end(){
+    closeAll(pid, last);
+    fputs("\n]}\n", out);
+  }
+
+  int boots() const { return pid; }
+
+ private:
+  int64_t unwrap(const FlightEvent &event){
+    if(!started){
+      started = true;
+      raw = event.time;
+      return 0;
+    }
+    int64_t time;
+    if(event.id == FLIGHT_BOOT){
+      time = last + BOOT_GAP_US;
+    }else{
+      /*tasks read the clock after claiming their slot, so neighbours can
+      be a few us out of order*/
+      time = now + (int32_t)(event.time - raw);
+    }
+    raw = event.time;
+    now = time;
+    return time;
+  }
+
+  bool close(int track, uint8_t id, uint16_t arg){
+    for(size_t i = open.size(); i-- > 0;){
+      const OpenSpan &span = open[i];
+      if(span.pid == pid && span.track == track && span.id == id &&
+         (track != FLIGHT_TRACK_HTTP || span.arg == arg)){
+        open.erase(open.begin() + i);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void closeAll(int which, int64_t time){
+    for(size_t i = open.size(); i-- > 0;){
+      const OpenSpan &span = open[i];
+      if(span.pid != which){
+        continue;
+      }
+      char extra[64];
+      const char *phase = "E";
+      if(span.track == FLIGHT_TRACK_HTTP){
+        snprintf(extra, sizeof(extra), ",\"cat\":\"http\",\"id\":%u", (unsigned)span.arg);
+        phase = "e";
+      }else{
+        extra[0] = '\0';
+      }
+      write(span.pid, span.track, flightEvents[span.id].name, phase, time, span.arg, extra, true);
+      open.erase(open.begin() + i);
+    }
+  }
+
+  /*pid 0 is whatever came before the first boot in the ring, its reset
+  reason is gone with the boot event*/
+  void names(int which, int resetReason){
+    char name[48];
+    if(resetReason < 0){
+      snprintf(name, sizeof(name), "before the oldest boot");
+    }else{
+      snprintf(name, sizeof(name), "boot %d, reset reason %d", which, resetReason);
+    }
+    separator();
+    fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"%s\"}}", which, name);
+    for(int track = 0; track < FLIGHT_TRACK_COUNT; track++){
+      separator();
+      fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+              which, track, flightTrackNames[track]);
+    }
+  }
+
+  void write(int which, int track, const char *name, const char *phase, int64_t time, uint16_t arg,
+             const char *extra, bool unfinished = false){
+    separator();
+    fprintf(out, "{\"name\":\"%s\",\"ph\":\"%s\",\"pid\":%d,\"tid\":%d,\"ts\":%lld%s,\"args\":{\"arg\":%u%s}}",
+            name, phase, which, track, (long long)time, extra, (unsigned)arg, unfinished ? ",\"unfinished\":true" : "");
+  }
+
+  void separator(){
+    if(!first){
+      fputs(",\n", out);
+    }
+    first = false;
+  }
+
+  FILE *out;
+  bool first = true;
+  bool started = false;
+  uint32_t raw = 0;
+  int64_t now = 0, last = 0;
+  int pid = 0;
+  std::vector<OpenSpan> open;
+};
+
+int main(int argc, char **argv){
+  Options opt;
+  if(!parseOptions(argc, argv, opt)){
+    fprintf(stderr, "usage: %s [FILE] [-o OUT]\n", argv[0]);
+    return 2;
+  }
+  FILE *in = opt.file ? fopen(opt.file, "r") : stdin;
+  if(in == NULL){
+    perror(opt.file);
+    return 2;
+  }
+
+  /*the last dump in the file*/
+  std::vector<FlightEvent> events;
+  unsigned long boots = 0, count = 0, capacity = 0;
+  bool header = false;
+  uint32_t skipped = 0;
+  char line[256];
+  while(fgets(line, sizeof(line), in) != NULL){
+    const char *at = strstr(line, "@FR ");
+    if(at != NULL && sscanf(at, "@FR %lu %lu %lu", &boots, &count, &capacity) == 3){
+      header = true;
+      events.clear();
+      skipped = 0;
+      continue;
+    }
+    at = strstr(line, "@FE ");
+    if(at == NULL || !header){
+      continue;
+    }
+    FlightEvent event;
+    if(parseFlightEvent(at, event)){
+      events.push_back(event);
+    }else{
+      skipped++;
+    }
+  }
+  if(in != stdin){
+    fclose(in);
+  }
+  if(!header){
+    fprintf(stderr, "no @FR line, type f in the serial monitor to get a dump\n");
+    return 1;
+  }
+
+  FILE *out = opt.out ? fopen(opt.out, "w") : stdout;
+  if(out == NULL){
+    perror(opt.out);
+    return 2;
+  }
+  TraceWriter writer(out);
+  writer.begin();
+  for(size_t i = 0; i < events.size(); i++){
+    writer.add(events[i]);
+  }
+  writer.end();
+  if(out != stdout){
+    fclose(out);
+  }
+
+  fprintf(stderr, "%zu of %lu events (ring of %lu, %lu boots since power on), %d boots in the trace, %u lines not understood\n",
+          events.size(), count, capacity, boots, writer.boots(), (unsigned)skipped);
+  return 0;
+}